@@ -7,6 +7,19 @@
 #include <tll/util/bench.h>
 #include <tll/util/ownedmsg.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 template <typename R, typename... Args>
 [[nodiscard]]
 R fail(R err, tll::logger::format_string<Args...> format, Args && ... args)
@@ -40,6 +53,40 @@ int post(tll::Channel * c, const tll_msg_t * msg)
 	return c->post(msg);
 }
 
+/// CPU timestamp counter or nanoseconds on platforms without it
+inline unsigned long long cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct Result
+{
+	std::string name;
+	std::string mode;
+	size_t count = 0;
+	size_t msgsize = 0;
+	nanoseconds time = {};
+
+	// Pair benchmark results
+	size_t received = 0;
+	std::vector<long long> latency; ///< Sorted latency samples, ns
+	double post_cycles = 0;
+	double process_cycles = 0;
+
+	long long percentile(double q) const
+	{
+		if (latency.empty())
+			return 0;
+		return latency[std::min(latency.size() - 1, (size_t) (q * latency.size()))];
+	}
+};
+
+std::vector<Result> results;
+
 std::string bench_name(const tll::Channel::Url &cfg)
 {
 	auto name = cfg.get("bench-name");
@@ -85,9 +132,10 @@ int timeit_post(tll::channel::Context &ctx, const tll::Channel::Url &url, bool c
 	if (!c.get())
 		return -1;
 
-	timeit(count, bench_name(url), post, c.get(), msg);
+	auto dt = timeit(count, bench_name(url), post, c.get(), msg);
 	if (callback && !counter)
 		fmt::print("Callback was added but not called\n");
+	results.push_back({ .name = bench_name(url), .mode = "post", .count = count, .msgsize = msg->size, .time = dt });
 	return 0;
 }
 
@@ -118,12 +166,290 @@ int timeit_process(tll::channel::Context &ctx, const tll::Channel::Url &url, boo
 	if (list.size() != 1)
 		return fail(-1, "Channel with several active childs\n");
 
-	timeit(count, bench_name(url), tll_channel_process, list[0], 0, 0);
+	auto dt = timeit(count, bench_name(url), tll_channel_process, list[0], 0, 0);
 	if (callback && !counter)
 		fmt::print("Callback was added but not called\n");
+	results.push_back({ .name = bench_name(url), .mode = "process", .count = count, .time = dt });
+	return 0;
+}
+
+int process_all(const std::vector<tll::Channel *> &list)
+{
+	int r = EAGAIN;
+	for (auto c : list) {
+		if (c->process() != EAGAIN)
+			r = 0;
+	}
+	return r;
+}
+
+int setaffinity(int cpu)
+{
+	if (cpu < 0)
+		return 0;
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		return fail(EINVAL, "Failed to pin thread to cpu {}: {}\n", cpu, strerror(errno));
+#else
+	fmt::print("CPU affinity not supported on this platform\n");
+#endif
+	return 0;
+}
+
+struct PairSettings
+{
+	int cpu_producer = -1;
+	int cpu_consumer = -1;
+	unsigned window = 256;
+};
+
+struct PairCallback
+{
+	std::vector<long long> latency;
+	std::atomic<size_t> received = 0;
+
+	int callback(const tll::Channel *, const tll_msg_t *m)
+	{
+		if (m->type != TLL_MESSAGE_DATA || m->size < sizeof(long long))
+			return 0;
+		auto idx = received.load(std::memory_order_relaxed);
+		if (idx >= latency.size())
+			return 0;
+		long long ts;
+		memcpy(&ts, m->data, sizeof(ts));
+		latency[idx] = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() - ts;
+		received.store(idx + 1, std::memory_order_release);
+		return 0;
+	}
+};
+
+/*
+ * Producer/consumer benchmark: writer channel is created from url and processed in producer thread,
+ * reader channel is created from 'bench-reader' subtree with writer as master and is processed in
+ * consumer thread. Each message carries send timestamp in first 8 bytes, producer is not allowed to
+ * get more then window messages ahead of consumer to avoid overruns in non-blocking transports.
+ */
+int timeit_pair(tll::channel::Context &ctx, tll::Channel::Url url, unsigned count, const tll_msg_t *msg, const PairSettings &settings)
+{
+	if (msg->size < sizeof(long long))
+		return fail(EINVAL, "Message size {} is too small for pair benchmark, need at least {}\n", msg->size, sizeof(long long));
+
+	tll::Channel::Url rurl;
+	if (url.sub("bench-reader")) {
+		auto r = url.getT<tll::Channel::Url>("bench-reader");
+		if (!r)
+			return fail(EINVAL, "Invalid reader url for {}: {}\n", bench_name(url), r.error());
+		rurl = *r;
+		url.unlink("bench-reader");
+	}
+	auto name = bench_name(url);
+	if (!rurl.has("tll.proto"))
+		rurl.proto(url.proto());
+	if (!rurl.has("name"))
+		rurl.set("name", "reader");
+
+	auto writer = ctx.channel(url);
+	if (!writer)
+		return fail(EINVAL, "Failed to create writer channel {}\n", name);
+	if (writer->open())
+		return fail(EINVAL, "Failed to open writer channel {}\n", name);
+
+	auto reader = ctx.channel(rurl, writer.get());
+	if (!reader)
+		return fail(EINVAL, "Failed to create reader channel for {}\n", name);
+
+	PairCallback cb;
+	cb.latency.resize(count);
+	reader->callback_add(&cb, TLL_MESSAGE_MASK_DATA);
+	auto & received = cb.received;
+
+	if (reader->open())
+		return fail(EINVAL, "Failed to open reader channel for {}\n", name);
+
+	// Process both sides until channels are active and there are no pending events, like accepted connections
+	for (auto end = steady_clock::now() + 1s; steady_clock::now() < end; ) {
+		auto r = process_all(process_list(writer.get()));
+		if (process_all(process_list(reader.get())) != EAGAIN || r != EAGAIN)
+			continue;
+		if (writer->state() == tll::state::Active && reader->state() == tll::state::Active)
+			break;
+		std::this_thread::sleep_for(1ms);
+	}
+	if (writer->state() != tll::state::Active || reader->state() != tll::state::Active)
+		return fail(EINVAL, "Failed to activate channels for {}: writer {}, reader {}\n", name,
+				tll_state_str(writer->state()), tll_state_str(reader->state()));
+
+	std::vector<char> buf((const char *) msg->data, (const char *) msg->data + msg->size);
+	tll_msg_t m = *msg;
+	m.data = buf.data();
+
+	std::atomic<bool> done = false;
+	unsigned long long post_cycles = 0;
+	unsigned long long process_cycles = 0;
+
+	auto start = steady_clock::now();
+
+	std::thread consumer([&]() {
+		if (setaffinity(settings.cpu_consumer))
+			return;
+		auto list = process_list(reader.get());
+		auto last = steady_clock::now();
+		auto seen = received.load();
+		while (received.load(std::memory_order_acquire) < count) {
+			for (auto c : list) {
+				auto t0 = cycles();
+				if (c->process() != EAGAIN)
+					process_cycles += cycles() - t0;
+			}
+			if (auto r = received.load(std::memory_order_relaxed); r != seen) {
+				seen = r;
+				last = steady_clock::now();
+			} else if (done.load(std::memory_order_relaxed) && steady_clock::now() - last > 1s)
+				break;
+		}
+	});
+
+	std::thread producer([&]() {
+		if (setaffinity(settings.cpu_producer)) {
+			done = true;
+			return;
+		}
+		auto list = process_list(writer.get());
+		for (unsigned i = 0; i < count; i++) {
+			if (i - received.load(std::memory_order_acquire) >= settings.window) {
+				auto end = steady_clock::now() + 1s;
+				while (i - received.load(std::memory_order_acquire) >= settings.window) {
+					process_all(list);
+					if (steady_clock::now() > end) {
+						fmt::print("Consumer is stalled for {}, stop after {} messages\n", name, i);
+						done = true;
+						return;
+					}
+				}
+			}
+			m.seq = i;
+			for (;;) {
+				long long ts = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+				memcpy(buf.data(), &ts, sizeof(ts));
+				auto t0 = cycles();
+				auto r = writer->post(&m);
+				post_cycles += cycles() - t0;
+				if (r == 0)
+					break;
+				if (r != EAGAIN) {
+					fmt::print("Failed to post message {} into {}: {}\n", i, name, strerror(r));
+					done = true;
+					return;
+				}
+				process_all(list);
+			}
+		}
+		done = true;
+		while (received.load(std::memory_order_acquire) < count && !process_all(list)) {}
+	});
+
+	producer.join();
+	consumer.join();
+	nanoseconds dt = steady_clock::now() - start;
+
+	Result result = { .name = name, .mode = "pair", .count = count, .msgsize = msg->size, .time = dt };
+	result.received = received.load();
+	cb.latency.resize(result.received);
+	std::sort(cb.latency.begin(), cb.latency.end());
+	result.latency = std::move(cb.latency);
+	if (count)
+		result.post_cycles = (double) post_cycles / count;
+	if (result.received)
+		result.process_cycles = (double) process_cycles / result.received;
+
+	fmt::print("Pair {}: {}/{} messages in {:.3}, {:.0f} msg/s\n", name, result.received, count,
+			std::chrono::duration<double, std::milli>(dt), result.received / std::chrono::duration<double>(dt).count());
+	fmt::print("  latency: min {}ns, p50 {}ns, p99 {}ns, p99.9 {}ns, max {}ns\n",
+			result.percentile(0), result.percentile(0.5), result.percentile(0.99), result.percentile(0.999),
+			result.latency.empty() ? 0 : result.latency.back());
+	fmt::print("  cycles per message: post {:.0f}, process {:.0f}\n", result.post_cycles, result.process_cycles);
+	if (result.received != count)
+		fmt::print("  lost {} messages\n", count - result.received);
+
+	results.push_back(std::move(result));
+
+	reader->close();
+	writer->close();
+	return 0;
+}
+
+std::string json_string(std::string_view s)
+{
+	std::string r = "\"";
+	for (auto c : s) {
+		if (c == '"' || c == '\\')
+			r += '\\';
+		if ((unsigned char) c < 0x20)
+			r += fmt::format("\\u{:04x}", c);
+		else
+			r += c;
+	}
+	return r + "\"";
+}
+
+std::string json_result(const Result &r)
+{
+	auto str = fmt::format("{{\"name\": {}, \"mode\": {}, \"count\": {}, \"msgsize\": {}, \"time\": {}",
+			json_string(r.name), json_string(r.mode), r.count, r.msgsize, r.time.count());
+	if (r.mode != "pair")
+		return str + fmt::format(", \"avg\": {:.3f}}}", r.count ? (double) r.time.count() / r.count : 0.);
+
+	str += fmt::format(", \"received\": {}, \"throughput\": {:.0f}", r.received, r.received / std::chrono::duration<double>(r.time).count());
+	str += ", \"latency\": {";
+	if (r.latency.size()) {
+		double sum = 0;
+		for (auto v : r.latency)
+			sum += v;
+		str += fmt::format("\"min\": {}, \"avg\": {:.0f}, \"max\": {}", r.latency.front(), sum / r.latency.size(), r.latency.back());
+		for (auto & [k, q] : std::initializer_list<std::pair<std::string_view, double>> {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p99.9", 0.999}})
+			str += fmt::format(", \"{}\": {}", k, r.percentile(q));
+	}
+	str += "}";
+	return str + fmt::format(", \"cycles\": {{\"post\": {:.1f}, \"process\": {:.1f}}}}}", r.post_cycles, r.process_cycles);
+}
+
+int json_dump(std::string_view filename)
+{
+	std::string body = "{\"results\": [";
+	for (auto & r : results) {
+		if (&r != &results.front())
+			body += ",";
+		body += "\n  " + json_result(r);
+	}
+	body += "\n]}\n";
+
+	if (filename == "-") {
+		fmt::print("{}", body);
+		return 0;
+	}
+	auto f = fopen(std::string(filename).c_str(), "w");
+	if (!f)
+		return fail(EINVAL, "Failed to open output file {}: {}\n", filename, strerror(errno));
+	fwrite(body.data(), 1, body.size(), f);
+	fclose(f);
 	return 0;
 }
 
+std::vector<std::string> pair_defaults(std::string_view dir, unsigned port)
+{
+	auto prefix = fmt::format("{}/tll-bench-{}", dir, getpid());
+	return {
+		"mem://;size=4mb;bench-name=mem",
+		"ipc://;mode=server;broadcast=yes;size=4mb;bench-name=ipc;bench-reader.mode=client",
+		fmt::format("pub+mem://{0}.pub;mode=server;size=4mb;bench-name=pub+mem;bench-reader.url=pub+mem://{0}.pub;bench-reader.mode=client", prefix),
+		fmt::format("pub+tcp://127.0.0.1:{0};mode=server;size=4mb;bench-name=pub+tcp;bench-reader.url=pub+tcp://127.0.0.1:{0};bench-reader.mode=client", port),
+		fmt::format("file://{0}.dat;dir=w;bench-name=file;bench-reader.url=file://{0}.dat;bench-reader.autoclose=no", prefix),
+	};
+}
+
 std::optional<tll::util::OwnedMessage> payload_read(tll::channel::Context &ctx, const tll::Channel::Url &url, std::string_view open)
 {
 	auto c = ctx.channel(url);
@@ -172,6 +498,11 @@ int main(int argc, char *argv[])
 	std::string config_file;
 	bool callback = false;
 	bool process = false;
+	bool pair = false;
+	PairSettings pair_settings;
+	std::string pair_dir = std::filesystem::temp_directory_path();
+	unsigned pair_port = 5557;
+	std::string json;
 	unsigned count = 10000000;
 	unsigned msgsize = 0;
 	int msgid = 0;
@@ -182,6 +513,13 @@ int main(int argc, char *argv[])
 	parser.add_argument({"-m", "--module"}, "load channel modules", &modules);
 	parser.add_argument({"-c", "--callback"}, "add callback", &callback);
 	parser.add_argument({"--process"}, "run process benchmark", &process);
+	parser.add_argument({"--pair"}, "run producer/consumer benchmark", &pair);
+	parser.add_argument({"--cpu-producer"}, "pin producer thread to cpu", &pair_settings.cpu_producer);
+	parser.add_argument({"--cpu-consumer"}, "pin consumer thread to cpu", &pair_settings.cpu_consumer);
+	parser.add_argument({"--window"}, "max number of messages in flight", &pair_settings.window);
+	parser.add_argument({"--dir"}, "directory for temporary files", &pair_dir);
+	parser.add_argument({"--port"}, "tcp port for default pub+tcp benchmark", &pair_port);
+	parser.add_argument({"--json"}, "write results in JSON format into file, '-' for stdout", &json);
 	parser.add_argument({"-C", "--count"}, "number of iterations", &count);
 	parser.add_argument({"--msgid"}, "message id", &msgid);
 	parser.add_argument({"--msgsize"}, "message size", &msgsize);
@@ -278,8 +616,18 @@ int main(int argc, char *argv[])
 	ctx.reg(&Echo::impl);
 	ctx.reg(&Prefix::impl);
 
-	if (url.empty() && curl.empty())
-		url = {"null://", "prefix+null://", "echo://", "prefix+echo://"};
+	if (pair && count == 10000000)
+		count = 1000000;
+
+	if (pair_settings.window == 0)
+		return fail(1, "Zero window size\n");
+
+	if (url.empty() && curl.empty()) {
+		if (pair)
+			url = pair_defaults(pair_dir, pair_port);
+		else
+			url = {"null://", "prefix+null://", "echo://", "prefix+echo://"};
+	}
 
 	for (auto & u : url) {
 		auto r = tll::Channel::Url::parse(u);
@@ -289,11 +637,23 @@ int main(int argc, char *argv[])
 	}
 	tll::bench::prewarm(100ms);
 	for (auto & u : curl) {
-		if (process)
+		if (pair)
+			timeit_pair(ctx, u, count, &msg, pair_settings);
+		else if (process)
 			timeit_process(ctx, u, callback, count);
 		else
 			timeit_post(ctx, u, callback, count, &msg);
 	}
 
+	if (pair) {
+		std::error_code ec;
+		for (auto & e : std::filesystem::directory_iterator(pair_dir, ec)) {
+			if (e.path().filename().string().rfind(fmt::format("tll-bench-{}.", getpid()), 0) == 0)
+				std::filesystem::remove(e.path(), ec);
+		}
+	}
+
+	if (json.size())
+		return json_dump(json) ? 1 : 0;
 	return 0;
 }
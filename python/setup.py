@@ -17,9 +17,10 @@ setup( name = 'tll'
         'tll.chrono',
         'tll.conv',
         'tll.error',
+        'tll.statfile',
         'tll.test_util',
         ]
-     , scripts = ['tll-pyprocessor', 'tll-schemegen', 'tll-resolve-browse']
+     , scripts = ['tll-pyprocessor', 'tll-schemegen', 'tll-resolve-browse', 'tll-stat-export']
      , include_dirs = ["../src"]
      , cmdclass = {'build_ext': build_ext}
      , ext_modules =
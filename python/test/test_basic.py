@@ -5,10 +5,11 @@ import tll.channel as C
 from tll.config import Config
 from tll.error import TLLError
 from tll.scheme import Scheme
-from tll.stat import Method, Unit
+from tll.stat import FieldGroup, FieldHistogram, Method, Unit
 from tll.test_util import Accum, ports
 from tll.processor import Loop
 
+import errno
 import lz4.block
 import os
 import pytest
@@ -541,11 +542,111 @@ class TestUdpNone(_test_udp_base):
     CLEANUP = ['./test.sock']
     FRAME = []
 
+@pytest.mark.skipif(sys.platform != 'linux', reason='Batching is not supported')
+class TestUdpBatch(_test_udp_base):
+    PROTO = 'udp://127.0.0.1:{};batch-rx=8;batch-tx=8'.format(ports.UDP4)
+
+@pytest.mark.skipif(sys.platform != 'linux', reason='Batching is not supported')
+class TestUdpBatchTS(_test_udp_base):
+    PROTO = 'udp://::1:{};timestamping=yes;timestamping-tx=yes;batch-rx=8;batch-tx=8'.format(ports.UDP6)
+    TIMESTAMP = True
+
+@pytest.mark.skipif(sys.platform != 'linux', reason='Batching is not supported')
+@pytest.mark.parametrize("proto", ['batch-rx=4;batch-tx=4', 'batch-rx=4;batch-tx=4;gro=yes;gso=yes', 'gro=yes;gso=yes;batch-tx=16;timestamping=yes'])
+def test_udp_batch(context, proto):
+    s = Accum(f'udp://127.0.0.1:{ports.UDP4};{proto}', mode='server', name='server', dump='yes', context=context)
+    c = Accum(f'udp://127.0.0.1:{ports.UDP4};{proto}', mode='client', name='client', dump='yes', context=context)
+
+    s.open()
+    c.open()
+
+    spoll = select.poll()
+    spoll.register(s.fd, select.POLLIN)
+
+    for i in range(10):
+        c.post(b'x' * 8, seq=i, msgid=10, flags=c.PostFlags.More)
+    c.post(b'x' * 4, seq=10, msgid=10, flags=c.PostFlags.More)
+    c.post(b'last', seq=11, msgid=20)
+
+    for _ in range(20):
+        if len(s.result) == 12:
+            break
+        spoll.poll(10)
+        s.process()
+
+    assert [(m.seq, m.msgid, m.data.tobytes()) for m in s.result] == [(i, 10, b'x' * 8) for i in range(10)] + [(10, 10, b'xxxx'), (11, 20, b'last')]
+
+@pytest.mark.skipif(sys.platform != 'linux', reason='GSO is not supported')
+def test_udp_gso(context):
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.bind(('127.0.0.1', ports.UDP4))
+    s.settimeout(1)
+
+    c = Accum(f'udp://127.0.0.1:{ports.UDP4};batch-tx=16;gso=yes;stat=yes', mode='client', name='client', context=context)
+    c.open()
+
+    stat = [x for x in context.stat_list if x.name == 'client'][0]
+    def txseq():
+        return [f.value for f in stat.swap() if f.name == 'txseq'][0]
+
+    empty = -2 ** 63 # Last value is not set in this interval
+
+    assert txseq() == empty
+    for i in range(4):
+        c.post(b'x' * 8, seq=i, msgid=10, flags=c.PostFlags.More)
+    assert txseq() == empty # Messages are stored in batch and not sent yet
+    c.post(b'y' * 8, seq=4, msgid=20)
+    assert txseq() == 4
+
+    # Segments of one GSO buffer are received as separate datagrams with std frame: size, msgid, seq
+    result = [s.recv(1024) for _ in range(5)]
+    assert [struct.unpack('<Iiq', r[:16]) + (r[16:],) for r in result] == [(8, 10, i, b'x' * 8) for i in range(4)] + [(8, 20, 4, b'y' * 8)]
+
 @pytest.mark.skipif(sys.platform != 'linux', reason='Network timestamping not supported')
 class TestUdpTS(_test_udp_base):
     PROTO = 'udp://::1:{};timestamping=yes;timestamping-tx=yes'.format(ports.UDP6)
     TIMESTAMP = True
 
+@pytest.mark.skipif(sys.platform != 'linux', reason='Network timestamping not supported')
+@pytest.mark.parametrize("proto", ['', 'batch-rx=4;batch-tx=4'])
+def test_udp_latency_stat(context, proto):
+    url = f'udp://127.0.0.1:{ports.UDP4};timestamping=yes;timestamping-tx=yes;stat=yes;{proto}'
+    s = Accum(url, mode='server', name='server', context=context)
+    c = Accum(url, mode='client', name='client', context=context)
+
+    s.open()
+    c.open()
+
+    spoll = select.poll()
+    spoll.register(s.fd, select.POLLIN)
+    cpoll = select.poll()
+    cpoll.register(c.fd, select.POLLIN)
+
+    for i in range(3):
+        c.post(b'xxx', seq=i)
+
+    for _ in range(20):
+        if len(s.result) == 3:
+            break
+        spoll.poll(10)
+        s.process()
+    assert [m.seq for m in s.result] == [0, 1, 2]
+
+    for _ in range(20):
+        if len([m for m in c.result if m.type == m.Type.Control]) == 3:
+            break
+        cpoll.poll(10)
+        c.process()
+
+    stat = {x.name: {f.name: f for f in x.swap() if isinstance(f, FieldHistogram)} for x in context.stat_list}
+
+    assert stat['server']['rxkern'].count == 3
+    assert stat['server']['rxcb'].count == 3
+    assert 0 <= stat['server']['rxkern'].min <= stat['server']['rxkern'].max < 1000000000
+    assert stat['server']['txkern'].count == 0
+    assert stat['client']['txkern'].count == 3
+    assert 0 <= stat['client']['txkern'].min <= stat['client']['txkern'].max < 1000000000
+
 @pytest.mark.multicast
 class TestMUdp4(_test_udp_base):
     PROTO = 'mudp://239.255.11.12:{};loop=yes'.format(ports.UDP6)
@@ -573,6 +674,105 @@ def test_lz4():
     c.post(b'xxx')
     assert s.state == s.State.Error
 
+def test_delta():
+    scheme = '''yamls://
+- name: Data
+  id: 10
+  fields:
+    - {name: key, type: int32}
+    - {name: f0, type: int64}
+    - {name: f1, type: int64}
+    - {name: f2, type: int64}
+'''
+    s = Accum('delta+direct://', name='server', scheme=scheme, context=ctx, **{'delta.key': 'key', 'delta.max-slots': 2})
+    c = Accum('direct://', name='client', master=s, context=ctx)
+
+    s.open()
+    c.open()
+
+    data = [
+        {'key': 0, 'f0': 100, 'f1': 200, 'f2': 300},
+        {'key': 1, 'f0': 100, 'f1': 200, 'f2': 300},
+        {'key': 0, 'f0': 100, 'f1': 201, 'f2': 300},
+        {'key': 2, 'f0': 100, 'f1': 200, 'f2': 300},
+        {'key': 1, 'f0': 100, 'f1': 200, 'f2': 300},
+        {'key': 0, 'f0': -1, 'f1': -1, 'f2': -1},
+    ]
+    for i, d in enumerate(data):
+        s.post(d, name='Data', seq=i)
+
+    assert [(m.msgid, m.seq) for m in c.result] == [(10, i) for i in range(len(data))]
+    # Header is (slot << 2) | type where type is 0 for raw, 1 for full and 2 for delta
+    assert [m.data.tobytes()[0] for m in c.result] == [0x1, 0x5, 0x2, 0x0, 0x6, 0x1]
+    assert c.result[2].data.tobytes() == bytes([0x2, 28, 12, 1]) + bytes([200 ^ 201])
+    assert c.result[4].data.tobytes() == bytes([0x6, 28])
+    assert s.result == []
+
+    for m in c.result:
+        c.post(m)
+
+    assert [(m.msgid, m.seq) for m in s.result] == [(10, i) for i in range(len(data))]
+    assert [s.unpack(m).as_dict() for m in s.result] == data
+
+    c.post(b'\x0a\x1c\x00\x00')
+    assert s.state == s.State.Error
+
+def test_delta_post_fail():
+    scheme = '''yamls://
+- name: Data
+  id: 10
+  fields:
+    - {name: key, type: int32}
+    - {name: body, type: byte64}
+'''
+    c = Accum('mem://', name='client', size='1kb', context=ctx)
+    s = Accum('delta+mem://', name='server', master=c, scheme=scheme, context=ctx, **{'delta.key': 'key'})
+
+    c.open()
+    s.open()
+
+    with pytest.raises(TLLError) as e:
+        s.post(b'x' * 1024 * 1024, msgid=10)
+    assert e.value.errno == errno.EMSGSIZE
+
+    data = []
+    for i in range(100):
+        d = {'key': i % 2, 'body': f'body {i}'.encode()}
+        try:
+            s.post(d, name='Data', seq=i)
+        except TLLError as e:
+            assert e.errno == errno.EAGAIN
+            break
+        data.append(d)
+    assert len(data) > 2
+
+    # Slot for new key is not created on failure
+    with pytest.raises(TLLError):
+        s.post({'key': 10, 'body': b'new'}, name='Data', seq=100)
+
+    for _ in range(len(data)):
+        c.process()
+    assert len(c.result) == len(data)
+
+    post = [{'key': 0, 'body': b'after'}, {'key': 10, 'body': b'new'}, {'key': 1, 'body': b'after'}]
+    for i, d in enumerate(post):
+        s.post(d, name='Data', seq=200 + i)
+        c.process()
+    data += post
+
+    # Header is (slot << 2) | type where type is 0 for raw, 1 for full and 2 for delta
+    assert [m.data.tobytes()[0] for m in c.result[-3:]] == [0x2, 0x9, 0x6]
+
+    d = Accum('delta+direct://', name='decoder', scheme=scheme, context=ctx, **{'delta.key': 'key'})
+    e = Accum('direct://', name='encoded', master=d, context=ctx)
+    d.open()
+    e.open()
+
+    for m in c.result:
+        e.post(m)
+    result = [d.unpack(m) for m in d.result]
+    assert [(m.key, bytes(m.body).rstrip(b'\0')) for m in result] == [(x['key'], x['body']) for x in data]
+
 def test_lz4_block():
     s = Accum('lz4b+direct://;dump=frame;direct.dump=yes', name='server', context=ctx)
     c = Accum('direct://', name='client', master=s, context=ctx)
@@ -766,3 +966,65 @@ def test_filter(flt):
     s.post(b'', name='Include', seq=200)
     s.post(b'', name='Exclude', seq=300)
     assert [(m.msgid, m.seq) for m in c.result] == [(30, 100), (10, 200)]
+
+def test_validate():
+    SCHEME = '''yamls://
+- name: Sub
+  fields:
+    - {name: s, type: string}
+- name: Data
+  id: 10
+  fields:
+    - {name: i, type: int32}
+    - {name: list, type: '*Sub'}
+    - {name: str, type: string}
+    - {name: arr, type: 'int8[4]'}
+    - {name: u, type: union, union: [{name: i8, type: int8}, {name: s, type: string}]}
+'''
+    s = Accum('validate+direct://', name='server', dir='inout', context=ctx, scheme=SCHEME, dump='frame', stat='yes')
+    c = Accum('direct://', name='client', master=s, context=ctx, scheme=SCHEME, dump='frame')
+
+    s.open()
+    c.open()
+
+    stat = [x for x in ctx.stat_list if x.name == 'server'][0]
+    stat.swap()
+
+    data = s.scheme['Data'].object(i=10, list=[{'s': 'a'}, {'s': 'b'}], str='string', arr=[1, 2], u={'s': 'union'}).pack()
+    assert len(s.scheme['Data'].object().pack()) == 34
+
+    def corrupt(offset, fmt, value):
+        r = bytearray(data)
+        struct.pack_into(fmt, r, offset, value)
+        return bytes(r)
+
+    c.post(data, msgid=10, seq=0)
+    c.post(data, msgid=20, seq=1) # Unknown message
+    c.post(data[:33], msgid=10, seq=2) # Truncated fixed part
+    c.post(data[:-1], msgid=10, seq=3) # Truncated union string
+    c.post(corrupt(4, '<I', len(data)), msgid=10, seq=4) # List offset
+    c.post(corrupt(8, '<I', (8 << 24) | 100), msgid=10, seq=5) # List size
+    c.post(corrupt(8, '<I', (4 << 24) | 2), msgid=10, seq=6) # List entity
+    c.post(corrupt(20, 'b', 5), msgid=10, seq=7) # Array count
+    c.post(corrupt(25, 'b', 2), msgid=10, seq=8) # Union type
+    c.post(data, msgid=10, seq=9)
+
+    assert [(m.msgid, m.seq) for m in s.result] == [(10, 0), (10, 9)]
+    assert {f.name: f.value for f in stat.swap()}['invalid'] == 8
+    assert s.unpack(s.result[0]).as_dict() == {'i': 10, 'list': [{'s': 'a'}, {'s': 'b'}], 'str': 'string', 'arr': [1, 2], 'u': {'s': 'union'}}
+
+    s.post(data, msgid=10, seq=10)
+    with pytest.raises(TLLError): s.post(data[:33], msgid=10, seq=11)
+    assert [(m.msgid, m.seq) for m in c.result] == [(10, 10)]
+
+    c.free()
+    s.free()
+
+    s = Accum('validate+direct://', name='server', context=ctx, scheme=SCHEME, **{'on-error': 'fail'})
+    c = Accum('direct://', name='client', master=s, context=ctx)
+
+    s.open()
+    c.open()
+
+    c.post(data[:33], msgid=10, seq=0)
+    assert s.state == s.State.Error
@@ -482,3 +482,10 @@ def test_open_update(context):
     c.result.clear()
     c.post(b'')
     assert [m.data.tobytes() for m in c.result] == [b"{'a': 'no'}"]
+
+def test_context_time_clock():
+    with pytest.raises(RuntimeError): C.Context(Config.from_dict({'time.clock': 'invalid'}))
+
+    ctx = C.Context(Config.from_dict({'time.clock': 'realtime'}))
+    c = ctx.Channel('null://', name='null')
+    assert c.name == 'null'
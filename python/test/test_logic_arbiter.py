@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+# vim: sts=4 sw=4 et
+
+import pytest
+
+from tll.asynctll import asyncloop_run
+from tll.channel import Context
+
+@pytest.fixture
+def context(path_builddir):
+    ctx = Context()
+    ctx.load(str(path_builddir / 'logic/tll-logic-arbiter'))
+    return ctx
+
+@asyncloop_run
+async def test(asyncloop, mock, context):
+    mock.init(asyncloop, '''yamls://
+mock:
+  a: direct://
+  b: direct://
+  output: direct://
+channel:
+    tll.proto: arbiter
+    name: arbiter
+    tll.channel: {input: 'a, b', output: output}
+    window: 100
+    stall-timeout: 50ms
+    stat: yes
+''')
+
+    mock.open()
+
+    a, b, output = mock.io('a', 'b', 'output')
+    arbiter = mock.channel
+
+    stat = [x for x in context.stat_list if x.name == 'arbiter'][0]
+    stat.swap()
+
+    assert arbiter.config['info.active'] == 'a'
+
+    for i in range(5):
+        a.post(b'a', seq=i)
+    for i in range(5):
+        b.post(b'b', seq=i)
+
+    for i in range(5):
+        m = await arbiter.recv()
+        assert (m.seq, m.data.tobytes()) == (i, b'a')
+        m = await output.recv()
+        assert (m.seq, m.data.tobytes()) == (i, b'a')
+    with pytest.raises(TimeoutError): await arbiter.recv(0.001)
+
+    a.post(b'a', seq=7)
+    b.post(b'b', seq=5)
+    b.post(b'b', seq=6)
+    b.post(b'b', seq=7)
+
+    assert [(m.seq, m.data.tobytes()) for m in [await arbiter.recv() for _ in range(3)]] == [(7, b'a'), (5, b'b'), (6, b'b')]
+    with pytest.raises(TimeoutError): await arbiter.recv(0.001)
+
+    fields = {f.name: f for f in stat.swap()}
+    assert {k: fields[k].value for k in ['dup', 'stale', 'switch', 'awin', 'bwin', 'aloss', 'bloss']} == \
+        {'dup': 6, 'stale': 0, 'switch': 0, 'awin': 6, 'bwin': 2, 'aloss': 2, 'bloss': 0}
+    assert fields['blag'].count == 6
+    assert fields['alag'].count == 0
+
+    await asyncloop.sleep(0.1)
+
+    b.post(b'b', seq=8)
+    assert (await arbiter.recv()).seq == 8
+    assert arbiter.config['info.active'] == 'b'
+
+    b.post(b'b', seq=200)
+    assert (await arbiter.recv()).seq == 200
+    a.post(b'a', seq=9)
+    a.post(b'a', seq=199)
+    assert (await arbiter.recv()).seq == 199
+
+    fields = {f.name: f for f in stat.swap()}
+    assert {k: fields[k].value for k in ['dup', 'stale', 'switch', 'awin', 'bwin']} == \
+        {'dup': 0, 'stale': 1, 'switch': 1, 'awin': 1, 'bwin': 2}
+
+CONFIG = '''yamls://
+mock:
+  a: direct://
+  b: direct://
+  output: direct://
+channel:
+    tll.proto: arbiter
+    name: arbiter
+    tll.channel: {input: 'a, b', output: output}
+    window: 100
+    stall-timeout: 50ms
+    stat: yes
+'''
+
+@asyncloop_run
+async def test_stall_timer(asyncloop, mock, context):
+    mock.init(asyncloop, CONFIG)
+    mock.open()
+
+    a, b, output = mock.io('a', 'b', 'output')
+    arbiter = mock.channel
+
+    stat = [x for x in context.stat_list if x.name == 'arbiter'][0]
+    stat.swap()
+
+    a.post(b'a', seq=0)
+    b.post(b'b', seq=0)
+    assert (await arbiter.recv()).seq == 0
+
+    # Both lines are quiet: active line is switched once, then second line stalls too
+    await asyncloop.sleep(0.2)
+    assert {f.name: f.value for f in stat.swap()}['switch'] == 1
+    assert arbiter.config['info.active'] == 'b'
+
+    # Active line fails while other is still stalled, active is not changed
+    b.post(b'', type=b.Type.State, msgid=int(b.State.Error))
+    assert arbiter.config['info.active'] == 'b'
+    assert arbiter.state == arbiter.State.Active
+
+    # First line is alive again and becomes active
+    a.post(b'a', seq=1)
+    assert (await arbiter.recv()).seq == 1
+    assert arbiter.config['info.active'] == 'a'
+    assert {f.name: f.value for f in stat.swap()}['switch'] == 1
+
+@asyncloop_run
+async def test_reset(asyncloop, mock, context):
+    mock.init(asyncloop, CONFIG)
+    mock.open()
+
+    a, b, output = mock.io('a', 'b', 'output')
+    arbiter = mock.channel
+
+    for i in range(1000, 1003):
+        a.post(b'a', seq=i)
+        b.post(b'b', seq=i)
+    assert [(await arbiter.recv()).seq for _ in range(3)] == [1000, 1001, 1002]
+
+    # Line A restarts sequence, old sequence on line B is dropped until it restarts too
+    a.post(b'a', seq=0)
+    b.post(b'b', seq=1003)
+    a.post(b'a', seq=1)
+    b.post(b'b', seq=0)
+    b.post(b'b', seq=1)
+    b.post(b'b', seq=2)
+
+    assert [(m.seq, m.data.tobytes()) for m in [await arbiter.recv() for _ in range(3)]] == [(0, b'a'), (1, b'a'), (2, b'b')]
+    with pytest.raises(TimeoutError): await arbiter.recv(0.001)
+
+@asyncloop_run
+async def test_mode_active(asyncloop, mock, context):
+    mock.init(asyncloop, CONFIG.replace('window: 100', 'window: 100\n    mode: active'))
+    mock.open()
+
+    a, b, output = mock.io('a', 'b', 'output')
+    arbiter = mock.channel
+
+    assert arbiter.config['info.active'] == 'a'
+
+    a.post(b'a', seq=0)
+    b.post(b'b', seq=0)
+    b.post(b'b', seq=1) # Ahead of active line, dropped
+    a.post(b'a', seq=1)
+    a.post(b'a', seq=3)
+    b.post(b'b', seq=2) # Gap on active line
+    b.post(b'b', seq=3)
+
+    assert [(m.seq, m.data.tobytes()) for m in [await arbiter.recv() for _ in range(4)]] == [(0, b'a'), (1, b'a'), (3, b'a'), (2, b'b')]
+    with pytest.raises(TimeoutError): await arbiter.recv(0.001)
@@ -2,6 +2,7 @@
 # vim: sts=4 sw=4 et
 
 import datetime
+import json
 import pytest
 
 from tll.asynctll import asyncloop_run
@@ -183,3 +184,145 @@ channel: stat://;tll.channel.timer=timer;node=test-node
     assert msg.fields.as_dict() == [{'name': 'field', 'unit': Unit.Unknown, 'value': {'ivalue': {'method': Method.Sum, 'value': 41}}}]
 
     with pytest.raises(TimeoutError): await stat.recv(0.001)
+
+@asyncloop_run
+async def test_histogram(asyncloop, mock, context):
+    class Stat(S.Base):
+        FIELDS = [S.Histogram('hist', unit=S.Unit.NS), S.Integer('field', S.Method.Sum)]
+
+    hist = Stat('hist')
+    context.stat_list.add(hist)
+
+    mock.init(asyncloop, f'''yamls://
+mock:
+  timer: direct://
+channel: stat://;tll.channel.timer=timer
+''')
+
+    mock.open()
+
+    timer = mock.io('timer')
+    stat = mock.channel
+
+    for i in range(1, 1001):
+        hist.update(hist=i)
+    hist.update(field=10)
+    timer.post(b'')
+
+    Unit = stat.scheme.enums['Unit'].klass
+    Method = stat.scheme.enums['Method'].klass
+
+    msg = stat.unpack(await stat.recv())
+    assert msg.name == 'hist'
+    assert msg.fields.as_dict() == [
+        {'name': 'hist', 'unit': Unit.NS, 'value': {'ihist': {'count': 1000, 'min': 1, 'max': 1000, 'avg': 500.5, 'p50': 511, 'p90': 959, 'p99': 1000, 'p999': 1000}}},
+        {'name': 'field', 'unit': Unit.Unknown, 'value': {'ivalue': {'method': Method.Sum, 'value': 10}}},
+    ]
+
+    timer.post(b'')
+    msg = stat.unpack(await stat.recv())
+    assert msg.fields.as_dict() == []
+
+@asyncloop_run
+async def test_export(asyncloop, mock, context, tmp_path):
+    from tll import statfile
+
+    class Stat(S.Base):
+        FIELDS = [S.Histogram('hist', unit=S.Unit.NS), S.Integer('sum', S.Method.Sum), S.Integer('last', S.Method.Last), S.Group('grp')]
+
+    page = Stat('page')
+    context.stat_list.add(page)
+
+    mock.init(asyncloop, f'''yamls://
+mock:
+  timer: direct://
+channel: stat://;tll.channel.timer=timer;export={tmp_path / "stat.export"};log=no
+''')
+
+    mock.open()
+
+    timer = mock.io('timer')
+    stat = mock.channel
+
+    for i in range(1, 1001):
+        page.update(hist=i)
+    page.update(sum=10, last=5, grp=20)
+    timer.post(b'')
+    await stat.recv()
+
+    snapshot = statfile.read(tmp_path / "stat.export")
+    assert [p.name for p in snapshot.pages] == ['page']
+    fields = snapshot.pages[0].fields
+    assert [f.name for f in fields] == ['hist', 'sum', 'last', 'grp']
+    assert (fields[0].count, fields[0].sum.value, fields[0].min.value, fields[0].max.value) == (1000, 500500, 1, 1000)
+    assert fields[0].quantile(0.5) == 511
+    assert fields[1].value == 10
+    assert fields[2].value == 5
+    assert (fields[3].count, fields[3].sum.value) == (1, 20)
+
+    page.update(hist=2000, sum=5, grp=10)
+    timer.post(b'')
+    await stat.recv()
+
+    snapshot = statfile.read(tmp_path / "stat.export")
+    fields = snapshot.pages[0].fields
+    # Histogram min and max are accumulated like buckets
+    assert (fields[0].count, fields[0].min.value, fields[0].max.value) == (1001, 1, 2000)
+    assert fields[0].quantile(0.5) == 511
+
+    pages = statfile.aggregate([snapshot] * 2)
+    assert snapshot.pages[0].fields[0].count == 1001
+    fields = pages['page'].fields
+    assert (fields[0].count, fields[0].min.value, fields[0].max.value) == (2002, 1, 2000)
+    assert fields[0].quantile(0.5) == 511
+    assert fields[1].value == 30
+    assert fields[2].empty
+    assert (fields[3].count, fields[3].sum.value, fields[3].max.value) == (4, 60, 20)
+
+    prom = statfile.prometheus(pages).split('\n')
+    assert 'tll_sum{page="page"} 30' in prom
+    assert 'tll_hist_ns_count{page="page"} 2002' in prom
+    assert 'tll_hist_ns_bucket{page="page",le="+Inf"} 2002' in prom
+    assert 'tll_grp_sum{page="page"} 60' in prom
+    assert not [x for x in prom if x.startswith('tll_last')]
+
+    # Idle interval does not reset accumulated range
+    timer.post(b'')
+    await stat.recv()
+
+    pages = statfile.aggregate([statfile.read(tmp_path / "stat.export")])
+    r = json.loads(statfile.to_json(pages))['pages']['page']
+    assert (r['hist']['count'], r['hist']['min'], r['hist']['max']) == (1001, 1, 2000)
+    assert (r['hist']['p50'], r['hist']['p999']) == (511, 1023)
+    assert (r['grp']['count'], r['grp']['min'], r['grp']['max']) == (2, 10, 20)
+
+@asyncloop_run
+@pytest.mark.parametrize("perf", [True, False])
+async def test_rusage(asyncloop, mock, context, perf):
+    mock.init(asyncloop, f'''yamls://
+mock:
+  timer: direct://
+channel: rusage://;tll.channel.timer=timer;name=rusage;stat=yes;type=thread;perf={'yes' if perf else 'no'}
+''')
+
+    mock.open()
+
+    timer = mock.io('timer')
+
+    pages = {p.name: p for p in context.stat_list}
+    assert 'rusage' in pages
+    if not perf:
+        assert 'rusage/perf' not in pages
+        return
+
+    page = pages['rusage/perf']
+    page.swap()
+
+    timer.post(b'')
+    fields = {f.name: f.value for f in page.swap()}
+    assert list(fields.keys()) == ['cycles', 'instr', 'cmiss', 'csw', 'ivcsw', 'migr']
+    assert all(v >= 0 for v in fields.values())
+
+    mock.channel.close()
+    mock.channel.free()
+    assert 'rusage/perf' not in [p.name for p in context.stat_list]
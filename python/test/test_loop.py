@@ -71,3 +71,26 @@ def test_nofd():
     assert c.state == c.State.Active
     assert l.pending
     assert l.poll() == None # Nothing to poll
+
+def test_profile():
+    ctx = C.Context()
+    l = Loop(config={'profile': '2'})
+    c = ctx.Channel('zero://;size=1kb;name=zero;zero.fd=no;zero.pending=yes')
+    l.add(c)
+    c.open()
+    assert l.pending
+
+    for _ in range(10):
+        l.step()
+
+    pages = {p.name: p for p in ctx.stat_list}
+    assert 'zero/profile' in pages
+    fields = pages['zero/profile'].swap()
+    assert [f.name for f in fields] == ['sample', 'again', 'time']
+    assert fields[0].value == 2
+    assert fields[1].value == 0
+    assert fields[2].count == 5
+    assert fields[2].max >= fields[2].min > 0
+
+    l.remove(c)
+    assert 'zero/profile' not in [p.name for p in ctx.stat_list]
@@ -15,6 +15,8 @@ import tll.asynctll.asyncio
 import tll.asynctll.bare
 
 import pytest
+import threading
+import time
 
 @pytest.fixture
 def context():
@@ -173,6 +175,70 @@ processor.objects:
     assert sorted(objects.keys()) == ['o0', 'o1', 'o2', 'o3', 'processor/stage/active']
     assert objects['processor/stage/active'] == {'depends': 'o2,o3', 'name': 'processor/stage/active'}
 
+class SlowInit(Base):
+    PROTO = "slow-init"
+
+    INIT = []
+
+    def _init(self, url, master=None):
+        super()._init(url, master)
+        self.INIT.append((self.name, threading.get_ident(), time.time()))
+        time.sleep(0.05)
+
+@pytest.mark.parametrize("threads", [1, 4])
+def test_init_threads(context, threads):
+    cfg = Config.load('''yamls://
+name: processor
+processor.objects:
+  o0:
+    init: slow-init://
+  o1:
+    init: slow-init://
+  o2:
+    init: slow-init://
+  o3:
+    init: slow-init://
+  logic:
+    init: null://
+    channels: {input: 'o0,o1,o2,o3'}
+    depends: o0, o1, o2, o3
+''')
+    cfg['processor.init-threads'] = str(threads)
+
+    context.register(SlowInit)
+    SlowInit.INIT = []
+
+    p = Processor(cfg, context=context)
+    assert sorted(x[0] for x in SlowInit.INIT) == ['o0', 'o1', 'o2', 'o3']
+    tids = set(x[1] for x in SlowInit.INIT)
+    if threads == 1:
+        assert len(tids) == 1
+    else: # Idle thread can take next object before others are started
+        assert 1 < len(tids) <= threads
+
+    objects = p.config.sub('objects').as_dict()
+    assert sorted(objects.keys()) == ['logic', 'o0', 'o1', 'o2', 'o3', 'processor/stage/active']
+    for n in ['o0', 'o1', 'o2', 'o3', 'logic']:
+        assert 'init-time' in objects[n]
+
+    p.open()
+    for w in p.workers:
+        w.open()
+
+    workers = [p] + p.workers
+    for _ in range(100):
+        if context.get('logic').state == p.State.Active:
+            break
+        for w in workers:
+            w.step(timeout=0.001)
+    assert context.get('logic').state == p.State.Active
+    for _ in range(10):
+        p.step(timeout=0.001)
+
+    objects = p.config.sub('objects').as_dict()
+    for n in ['o0', 'o1', 'o2', 'o3', 'logic']:
+        assert 'open-time' in objects[n]
+
 @asyncloop_run
 async def test_control(asyncloop, context):
     cfg = Config.load('''yamls://
@@ -336,6 +402,112 @@ processor.objects:
         await check_state(c, State.Opening)
         await check_state(c, State.Active)
 
+@asyncloop_run
+async def test_move(asyncloop, context):
+    cfg = Config.load('''yamls://
+name: test
+processor.objects:
+  server:
+    init: direct://
+    worker: w0
+  peer:
+    init: direct://;master=server
+    worker: w0
+  null:
+    init: null://
+    worker: w0
+  other:
+    init: null://
+    worker: w1
+''')
+
+    p = Processor(cfg, context=context)
+    asyncloop._loop.add(p)
+
+    p.open()
+
+    client = asyncloop.Channel('ipc://;mode=client;name=client;scheme=channel://test', master=p)
+    client.open()
+
+    workers = {w.name: w for w in p.workers}
+    assert sorted(workers.keys()) == ['test/worker/w0', 'test/worker/w1']
+    for w in p.workers:
+        w.open()
+
+    def objects(w):
+        return sorted(c.name for c in workers[f'test/worker/{w}'].children if c.name in ('server', 'peer', 'null', 'other'))
+
+    State = client.scheme.messages.StateUpdate.enums['State'].klass
+
+    while True:
+        m = client.unpack(await client.recv(0.1))
+        if m.as_dict(only = {'channel', 'state'}) == {'channel': 'test/stage/active', 'state': State.Active}:
+            break
+    assert objects('w0') == ['null', 'peer', 'server']
+    assert objects('w1') == ['other']
+
+    client.post({'channel': 'peer', 'worker': 'w1'}, name='ChannelMove')
+    await asyncloop.sleep(0.05)
+
+    assert objects('w0') == ['null']
+    assert objects('w1') == ['other', 'peer', 'server']
+
+    client.post({'channel': 'server'}, name='ChannelClose')
+
+    states = []
+    while states[-1:] != [State.Active]:
+        m = client.unpack(await client.recv(0.1))
+        if m.channel == 'server':
+            states.append(m.state)
+    assert states == [State.Closing, State.Closed, State.Opening, State.Active]
+
+    client.post({'channel': 'null', 'worker': 'unknown'}, name='ChannelMove')
+    await asyncloop.sleep(0.01)
+    assert objects('w0') == ['null']
+
+def test_balance(context):
+    cfg = Config.load('''yamls://
+name: test
+processor.balance: {enable: yes, interval: 100ms, threshold: 0.1}
+processor.objects:
+  zero:
+    init: zero://;size=64b
+    worker: w0
+    balance: yes
+  null:
+    init: null://
+    worker: w1
+''')
+
+    p = Processor(cfg, context=context)
+    p.open()
+
+    def run(w):
+        # Worker is opened in its own thread, load is measured with thread CPU clock
+        w.open()
+        w.run(0.01)
+
+    threads = [threading.Thread(target=run, args=(w,)) for w in p.workers]
+    for t in threads:
+        t.start()
+
+    try:
+        # Zero channel keeps w0 busy all the time, balancer moves it to idle w1
+        for _ in range(500):
+            p.step(0.01)
+            if p.config.get('objects.zero.worker', None) == 'test/worker/w1':
+                break
+        assert p.config.get('objects.zero.worker', None) == 'test/worker/w1'
+    finally:
+        p.close()
+        for _ in range(500):
+            if not any(t.is_alive() for t in threads):
+                break
+            p.step(0.01)
+        for t in threads:
+            t.join(1)
+    assert not any(t.is_alive() for t in threads)
+
 @asyncloop_run
 async def test_forward_helper(asyncloop, tmp_path):
     asyncloop.context.register(Forward)
@@ -236,6 +236,50 @@ async def test_client(asyncloop, server):
 
     assert (await c.recv()).seq == 100
 
+@asyncloop_run
+async def test_delta_late(asyncloop, tmp_path):
+    scheme = '''yamls://
+- name: Data
+  id: 10
+  fields:
+    - {name: key, type: int32}
+    - {name: f0, type: int64}
+'''
+    s = asyncloop.Channel(f'delta+pub+tcp:///{tmp_path}/pub.sock', mode='server', name='server', scheme=scheme, **{'delta.key': 'key', 'delta.refresh': 3})
+    c0 = asyncloop.Channel(f'delta+pub+tcp:///{tmp_path}/pub.sock', mode='client', name='c0', scheme=scheme, **{'delta.key': 'key'})
+    c1 = asyncloop.Channel(f'delta+pub+tcp:///{tmp_path}/pub.sock', mode='client', name='c1', scheme=scheme, **{'delta.key': 'key'})
+
+    s.open()
+    c0.open()
+    assert (await c0.recv_state()) == c0.State.Active
+
+    # Slot 0 is full in messages 0 and 3, slot 1 is created later and has full message 5
+    data = [(0, 0), (0, 1), (0, 2), (0, 3), (0, 4), (1, 5), (0, 6), (1, 7), (0, 8)]
+    for i, (k, v) in enumerate(data[:2]):
+        s.post({'key': k, 'f0': v}, name='Data', seq=i)
+    for i in range(2):
+        assert (await c0.recv()).seq == i
+
+    # Second client joins after data was posted and starts from next full message in each slot
+    c1.open()
+    assert (await c1.recv_state()) == c1.State.Active
+
+    for i, (k, v) in enumerate(data[2:], start=2):
+        s.post({'key': k, 'f0': v}, name='Data', seq=i)
+
+    r0 = [c0.unpack(await c0.recv()) for _ in range(len(data) - 2)]
+    assert [(m.key, m.f0) for m in r0] == data[2:]
+
+    # Delta in message 2 is dropped
+    r1 = [c1.unpack(await c1.recv()) for _ in range(len(data) - 3)]
+    assert [(m.key, m.f0) for m in r1] == data[3:]
+    assert c1.state == c1.State.Active
+
+@pytest.mark.parametrize("mode", ['client', 'server'])
+def test_tls(context, tmp_path, mode):
+    with pytest.raises(TLLError):
+        context.Channel(f'pub+tcp:///{tmp_path}/pub.sock;mode={mode};tls=yes;tls-verify=no')
+
 @asyncloop_run
 async def test_mem(asyncloop, tmp_path):
     s = asyncloop.Channel(f'pub+mem:///{tmp_path}/memory', mode='server', name='server', dump='frame', size='16kb')
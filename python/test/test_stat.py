@@ -97,3 +97,35 @@ def test_alias():
     fields = iter(l).swap()
     assert fields != None
     assert [(f.name, f.value) for f in fields] == [('rx', 2), ('rx', 100)]
+
+class Histogram(S.Base):
+    FIELDS = [S.Integer('sum', S.Method.Sum)
+             ,S.Histogram('lat', unit=S.Unit.NS)
+             ,S.Histogram('size', precision=1, range=10)
+             ]
+
+def test_histogram():
+    s = Histogram('test')
+    l = S.List(new=True)
+    l.add(s)
+
+    for i in range(1, 1001):
+        s.update(lat=i)
+    s.update(sum=10, size=5)
+    s.update(size=100000)
+
+    fields = iter(l).swap()
+    assert [f.name for f in fields] == ['sum', 'lat', 'size']
+    lat = fields[1]
+    assert (lat.unit, lat.precision, lat.count, lat.sum, lat.min, lat.max) == (S.Unit.NS, 3, 1000, 500500, 1, 1000)
+    assert [lat.quantile(q) for q in (0.5, 0.99, 1)] == [511, 1000, 1000]
+    assert sum(v for _, v in lat.buckets) == 1000
+    assert lat.buckets[:3] == [(1, 1), (2, 1), (3, 1)]
+
+    size = fields[2]
+    assert (size.precision, len(size) - 4) == (1, 20)
+    assert size.buckets == [(4, 1), (768, 1)]
+    assert size.quantile(0.5) == 5
+
+    fields = iter(l).swap()
+    assert [(f.count, f.buckets) for f in fields[1:]] == [(0, []), (0, [])]
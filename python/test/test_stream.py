@@ -1405,3 +1405,61 @@ async def test_goat_resolve(asyncloop, context, path_srcdir):
         m = await client.recv()
         assert (m.type, m.seq) == (m.Type.Data, i)
         assert client.unpack(m).as_dict() == {'f': i, 'e': 0xff}
+
+@asyncloop_run
+async def test_recovery(asyncloop, tmp_path):
+    s = asyncloop.Channel(f'stream+null://;request.url=tcp://{tmp_path}/request.sock;storage.url=file://{tmp_path}/storage.dat;name=server;mode=server;request.dump=frame')
+    c = asyncloop.Channel(f'recovery+direct://;request.url=tcp://{tmp_path}/request.sock;name=client;peer=test;stat=yes;dump=frame;request.dump=frame')
+
+    assert [x.name for x in c.children] == ['client/request', 'client/recovery']
+
+    s.open()
+    for i in range(1, 11):
+        s.post(b'xxx', seq=i)
+
+    c.open()
+    online = asyncloop.Channel('direct://', master=c.children[1], name='online')
+    online.open()
+
+    stat = [x for x in asyncloop.context.stat_list if x.name == 'client'][0]
+    stat.swap()
+
+    for i in [1, 2, 5, 6]:
+        online.post(b'online', seq=i)
+
+    for i in [1, 2]:
+        m = await c.recv()
+        assert (m.seq, m.data.tobytes()) == (i, b'online')
+
+    for i, data in [(3, b'xxx'), (4, b'xxx'), (5, b'online'), (6, b'online')]:
+        m = await c.recv()
+        assert (m.seq, m.data.tobytes()) == (i, data)
+
+    for _ in range(10):
+        if c.children[0].state == c.State.Closed:
+            break
+        await asyncloop.sleep(0.01)
+    assert c.children[0].state == c.State.Closed
+
+    online.post(b'online', seq=6)
+    online.post(b'online', seq=7)
+
+    m = await c.recv()
+    assert (m.seq, m.data.tobytes()) == (7, b'online')
+    assert c.config['info.seq'] == '7'
+
+    fields = {f.name: f for f in stat.swap()}
+    assert (fields['gap'].value, fields['lost'].value, fields['dup'].value) == (1, 0, 1)
+    assert fields['rectime'].count == 1
+    assert fields['buftime'].count == 2
+
+    s.close()
+
+    online.post(b'online', seq=12)
+    m = await c.recv()
+    assert (m.seq, m.data.tobytes()) == (12, b'online')
+    assert c.state == c.State.Active
+    assert c.children[0].state == c.State.Closed
+
+    fields = {f.name: f for f in stat.swap()}
+    assert (fields['gap'].value, fields['lost'].value, fields['dup'].value) == (1, 4, 0)
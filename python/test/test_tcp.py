@@ -8,10 +8,14 @@ from tll.test_util import Accum, ports
 from tll.processor import Loop
 from tll.asynctll import asyncloop_run
 
+import errno
 import os
 import pytest
 import select
+import shutil
 import socket
+import struct
+import subprocess
 import sys
 import time
 
@@ -369,6 +373,35 @@ def test_prefix():
 
     assert [(m.msgid, m.seq, m.data.tobytes()) for m in s.result[1:]] == [(10, 100, b'abc' * 10)]
 
+@pytest.mark.parametrize("params,sizes", [
+    ({}, [1, 1, 1, 1, 1]),
+    ({'drain-frames': '3'}, [3, 2]),
+    ({'drain-frames': '10', 'drain-bytes': '40b'}, [2, 2, 1]),
+    ])
+def test_drain(params, sizes):
+    s = Accum('tcp://./tcp.sock;mode=server;frame=none;dump=frame')
+    c = Accum('tcp://./tcp.sock;mode=client;dump=frame', **params)
+    s.open()
+    c.open()
+    for x in s.children:
+        x.process()
+    c.process()
+
+    assert [(m.type, m.msgid) for m in s.result] == [(C.Type.Control, s.scheme_control['Connect'].msgid)]
+    addr = s.result[-1].addr
+
+    s.post(b''.join([struct.pack('=iiq', 8, 10, i) + b'abcdefgh' for i in range(5)]), addr=addr)
+
+    seq = 0
+    for size in sizes:
+        c.result.clear()
+        c.process()
+        assert [m.seq for m in c.result] == list(range(seq, seq + size))
+        seq += size
+    c.result.clear()
+    c.process()
+    assert c.result == []
+
 def test_open_peer():
     s = Accum('tcp://./tcp.sock;mode=server;dump=frame')
     c = Accum('tcp://;mode=client')
@@ -496,6 +529,161 @@ def test_mptcp(host, client, server):
         s.close()
         c.close()
 
+@pytest.mark.parametrize("config,busy", [({}, False), ({'busy-poll': '100ms'}, True), ({'poll': 'no'}, True)])
+def test_busy_poll(context, config, busy):
+    opts = 'busy-poll=50us;prefer-busy-poll=yes;incoming-cpu=0'
+    s = Accum(f'tcp://./test.sock;mode=server;name=server;{opts}', context=context)
+    c = Accum(f'tcp://./test.sock;mode=client;name=client;{opts};stat=yes', context=context)
+
+    loop = Loop(config=config)
+
+    loop.add(s)
+    loop.add(c)
+
+    s.open()
+    c.open()
+
+    try:
+        for _ in range(100):
+            if s.result and c.state == c.State.Active:
+                break
+            loop.step(0.001)
+        addr = s.result[-1].addr
+
+        stat = [x for x in context.stat_list if x.name == 'client'][0]
+        stat.swap()
+
+        s.post(b'zzz', seq=20, addr=addr)
+        for _ in range(100):
+            if c.result:
+                break
+            loop.step(0.001)
+        assert [(m.data.tobytes(), m.seq) for m in c.result] == [(b'zzz', 20)]
+
+        fields = {f.name: f.value for f in stat.swap() if f.name in ('rxbusy', 'rxwake')}
+        assert fields == {'rxbusy': 1, 'rxwake': 0} if busy else {'rxbusy': 0, 'rxwake': 1}
+    finally:
+        s.close()
+        c.close()
+
+def test_memory_stat(context):
+    s = Accum('tcp://./test.sock;mode=server;name=server', context=context)
+    c = Accum('tcp://./test.sock;mode=client;name=client;stat=yes;recv-buffer-size=64kb', context=context)
+
+    loop = Loop()
+
+    loop.add(s)
+    loop.add(c)
+
+    s.open()
+    c.open()
+
+    try:
+        for _ in range(100):
+            if s.result and c.state == c.State.Active:
+                break
+            loop.step(0.001)
+        assert c.state == c.State.Active
+
+        assert int(c.config['info.memory']) >= 64 * 1024
+
+        stat = [x for x in context.stat_list if x.name == 'client'][0]
+        fields = {f.name: f.value for f in stat.swap() if f.name in ('mem', 'alloc')}
+        assert fields['mem'] == int(c.config['info.memory'])
+        assert fields['alloc'] >= 1
+
+        # Buffer sizes are not changed but are reported in each stat interval
+        s.post(b'xxx', addr=s.result[0].addr)
+        for _ in range(100):
+            if c.result:
+                break
+            loop.step(0.001)
+        assert [m.data.tobytes() for m in c.result] == [b'xxx']
+
+        fields = {f.name: f.value for f in stat.swap() if f.name in ('mem', 'alloc')}
+        assert fields == {'mem': int(c.config['info.memory']), 'alloc': 0}
+    finally:
+        s.close()
+        c.close()
+
+def test_buffer_pool_drain_error(context):
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    s.bind(('127.0.0.1', ports.TCP4))
+    s.listen(1)
+
+    c = Accum(f'tcp://127.0.0.1:{ports.TCP4};mode=client;name=client;buffer-pool=yes;recv-buffer-size=1kb;drain-frames=16', context=context)
+
+    loop = Loop()
+    loop.add(c)
+
+    c.open()
+
+    try:
+        conn, _ = s.accept()
+        for _ in range(100):
+            if c.state == c.State.Active:
+                break
+            loop.step(0.001)
+        assert c.state == c.State.Active
+
+        # Two valid frames followed by a header of the frame that does not fit into the buffer
+        data = b''.join(struct.pack('=iiq', 3, 10, i) + b'xxx' for i in range(2))
+        conn.sendall(data + struct.pack('=iiq', 1024 * 1024, 10, 2))
+
+        assert select.select([c.fd], [], [], 1) == ([c.fd], [], [])
+        time.sleep(0.01)
+        with pytest.raises(TLLError): c.process()
+
+        assert [(m.seq, m.data.tobytes()) for m in c.result] == [(0, b'xxx'), (1, b'xxx')]
+        assert c.state == c.State.Error
+        # Receive buffer with broken stream is returned into the pool
+        assert c.config['info.memory'] == '0'
+    finally:
+        c.close()
+        s.close()
+
+@pytest.mark.skipif(sys.platform != 'linux', reason='Network timestamping not supported')
+def test_latency_stat(context):
+    s = Accum(f'tcp://127.0.0.1:{ports.TCP4};mode=server;name=server', context=context)
+    c = Accum(f'tcp://127.0.0.1:{ports.TCP4};mode=client;name=client;stat=yes;timestamping=yes;drain-frames=16', context=context)
+
+    loop = Loop()
+
+    loop.add(s)
+    loop.add(c)
+
+    s.open()
+    c.open()
+
+    try:
+        for _ in range(100):
+            if s.result and c.state == c.State.Active:
+                break
+            loop.step(0.001)
+        assert c.state == c.State.Active
+
+        stat = [x for x in context.stat_list if x.name == 'client'][0]
+        stat.swap()
+
+        for i in range(3):
+            s.post(b'xxx', seq=i, addr=s.result[0].addr)
+
+        # Wait until all frames are in the socket buffer so they are received with one call
+        time.sleep(0.01)
+        assert select.select([c.fd], [], [], 1) == ([c.fd], [], [])
+        c.process()
+        assert [m.seq for m in c.result] == [0, 1, 2]
+
+        # Latency is recorded once for each recv call, not for each frame
+        fields = {f.name: f for f in stat.swap() if f.name in ('rxkern', 'rxcb')}
+        assert fields['rxkern'].count == 1
+        assert fields['rxcb'].count == 1
+        assert 0 <= fields['rxkern'].min < 1000000000
+    finally:
+        s.close()
+        c.close()
+
 @asyncloop_run
 @pytest.mark.skipif(WITHOUT_SCTP, reason="SCTP not available")
 @pytest.mark.parametrize("client", ['::1', '127.0.0.1'])
@@ -701,3 +889,310 @@ async def test_post_more(asyncloop):
     finally:
         s.close()
         c.close()
+
+@asyncloop_run
+@pytest.mark.skipif(sys.platform != 'linux', reason='Epoll is supported only on linux')
+@pytest.mark.parametrize("frame", ['std', 'none'])
+async def test_epoll_server(asyncloop, tmp_path, frame):
+    base = f'tcp://{tmp_path}/server.sock;dump=frame;frame={frame}'
+    s = asyncloop.Channel(f'{base};epoll=yes', mode='server', name='server', **{'send-buffer-hwm': '4kb'})
+    clients = [asyncloop.Channel(base, name=f'client{i}') for i in range(3)]
+
+    s.open()
+    assert s.dcaps & s.DCaps.Process
+    assert len(s.children) == 1 # Only listening socket
+
+    addr = []
+    for c in clients:
+        c.open()
+        m = await s.recv()
+        assert (m.type, m.msgid) == (m.Type.Control, s.scheme_control.messages.Connect.msgid)
+        addr.append(m.addr)
+        assert c.State.Active == await c.recv_state()
+    assert len(set(addr)) == 3
+    assert len(s.children) == 1
+
+    for i, c in enumerate(clients):
+        c.post(b'x' * (i + 1), seq=i, msgid=10)
+    for i in range(3):
+        m = await s.recv()
+        assert m.addr in addr
+        idx = addr.index(m.addr)
+        assert m.data.tobytes() == b'x' * (idx + 1)
+        if frame != 'none':
+            assert (m.seq, m.msgid) == (idx, 10)
+
+    for i, a in enumerate(addr):
+        s.post(b'z' * (i + 1), seq=i, addr=a)
+    for i, c in enumerate(clients):
+        m = await c.recv()
+        assert m.data.tobytes() == b'z' * (i + 1)
+
+    if frame != 'none':
+        for i in range(2):
+            s.post(b'more', seq=100 + i, addr=addr[2], flags=s.PostFlags.More)
+        s.post(b'last', seq=102, addr=addr[2])
+        assert [(m.seq, m.data.tobytes()) for m in [await clients[2].recv() for _ in range(3)]] == [(100, b'more'), (101, b'more'), (102, b'last')]
+        m = await s.recv()
+        assert (m.type, m.msgid, m.addr) == (m.Type.Control, s.scheme_control.messages.WriteReady.msgid, addr[2])
+
+    s.post(b'', name='Disconnect', type=s.Type.Control, addr=addr[0])
+    m = await s.recv()
+    assert (m.type, m.msgid, m.addr) == (m.Type.Control, s.scheme_control.messages.Disconnect.msgid, addr[0])
+    assert clients[0].State.Closed == await clients[0].recv_state()
+    with pytest.raises(TLLError): s.post(b'xxx', addr=addr[0])
+
+    clients[1].close()
+    m = await s.recv()
+    assert (m.type, m.msgid, m.addr) == (m.Type.Control, s.scheme_control.messages.Disconnect.msgid, addr[1])
+
+    s.close()
+    m = await s.recv()
+    assert (m.type, m.msgid, m.addr) == (m.Type.Control, s.scheme_control.messages.Disconnect.msgid, addr[2])
+
+@asyncloop_run
+@pytest.mark.parametrize("epoll", ['no', pytest.param('yes', marks=pytest.mark.skipif(sys.platform != 'linux', reason='Epoll is supported only on linux'))])
+async def test_buffer_pool(asyncloop, tmp_path, epoll):
+    s = asyncloop.Channel(f'tcp://{tmp_path}/server.sock;mode=server;dump=frame;buffer-pool=yes;epoll={epoll}', name='server')
+    c = asyncloop.Channel(f'tcp://{tmp_path}/server.sock;mode=client;dump=frame;frame=none', name='client')
+
+    s.open()
+    c.open()
+
+    assert c.State.Active == await c.recv_state()
+    m = await s.recv()
+    assert (m.type, m.msgid) == (m.Type.Control, s.scheme_control.messages.Connect.msgid)
+    addr = m.addr
+
+    data = struct.pack('=iiq', 8, 10, 100) + b'abcdefgh'
+    c.post(data[:12])
+    with pytest.raises(TimeoutError): await s.recv(0.01)
+
+    c.post(data[12:] + data.replace(b'abcd', b'ijkl'))
+    m = await s.recv()
+    assert (m.type, m.msgid, m.seq, m.addr, m.data.tobytes()) == (m.Type.Data, 10, 100, addr, b'abcdefgh')
+    m = await s.recv()
+    assert (m.type, m.msgid, m.seq, m.addr, m.data.tobytes()) == (m.Type.Data, 10, 100, addr, b'ijklefgh')
+
+    s.post(b'x' * 1024, msgid=20, seq=200, addr=addr)
+    m = await c.recv()
+    assert m.data.tobytes() == struct.pack('=iiq', 1024, 20, 200) + b'x' * 1024
+
+def check_tls():
+    try:
+        C.Context().Channel('tcp://./tcp.sock;mode=client;tls=yes;tls-verify=no')
+    except TLLError:
+        return False
+    return shutil.which('openssl') is not None
+
+WITHOUT_TLS = not check_tls()
+
+@pytest.fixture
+def certs(tmp_path):
+    def gen(name):
+        subprocess.run(['openssl', 'req', '-x509', '-newkey', 'ec', '-pkeyopt', 'ec_paramgen_curve:prime256v1', '-nodes',
+            '-keyout', tmp_path / f'{name}.key', '-out', tmp_path / f'{name}.pem', '-days', '1', '-subj', '/CN=localhost',
+            '-addext', 'subjectAltName=IP:127.0.0.1,DNS:localhost'], check=True, capture_output=True)
+        return {'tls-cert': str(tmp_path / f'{name}.pem'), 'tls-key': str(tmp_path / f'{name}.key')}
+    return gen('server'), gen('other')
+
+@asyncloop_run
+@pytest.mark.skipif(WITHOUT_TLS, reason="TLS not supported")
+@pytest.mark.parametrize("frame", ['std', 'none'])
+@pytest.mark.parametrize("ktls", ['yes', 'no'])
+async def test_tls(asyncloop, certs, frame, ktls):
+    server, other = certs
+    s = asyncloop.Channel(f'tcp://127.0.0.1:{ports.TCP4};mode=server;dump=frame;tls=yes;frame={frame};ktls={ktls}', name='server', **server)
+    c = asyncloop.Channel(f'tcp://127.0.0.1:{ports.TCP4};mode=client;dump=frame;tls=yes;frame={frame};ktls={ktls}', name='client', **{'tls-ca': server['tls-cert']})
+
+    s.open()
+    c.open()
+
+    assert c.State.Active == await c.recv_state()
+    if ktls == 'yes':
+        if c.config.get('info.tls.ktls-recv', 'false') != 'true':
+            pytest.skip("Kernel TLS receive offload is not available")
+    else:
+        assert c.config['info.tls.ktls-recv'] == 'false'
+    m = await s.recv()
+    assert (m.type, m.msgid) == (m.Type.Control, s.scheme_control.messages.Connect.msgid)
+    addr = m.addr
+
+    data = bytes(range(256)) * 128 # Larger then TLS record
+    if frame == 'none':
+        c.post(b'hello')
+        assert (await s.recv()).data.tobytes() == b'hello'
+    else:
+        for i in range(3):
+            c.post(data[:10000 * (i + 1)], msgid=10, seq=i)
+        for i in range(3):
+            m = await s.recv()
+            assert (m.msgid, m.seq, m.addr, m.data.tobytes()) == (10, i, addr, data[:10000 * (i + 1)])
+
+        s.post(data, msgid=20, seq=100, addr=addr)
+        m = await c.recv()
+        assert (m.msgid, m.seq, m.data.tobytes()) == (20, 100, data)
+
+    c.close()
+    m = await s.recv()
+    assert (m.type, m.msgid, m.addr) == (m.Type.Control, s.scheme_control.messages.Disconnect.msgid, addr)
+
+    c.free()
+    c = asyncloop.Channel(f'tcp://127.0.0.1:{ports.TCP4};mode=client;tls=yes;frame={frame}', name='client', **{'tls-ca': other['tls-cert']})
+    c.open()
+    assert c.State.Error == await c.recv_state()
+    with pytest.raises(TimeoutError): await s.recv(0.05)
+
+@asyncloop_run
+@pytest.mark.skipif(WITHOUT_TLS, reason="TLS not supported")
+async def test_tls_handshake_timeout(asyncloop, certs):
+    server, _ = certs
+    s = asyncloop.Channel(f'tcp://127.0.0.1:{ports.TCP4};mode=server;tls=yes;tls-handshake-timeout=50ms', name='server', **server)
+    s.open()
+
+    # Peer that connects and never starts handshake
+    raw = socket.create_connection(('127.0.0.1', ports.TCP4))
+    raw.settimeout(1)
+    try:
+        with pytest.raises(TimeoutError): await s.recv(0.2)
+        assert raw.recv(1) == b''
+    finally:
+        raw.close()
+
+    s.close()
+
+    listen = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    listen.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listen.bind(('127.0.0.1', ports.TCP4))
+    listen.listen(1)
+
+    c = asyncloop.Channel(f'tcp://127.0.0.1:{ports.TCP4};mode=client;tls=yes;tls-verify=no;tls-handshake-timeout=50ms', name='client')
+    try:
+        c.open()
+        conn, _ = listen.accept()
+        assert c.State.Error == await c.recv_state(1)
+        conn.close()
+    finally:
+        listen.close()
+
+@asyncloop_run
+@pytest.mark.parametrize("pool", ['1mb', '0b'])
+async def test_seqpacket(asyncloop, tmp_path, pool):
+    base = f'seqpacket://{tmp_path}/server.sock;inline-size=64b;pool-size={pool};stat=yes'
+    s = asyncloop.Channel(base, mode='server', name='server')
+    c = asyncloop.Channel(base, mode='client', name='client')
+
+    s.open()
+    c.open()
+
+    assert c.State.Active == await c.recv_state()
+    m = await s.recv()
+    assert (m.type, m.msgid) == (m.Type.Control, s.scheme_control.messages.Connect.msgid)
+    addr = m.addr
+
+    stat = {x.name: x for x in asyncloop.context.stat_list if x.name in ('server', 'client')}
+    for x in stat.values():
+        x.swap()
+
+    large = bytes(range(256)) * 40
+    c.post(b'small', msgid=10, seq=1)
+    c.post(large, msgid=20, seq=2)
+    c.post(b'', msgid=30, seq=3)
+    for msgid, seq, data in [(10, 1, b'small'), (20, 2, large), (30, 3, b'')]:
+        m = await s.recv()
+        assert (m.msgid, m.seq, m.addr, m.data.tobytes()) == (msgid, seq, addr, data)
+
+    for i in range(10):
+        s.post(large[:100 * (i + 1)], msgid=i, seq=100 + i, addr=addr)
+    for i in range(10):
+        m = await c.recv()
+        assert (m.msgid, m.seq, m.data.tobytes()) == (i, 100 + i, large[:100 * (i + 1)])
+
+    shared = pool != '0b'
+    fields = {f.name: f.value for f in stat['client'].swap() if f.name.startswith('shm')}
+    assert fields == {'shmtx': 1 if shared else 0, 'shmrx': 10 if shared else 0, 'shmfull': 0}
+
+    c.close()
+    m = await s.recv()
+    assert (m.type, m.msgid, m.addr) == (m.Type.Control, s.scheme_control.messages.Disconnect.msgid, addr)
+
+def test_seqpacket_pool(context, tmp_path):
+    base = f'seqpacket://{tmp_path}/server.sock;inline-size=64b;pool-size=4kb'
+    s = Accum(base, mode='server', name='server', broadcast='yes', context=context)
+    clients = [Accum(base, mode='client', name=f'client{i}', context=context) for i in range(2)]
+
+    def process(*channels, count=3):
+        for _ in range(count):
+            for c in channels:
+                c.process()
+                for x in c.children:
+                    x.process()
+
+    s.open()
+    addr = []
+    for c in clients:
+        c.open()
+        process(s, c)
+        assert c.state == c.State.Active
+        assert [(m.type, m.msgid) for m in s.result] == [(C.Type.Control, s.scheme_control['Connect'].msgid)]
+        addr.append(s.result[0].addr)
+        s.result = []
+
+    # Broadcast message is written once and shared by both clients, two copies do not fit into the pool
+    large = b'x' * 3000
+    s.post(large, msgid=10, seq=1, addr=0)
+
+    # Block is still referenced by clients
+    with pytest.raises(TLLError) as e:
+        s.post(large, msgid=10, seq=2, addr=addr[0])
+    assert e.value.errno == errno.EAGAIN
+
+    process(*clients)
+    for c in clients:
+        assert [(m.msgid, m.seq, m.data.tobytes()) for m in c.result] == [(10, 1, large)]
+        c.result = []
+
+    # Release notifications from both clients free the block
+    process(s)
+    s.post(large, msgid=10, seq=2, addr=addr[0])
+    process(clients[0], s)
+    assert [(m.seq, m.data.tobytes()) for m in clients[0].result] == [(2, large)]
+    clients[0].result = []
+
+    # Same buffer and seq posted twice must not reuse stale block
+    buf = bytearray(b'a' * 1000)
+    s.post(buf, seq=0, addr=addr[0])
+    buf[:] = b'b' * 1000
+    s.post(buf, seq=0, addr=addr[0])
+    process(clients[0], s)
+    assert [(m.seq, m.data.tobytes()) for m in clients[0].result] == [(0, b'a' * 1000), (0, b'b' * 1000)]
+    clients[0].result = []
+
+    # Fill client socket buffer so release notification is queued
+    for i in range(100000):
+        try:
+            clients[0].post(b'x', seq=i)
+        except TLLError as e:
+            assert e.errno == errno.EAGAIN
+            break
+    else:
+        assert False, "Client socket buffer is never full"
+
+    s.post(large, msgid=10, seq=3, addr=addr[0])
+    process(clients[0])
+    assert [(m.seq, m.data.tobytes()) for m in clients[0].result] == [(3, large)]
+
+    # Release is not delivered yet
+    with pytest.raises(TLLError) as e:
+        s.post(large, msgid=10, seq=4, addr=addr[0])
+    assert e.value.errno == errno.EAGAIN
+
+    # Drain inline messages on server side, then release queue is flushed by the client
+    for _ in range(i + 10):
+        process(s, count=1)
+    assert len(s.result) == i
+    process(clients[0], s)
+    s.post(large, msgid=10, seq=4, addr=addr[0])
+
+def test_seqpacket_tcp_address(context):
+    with pytest.raises(TLLError): context.Channel(f'seqpacket://127.0.0.1:{ports.TCP4};mode=server')
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# vim: sts=4 sw=4 et
+
+import tll.channel as C
+from tll.error import TLLError
+from tll.test_util import Accum
+
+import pytest
+
+SCHEME = '''yamls://
+- name: A
+  id: 10
+  fields: [{name: f0, type: int32}]
+- name: B
+  id: 20
+  fields: [{name: f0, type: int32}]
+'''
+
+@pytest.fixture
+def context():
+    return C.Context()
+
+def test_invalid(context):
+    with pytest.raises(TLLError): context.Channel('timeit+null://', name='invalid', sample='0')
+
+def test_per_message(context):
+    s = Accum('direct://', name='server', scheme=SCHEME, context=context)
+    c = Accum('timeit+direct://', name='timeit', master=s, scheme=SCHEME, context=context, **{'per-message': 'yes'})
+
+    s.open()
+    c.open()
+
+    c.post({'f0': 1}, name='A')
+    c.post({'f0': 2}, name='B', seq=1)
+    c.post(b'', msgid=30, seq=2)
+    s.post({'f0': 3}, name='A', seq=3)
+
+    assert [m.seq for m in s.result] == [0, 1, 2]
+    assert [m.seq for m in c.result] == [3]
+
+    pages = {p.name: p for p in context.stat_list}
+    assert 'timeit/A' in pages
+    assert 'timeit/B' in pages
+    assert 'timeit/30' in pages
+
+    fields = pages['timeit/A'].swap()
+    assert [f.name for f in fields] == ['rxt', 'txt']
+    assert fields[0].count == 1
+    assert fields[1].count == 1
+
+    c.close()
+    c.free()
+    assert 'timeit/A' not in [p.name for p in context.stat_list]
+
+def test_trace(context, tmp_path):
+    s = Accum('direct://', name='server', context=context)
+    c = Accum('timeit+direct://', name='timeit', master=s, sample='2', context=context,
+              **{'trace.url': f'file://{tmp_path}/trace.dat', 'trace.block': '4kb'})
+
+    assert [x.name for x in c.children] == ['timeit/trace', 'timeit/timeit']
+
+    s.open()
+    c.open()
+
+    for i in range(4):
+        c.post(b'xxx', msgid=10, seq=100 + i)
+    for i in range(4):
+        s.post(b'yyy', msgid=20, seq=200 + i)
+
+    assert [m.seq for m in s.result] == [100, 101, 102, 103]
+    assert [m.seq for m in c.result] == [200, 201, 202, 203]
+
+    c.close()
+
+    r = Accum(f'file://{tmp_path}/trace.dat', name='reader', autoclose='no', context=context)
+    r.open()
+    for _ in range(10):
+        r.process()
+
+    result = [r.unpack(m) for m in r.result if m.type == m.Type.Data]
+    assert [(m.seq, m.msgid, m.direction.name) for m in result] == [
+        (101, 10, 'Tx'),
+        (103, 10, 'Tx'),
+        (201, 20, 'Rx'),
+        (203, 20, 'Rx'),
+    ]
+    for m in result:
+        assert m.end >= m.start
@@ -141,3 +141,61 @@ def test_skip():
     c.process()
     c.process()
     assert len(c.result) == 2
+
+def test_wheel_invalid():
+    with pytest.raises(TLLError): ctx.Channel('timer://;wheel=yes;interval=10ms', name='wheel')
+    with pytest.raises(TLLError): ctx.Channel('timer://;wheel=yes;resolution=0ms', name='wheel')
+
+    w = ctx.Channel('timer://;wheel=yes', name='wheel', clock='realtime')
+    with pytest.raises(TLLError): ctx.Channel('timer://', name='timer', master=w, clock='monotonic')
+
+    w.open()
+    with pytest.raises(TLLError): w.post({'ts': 0}, name='relative')
+
+@pytest.mark.skipif('linux' not in sys.platform, reason='timerfd not supported')
+def test_wheel():
+    w = Accum('timer://;wheel=yes;resolution=1ms', name='wheel', context=ctx)
+    c0 = Accum('timer://;interval=10ms', name='c0', master=w, context=ctx)
+    c1 = Accum('timer://;interval=5ms;oneshot=yes', name='c1', master=w, context=ctx)
+    c2 = Accum('timer://', name='c2', master=w, context=ctx)
+
+    w.open()
+    assert w.dcaps == w.DCaps.Process | w.DCaps.PollIn
+
+    poll = select.poll()
+    poll.register(w.fd, select.POLLIN)
+    assert poll.poll(0) == []
+
+    start = time.time()
+    for c in (c0, c1, c2):
+        c.open()
+        assert c.fd is None
+        assert c.dcaps == 0
+
+    c2.post({'ts': 0.003}, name='relative')
+    c2.post({'ts': 0}, name='relative') # Clear timer
+    c2.post({'ts': 0.015}, name='relative')
+
+    events = []
+    while len(events) < 5 and time.time() - start < 1:
+        poll.poll(50)
+        w.process()
+        for c in (c0, c1, c2):
+            for m in c.result:
+                assert m.msgid == 2
+                events.append((c.name, 1000 * (time.time() - start)))
+            c.result = []
+
+    assert [n for n, _ in events] == ['c1', 'c0', 'c2', 'c0', 'c0']
+    for (name, dt), expected in zip(events, [5, 10, 15, 20, 30]):
+        assert expected <= dt + 1, f'{name} fired at {dt:.3f}ms, expected {expected}ms'
+
+    c0.close()
+    c1.close()
+    c2.close()
+
+    # Removal does not rearm timer fd, there can be one spurious wakeup
+    if poll.poll(20):
+        w.process()
+    assert poll.poll(20) == []
+    assert [c.result for c in (c0, c1, c2)] == [[], [], []]
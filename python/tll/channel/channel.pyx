@@ -231,8 +231,12 @@ cdef class Channel:
         for k,v in kw.items():
             curl[k] = v
 
+        cdef const tll_config_t * uptr = curl._ptr
+        cdef tll_channel_t * ptr = NULL
+        with nogil: # Channel may create objects in other threads, like processor with parallel init
+            ptr = tll_channel_new_url(cptr, uptr, pptr, NULL)
         self._own = True
-        self._ptr = tll_channel_new_url(cptr, curl._ptr, pptr, NULL)
+        self._ptr = ptr
         if self._ptr == NULL:
             raise TLLError("Init channel with url {} failed".format(url))
 
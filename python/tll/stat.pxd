@@ -89,4 +89,5 @@ cdef class Base:
     cdef array fields1
     cdef object offsets
     cdef object groups
+    cdef object histograms
     cdef object normalized
@@ -10,6 +10,7 @@ from .s2b cimport s2b, b2s
 from .error import TLLError
 
 import enum
+import itertools
 import time
 from collections import namedtuple
 
@@ -98,6 +99,97 @@ cdef class FieldGroup:
     @property
     def max(self): return self.fields[3].value
 
+def _hist_index(precision, value):
+    ''' Log-linear bucket index, same as tll::stat::histogram::index '''
+    if value < (1 << precision):
+        return max(value, 0)
+    e = value.bit_length() - 1
+    return ((e - precision + 1) << precision) + ((value >> (e - precision)) & ((1 << precision) - 1))
+
+def _hist_lower(precision, idx):
+    ''' Lowest value in the bucket, same as tll::stat::histogram::lower '''
+    sub = 1 << precision
+    if idx < sub:
+        return idx
+    return (sub + idx % sub) << (idx // sub - 1)
+
+cdef int _hist_precision(tll_stat_field_t * ptr):
+    if memcmp(ptr.name, b'_tllhs', 6) != 0:
+        return -1
+    cdef int c = ptr.name[6]
+    if c < ord('0') or c > ord('9'):
+        return -1
+    return c - ord('0')
+
+cdef unsigned _hist_buckets(tll_stat_field_t * ptr, tll_stat_field_t * end):
+    cdef unsigned r = 0
+    ptr += 4
+    while ptr < end and memcmp(ptr.name, b'_tllbkt', 7) == 0:
+        r += 1
+        ptr += 1
+    return r
+
+cdef class FieldHistogram:
+    cdef tll_stat_field_t * ptr
+    cdef object fields
+    cdef readonly int precision
+
+    def __cinit__(self):
+        self.ptr = NULL
+
+    @staticmethod
+    cdef wrap(tll_stat_field_t * ptr, tll_stat_field_t * end):
+        cdef int precision = _hist_precision(ptr)
+        if precision < 0 or end - ptr < 4:
+            raise ValueError("Not a stat histogram")
+        f = FieldHistogram()
+        f.ptr = ptr
+        f.precision = precision
+        f.fields = [Field.wrap(ptr + i) for i in range(4 + _hist_buckets(ptr, end))]
+        return f
+
+    def __len__(self): return len(self.fields)
+
+    @property
+    def type(self): return self.fields[1].type
+
+    @property
+    def unit(self): return self.fields[1].unit
+
+    @property
+    def name(self): return self.fields[1].name
+
+    @property
+    def count(self): return self.fields[0].value
+
+    @property
+    def sum(self): return self.fields[1].value
+
+    @property
+    def min(self): return self.fields[2].value
+
+    @property
+    def max(self): return self.fields[3].value
+
+    @property
+    def buckets(self):
+        ''' List of (lower bound, count) pairs for non-empty buckets '''
+        return [(_hist_lower(self.precision, i), f.value) for i, f in enumerate(self.fields[4:]) if f.value]
+
+    def quantile(self, q):
+        ''' Upper bound of the bucket where quantile falls, clamped to [min, max] '''
+        if self.count == 0:
+            return 0
+        rank = max(1, int(q * self.count + 0.5))
+        s = 0
+        for i, f in enumerate(self.fields[4:]):
+            s += f.value
+            if s >= rank:
+                if i == len(self.fields) - 5:
+                    return self.max
+                return min(max(_hist_lower(self.precision, i + 1) - 1, self.min), self.max)
+        return self.max
+
 cdef class Page:
     cdef tll_stat_page_t * ptr
 
@@ -118,6 +210,10 @@ cdef class Page:
             if memcmp(self.ptr.fields[i].name, b'_tllgrp', 7) == 0:
                 r.append(FieldGroup.wrap(self.ptr.fields + i))
                 i += 4
+            elif _hist_precision(self.ptr.fields + i) >= 0:
+                h = FieldHistogram.wrap(self.ptr.fields + i, self.ptr.fields + self.ptr.size)
+                r.append(h)
+                i += len(h)
             else:
                 r.append(Field.wrap(self.ptr.fields + i))
                 i += 1
@@ -162,6 +258,22 @@ class Group:
             {'name':self.name, 'method':Method.Max, 'unit':self.unit, 'type':self.type},
         ]
 
+class Histogram:
+    ''' Log-linear histogram, see tll::stat::HistogramT '''
+    def __init__(self, name, unit=Unit.Unknown, precision=3, range=40):
+        if not 0 <= precision <= 9 or precision >= range:
+            raise ValueError(f"Invalid histogram precision {precision} or range {range}")
+        self.name, self.unit, self.precision = name, unit, precision
+        self.size = (range - precision + 1) << precision
+
+    def fields(self):
+        return [
+            {'name':f'_tllhs{self.precision}', 'method':Method.Sum, 'unit':Unit.Unknown, 'type':int},
+            {'name':self.name, 'method':Method.Sum, 'unit':self.unit, 'type':int},
+            {'name':self.name, 'method':Method.Min, 'unit':self.unit, 'type':int},
+            {'name':self.name, 'method':Method.Max, 'unit':self.unit, 'type':int},
+        ] + [{'name':'_tllbkt', 'method':Method.Sum, 'unit':Unit.Unknown, 'type':int}] * self.size
+
 cdef class Base:
     FIELDS = []
 
@@ -169,7 +281,7 @@ cdef class Base:
         self.name = s2b(name)
         self.normalized = []
         for f in self.FIELDS:
-            if isinstance(f, Group):
+            if isinstance(f, (Group, Histogram)):
                 self.normalized += f.fields()
             else:
                 self.normalized += [f]
@@ -187,6 +299,7 @@ cdef class Base:
 
         self.offsets = {}
         self.groups = {}
+        self.histograms = {}
         for i,f in enumerate(self.normalized):
             name = s2b(f['name'])[:7]
             name += b'\0' * (7 - len(name))
@@ -203,6 +316,9 @@ cdef class Base:
             self.offsets[f.get('alias', f['name'])] = i
             if f['name'] == '_tllgrp':
                 self.groups[self.normalized[i+1]['name']] = i
+            elif f['name'].startswith('_tllhs'):
+                nbuckets = len(list(itertools.takewhile(lambda x: x['name'] == '_tllbkt', self.normalized[i+4:])))
+                self.histograms[self.normalized[i+1]['name']] = (i, int(f['name'][-1]), nbuckets)
 
     @property
     def _block(self):
@@ -215,8 +331,15 @@ cdef class Base:
         cdef unsigned int[:] offsets = array('I', [0] * size)
         cdef long long [:] updates_i = array('q', [0] * size)
         cdef double [:] updates_f = array('d', [0] * size)
+        cdef int [:] buckets = array('i', [-1] * size)
         cdef unsigned i
         for i,(name, value) in enumerate(kw.items()):
+            h = self.histograms.get(name, None)
+            if h is not None:
+                offsets[i], precision, nbuckets = h
+                updates_i[i] = value
+                buckets[i] = min(_hist_index(precision, value), nbuckets - 1)
+                continue
             o = self.groups.get(name, None)
             if o is None:
                 o = self.offsets.get(name, None)
@@ -242,7 +365,13 @@ cdef class Base:
                 i = 0
                 while i < size:
                     field = page.fields + offsets[i]
-                    if memcmp(field.name, b'_tllgrp', 7) == 0:
+                    if buckets[i] >= 0:
+                        tll_stat_field_update_int(field, 1)
+                        tll_stat_field_update_int(field + 1, updates_i[i])
+                        tll_stat_field_update_int(field + 2, updates_i[i])
+                        tll_stat_field_update_int(field + 3, updates_i[i])
+                        tll_stat_field_update_int(field + 4 + buckets[i], 1)
+                    elif memcmp(field.name, b'_tllgrp', 7) == 0:
                         tll_stat_field_update_int(field, 1)
                         if field[1].type == TLL_STAT_INT:
                             tll_stat_field_update_int(field + 1, updates_i[i])
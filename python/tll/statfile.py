@@ -0,0 +1,269 @@
+#!/usr/bin/env python3
+# vim: sts=4 sw=4 et
+
+''' Reader for stat export files written by ``stat://`` logic with ``export`` parameter '''
+
+import copy
+import json
+import mmap
+import re
+import struct
+import sys
+import time
+
+from .stat import Method, Type, Unit, _hist_lower
+
+MAGIC = b'TLLSTAT\0'
+VERSION = 1
+
+HEADER = struct.Struct('=8sIIQqQQI4x8x')
+PAGE = struct.Struct('=IHxxI4x')
+FIELD = struct.Struct('=B7s8s')
+
+INT_MIN, INT_MAX = -(1 << 63), (1 << 63) - 1
+FLOAT_MIN, FLOAT_MAX = sys.float_info.min, sys.float_info.max
+
+def _default(method, type):
+    if method == Method.Sum:
+        return 0
+    if method == Method.Min:
+        return FLOAT_MAX if type == Type.Float else INT_MAX
+    return FLOAT_MIN if type == Type.Float else INT_MIN
+
+class Field:
+    def __init__(self, name, method, type, unit, value):
+        self.name, self.method, self.type, self.unit, self.value = name, method, type, unit, value
+
+    @property
+    def empty(self):
+        return self.value == _default(self.method, self.type)
+
+    def merge(self, other):
+        if other.empty:
+            return
+        if self.empty or self.method == Method.Last:
+            self.value = other.value
+        elif self.method == Method.Sum:
+            self.value += other.value
+        elif self.method == Method.Min:
+            self.value = min(self.value, other.value)
+        elif self.method == Method.Max:
+            self.value = max(self.value, other.value)
+
+    def as_dict(self):
+        return {'method': self.method.name, 'unit': self.unit.name, 'value': None if self.empty else self.value}
+
+    def __repr__(self):
+        return f'<Field {self.name} {self.method.name} {self.value}>'
+
+class Group:
+    def __init__(self, count, sum, min, max):
+        self.name, self.unit = sum.name, sum.unit
+        self.count, self.sum, self.min, self.max = count.value, sum, min, max
+
+    def merge(self, other):
+        self.count += other.count
+        for s, o in [(self.sum, other.sum), (self.min, other.min), (self.max, other.max)]:
+            s.merge(o)
+
+    def as_dict(self):
+        return {'unit': self.unit.name, 'count': self.count, 'sum': self.sum.value,
+                'min': None if self.min.empty else self.min.value,
+                'max': None if self.max.empty else self.max.value}
+
+    def __repr__(self):
+        return f'<Group {self.name} {self.count}>'
+
+class Histogram(Group):
+    def __init__(self, precision, fields):
+        Group.__init__(self, *fields[:4])
+        self.precision = precision
+        self.buckets = [f.value for f in fields[4:]]
+
+    def merge(self, other):
+        if other.precision != self.precision:
+            raise ValueError(f"Can not merge histogram '{self.name}' with different precision: {self.precision} != {other.precision}")
+        Group.merge(self, other)
+        if len(other.buckets) > len(self.buckets):
+            self.buckets += [0] * (len(other.buckets) - len(self.buckets))
+        for i, v in enumerate(other.buckets):
+            self.buckets[i] += v
+
+    def upper(self, idx):
+        ''' Highest value in the bucket, None for the last overflow bucket '''
+        if idx + 1 >= len(self.buckets):
+            return None
+        return _hist_lower(self.precision, idx + 1) - 1
+
+    def quantile(self, q):
+        ''' Upper bound of the bucket where quantile falls, clamped to [min, max] if they are known '''
+        if self.count == 0:
+            return 0
+        rank = max(1, int(q * self.count + 0.5))
+        acc = 0
+        for i, v in enumerate(self.buckets[:-1]):
+            acc += v
+            if acc >= rank:
+                r = self.upper(i)
+                if not self.min.empty:
+                    r = max(r, self.min.value)
+                if not self.max.empty:
+                    r = min(r, self.max.value)
+                return r
+        return None if self.max.empty else self.max.value
+
+    def as_dict(self):
+        r = Group.as_dict(self)
+        r['precision'] = self.precision
+        r['buckets'] = [[self.upper(i), v] for i, v in enumerate(self.buckets) if v]
+        if self.count:
+            r.update({f'p{k}': self.quantile(q) for k, q in [('50', 0.5), ('90', 0.9), ('99', 0.99), ('999', 0.999)]})
+        return r
+
+    def __repr__(self):
+        return f'<Histogram {self.name} {self.count}>'
+
+class Page:
+    def __init__(self, name, fields):
+        self.name = name
+        self.fields = fields
+
+    def merge(self, other):
+        if [(f.__class__, f.name) for f in self.fields] != [(f.__class__, f.name) for f in other.fields]:
+            raise ValueError(f"Can not merge pages '{self.name}' with different layout")
+        for s, o in zip(self.fields, other.fields):
+            s.merge(o)
+
+    def as_dict(self):
+        return {f.name: f.as_dict() for f in self.fields}
+
+    def __repr__(self):
+        return f'<Page {self.name} {self.fields}>'
+
+def _parse_fields(data):
+    raw = []
+    for i in range(0, len(data), FIELD.size):
+        desc, name, value = FIELD.unpack_from(data, i)
+        method, type, unit = Method(desc & 0xf), Type((desc >> 4) & 1), Unit(desc >> 5)
+        value = struct.unpack('=d' if type == Type.Float else '=q', value)[0]
+        raw.append(Field(name.split(b'\0')[0].decode(), method, type, unit, value))
+
+    r = []
+    i = 0
+    while i < len(raw):
+        f = raw[i]
+        m = re.fullmatch('_tllhs([0-9])', f.name)
+        if m and i + 4 < len(raw) and raw[i + 4].name == '_tllbkt':
+            end = i + 4
+            while end < len(raw) and raw[end].name == '_tllbkt':
+                end += 1
+            r.append(Histogram(int(m.group(1)), raw[i:end]))
+            i = end
+        elif f.name == '_tllgrp' and i + 3 < len(raw):
+            r.append(Group(*raw[i:i + 4]))
+            i += 4
+        else:
+            if f.name:
+                r.append(f)
+            i += 1
+    return r
+
+class Snapshot:
+    def __init__(self, time, pages):
+        self.time = time
+        self.pages = pages
+
+def parse(data):
+    ''' Parse consistent copy of stat export file '''
+    magic, version, hsize, seq, ts, capacity, size, count = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError(f"Invalid magic: {magic}")
+    if version != VERSION:
+        raise ValueError(f"Unsupported version {version}, expected {VERSION}")
+    pages = []
+    off = hsize
+    for _ in range(count):
+        psize, nsize, fields = PAGE.unpack_from(data, off)
+        name = data[off + PAGE.size:off + PAGE.size + nsize].decode()
+        foff = off + PAGE.size + ((nsize + 7) & ~7)
+        pages.append(Page(name, _parse_fields(data[foff:foff + fields * FIELD.size])))
+        off += psize
+    return Snapshot(ts, pages)
+
+def read(filename, retry=1000):
+    ''' Read snapshot from file, retry if it is being updated '''
+    with open(filename, 'rb') as fp:
+        with mmap.mmap(fp.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+            for _ in range(retry):
+                seq0 = HEADER.unpack_from(mm, 0)[3]
+                if seq0 % 2 == 0:
+                    data = bytes(mm[:])
+                    if HEADER.unpack_from(mm, 0)[3] == seq0:
+                        return parse(data)
+                time.sleep(0.0001)
+    raise TimeoutError(f"Failed to get consistent snapshot from {filename}")
+
+def aggregate(snapshots, match=None):
+    ''' Merge pages with same name from several snapshots, snapshots are not modified '''
+    r = {}
+    for s in snapshots:
+        for p in s.pages:
+            if match is not None and not re.search(match, p.name):
+                continue
+            if p.name in r:
+                r[p.name].merge(p)
+            else:
+                r[p.name] = copy.deepcopy(p)
+    return r
+
+def _metric(prefix, name, unit):
+    name = re.sub('[^a-zA-Z0-9_]', '_', f'{prefix}_{name}')
+    if unit == Unit.Bytes:
+        return name + '_bytes'
+    elif unit == Unit.NS:
+        return name + '_ns'
+    return name
+
+def _label(v):
+    return v.replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n')
+
+def prometheus(pages, prefix='tll'):
+    ''' Format pages in Prometheus text exposition format '''
+    metrics = {}
+    def add(name, kind, *lines):
+        metrics.setdefault(name, (kind, []))[1].extend(lines)
+
+    for page in pages.values():
+        label = f'page="{_label(page.name)}"'
+        for f in page.fields:
+            name = _metric(prefix, f.name, f.unit)
+            if isinstance(f, Group):
+                lines = []
+                if isinstance(f, Histogram):
+                    acc = 0
+                    for i, v in enumerate(f.buckets[:-1]):
+                        acc += v
+                        if v:
+                            lines.append(f'{name}_bucket{{{label},le="{f.upper(i)}"}} {acc}')
+                    lines.append(f'{name}_bucket{{{label},le="+Inf"}} {f.count}')
+                lines.append(f'{name}_sum{{{label}}} {f.sum.value}')
+                lines.append(f'{name}_count{{{label}}} {f.count}')
+                add(name, 'histogram' if isinstance(f, Histogram) else 'summary', *lines)
+                for suffix, v in [('min', f.min), ('max', f.max)]:
+                    if not v.empty:
+                        add(f'{name}_{suffix}', 'gauge', f'{name}_{suffix}{{{label}}} {v.value}')
+            elif not f.empty:
+                add(name, 'counter' if f.method == Method.Sum else 'gauge', f'{name}{{{label}}} {f.value}')
+
+    r = []
+    for name, (kind, lines) in sorted(metrics.items()):
+        r.append(f'# TYPE {name} {kind}')
+        r += lines
+    return '\n'.join(r) + '\n'
+
+def to_json(pages, snapshot_time=None):
+    ''' Format pages as JSON string '''
+    r = {'pages': {n: p.as_dict() for n, p in pages.items()}}
+    if snapshot_time is not None:
+        r['time'] = snapshot_time
+    return json.dumps(r)
@@ -91,6 +91,26 @@ using const_type_{f.name} = {t.replace("<Buf", "<const Buf")};
 const_type_{f.name} get_{f.name}() const {{ return this->template _get_binder<const_type_{f.name}>(offset_{f.name}); }}
 type_{f.name} get_{f.name}() {{ return this->template _get_binder<type_{f.name}>(offset_{f.name}); }}""" + suffix)
 
+def field_fixed(f):
+    if f.type == f.Pointer:
+        return False
+    elif f.type == f.Message:
+        return message_fixed(f.type_msg)
+    elif f.type == f.Union:
+        return all(field_fixed(x) for x in f.type_union.fields)
+    elif f.type == f.Array:
+        return field_fixed(f.type_array)
+    return True
+
+def message_fixed(msg):
+    return all(field_fixed(f) for f in msg.fields)
+
+def field2validate(f, offset):
+    t, m = field2type(f)
+    if m == 'string':
+        t = f"tll::scheme::binder::String<Buf, {cpp.offset_ptr_version(f)}>"
+    return f"this->template _get_binder<{t.replace('<Buf', '<const Buf')}>({offset}).validate()"
+
 def field2copy(f):
     _, tp = field2type(f)
     if tp in ('scalar', 'string', 'bytestring'):
@@ -107,6 +127,20 @@ struct ${u.name}: public tll::scheme::binder::Union<Buf, ${cpp.numeric(u.type_pt
 {
 	using union_index_type = ${cpp.numeric(u.type_ptr.type)};
 	using tll::scheme::binder::Union<Buf, union_index_type>::Union;
+
+	static constexpr bool meta_fixed() { return ${'true' if all(field_fixed(f) for f in u.fields) else 'false'}; }
+
+	bool validate() const
+	{
+		if (this->view().size() < this->data_offset + ${u.union_size})
+			return false;
+		switch (this->union_type()) {
+% for f in u.fields:
+		case index_${f.name}: return ${'true' if field_fixed(f) else field2validate(f, f.offset)};
+% endfor
+		default: return false;
+		}
+	}
 % for f in u.fields:
 
 <% (t, m) = field2type(f) %>\
@@ -176,6 +210,7 @@ struct ${msg.name}
 % if msg.msgid:
 	static constexpr int meta_id() { return ${msg.msgid}; }
 % endif
+	static constexpr bool meta_fixed() { return ${'true' if message_fixed(msg) else 'false'}; }
 % for f in msg.fields:
 	static constexpr size_t offset_${f.name} = ${f.offset};
 % endfor
@@ -201,6 +236,7 @@ ${cpp.indent("\t", cpp.declare_bits(b))}
 % if msg.msgid:
 		static constexpr auto meta_id() { return ${msg.name}::meta_id(); }
 % endif
+		static constexpr auto meta_fixed() { return ${msg.name}::meta_fixed(); }
 		void view_resize() { this->_view_resize(meta_size()); }
 % if msg.pmap:
 		bool _pmap_get(int index) const { return tll::scheme::pmap_get(this->view().view(${msg.pmap.offset}).data(), index); }
@@ -214,6 +250,20 @@ ${cpp.indent("\t", cpp.declare_bits(b))}
 			${field2copy(f)}
 % endfor
 		}
+
+		/// Check that message and all its variable size fields are inside buffer
+		bool validate() const
+		{
+			if (this->view().size() < meta_size())
+				return false;
+% for f in msg.fields:
+% if not field_fixed(f):
+			if (!${field2validate(f, 'offset_' + f.name)})
+				return false;
+% endif
+% endfor
+			return true;
+		}
 % for f in msg.fields:
 
 ${field2code(msg, f)}
@@ -225,6 +275,9 @@ ${field2code(msg, f)}
 
 	template <typename Buf>
 	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
+
+	template <typename Buf>
+	static bool validate(const Buf &buf, size_t offset = 0) { return bind(buf, offset).validate(); }
 };
 % endfor
 % if options.namespace:
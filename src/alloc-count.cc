@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Pavel Shramov <shramov@mexmat.net>
+ *
+ * tll is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/*
+ * Counting allocator: replacement of global operator new/delete that keeps number of allocations
+ * and allocated bytes. Intended to be loaded with LD_PRELOAD, processor reports counters in its
+ * rusage stat page.
+ */
+
+#include "tll/util/alloccount.h"
+
+#include <malloc.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+
+namespace {
+tll_alloc_count_t counters = {};
+
+inline void * count_alloc(void * ptr)
+{
+	if (ptr) {
+		counters.alloc.fetch_add(1, std::memory_order_relaxed);
+		counters.bytes.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed);
+	}
+	return ptr;
+}
+
+inline void count_free(void * ptr)
+{
+	if (!ptr)
+		return;
+	counters.free.fetch_add(1, std::memory_order_relaxed);
+	counters.bytes.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+	::free(ptr);
+}
+
+void * alloc_throw(size_t size)
+{
+	if (size == 0)
+		size = 1;
+	for (;;) {
+		if (auto ptr = count_alloc(malloc(size)); ptr)
+			return ptr;
+		auto handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void * alloc_aligned(size_t size, std::align_val_t align)
+{
+	if (size == 0)
+		size = 1;
+	void * ptr = nullptr;
+	auto a = std::max(sizeof(void *), static_cast<size_t>(align));
+	if (posix_memalign(&ptr, a, size))
+		return nullptr;
+	return count_alloc(ptr);
+}
+
+void * alloc_aligned_throw(size_t size, std::align_val_t align)
+{
+	for (;;) {
+		if (auto ptr = alloc_aligned(size, align); ptr)
+			return ptr;
+		auto handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+} // namespace
+
+extern "C" __attribute__((visibility("default"))) const tll_alloc_count_t * tll_alloc_count() { return &counters; }
+
+void * operator new(size_t size) { return alloc_throw(size); }
+void * operator new[](size_t size) { return alloc_throw(size); }
+void * operator new(size_t size, const std::nothrow_t &) noexcept { return count_alloc(malloc(size ? size : 1)); }
+void * operator new[](size_t size, const std::nothrow_t &) noexcept { return count_alloc(malloc(size ? size : 1)); }
+void * operator new(size_t size, std::align_val_t align) { return alloc_aligned_throw(size, align); }
+void * operator new[](size_t size, std::align_val_t align) { return alloc_aligned_throw(size, align); }
+void * operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept { return alloc_aligned(size, align); }
+void * operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept { return alloc_aligned(size, align); }
+
+void operator delete(void * ptr) noexcept { count_free(ptr); }
+void operator delete[](void * ptr) noexcept { count_free(ptr); }
+void operator delete(void * ptr, size_t) noexcept { count_free(ptr); }
+void operator delete[](void * ptr, size_t) noexcept { count_free(ptr); }
+void operator delete(void * ptr, const std::nothrow_t &) noexcept { count_free(ptr); }
+void operator delete[](void * ptr, const std::nothrow_t &) noexcept { count_free(ptr); }
+void operator delete(void * ptr, std::align_val_t) noexcept { count_free(ptr); }
+void operator delete[](void * ptr, std::align_val_t) noexcept { count_free(ptr); }
+void operator delete(void * ptr, size_t, std::align_val_t) noexcept { count_free(ptr); }
+void operator delete[](void * ptr, size_t, std::align_val_t) noexcept { count_free(ptr); }
+void operator delete(void * ptr, std::align_val_t, const std::nothrow_t &) noexcept { count_free(ptr); }
+void operator delete[](void * ptr, std::align_val_t, const std::nothrow_t &) noexcept { count_free(ptr); }
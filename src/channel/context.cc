@@ -26,6 +26,8 @@
 #include "tll/stat.h"
 #include "tll/util/listiter.h"
 #include "tll/util/refptr.h"
+#include "tll/util/props.h"
+#include "tll/util/time.h"
 #include "tll/util/value_tree_check.h"
 
 #include "channel/channels.h"
@@ -33,6 +35,7 @@
 #include "channel/async.h"
 #include "channel/blocks.h"
 #include "channel/convert.h"
+#include "channel/delta.h"
 #include "channel/direct.h"
 #include "channel/ipc.h"
 #include "channel/file-init.h"
@@ -50,8 +53,10 @@
 #include "channel/pub-mem.h"
 #include "channel/random.h"
 #include "channel/rate.h"
+#include "channel/recovery.h"
 #include "channel/resolve.h"
 #include "channel/rotate.h"
+#include "channel/seqpacket.h"
 #include "channel/serial.h"
 #include "channel/seq-check.h"
 #include "channel/stream-server.h"
@@ -60,6 +65,7 @@
 #include "channel/timeline.h"
 #include "channel/timer.h"
 #include "channel/udp.h"
+#include "channel/validate.h"
 #include "channel/yaml.h"
 #include "channel/zero.h"
 
@@ -71,9 +77,11 @@ TLL_DEFINE_IMPL(tll::channel::Convert);
 TLL_DEFINE_IMPL(tll::channel::Filter);
 TLL_DEFINE_IMPL(tll::channel::Random);
 TLL_DEFINE_IMPL(tll::channel::SeqCheck);
+TLL_DEFINE_IMPL(tll::channel::Validate);
 
 TLL_DECLARE_IMPL(tll::channel::Async);
 TLL_DECLARE_IMPL(tll::channel::Blocks);
+TLL_DECLARE_IMPL(ChDelta);
 TLL_DECLARE_IMPL(ChDirect);
 TLL_DECLARE_IMPL(ChIpc);
 TLL_DECLARE_IMPL(channel::FileInit);
@@ -86,9 +94,11 @@ TLL_DECLARE_IMPL(ChLZ4);
 TLL_DECLARE_IMPL(ChLZ4B);
 TLL_DECLARE_IMPL(ChPubMem);
 TLL_DECLARE_IMPL(ChPubServer);
+TLL_DECLARE_IMPL(ChSeqPacket);
 TLL_DECLARE_IMPL(ChSerial);
 TLL_DECLARE_IMPL(tll::channel::StreamServer);
 TLL_DECLARE_IMPL(tll::channel::Rate);
+TLL_DECLARE_IMPL(tll::channel::Recovery);
 TLL_DECLARE_IMPL(tll::channel::Resolve);
 TLL_DECLARE_IMPL(tll::channel::Rotate);
 TLL_DECLARE_IMPL(ChTcp);
@@ -128,6 +138,7 @@ struct tll_channel_context_t : public tll::util::refbase_t<tll_channel_context_t
 		reg(&tll::channel::Async::impl);
 		reg(&tll::channel::Blocks::impl);
 		reg(&tll::channel::Convert::impl);
+		reg(&ChDelta::impl);
 		reg(&ChDirect::impl);
 		reg(&ChIpc::impl);
 		reg(&channel::FileInit::impl);
@@ -145,8 +156,10 @@ struct tll_channel_context_t : public tll::util::refbase_t<tll_channel_context_t
 		reg(&ChPubServer::impl);
 		reg(&tll::channel::Random::impl);
 		reg(&tll::channel::Rate::impl);
+		reg(&tll::channel::Recovery::impl);
 		reg(&tll::channel::Resolve::impl);
 		reg(&tll::channel::Rotate::impl);
+		reg(&ChSeqPacket::impl);
 		reg(&ChSerial::impl);
 		reg(&tll::channel::StreamServer::impl);
 		reg(&ChTcp::impl);
@@ -154,6 +167,7 @@ struct tll_channel_context_t : public tll::util::refbase_t<tll_channel_context_t
 		reg(&tll::channel::TimeLine::impl);
 		reg(&ChTimer::impl);
 		reg(&ChUdp::impl);
+		reg(&tll::channel::Validate::impl);
 		reg(&ChYaml::impl);
 		reg(&ChZero::impl);
 
@@ -500,6 +514,17 @@ tll_channel_context_t * tll_channel_context_new(tll_config_t *defaults)
 	Config cfg;
 	if (defaults)
 		cfg = Config(defaults);
+
+	if (cfg.has("time.clock")) {
+		tll::Logger log = {"tll.context"};
+		auto reader = tll::make_props_reader(cfg);
+		auto clock = reader.getT("time.clock", TLL_TIME_CLOCK_REALTIME, {{"realtime", TLL_TIME_CLOCK_REALTIME}, {"tsc", TLL_TIME_CLOCK_TSC}});
+		if (!reader)
+			return log.fail(nullptr, "Invalid time clock: {}", reader.error());
+		if (auto r = tll_time_clock_set(clock); r)
+			log.warning("Failed to set time clock {}: {}, keep current one", cfg.get("time.clock").value_or(""), strerror(r));
+	}
+
 	return new tll_channel_context_t(cfg);
 }
 
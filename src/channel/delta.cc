@@ -0,0 +1,350 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#include "channel/delta.h"
+
+#include "tll/scheme.h"
+#include "tll/util/memoryview.h"
+#include "tll/util/size.h"
+#include "tll/util/varint.h"
+
+using namespace tll;
+
+TLL_DEFINE_IMPL(ChDelta);
+
+namespace {
+template <typename Buf>
+void put_uint(Buf &buf, uint64_t v)
+{
+	auto view = make_view(buf, buf.size());
+	tll::varint::encode_uint(v, view);
+}
+}
+
+int ChDelta::_init(const tll::Channel::Url &url, tll::Channel *master)
+{
+	auto reader = channel_props_reader(url);
+	_key_name = reader.getT<std::string>("key", "");
+	_max_slots = reader.getT<size_t>("max-slots", 1024);
+	_max_size = reader.getT("max-size", tll::util::Size { 256 * 1024 });
+	_min_run = reader.getT<size_t>("min-run", 3);
+	_refresh = reader.getT<size_t>("refresh", 0);
+	if (!reader)
+		return _log.fail(EINVAL, "Invalid url: {}", reader.error());
+	if (_min_run == 0)
+		return _log.fail(EINVAL, "Zero min-run parameter");
+
+	return Base::_init(url, master);
+}
+
+int ChDelta::_open(const tll::ConstConfig &props)
+{
+	_slot_map.clear();
+	_slots_enc.clear();
+	_slots_dec.clear();
+	_pending.reset();
+	_dropped = 0;
+
+	return Base::_open(props);
+}
+
+int ChDelta::_on_active()
+{
+	_keys.clear();
+	if (_key_name.size()) {
+		auto s = _child->scheme();
+		if (!s)
+			return _log.fail(EINVAL, "Child without scheme, can not lookup key field '{}'", _key_name);
+		for (auto m = s->messages; m; m = m->next) {
+			if (!m->msgid)
+				continue;
+			auto f = m->lookup(_key_name);
+			if (!f)
+				continue;
+			switch (f->type) {
+			case tll::scheme::Field::Int8:
+			case tll::scheme::Field::Int16:
+			case tll::scheme::Field::Int32:
+			case tll::scheme::Field::Int64:
+			case tll::scheme::Field::UInt8:
+			case tll::scheme::Field::UInt16:
+			case tll::scheme::Field::UInt32:
+			case tll::scheme::Field::UInt64:
+			case tll::scheme::Field::Bytes:
+				break;
+			default:
+				return _log.fail(EINVAL, "Key field {}.{} has unsupported type", m->name, f->name);
+			}
+			if (f->size > sizeof(uint64_t))
+				return _log.fail(EINVAL, "Key field {}.{} is too large: {} > {}", m->name, f->name, f->size, sizeof(uint64_t));
+			_log.debug("Key for message {}: offset {}, size {}", m->name, f->offset, f->size);
+			_keys.emplace(m->msgid, Key { f->offset, f->size });
+		}
+	}
+	return Base::_on_active();
+}
+
+tll::result_t<uint64_t> ChDelta::_key(const tll_msg_t *msg) const
+{
+	if (_keys.empty())
+		return 0;
+	auto it = _keys.find(msg->msgid);
+	if (it == _keys.end())
+		return 0;
+	if (msg->size < it->second.offset + it->second.size)
+		return error(fmt::format("Message size {} is less then key field end {}", msg->size, it->second.offset + it->second.size));
+	uint64_t key = 0;
+	memcpy(&key, static_cast<const char *>(msg->data) + it->second.offset, it->second.size);
+	return key;
+}
+
+int ChDelta::_post(const tll_msg_t *msg, int flags)
+{
+	if (msg->type != TLL_MESSAGE_DATA)
+		return Base::_post(msg, flags);
+	if (_inverted) {
+		auto m = _decode(msg);
+		if (!m) {
+			if (_drop)
+				return 0;
+			return _log.fail(EINVAL, "Failed to decode data ({} bytes)", msg->size);
+		}
+		return _child->post(m, flags);
+	}
+	if (msg->size > _max_size)
+		return _log.fail(EMSGSIZE, "Message size too large: {} > limit {}", msg->size, _max_size);
+	auto r = Base::_post(msg, flags);
+	// Peer state is changed only if message was posted, on failure (like EAGAIN) next delta is
+	// encoded against previous message again
+	_commit(msg, r == 0);
+	return r;
+}
+
+int ChDelta::_on_data(const tll_msg_t *msg)
+{
+	if (!_inverted) {
+		auto m = _decode(msg);
+		if (!m) {
+			if (_drop)
+				return 0;
+			return _log.fail(EINVAL, "Failed to decode data ({} bytes)", msg->size);
+		}
+		return _callback_data(m);
+	}
+	auto r = Base::_on_data(msg);
+	_commit(msg, true);
+	return r;
+}
+
+void ChDelta::_commit(const tll_msg_t *msg, bool delivered)
+{
+	if (!_pending)
+		return;
+	auto pending = *_pending;
+	_pending.reset();
+	if (delivered) {
+		auto & slot = _slots_enc[pending.slot];
+		slot.data.resize(msg->size);
+		memcpy(slot.data.data(), msg->data, msg->size);
+		slot.updates = pending.full ? 0 : slot.updates + 1;
+	} else if (pending.created) {
+		// Peer does not know about new slot, it is always last one
+		for (auto it = _slot_map.begin(); it != _slot_map.end(); it++) {
+			if (it->second == pending.slot) {
+				_slot_map.erase(it);
+				break;
+			}
+		}
+		_slots_enc.pop_back();
+	}
+}
+
+const tll_msg_t * ChDelta::_encode_raw(const tll_msg_t *msg, Frame frame, size_t slot)
+{
+	_buffer_enc.clear();
+	put_uint(_buffer_enc, (slot << 2) | frame);
+	auto view = make_view(_buffer_enc, _buffer_enc.size());
+	view.resize(msg->size);
+	memcpy(view.data(), msg->data, msg->size);
+
+	tll_msg_copy_info(&_msg_enc, msg);
+	_msg_enc.data = _buffer_enc.data();
+	_msg_enc.size = _buffer_enc.size();
+	return &_msg_enc;
+}
+
+const tll_msg_t * ChDelta::_encode(const tll_msg_t *msg)
+{
+	if (msg->size > _max_size)
+		return _log.fail(nullptr, "Message size too large: {} > limit {}", msg->size, _max_size);
+	auto key = _key(msg);
+	if (!key)
+		return _log.fail(nullptr, "Failed to get key from message {}: {}", msg->msgid, key.error());
+
+	_pending.reset();
+	bool created = false;
+	auto it = _slot_map.find({msg->msgid, *key});
+	if (it == _slot_map.end()) {
+		if (_slot_map.size() >= _max_slots)
+			return _encode_raw(msg, Frame::Raw, 0);
+		it = _slot_map.emplace(std::make_pair(msg->msgid, *key), _slots_enc.size()).first;
+		_slots_enc.emplace_back();
+		created = true;
+		_log.debug("New slot {} for msgid {}, key {}", it->second, msg->msgid, *key);
+	}
+
+	auto slot = it->second;
+	auto & prev = _slots_enc[slot].data;
+	auto updates = _slots_enc[slot].updates;
+
+	auto data = static_cast<const unsigned char *>(msg->data);
+	auto pdata = reinterpret_cast<const unsigned char *>(prev.data());
+	const size_t size = msg->size;
+	const size_t common = std::min(size, prev.size());
+
+	auto diff = [&](size_t i) -> unsigned char { return i < common ? data[i] ^ pdata[i] : data[i]; };
+	auto skip = [&](size_t i) -> size_t {
+		while (i < size) {
+			if (i + sizeof(uint64_t) <= common && !memcmp(data + i, pdata + i, sizeof(uint64_t))) {
+				i += sizeof(uint64_t);
+				continue;
+			}
+			if (diff(i))
+				return i;
+			i++;
+		}
+		return size;
+	};
+
+	// Periodic full message lets decoder that missed beginning of the stream to pick up the slot
+	bool full = prev.empty() || (_refresh && updates + 1 >= _refresh);
+
+	_buffer_enc.clear();
+	put_uint(_buffer_enc, (slot << 2) | Frame::Delta);
+	put_uint(_buffer_enc, size);
+
+	for (size_t last = 0, i = skip(0); !full && i < size; i = skip(i)) {
+		const size_t start = i;
+		size_t zeros = 0;
+		for (; i < size && zeros < _min_run; i++) {
+			if (diff(i))
+				zeros = 0;
+			else
+				zeros++;
+		}
+		const size_t end = i - zeros;
+
+		put_uint(_buffer_enc, start - last);
+		put_uint(_buffer_enc, end - start);
+		auto view = make_view(_buffer_enc, _buffer_enc.size());
+		view.resize(end - start);
+		auto ptr = view.dataT<unsigned char>();
+		for (auto j = start; j < end; j++)
+			*ptr++ = diff(j);
+		last = end;
+
+		if (_buffer_enc.size() >= size)
+			full = true; // Delta is larger then message itself
+	}
+
+	_pending = Pending { slot, created, full };
+
+	if (full)
+		return _encode_raw(msg, Frame::Full, slot);
+
+	_log.trace("Delta size: {}, message size {}", _buffer_enc.size(), size);
+
+	tll_msg_copy_info(&_msg_enc, msg);
+	_msg_enc.data = _buffer_enc.data();
+	_msg_enc.size = _buffer_enc.size();
+	return &_msg_enc;
+}
+
+const tll_msg_t * ChDelta::_decode(const tll_msg_t *msg)
+{
+	_drop = false;
+	auto ptr = static_cast<const unsigned char *>(msg->data);
+	auto end = ptr + msg->size;
+
+	uint64_t header;
+	auto r = tll::varint::decode_uint(header, ptr, end - ptr);
+	if (r < 0)
+		return _log.fail(nullptr, "Failed to decode frame header");
+	ptr += r;
+
+	auto frame = (Frame) (header & 0x3u);
+	auto slot = header >> 2;
+
+	tll_msg_copy_info(&_msg_dec, msg);
+
+	switch (frame) {
+	case Frame::Raw:
+		_msg_dec.data = ptr;
+		_msg_dec.size = end - ptr;
+		return &_msg_dec;
+	case Frame::Full:
+	case Frame::Delta:
+		break;
+	default:
+		return _log.fail(nullptr, "Invalid frame type {}", (unsigned) frame);
+	}
+
+	if (slot >= _max_slots)
+		return _log.fail(nullptr, "Invalid slot {}, limit is {}", slot, _max_slots);
+	// Slot table is sparse when stream is decoded not from the beginning
+	if (slot >= _slots_dec.size())
+		_slots_dec.resize(slot + 1);
+
+	if (frame == Frame::Full) {
+		auto & s = _slots_dec[slot];
+		s.data.resize(end - ptr);
+		memcpy(s.data.data(), ptr, s.data.size());
+		if (!s.valid)
+			_log.debug("Got full message for slot {}", slot);
+		s.valid = true;
+		_msg_dec.data = s.data.data();
+		_msg_dec.size = s.data.size();
+		return &_msg_dec;
+	}
+
+	if (!_slots_dec[slot].valid) {
+		if (_dropped++ == 0)
+			_log.info("Delta for unknown slot {}, messages are dropped until full frame is received", slot);
+		_drop = true;
+		return nullptr;
+	}
+
+	uint64_t size;
+	if (r = tll::varint::decode_uint(size, ptr, end - ptr); r < 0)
+		return _log.fail(nullptr, "Failed to decode message size");
+	ptr += r;
+	if (size > _max_size)
+		return _log.fail(nullptr, "Message size too large: {} > limit {}", size, _max_size);
+
+	auto & data = _slots_dec[slot].data;
+	data.resize(size);
+
+	auto out = reinterpret_cast<unsigned char *>(data.data());
+	for (size_t offset = 0; ptr < end; ) {
+		uint64_t skip, len;
+		if (r = tll::varint::decode_uint(skip, ptr, end - ptr); r < 0)
+			return _log.fail(nullptr, "Failed to decode skip length");
+		ptr += r;
+		if (r = tll::varint::decode_uint(len, ptr, end - ptr); r < 0)
+			return _log.fail(nullptr, "Failed to decode literal length");
+		ptr += r;
+		if (skip > size - offset || len > size - offset - skip)
+			return _log.fail(nullptr, "Delta range {} +{} out of message size {}", offset + skip, len, size);
+		if (len > (size_t) (end - ptr))
+			return _log.fail(nullptr, "Truncated delta: need {} bytes, got {}", len, end - ptr);
+		offset += skip;
+		for (auto i = 0u; i < len; i++)
+			out[offset + i] ^= ptr[i];
+		offset += len;
+		ptr += len;
+	}
+
+	_msg_dec.data = data.data();
+	_msg_dec.size = data.size();
+	return &_msg_dec;
+}
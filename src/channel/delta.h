@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#ifndef _TLL_CHANNEL_DELTA_H
+#define _TLL_CHANNEL_DELTA_H
+
+#include "tll/channel/codec.h"
+
+#include <map>
+#include <optional>
+
+class ChDelta : public tll::channel::Codec<ChDelta>
+{
+	using Base = tll::channel::Codec<ChDelta>;
+
+	/// Location of key field in message body
+	struct Key
+	{
+		size_t offset = 0;
+		size_t size = 0;
+	};
+
+	/// Last message seen for (msgid, key) pair
+	struct Slot
+	{
+		std::vector<char> data;
+		bool valid = false; ///< Decoder got full message for this slot, deltas can be applied
+		size_t updates = 0; ///< Number of deltas sent since last full message
+	};
+
+	std::string _key_name;
+	std::map<int, Key> _keys;
+
+	std::map<std::pair<int, uint64_t>, size_t> _slot_map;
+	std::vector<Slot> _slots_enc;
+	std::vector<Slot> _slots_dec;
+
+	/// Slot updated by last encoded message, it is committed only when message is passed further
+	struct Pending
+	{
+		size_t slot;
+		bool created; ///< Slot was created for this message
+		bool full; ///< Message is encoded as full frame
+	};
+	std::optional<Pending> _pending;
+
+	size_t _max_slots = 1024;
+	size_t _max_size = 0;
+	size_t _min_run = 3;
+	size_t _refresh = 0;
+
+	size_t _dropped = 0; ///< Number of deltas dropped because slot state is unknown
+	bool _drop = false; ///< Last decoded message was dropped, not an error
+
+ public:
+	static constexpr std::string_view channel_protocol() { return "delta+"; }
+
+	/// Frame types, stored in lower bits of frame header
+	enum Frame : unsigned
+	{
+		Raw = 0, ///< Message without state, not stored in slot
+		Full = 1, ///< Full message, stored in slot
+		Delta = 2, ///< Delta against last message in slot
+	};
+
+	int _init(const tll::Channel::Url &, tll::Channel *master);
+	int _open(const tll::ConstConfig &);
+
+	int _on_active();
+
+	int _post(const tll_msg_t *msg, int flags);
+	int _on_data(const tll_msg_t *msg);
+
+	const tll_msg_t * _encode(const tll_msg_t *msg);
+	const tll_msg_t * _decode(const tll_msg_t *msg);
+
+ private:
+	tll::result_t<uint64_t> _key(const tll_msg_t *msg) const;
+	const tll_msg_t * _encode_raw(const tll_msg_t *msg, Frame frame, size_t slot);
+	/// Store last encoded message in its slot if it was delivered or drop pending state
+	void _commit(const tll_msg_t *msg, bool delivered);
+};
+
+#endif//_TLL_CHANNEL_DELTA_H
@@ -317,6 +317,7 @@ int File<TIO>::_open(const ConstConfig &props)
 	_seq = _seq_begin = -1;
 	this->config_info().set_ptr("seq-begin", &_seq_begin);
 	this->config_info().set_ptr("seq", &_seq);
+	tll::channel::memory_export(this, _memory);
 	_delta_seq_base = 0;
 
 	auto reader = tll::make_props_reader(props);
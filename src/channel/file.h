@@ -9,6 +9,7 @@
 #define _TLL_CHANNEL_FILE_H
 
 #include "tll/channel/autoseq.h"
+#include "tll/channel/memory.h"
 
 #include "tll/util/lz4block.h"
 #include "tll/util/memoryview.h"
@@ -57,6 +58,8 @@ class File : public tll::channel::AutoSeq<File<TIO>>
 	tll::lz4::StreamEncode _lz4_encode;
 	std::vector<char> _lz4_buf;
 
+	tll::channel::MemoryAccount _memory;
+
 	long long _delta_seq_base = 0;
 	Compression _compression = Compression::None, _compression_init = Compression::None;
 	Version _version = Version::Stable, _version_init = Version::Stable;
@@ -116,6 +119,7 @@ private:
 			return this->_log.fail(EINVAL, "Failed to init lz4 decoder with block size {}", block);
 		_lz4_decode_offset = -1;
 		_lz4_decode_last = {};
+		_memory.update(_lz4_buf.capacity() + _lz4_encode.ring.ring.capacity() + _lz4_decode.ring.ring.capacity());
 		return 0;
 	}
 
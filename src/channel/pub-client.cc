@@ -27,9 +27,12 @@ int ChPubClient::_init(const Channel::Url &url, tll::Channel *master)
 	_peer = reader.getT<std::string>("peer", "");
 	auto size = reader.getT<util::Size>("max-size", 64 * 1024);
 	_size = reader.getT<util::Size>("size", 4 * size); // At least 4 messages
+	auto tls = reader.getT("tls", false);
 
 	if (!reader)
 		return _log.fail(EINVAL, "Invalid url: {}", reader.error());
+	if (tls)
+		return _log.fail(EINVAL, "TLS is not supported");
 
 	return 0;
 }
@@ -60,8 +60,11 @@ int ChPubServer::_init(const Channel::Url &url, tll::Channel *master)
 	_hello = reader.getT("hello", true);
 	auto size = reader.getT<util::Size>("size", 64 * 1024);
 	_size = reader.getT<util::Size>("size", std::max(1024lu * 1024, 16 * size)); // Preserve default of 1mb
+	auto tls = reader.getT("tls", false);
 	if (!reader)
 		return _log.fail(EINVAL, "Invalid url: {}", reader.error());
+	if (tls)
+		return _log.fail(EINVAL, "TLS is not supported");
 
 	if (_size < 1024)
 		return _log.fail(EINVAL, "Buffer size too small: {}", _size);
@@ -69,6 +72,9 @@ int ChPubServer::_init(const Channel::Url &url, tll::Channel *master)
 	_ring.data_resize(_size);
 	_ring.resize(_size / 64);
 
+	_memory.update(_ring.data_capacity() + (_ring.capacity() + 1) * sizeof(decltype(_ring)::value_type));
+	tll::channel::memory_export(this, _memory);
+
 	return 0;
 }
 
@@ -60,6 +60,8 @@ class ChPubServer : public tll::channel::LastSeqTx<ChPubServer, tll::channel::Tc
 	tll::util::DataRing<tll_frame_t> _ring;
 	bool _hello = true;
 
+	tll::channel::MemoryAccount _memory;
+
  public:
 	static constexpr auto socket_impl_policy() { return SocketImplPolicy::Fixed; }
 
@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#include "channel/recovery.h"
+#include "channel/stream-scheme.h"
+
+using namespace tll;
+using namespace tll::channel;
+
+TLL_DEFINE_IMPL(Recovery);
+
+int Recovery::_on_init(tll::Channel::Url &curl, const tll::Channel::Url &url, tll::Channel *master)
+{
+	auto reader = channel_props_reader(url);
+	_buffer_size = reader.getT<unsigned>("buffer-size", 10000);
+	_peer = reader.getT<std::string>("peer", "");
+	_fail_on_loss = reader.getT("on-loss", false, {{"skip", false}, {"fail", true}});
+	if (!reader)
+		return _log.fail(EINVAL, "Invalid url: {}", reader.error());
+
+	if (_buffer_size == 0)
+		return _log.fail(EINVAL, "Zero buffer size");
+
+	auto rurl = url.getT<tll::Channel::Url>("request");
+	if (!rurl)
+		return _log.fail(EINVAL, "Failed to get request url: {}", rurl.error());
+	child_url_fill(*rurl, "request");
+	if (!rurl->has("mode"))
+		rurl->set("mode", "client");
+
+	_request = context().channel(*rurl, master);
+	if (!_request)
+		return _log.fail(EINVAL, "Failed to create request channel");
+	_request->callback_add<Recovery, &Recovery::_on_request_state>(this, TLL_MESSAGE_MASK_STATE);
+	_request->callback_add<Recovery, &Recovery::_on_request_data>(this, TLL_MESSAGE_MASK_DATA);
+	_child_add(_request.get(), "request");
+
+	curl.unlink("request");
+	return 0;
+}
+
+int Recovery::_open(const tll::ConstConfig &cfg)
+{
+	_buffer.clear();
+	_recover = Recover::Idle;
+
+	if (auto sub = cfg.sub("request"); sub)
+		_request_open = sub->copy();
+	else
+		_request_open = tll::Config();
+
+	auto reader = channel_props_reader(cfg);
+	_seq = reader.getT<long long>("seq", -1);
+	if (!reader)
+		return _log.fail(EINVAL, "Invalid open parameters: {}", reader.error());
+
+	config_info().set_ptr("seq", &_seq);
+
+	return Base::_open(cfg);
+}
+
+int Recovery::_close(bool force)
+{
+	_recover_close();
+	_buffer.clear();
+	config_info().setT("seq", _seq);
+	return Base::_close(force);
+}
+
+int Recovery::_on_data(const tll_msg_t *msg)
+{
+	if (_seq == -1 && _buffer.empty()) {
+		_log.info("First message with seq {}", msg->seq);
+		return _deliver(msg);
+	}
+
+	if (msg->seq <= _seq) {
+		if (auto page = stat_acquire(this); page)
+			page->dup.update(1);
+		return 0;
+	}
+
+	if (msg->seq != _seq + 1)
+		return _store(msg);
+
+	auto guard = state_guard();
+	_deliver(msg);
+	if (guard)
+		return 0;
+	return _drain();
+}
+
+int Recovery::_store(const tll_msg_t *msg)
+{
+	auto [it, inserted] = _buffer.try_emplace(msg->seq);
+	if (!inserted) {
+		if (auto page = stat_acquire(this); page)
+			page->dup.update(1);
+		return 0;
+	}
+
+	auto & m = it->second;
+	m.msgid = msg->msgid;
+	m.time = msg->time;
+	m.addr = msg->addr;
+	m.stored = tll::time::now();
+	auto data = static_cast<const char *>(msg->data);
+	m.data.assign(data, data + msg->size);
+
+	if (_recover == Recover::Idle) {
+		_log.info("Gap detected: last seq {}, received {}", _seq, msg->seq);
+		if (auto r = _recover_begin(); r)
+			return r;
+	}
+
+	if (_buffer.size() > _buffer_size) {
+		if (_fail_on_loss)
+			return state_fail(0, "Recovery buffer overflow: {} messages, gap {}..{}", _buffer.size(), _seq + 1, _buffer.begin()->first - 1);
+		_log.warning("Recovery buffer overflow: {} messages, skip gap {}..{}", _buffer.size(), _seq + 1, _buffer.begin()->first - 1);
+		return _skip_gap();
+	}
+	return 0;
+}
+
+int Recovery::_drain()
+{
+	// Drop messages that were already delivered from request channel
+	while (!_buffer.empty() && _buffer.begin()->first <= _seq)
+		_buffer.erase(_buffer.begin());
+
+	auto guard = state_guard();
+	while (!_buffer.empty() && _buffer.begin()->first == _seq + 1) {
+		// Extract node, user callback can close channel and clear buffer
+		auto node = _buffer.extract(_buffer.begin());
+		auto & m = node.mapped();
+
+		if (auto page = stat_acquire(this); page)
+			page->buftime = std::chrono::duration_cast<std::chrono::nanoseconds>(tll::time::now() - m.stored).count();
+
+		tll_msg_t msg = { TLL_MESSAGE_DATA };
+		msg.msgid = m.msgid;
+		msg.seq = node.key();
+		msg.time = m.time;
+		msg.addr = m.addr;
+		msg.data = m.data.data();
+		msg.size = m.data.size();
+		_deliver(&msg);
+		if (guard)
+			return 0;
+	}
+
+	if (_buffer.empty() && _recover != Recover::Idle)
+		return _recover_done();
+	return 0;
+}
+
+int Recovery::_skip_gap()
+{
+	if (_buffer.empty())
+		return 0;
+	auto first = _buffer.begin()->first;
+	_log.warning("Lost {} messages: {}..{}", first - _seq - 1, _seq + 1, first - 1);
+	if (auto page = stat_acquire(this); page)
+		page->lost.update(first - _seq - 1);
+	_seq = first - 1;
+	return _drain();
+}
+
+int Recovery::_on_loss(std::string_view reason)
+{
+	if (_fail_on_loss)
+		return state_fail(0, "Failed to recover gap after seq {}: {}", _seq, reason);
+	_log.warning("Failed to recover gap after seq {}: {}", _seq, reason);
+
+	auto guard = state_guard();
+	while (!_buffer.empty()) {
+		_skip_gap();
+		if (guard)
+			return 0;
+	}
+	if (_recover != Recover::Idle)
+		return _recover_done();
+	return 0;
+}
+
+int Recovery::_recover_begin()
+{
+	if (auto page = stat_acquire(this); page)
+		page->gap.update(1);
+	_recover_start = tll::time::now();
+
+	if (_request->state() != tll::state::Closed) {
+		_log.debug("Close stale request channel in state {}", tll_state_str(_request->state()));
+		_recover_close();
+	}
+
+	_log.info("Open request channel from seq {}", _seq + 1);
+	_recover = Recover::Opening;
+	if (_request->open(_request_open) && _recover == Recover::Opening)
+		return _on_loss("failed to open request channel");
+	return 0;
+}
+
+int Recovery::_recover_done()
+{
+	if (_recover == Recover::Active)
+		_post_done();
+
+	if (auto page = stat_acquire(this); page)
+		page->rectime = std::chrono::duration_cast<std::chrono::nanoseconds>(tll::time::now() - _recover_start).count();
+	_log.info("Recovery finished on seq {}", _seq);
+	_recover_close();
+	return 0;
+}
+
+void Recovery::_recover_close()
+{
+	_recover = Recover::Closing;
+	if (_request && _request->state() != tll::state::Closed)
+		_request->close(_request->state() == tll::state::Error);
+	_recover = Recover::Idle;
+}
+
+int Recovery::_post_done()
+{
+	auto data = stream_scheme::ClientDone::bind(_request_buf);
+	data.view().resize(0);
+	data.view().resize(data.meta_size());
+	data.set_seq(_seq);
+
+	tll_msg_t msg = { TLL_MESSAGE_DATA };
+	msg.msgid = data.meta_id();
+	msg.data = data.view().data();
+	msg.size = data.view().size();
+	if (auto r = _request->post(&msg); r)
+		_log.warning("Failed to post Done message");
+	return 0;
+}
+
+int Recovery::_on_request_active()
+{
+	if (_recover != Recover::Opening)
+		return 0;
+
+	auto req = stream_scheme::Request::bind_reset(_request_buf);
+	req.set_version(stream_scheme::Version::Current);
+	if (_peer.size())
+		req.set_client(_peer);
+	req.get_data().set_seq(_seq + 1);
+
+	tll_msg_t msg = { TLL_MESSAGE_DATA };
+	msg.msgid = req.meta_id();
+	msg.data = req.view().data();
+	msg.size = req.view().size();
+	if (auto r = _request->post(&msg); r)
+		return _on_loss("failed to post request message");
+	_log.info("Posted request for seq {}", _seq + 1);
+	_recover = Recover::Requested;
+	return 0;
+}
+
+int Recovery::_on_request_error()
+{
+	switch (_recover) {
+	case Recover::Idle:
+	case Recover::Closing:
+		return 0;
+	default:
+		return _on_loss("request channel failed");
+	}
+}
+
+int Recovery::_on_request_closed()
+{
+	switch (_recover) {
+	case Recover::Idle:
+	case Recover::Closing:
+		return 0;
+	default:
+		return _on_loss("request channel closed");
+	}
+}
+
+int Recovery::_on_request_data(const tll::Channel *, const tll_msg_t *msg)
+{
+	if (_recover == Recover::Requested) {
+		if (msg->msgid == stream_scheme::Error::meta_id()) {
+			auto data = stream_scheme::Error::bind(*msg);
+			if (data.meta_size() > msg->size)
+				return _on_loss(fmt::format("invalid Error message size: {} < min {}", msg->size, data.meta_size()));
+			return _on_loss(fmt::format("server error: {}", data.get_error()));
+		} else if (msg->msgid != stream_scheme::Reply::meta_id())
+			return _on_loss(fmt::format("unknown message from server: {}", msg->msgid));
+		auto data = stream_scheme::Reply::bind(*msg);
+		if (msg->size < data.meta_size())
+			return _on_loss(fmt::format("invalid reply size: {} < minimum {}", msg->size, data.meta_size()));
+		_log.info("Server seq: {}, requested seq: {}", data.get_last_seq(), data.get_requested_seq());
+		_recover = Recover::Active;
+		if (data.get_last_seq() <= _seq)
+			return _on_loss(fmt::format("server has no data after seq {}", data.get_last_seq()));
+		if (_buffer.empty())
+			return _recover_done();
+		return 0;
+	} else if (_recover != Recover::Active)
+		return 0;
+
+	if (msg->seq <= _seq)
+		return 0;
+	if (msg->seq > _seq + 1) {
+		_log.warning("Server skipped {} messages: {}..{}", msg->seq - _seq - 1, _seq + 1, msg->seq - 1);
+		if (auto page = stat_acquire(this); page)
+			page->lost.update(msg->seq - _seq - 1);
+	}
+
+	// Buffered copy is not needed anymore
+	_buffer.erase(msg->seq);
+
+	auto guard = state_guard();
+	_deliver(msg);
+	if (guard)
+		return 0;
+	return _drain();
+}
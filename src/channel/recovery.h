@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#ifndef _TLL_IMPL_CHANNEL_RECOVERY_H
+#define _TLL_IMPL_CHANNEL_RECOVERY_H
+
+#include "tll/channel/prefix.h"
+#include "tll/util/time.h"
+
+#include <map>
+#include <vector>
+
+namespace tll::channel {
+
+/**
+ * Reliable delivery on top of lossy online channel with contiguous seq, for example multicast feed.
+ *
+ * Messages are passed to user in seq order. Messages received after a gap are buffered and missing
+ * range is requested from stream server using request channel (same protocol as stream client).
+ * When gap is filled buffered messages are delivered and request channel is closed.
+ */
+class Recovery : public tll::channel::Prefix<Recovery>
+{
+	using Base = tll::channel::Prefix<Recovery>;
+
+	/// Message stored after the gap
+	struct Stored
+	{
+		int msgid = 0;
+		long long time = 0;
+		tll_addr_t addr = {};
+		tll::time_point stored = {}; ///< Time when message was buffered
+		std::vector<char> data;
+	};
+
+	std::map<long long, Stored> _buffer;
+	size_t _buffer_size = 0; ///< Maximum number of buffered messages
+
+	std::unique_ptr<Channel> _request;
+	tll::Config _request_open;
+	std::vector<char> _request_buf;
+	std::string _peer;
+
+	enum class Recover { Idle, Opening, Requested, Active, Closing };
+	Recover _recover = Recover::Idle;
+	tll::time_point _recover_start = {};
+
+	long long _seq = -1; ///< Last delivered seq
+	bool _fail_on_loss = false;
+
+ public:
+	static constexpr std::string_view channel_protocol() { return "recovery+"; }
+	static constexpr auto readwrite_policy() { return ReadWritePolicy::ReadOnly; }
+	static constexpr auto prefix_config_policy() { return PrefixConfigPolicy::Extend; }
+
+	struct StatType : public Base::StatType
+	{
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'g', 'a', 'p'> gap; ///< Number of started recoveries
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'l', 'o', 's', 't'> lost; ///< Messages that were not recovered
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'd', 'u', 'p'> dup; ///< Dropped duplicates
+		tll::stat::IntegerGroup<tll::stat::Ns, 'b', 'u', 'f', 't', 'i', 'm', 'e'> buftime; ///< Time spent by message in buffer
+		tll::stat::IntegerGroup<tll::stat::Ns, 'r', 'e', 'c', 't', 'i', 'm', 'e'> rectime; ///< Time from gap detection to recovery
+	};
+
+	int _on_init(tll::Channel::Url &curl, const tll::Channel::Url &url, tll::Channel *master);
+	void _free()
+	{
+		_request.reset();
+		return Base::_free();
+	}
+
+	int _open(const tll::ConstConfig &cfg);
+	int _close(bool force);
+
+	int _on_data(const tll_msg_t *msg);
+	int _on_closing()
+	{
+		_recover_close();
+		return Base::_on_closing();
+	}
+
+ private:
+	int _on_request_state(const tll::Channel *, const tll_msg_t *msg)
+	{
+		switch ((tll_state_t) msg->msgid) {
+		case tll::state::Active: return _on_request_active();
+		case tll::state::Error: return _on_request_error();
+		case tll::state::Closed: return _on_request_closed();
+		default:
+			return 0;
+		}
+	}
+
+	int _on_request_data(const tll::Channel *, const tll_msg_t *msg);
+	int _on_request_active();
+	int _on_request_error();
+	int _on_request_closed();
+
+	/// Pass message to user and update last seq
+	int _deliver(const tll_msg_t *msg)
+	{
+		_seq = msg->seq;
+		return _callback_data(msg);
+	}
+
+	/// Deliver buffered messages that are in order, finish recovery if there is no gap left
+	int _drain();
+
+	/// Store message after the gap, start recovery if needed
+	int _store(const tll_msg_t *msg);
+
+	/// Account lost range and skip to first buffered message
+	int _skip_gap();
+
+	/// Missing data can not be recovered, fail or skip all gaps depending on on-loss parameter
+	int _on_loss(std::string_view reason);
+
+	int _recover_begin();
+	int _recover_done();
+	void _recover_close();
+	int _post_done();
+};
+
+} // namespace tll::channel
+
+#endif//_TLL_IMPL_CHANNEL_RECOVERY_H
@@ -0,0 +1,629 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#include "channel/seqpacket.h"
+
+#include "tll/channel/tcp.h"
+#include "tll/channel/tcp.hpp"
+#include "tll/util/size.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <set>
+
+using namespace tll;
+using tll::channel::TcpChannelMode;
+
+namespace {
+
+/// Packet header, inline messages have body right after the header
+struct packet_header_t
+{
+	enum Type : uint16_t { Inline = 0, Shared = 1, Release = 2 };
+
+	int32_t msgid;
+	uint16_t type;
+	uint16_t reserved;
+	int64_t seq;
+	uint64_t offset; ///< Offset of the body in the shared pool, for Shared and Release packets
+	uint64_t size; ///< Body size
+};
+
+static_assert(sizeof(packet_header_t) == 32, "Unexpected padding in packet header");
+
+/**
+ * Shared memory pool backed by memfd
+ *
+ * Message body is written into the block once and reference is passed to the peer. Block is freed
+ * when all references are released by peers or their connections are closed. Block is shared only
+ * inside explicit broadcast scope (see share_begin/share_end): all puts in the scope reference block
+ * written by the first one.
+ */
+class Pool
+{
+	int _fd = -1;
+	char * _data = nullptr;
+	size_t _size = 0;
+	std::map<size_t, size_t> _free; ///< Free blocks, offset -> size
+	std::map<size_t, std::pair<size_t, unsigned>> _used; ///< Allocated blocks, offset -> (size, refs)
+
+	bool _sharing = false; ///< Broadcast scope is active
+	std::optional<size_t> _shared; ///< Block of current broadcast message
+
+ public:
+	static constexpr size_t align = 64;
+
+	~Pool() { reset(); }
+
+	int fd() const { return _fd; }
+	size_t size() const { return _size; }
+
+	/// Start broadcast scope, same message body is posted to several peers until share_end
+	void share_begin() { _sharing = true; _shared.reset(); }
+	void share_end() { _sharing = false; _shared.reset(); }
+
+	int init(tll::Logger &log, std::string_view name, size_t size)
+	{
+		reset();
+		size = (size + align - 1) & ~(align - 1);
+#ifdef __linux__
+		_fd = memfd_create(std::string(name).c_str(), MFD_CLOEXEC);
+#else
+		auto path = fmt::format("/tll-seqpacket-{}-{}", getpid(), (void *) this);
+		_fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (_fd != -1)
+			shm_unlink(path.c_str());
+#endif
+		if (_fd == -1)
+			return log.fail(EINVAL, "Failed to create shared memory: {}", strerror(errno));
+		if (ftruncate(_fd, size))
+			return log.fail(EINVAL, "Failed to resize shared memory to {}: {}", size, strerror(errno));
+		auto ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+		if (ptr == MAP_FAILED)
+			return log.fail(EINVAL, "Failed to map shared memory: {}", strerror(errno));
+		_data = static_cast<char *>(ptr);
+		_size = size;
+		_free.emplace(0, size);
+		log.info("Shared memory pool size {}", size);
+		return 0;
+	}
+
+	void reset()
+	{
+		if (_data)
+			munmap(_data, _size);
+		if (_fd != -1)
+			::close(_fd);
+		_fd = -1;
+		_data = nullptr;
+		_size = 0;
+		_free.clear();
+		_used.clear();
+		_sharing = false;
+		_shared.reset();
+	}
+
+	/// Write message body into the pool, returns block offset or nullopt if there is no free space
+	std::optional<size_t> put(const tll_msg_t *msg)
+	{
+		if (_shared) {
+			_used[*_shared].second++;
+			return _shared;
+		}
+
+		auto offset = _allocate(msg->size);
+		if (!offset)
+			return std::nullopt;
+		memcpy(_data + *offset, msg->data, msg->size);
+		if (_sharing)
+			_shared = offset;
+		return offset;
+	}
+
+	/// Drop one reference to the block
+	int release(size_t offset)
+	{
+		auto it = _used.find(offset);
+		if (it == _used.end())
+			return ENOENT;
+		if (--it->second.second)
+			return 0;
+		auto size = it->second.first;
+		_used.erase(it);
+		if (_shared == offset)
+			_shared.reset();
+
+		auto next = _free.lower_bound(offset);
+		if (next != _free.end() && offset + size == next->first) {
+			size += next->second;
+			next = _free.erase(next);
+		}
+		if (next != _free.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset) {
+				prev->second += size;
+				return 0;
+			}
+		}
+		_free.emplace_hint(next, offset, size);
+		return 0;
+	}
+
+ private:
+	std::optional<size_t> _allocate(size_t size)
+	{
+		size = std::max(align, (size + align - 1) & ~(align - 1));
+		for (auto it = _free.begin(); it != _free.end(); it++) {
+			if (it->second < size)
+				continue;
+			auto offset = it->first;
+			auto rest = it->second - size;
+			it = _free.erase(it);
+			if (rest)
+				_free.emplace_hint(it, offset + size, rest);
+			_used.emplace(offset, std::make_pair(size, 1u));
+			return offset;
+		}
+		return std::nullopt;
+	}
+};
+
+} // namespace
+
+template <typename T>
+class SeqPacketSocketT : public tll::channel::TcpSocket<T>
+{
+ protected:
+	std::shared_ptr<Pool> _pool; ///< Pool for outgoing messages, shared between server sockets
+	size_t _inline_size = 0; ///< Messages larger then this size are passed through the pool
+	bool _pool_sent = false; ///< Pool descriptor was passed to the peer
+	std::multiset<size_t> _refs; ///< Blocks referenced by the peer
+
+	const char * _peer_data = nullptr; ///< Mapped pool of the peer
+	size_t _peer_size = 0;
+	std::vector<size_t> _release_queue; ///< Release notifications delayed by full socket buffer
+
+ public:
+	using Base = tll::channel::TcpSocket<T>;
+
+	static constexpr std::string_view param_prefix() { return "seqpacket"; }
+
+	struct StatType : public Base::StatType
+	{
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 's', 'h', 'm', 't', 'x'> shmtx; ///< Messages sent through the pool
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 's', 'h', 'm', 'r', 'x'> shmrx; ///< Messages received from peer pool
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 's', 'h', 'm', 'f', 'u', 'l', 'l'> shmfull; ///< Posts failed due to full pool
+	};
+
+	void pool(std::shared_ptr<Pool> pool, size_t inline_size)
+	{
+		_pool = std::move(pool);
+		_inline_size = inline_size;
+	}
+
+	int _close()
+	{
+		for (auto offset : _refs)
+			_pool->release(offset);
+		_refs.clear();
+		_pool_sent = false;
+		_release_queue.clear();
+		_peer_unmap();
+		return Base::_close();
+	}
+
+	int _post_data(const tll_msg_t *msg, int flags);
+	int _process(long timeout, int flags);
+
+ private:
+	ssize_t _send(const packet_header_t &header, const void * data, size_t size, int fd = -1);
+
+	int _on_release(size_t offset);
+	int _send_release(size_t offset);
+	int _flush_release();
+
+	int _peer_map(int fd);
+	void _peer_unmap()
+	{
+		if (_peer_data)
+			munmap((void *) _peer_data, _peer_size);
+		_peer_data = nullptr;
+		_peer_size = 0;
+	}
+};
+
+template <typename T>
+ssize_t SeqPacketSocketT<T>::_send(const packet_header_t &header, const void * data, size_t size, int fd)
+{
+	iovec iov[2] = {{(void *) &header, sizeof(header)}, {(void *) data, size}};
+	msghdr mhdr = {};
+	mhdr.msg_iov = iov;
+	mhdr.msg_iovlen = size ? 2 : 1;
+
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+	if (fd != -1) {
+		mhdr.msg_control = control;
+		mhdr.msg_controllen = sizeof(control);
+		auto cmsg = CMSG_FIRSTHDR(&mhdr);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+	}
+	return sendmsg(this->fd(), &mhdr, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+template <typename T>
+int SeqPacketSocketT<T>::_post_data(const tll_msg_t *msg, int flags)
+{
+	if (msg->type != TLL_MESSAGE_DATA)
+		return 0;
+
+	packet_header_t header = {};
+	header.msgid = msg->msgid;
+	header.seq = msg->seq;
+	header.size = msg->size;
+
+	if (!_pool || msg->size <= _inline_size) {
+		header.type = packet_header_t::Inline;
+		if (_send(header, msg->data, msg->size) < 0) {
+			if (errno == EAGAIN)
+				return EAGAIN;
+			return this->_on_send_error(this->_log.fail(errno, "Failed to post data: {}", strerror(errno)));
+		}
+		return 0;
+	}
+
+	auto offset = _pool->put(msg);
+	if (!offset) {
+		this->_log.debug("No space in shared pool for {} bytes", msg->size);
+		if (auto page = tll::channel::stat_acquire(this); page)
+			page->shmfull.update(1);
+		return EAGAIN;
+	}
+
+	header.type = packet_header_t::Shared;
+	header.offset = *offset;
+	if (_send(header, nullptr, 0, _pool_sent ? -1 : _pool->fd()) < 0) {
+		auto err = errno;
+		_pool->release(*offset);
+		if (err == EAGAIN)
+			return EAGAIN;
+		return this->_on_send_error(this->_log.fail(err, "Failed to post data: {}", strerror(err)));
+	}
+	_pool_sent = true;
+	_refs.insert(*offset);
+	if (auto page = tll::channel::stat_acquire(this); page)
+		page->shmtx.update(1);
+	return 0;
+}
+
+template <typename T>
+int SeqPacketSocketT<T>::_process(long timeout, int flags)
+{
+	if (_release_queue.size()) {
+		if (auto r = _flush_release(); r)
+			return r;
+	}
+
+	this->_rbuf_acquire();
+	auto & buf = this->_rbuf.buf;
+	iovec iov = { buf.data(), buf.size() };
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+	msghdr mhdr = {};
+	mhdr.msg_iov = &iov;
+	mhdr.msg_iovlen = 1;
+	mhdr.msg_control = control;
+	mhdr.msg_controllen = sizeof(control);
+
+	auto r = recvmsg(this->fd(), &mhdr, MSG_NOSIGNAL | MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	if (r < 0) {
+		this->_rbuf_release();
+		if (errno == EAGAIN)
+			return EAGAIN;
+		return this->state_fail(EINVAL, "Failed to receive data: {}", strerror(errno));
+	} else if (r == 0) {
+		this->_rbuf_release();
+		this->_log.debug("Connection closed");
+		this->channelT()->_on_close();
+		return 0;
+	}
+
+	for (auto cmsg = CMSG_FIRSTHDR(&mhdr); cmsg; cmsg = CMSG_NXTHDR(&mhdr, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		int fd = -1;
+		memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+		if (_peer_map(fd))
+			return this->state_fail(EINVAL, "Failed to map peer shared memory");
+	}
+
+	if (mhdr.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+		return this->state_fail(EMSGSIZE, "Truncated packet, receive buffer size {}", buf.size());
+	if ((size_t) r < sizeof(packet_header_t))
+		return this->state_fail(EMSGSIZE, "Packet size {} is less then header size {}", r, sizeof(packet_header_t));
+
+	tll::channel::busy_poll_stat_update(this, flags);
+
+	packet_header_t header;
+	memcpy(&header, buf.data(), sizeof(header));
+
+	tll_msg_t msg = { TLL_MESSAGE_DATA };
+	msg.msgid = header.msgid;
+	msg.seq = header.seq;
+	msg.addr = this->_msg_addr;
+
+	switch (header.type) {
+	case packet_header_t::Release:
+		this->_rbuf_release();
+		return _on_release(header.offset);
+	case packet_header_t::Inline:
+		if (header.size != r - sizeof(header))
+			return this->state_fail(EMSGSIZE, "Invalid inline message size {}, packet body {}", header.size, r - sizeof(header));
+		msg.data = buf.data() + sizeof(header);
+		msg.size = header.size;
+		this->_callback_data(&msg);
+		this->_rbuf_release();
+		return 0;
+	case packet_header_t::Shared:
+		this->_rbuf_release();
+		if (!_peer_data)
+			return this->state_fail(EINVAL, "Shared message without peer pool");
+		if (header.offset > _peer_size || header.size > _peer_size - header.offset)
+			return this->state_fail(EINVAL, "Shared message out of pool bounds: offset {}, size {}, pool {}", header.offset, header.size, _peer_size);
+		msg.data = _peer_data + header.offset;
+		msg.size = header.size;
+		if (auto page = tll::channel::stat_acquire(this); page)
+			page->shmrx.update(1);
+		this->_callback_data(&msg);
+		if (this->fd() == -1) // Closed from callback
+			return 0;
+		return _send_release(header.offset);
+	default:
+		break;
+	}
+	return this->state_fail(EINVAL, "Unknown packet type {}", header.type);
+}
+
+template <typename T>
+int SeqPacketSocketT<T>::_on_release(size_t offset)
+{
+	auto it = _refs.find(offset);
+	if (it == _refs.end())
+		return this->state_fail(EINVAL, "Peer released unknown block {}", offset);
+	_refs.erase(it);
+	_pool->release(offset);
+	return 0;
+}
+
+template <typename T>
+int SeqPacketSocketT<T>::_send_release(size_t offset)
+{
+	if (_release_queue.empty()) {
+		packet_header_t header = {};
+		header.type = packet_header_t::Release;
+		header.offset = offset;
+		if (_send(header, nullptr, 0) >= 0)
+			return 0;
+		if (errno != EAGAIN)
+			return this->state_fail(EINVAL, "Failed to release shared block: {}", strerror(errno));
+		this->_update_dcaps(tll::dcaps::CPOLLOUT);
+	}
+	_release_queue.push_back(offset);
+	return 0;
+}
+
+template <typename T>
+int SeqPacketSocketT<T>::_flush_release()
+{
+	auto it = _release_queue.begin();
+	for (; it != _release_queue.end(); it++) {
+		packet_header_t header = {};
+		header.type = packet_header_t::Release;
+		header.offset = *it;
+		if (_send(header, nullptr, 0) >= 0)
+			continue;
+		if (errno != EAGAIN)
+			return this->state_fail(EINVAL, "Failed to release shared block: {}", strerror(errno));
+		break;
+	}
+	_release_queue.erase(_release_queue.begin(), it);
+	if (_release_queue.empty())
+		this->_update_dcaps(0, tll::dcaps::CPOLLOUT);
+	return 0;
+}
+
+template <typename T>
+int SeqPacketSocketT<T>::_peer_map(int fd)
+{
+	_peer_unmap();
+	struct stat st = {};
+	if (fstat(fd, &st)) {
+		::close(fd);
+		return this->_log.fail(EINVAL, "Failed to get peer pool size: {}", strerror(errno));
+	}
+	auto ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (ptr == MAP_FAILED)
+		return this->_log.fail(EINVAL, "Failed to map peer pool: {}", strerror(errno));
+	_peer_data = static_cast<const char *>(ptr);
+	_peer_size = st.st_size;
+	this->_log.info("Mapped peer shared memory pool, size {}", _peer_size);
+	return 0;
+}
+
+class SeqPacketSocket : public SeqPacketSocketT<SeqPacketSocket>
+{
+ public:
+	using Base = SeqPacketSocketT<SeqPacketSocket>;
+
+	static constexpr std::string_view channel_protocol() { return "seqpacket-socket"; } // Only visible in logs
+	static constexpr auto open_policy() { return OpenPolicy::Manual; }
+
+	int _open(const tll::ConstConfig &cfg)
+	{
+		if (auto r = Base::_open(cfg); r)
+			return r;
+		state(tll::state::Active);
+		return 0;
+	}
+};
+
+/// Common pool settings for client and server
+struct pool_settings_t
+{
+	size_t size = 0;
+	size_t inline_size = 0;
+
+	template <typename Reader>
+	int init(tll::Logger &log, Reader &reader, const tll::channel::tcp_settings_t &settings)
+	{
+		size = reader.getT("pool-size", tll::util::Size { 64 * 1024 * 1024 });
+		inline_size = reader.getT("inline-size", tll::util::Size { 4096 });
+		if (!reader)
+			return log.fail(EINVAL, "Invalid url: {}", reader.error());
+		if (inline_size + sizeof(packet_header_t) > settings.rcv_buffer_size)
+			return log.fail(EINVAL, "Inline size {} does not fit into receive buffer {}", inline_size, settings.rcv_buffer_size);
+		return 0;
+	}
+};
+
+class SeqPacketClient : public tll::channel::TcpClient<SeqPacketClient, SeqPacketSocketT<SeqPacketClient>>
+{
+	pool_settings_t _pool_settings;
+
+ public:
+	using Base = tll::channel::TcpClient<SeqPacketClient, SeqPacketSocketT<SeqPacketClient>>;
+
+	static constexpr std::string_view channel_protocol() { return "seqpacket-client"; } // Only visible in logs
+
+	int _init(const tll::Channel::Url &url, tll::Channel *master)
+	{
+		if (auto r = Base::_init(url, master); r)
+			return r;
+		if (_peer && _peer->af != tll::network::AddressFamily::UNIX)
+			return _log.fail(EINVAL, "Only unix sockets are supported, got address {}", _peer->host);
+		_settings.socket_type = SOCK_SEQPACKET;
+
+		auto reader = channel_props_reader(url);
+		return _pool_settings.init(_log, reader, _settings);
+	}
+
+	int _open(const tll::ConstConfig &cfg)
+	{
+		std::shared_ptr<Pool> pool;
+		if (_pool_settings.size) {
+			pool.reset(new Pool);
+			if (pool->init(_log, name, _pool_settings.size))
+				return _log.fail(EINVAL, "Failed to create shared memory pool");
+		}
+		this->pool(std::move(pool), _pool_settings.inline_size);
+		return Base::_open(cfg);
+	}
+
+	int _close()
+	{
+		auto r = Base::_close();
+		_pool.reset();
+		return r;
+	}
+};
+
+class SeqPacketServer : public tll::channel::TcpServer<SeqPacketServer, SeqPacketSocket>
+{
+	pool_settings_t _pool_settings;
+	std::shared_ptr<Pool> _pool;
+	bool _broadcast = false;
+
+ public:
+	using Base = tll::channel::TcpServer<SeqPacketServer, SeqPacketSocket>;
+
+	static constexpr std::string_view channel_protocol() { return "seqpacket"; }
+	static constexpr std::string_view param_prefix() { return "seqpacket"; }
+	static constexpr auto socket_impl_policy() { return SocketImplPolicy::Fixed; }
+
+	int _init(const tll::Channel::Url &url, tll::Channel *master)
+	{
+		if (auto r = Base::_init(url, master); r)
+			return r;
+		if (_host.af != tll::network::AddressFamily::UNIX)
+			return _log.fail(EINVAL, "Only unix sockets are supported, got address {}", _host.host);
+		_settings.socket_type = SOCK_SEQPACKET;
+
+		auto reader = channel_props_reader(url);
+		_broadcast = reader.getT("broadcast", false);
+		return _pool_settings.init(_log, reader, _settings);
+	}
+
+	int _open(const tll::ConstConfig &cfg)
+	{
+		if (_pool_settings.size) {
+			_pool.reset(new Pool);
+			if (_pool->init(_log, name, _pool_settings.size))
+				return _log.fail(EINVAL, "Failed to create shared memory pool");
+		}
+		return Base::_open(cfg);
+	}
+
+	int _close()
+	{
+		auto r = Base::_close();
+		_pool.reset();
+		return r;
+	}
+
+	int _post(const tll_msg_t *msg, int flags)
+	{
+		if (msg->addr.u64 != 0 || !_broadcast)
+			return Base::_post(msg, flags);
+		if (msg->type != TLL_MESSAGE_DATA)
+			return 0;
+
+		if (_pool)
+			_pool->share_begin();
+		for (auto & [fd, c] : _clients) {
+			if (c->state() != tll::state::Active)
+				continue;
+			if (auto r = c->post(msg, flags); r)
+				_log.warning("Failed to post broadcast message to {}: {}", c->name, strerror(r));
+		}
+		if (_pool)
+			_pool->share_end();
+		return 0;
+	}
+
+	int _on_accept(tll_channel_t * c)
+	{
+		auto socket = tll::channel_cast<SeqPacketSocket>(c);
+		if (!socket)
+			return _log.fail(EINVAL, "Invalid socket channel type");
+		socket->pool(_pool, _pool_settings.inline_size);
+		return 0;
+	}
+};
+
+TLL_DEFINE_IMPL(ChSeqPacket);
+TLL_DEFINE_IMPL(SeqPacketClient);
+TLL_DEFINE_IMPL(SeqPacketServer);
+TLL_DEFINE_IMPL(SeqPacketSocket);
+TLL_DEFINE_IMPL(tll::channel::TcpServerSocket<SeqPacketServer>);
+
+std::optional<const tll_channel_impl_t *> ChSeqPacket::_init_replace(const tll::Channel::Url &url, tll::Channel *master)
+{
+	auto reader = channel_props_reader(url);
+	auto mode = reader.getT("mode", TcpChannelMode::Client);
+	if (!reader)
+		return _log.fail(std::nullopt, "Invalid url: {}", reader.error());
+
+	switch (mode) {
+	case TcpChannelMode::Client: return &SeqPacketClient::impl;
+	case TcpChannelMode::Server: return &SeqPacketServer::impl;
+	case TcpChannelMode::Socket: return &SeqPacketSocket::impl;
+	}
+	return _log.fail(std::nullopt, "Unknown mode {}", (int) mode);
+}
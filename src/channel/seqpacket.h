@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#ifndef _TLL_IMPL_CHANNEL_SEQPACKET_H
+#define _TLL_IMPL_CHANNEL_SEQPACKET_H
+
+#include "tll/channel/base.h"
+
+class ChSeqPacket : public tll::channel::Base<ChSeqPacket>
+{
+ public:
+	static constexpr std::string_view channel_protocol() { return "seqpacket"; }
+
+	std::optional<const tll_channel_impl_t *> _init_replace(const tll::Channel::Url &url, tll::Channel *master);
+
+	int _init(const tll::Channel::Url &url, tll::Channel * master) { return _log.fail(EINVAL, "Failed to choose proper seqpacket channel"); }
+};
+
+#endif//_TLL_IMPL_CHANNEL_SEQPACKET_H
@@ -6,6 +6,7 @@
  */
 
 #include "channel/tcp.h"
+#include "channel/tls.h"
 
 #include "tll/channel/frame.h"
 #include "tll/channel/tcp.h"
@@ -15,18 +16,102 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
 using namespace tll;
 
+/// TCP socket with optional TLS session
+template <typename T>
+class TlsSocket : public tll::channel::TcpSocket<T>
+{
+ protected:
+#ifdef WITH_OPENSSL
+	std::unique_ptr<tll::channel::tls::Session> _tls;
+
+	int _tls_start(const tll::channel::tls::context_ptr_t &ctx, bool server, std::string_view hostname)
+	{
+		_tls.reset(new tll::channel::tls::Session);
+		return _tls->init(this->_log, ctx, this->fd(), server, hostname);
+	}
+
+	/// Continue handshake, returns 0 when it is finished and EAGAIN if it is still in progress
+	int _tls_handshake()
+	{
+		bool want_write = false;
+		auto r = _tls->handshake(this->_log, want_write);
+		if (r == EAGAIN)
+			this->_dcaps_poll(want_write ? tll::dcaps::CPOLLOUT : tll::dcaps::CPOLLIN);
+		else if (r == 0) {
+			this->config_info().setT("tls.ktls-send", _tls->ktls_send());
+			this->config_info().setT("tls.ktls-recv", _tls->ktls_recv());
+		}
+		return r;
+	}
+
+	bool _tls_handshake_pending() const { return _tls && _tls->handshake_pending(); }
+
+	/// Decrypted data that is buffered in the session is not visible by poll, process channel again
+	void _tls_check_pending()
+	{
+		if (_tls && _tls->pending())
+			this->_dcaps_pending(true);
+	}
+#else
+	bool _tls_handshake_pending() const { return false; }
+	void _tls_check_pending() {}
+#endif
+
+ public:
+	using Base = tll::channel::TcpSocket<T>;
+
+	int _close()
+	{
+#ifdef WITH_OPENSSL
+		if (_tls)
+			_tls->reset();
+		_tls.reset();
+#endif
+		return Base::_close();
+	}
+
+	int _process(long timeout, int flags)
+	{
+		auto r = Base::_process(timeout, flags);
+		_tls_check_pending();
+		return r;
+	}
+
+#ifdef WITH_OPENSSL
+	ssize_t _sys_sendmsg(const msghdr * msg)
+	{
+		if (_tls)
+			return _tls->sendmsg(this->fd(), msg);
+		return Base::_sys_sendmsg(msg);
+	}
+
+	ssize_t _sys_recvmsg(msghdr * msg)
+	{
+		if (_tls)
+			return _tls->recvmsg(this->fd(), msg);
+		return Base::_sys_recvmsg(msg);
+	}
+#endif
+};
+
 template <typename T, typename F>
-class FramedSocket : public tll::channel::TcpSocket<T>
+class FramedSocket : public TlsSocket<T>
 {
  protected:
 	size_t _send_hwm = 0;
+	unsigned _drain_frames = 1; ///< Maximum number of frames delivered in one process call
+	size_t _drain_bytes = 0; ///< Stop delivering frames in one process call after this size, 0 - no limit
 
  public:
 	using Frame = F;
 	using FrameT = tll::frame::FrameT<Frame>;
-	using Base = tll::channel::TcpSocket<T>;
+	using Base = TlsSocket<T>;
 
 	static constexpr std::string_view param_prefix() { return "tcp"; }
 
@@ -46,18 +131,24 @@ class FramedSocket : public tll::channel::TcpSocket<T>
 		_send_hwm = hwm;
 	}
 
+	void drain(unsigned frames, size_t bytes)
+	{
+		_drain_frames = frames;
+		_drain_bytes = bytes;
+	}
+
  private:
-	int _pending();
+	int _pending(size_t &bytes);
 };
 
 template <typename T>
-class FramedSocket<T, void> : public tll::channel::TcpSocket<T>
+class FramedSocket<T, void> : public TlsSocket<T>
 {
  protected:
 	size_t _send_hwm = 0;
 
  public:
-	using Base = tll::channel::TcpSocket<T>;
+	using Base = TlsSocket<T>;
 	void _on_output_full()
 	{
 		if (this->_wbuf.size() > _send_hwm)
@@ -68,16 +159,26 @@ class FramedSocket<T, void> : public tll::channel::TcpSocket<T>
 	{
 		_send_hwm = hwm;
 	}
+
+	/// Each chunk of data is delivered as is, nothing to drain
+	void drain(unsigned frames, size_t bytes) {}
 };
 
 template <typename Frame>
 class ChTcpClient : public tll::channel::TcpClient<ChTcpClient<Frame>, FramedSocket<ChTcpClient<Frame>, Frame>>
 {
+#ifdef WITH_OPENSSL
+	tll::channel::tls::context_ptr_t _tls_ctx;
+	std::string _tls_hostname;
+	std::unique_ptr<tll::Channel> _tls_timer; ///< Oneshot handshake timeout, created if it is enabled
+	tll::duration _tls_timeout = {};
+#endif
  public:
 	using Base = tll::channel::TcpClient<ChTcpClient<Frame>, FramedSocket<ChTcpClient<Frame>, Frame>>;
 
 	static constexpr std::string_view param_prefix() { return "tcp"; }
 	static constexpr std::string_view channel_protocol() { return "tcp-client"; } // Only visible in logs
+	static constexpr auto child_policy() { return Base::ChildPolicy::Many; }
 
 	int _init(const tll::Channel::Url &url, tll::Channel *master)
 	{
@@ -86,29 +187,186 @@ class ChTcpClient : public tll::channel::TcpClient<ChTcpClient<Frame>, FramedSoc
 
 		auto reader = this->channel_props_reader(url);
 		auto hwm = reader.getT("send-buffer-hwm", tll::util::Size { 0 });
+		auto frames = reader.getT("drain-frames", 1u);
+		auto bytes = reader.getT("drain-bytes", tll::util::Size { 0 });
 		if (!reader)
 			return this->_log.fail(EINVAL, "Invalid url: {}", reader.error());
 		if (hwm > this->_settings.snd_buffer_size * 0.8)
 			return this->_log.fail(EINVAL, "Send HWM is too large: {} > 80% of send buffer {}", hwm, this->_settings.snd_buffer_size);
+		if (frames == 0)
+			return this->_log.fail(EINVAL, "Zero drain-frames parameter");
 		if (hwm)
 			this->_log.debug("Store up to {} of data on blocked connection", hwm);
 		this->_send_hwm = hwm;
+		this->drain(frames, bytes);
+
+		tll::channel::tls::settings_t tls;
+		if (tls.init(this->_log, reader))
+			return EINVAL;
+		if (tls.enable) {
+#ifdef WITH_OPENSSL
+			if (this->_settings.timestamping)
+				return this->_log.fail(EINVAL, "Timestamping is not supported with TLS");
+			_tls_ctx = tll::channel::tls::context(this->_log, tls, false);
+			if (!_tls_ctx)
+				return this->_log.fail(EINVAL, "Failed to create TLS context");
+			_tls_hostname = tls.hostname;
+			_tls_timeout = tls.handshake_timeout;
+			if (_tls_timeout.count()) {
+				auto curl = this->child_url_parse("timer://;clock=monotonic;oneshot=yes", "tls-timer");
+				if (!curl)
+					return this->_log.fail(EINVAL, "Failed to parse timer url: {}", curl.error());
+				curl->set("interval", tll::conv::to_string(tls.handshake_timeout));
+				_tls_timer = this->context().channel(*curl);
+				if (!_tls_timer)
+					return this->_log.fail(EINVAL, "Failed to create timer channel");
+				_tls_timer->callback_add([](auto * c, auto * m, void * user) { return static_cast<ChTcpClient *>(user)->_on_tls_timeout(); }, this, TLL_MESSAGE_MASK_DATA);
+				this->_child_add(_tls_timer.get(), "tls-timer");
+			}
+#else
+			return this->_log.fail(EINVAL, "TLS is not supported, library is built without OpenSSL");
+#endif
+		}
 		return 0;
 	}
+
+	int _process(long timeout, int flags)
+	{
+		if (this->_tls_handshake_pending()) {
+			auto r = this->_tls_handshake();
+			if (r != EAGAIN)
+				_tls_timer_stop();
+			if (r)
+				return r;
+			return Base::_on_connect();
+		}
+		return Base::_process(timeout, flags);
+	}
+
+	int _on_connect()
+	{
+#ifdef WITH_OPENSSL
+		if (_tls_ctx) {
+			auto host = _tls_hostname;
+			if (host.empty() && (*this->_addr)->sa_family != AF_UNIX)
+				host = this->_peer_active.host;
+			if (auto r = this->_tls_start(_tls_ctx, false, host); r)
+				return r;
+			if (auto r = this->_tls_handshake(); r) {
+				if (r != EAGAIN)
+					return r;
+				if (_tls_timer && _tls_timer->open())
+					return this->_log.fail(EINVAL, "Failed to open handshake timer");
+				return 0;
+			}
+		}
+#endif
+		return Base::_on_connect();
+	}
+
+	int _close()
+	{
+		_tls_timer_stop();
+		return Base::_close();
+	}
+
+#ifdef WITH_OPENSSL
+	void _free()
+	{
+		_tls_timer.reset();
+		return Base::_free();
+	}
+
+ private:
+	void _tls_timer_stop()
+	{
+		if (_tls_timer && _tls_timer->state() != tll::state::Closed)
+			_tls_timer->close(true);
+	}
+
+	int _on_tls_timeout()
+	{
+		if (!this->_tls_handshake_pending())
+			return 0;
+		this->_log.error("TLS handshake is not finished in {}", tll::conv::to_string(_tls_timeout));
+		this->_dcaps_poll(0);
+		this->state(tll::state::Error);
+		return 0;
+	}
+#else
+ private:
+	void _tls_timer_stop() {}
+#endif
 };
 
 template <typename Frame>
 class ChFramedSocket : public FramedSocket<ChFramedSocket<Frame>, Frame>
 {
+#ifdef WITH_OPENSSL
+	tll::channel::tls::context_ptr_t _tls_ctx;
+#endif
  public:
+	using Base = FramedSocket<ChFramedSocket<Frame>, Frame>;
+
 	static constexpr std::string_view param_prefix() { return "tcp"; }
 	static constexpr std::string_view channel_protocol() { return "tcp-socket"; } // Only visible in logs
+	static constexpr auto open_policy() { return tll::channel::Base<ChFramedSocket<Frame>>::OpenPolicy::Manual; }
+
+	int _open(const tll::ConstConfig &cfg)
+	{
+		if (auto r = Base::_open(cfg); r)
+			return r;
+#ifdef WITH_OPENSSL
+		if (_tls_ctx) {
+			if (auto r = this->_tls_start(_tls_ctx, true, ""); r)
+				return r;
+			if (auto r = this->_tls_handshake(); r)
+				return r == EAGAIN ? 0 : r;
+		}
+#endif
+		this->state(tll::state::Active);
+		return 0;
+	}
+
+	int _process(long timeout, int flags)
+	{
+		if (this->_tls_handshake_pending()) {
+			if (auto r = this->_tls_handshake(); r)
+				return r;
+			this->_dcaps_poll(tll::dcaps::CPOLLIN);
+			this->state(tll::state::Active);
+			return 0;
+		}
+		return Base::_process(timeout, flags);
+	}
+
+#ifdef WITH_OPENSSL
+	/// Run server side of TLS handshake after open
+	void tls(tll::channel::tls::context_ptr_t ctx) { _tls_ctx = std::move(ctx); }
+#endif
 };
 
 template <typename Frame>
 class ChTcpServer : public tll::channel::TcpServer<ChTcpServer<Frame>, ChFramedSocket<Frame>>
 {
 	size_t _send_hwm = 0;
+	unsigned _drain_frames = 1;
+	size_t _drain_bytes = 0;
+
+#ifdef WITH_OPENSSL
+	tll::channel::tls::context_ptr_t _tls_ctx;
+
+	/// Client with TLS handshake in progress, Connect is reported when it is finished
+	struct TlsPending
+	{
+		unsigned seq;
+		tll::network::sockaddr_any addr;
+		tll::time_point deadline; ///< Connection is closed if handshake is not finished before it
+	};
+	std::map<int, TlsPending> _tls_pending;
+	tll::duration _tls_timeout = {};
+	std::unique_ptr<tll::Channel> _tls_timer; ///< Periodic check of stalled handshakes
+#endif
  public:
 	using Base = tll::channel::TcpServer<ChTcpServer<Frame>, ChFramedSocket<Frame>>;
 	using Socket = ChFramedSocket<Frame>;
@@ -127,13 +385,44 @@ class ChTcpServer : public tll::channel::TcpServer<ChTcpServer<Frame>, ChFramedS
 
 		auto reader = this->channel_props_reader(url);
 		auto hwm = reader.getT("send-buffer-hwm", tll::util::Size { 0 });
+		_drain_frames = reader.getT("drain-frames", 1u);
+		_drain_bytes = reader.getT("drain-bytes", tll::util::Size { 0 });
 		if (!reader)
 			return this->_log.fail(EINVAL, "Invalid url: {}", reader.error());
 		if (hwm > this->_settings.snd_buffer_size * 0.8)
 			return this->_log.fail(EINVAL, "Send HWM is too large: {} > 80% of send buffer {}", hwm, this->_settings.snd_buffer_size);
+		if (_drain_frames == 0)
+			return this->_log.fail(EINVAL, "Zero drain-frames parameter");
 		if (hwm)
 			this->_log.debug("Store up to {} of data on blocked connection", hwm);
 		this->_send_hwm = hwm;
+
+		tll::channel::tls::settings_t tls;
+		if (tls.init(this->_log, reader))
+			return EINVAL;
+		if (tls.enable) {
+#ifdef WITH_OPENSSL
+			if (this->_settings.timestamping)
+				return this->_log.fail(EINVAL, "Timestamping is not supported with TLS");
+			_tls_ctx = tll::channel::tls::context(this->_log, tls, true);
+			if (!_tls_ctx)
+				return this->_log.fail(EINVAL, "Failed to create TLS context");
+			_tls_timeout = tls.handshake_timeout;
+			if (_tls_timeout.count()) {
+				auto curl = this->child_url_parse("timer://;clock=monotonic", "tls-timer");
+				if (!curl)
+					return this->_log.fail(EINVAL, "Failed to parse timer url: {}", curl.error());
+				curl->set("interval", tll::conv::to_string(_tls_timeout / 2));
+				_tls_timer = this->context().channel(*curl);
+				if (!_tls_timer)
+					return this->_log.fail(EINVAL, "Failed to create timer channel");
+				_tls_timer->callback_add([](auto * c, auto * m, void * user) { return static_cast<ChTcpServer *>(user)->_on_tls_timer(); }, this, TLL_MESSAGE_MASK_DATA);
+				this->_child_add(_tls_timer.get(), "tls-timer");
+			}
+#else
+			return this->_log.fail(EINVAL, "TLS is not supported, library is built without OpenSSL");
+#endif
+		}
 		return 0;
 	}
 
@@ -142,9 +431,471 @@ class ChTcpServer : public tll::channel::TcpServer<ChTcpServer<Frame>, ChFramedS
 		if (!socket)
 			return this->_log.fail(EINVAL, "Can not cast {} to socket channel", c->name());
 		socket->send_hwm(this->_send_hwm);
+		socket->drain(_drain_frames, _drain_bytes);
+#ifdef WITH_OPENSSL
+		if (_tls_ctx)
+			socket->tls(_tls_ctx);
+#endif
+		return 0;
+	}
+
+#ifdef WITH_OPENSSL
+	void _free()
+	{
+		_tls_timer.reset();
+		return Base::_free();
+	}
+
+	int _open(const tll::ConstConfig &cfg)
+	{
+		if (_tls_timer && _tls_timer->open())
+			return this->_log.fail(EINVAL, "Failed to open handshake timer");
+		return Base::_open(cfg);
+	}
+
+	int _close()
+	{
+		if (_tls_timer)
+			_tls_timer->close(true);
+		_tls_pending.clear();
+		return Base::_close();
+	}
+
+	void _on_child_connect(typename Base::tcp_socket_t * socket, const tll::channel::tcp_connect_t * conn)
+	{
+		if (!_tls_ctx || socket->state() == tll::state::Active)
+			return Base::_on_child_connect(socket, conn);
+		auto & pending = _tls_pending[socket->msg_addr().fd];
+		pending.seq = socket->msg_addr().seq;
+		pending.addr.size = std::min<socklen_t>(conn->addrlen, sizeof(pending.addr.buf));
+		memcpy(pending.addr.buf, conn->addr, pending.addr.size);
+		pending.deadline = tll::time::now() + _tls_timeout;
+	}
+
+	void _on_child_active(typename Base::tcp_socket_t * socket)
+	{
+		auto it = _tls_pending.find(socket->msg_addr().fd);
+		if (it == _tls_pending.end() || it->second.seq != socket->msg_addr().seq)
+			return;
+		auto & addr = it->second.addr;
+		tll::channel::tcp_connect_t conn = { socket->fd(), addr.size, addr };
+		this->_callback_connect(socket->msg_addr(), &conn);
+		_tls_pending.erase(it);
+	}
+
+	void _on_child_closing(typename Base::tcp_socket_t * socket)
+	{
+		auto it = _tls_pending.find(socket->msg_addr().fd);
+		if (it != _tls_pending.end() && it->second.seq == socket->msg_addr().seq) {
+			// Handshake was not finished, Connect was not reported
+			_tls_pending.erase(it);
+			return;
+		}
+		Base::_on_child_closing(socket);
+	}
+
+	/// Close connections that did not finish handshake in time, socket and session are freed on cleanup
+	int _on_tls_timer()
+	{
+		auto now = tll::time::now();
+		std::vector<typename Base::tcp_socket_t *> expired;
+		for (auto & [fd, pending] : _tls_pending) {
+			if (pending.deadline > now)
+				continue;
+			auto it = this->_clients.find(fd);
+			if (it != this->_clients.end() && it->second->msg_addr().seq == pending.seq)
+				expired.push_back(it->second);
+		}
+		for (auto socket : expired) {
+			this->_log.info("TLS handshake with client {} is not finished in {}, close connection", socket->name, tll::conv::to_string(_tls_timeout));
+			socket->close(true);
+		}
+		return 0;
+	}
+#endif
+};
+
+#ifdef __linux__
+/**
+ * TCP server that keeps client connections inside one channel
+ *
+ * Listening sockets are same as in ChTcpServer but accepted connections are stored in the table
+ * indexed by file descriptor instead of separate child channels. Connections are polled with
+ * dedicated epoll instance that is exported as channel fd.
+ */
+template <typename Frame>
+class ChTcpEpollServer : public tll::channel::TcpServer<ChTcpEpollServer<Frame>, ChFramedSocket<Frame>>
+{
+	using FrameT = tll::frame::FrameT<Frame>;
+	using tcp_socket_addr_t = tll::channel::tcp_socket_addr_t;
+
+	struct Connection
+	{
+		int fd = -1;
+		unsigned seq = 0;
+		bool pollout = false;
+		tll::channel::PartialBuffer rbuf;
+		tll::channel::PartialBuffer wbuf;
+
+		tcp_socket_addr_t addr() const { return { fd, seq }; }
+	};
+
+	std::vector<Connection> _connections; ///< Connections indexed by file descriptor
+	const Connection * _input = nullptr; ///< Connection which data is passed to user now
+	std::vector<epoll_event> _events;
+	size_t _send_hwm = 0;
+
+ public:
+	using Base = tll::channel::TcpServer<ChTcpEpollServer<Frame>, ChFramedSocket<Frame>>;
+
+	static constexpr std::string_view channel_protocol() { return "tcp"; }
+	static constexpr auto process_policy() { return Base::ProcessPolicy::Custom; }
+
+	int _init(const tll::Channel::Url &url, tll::Channel *master)
+	{
+		if (auto r = Base::_init(url, master))
+			return r;
+
+		auto reader = this->channel_props_reader(url);
+		auto hwm = reader.getT("send-buffer-hwm", tll::util::Size { 0 });
+		auto events = reader.getT("epoll-events", 64u);
+		auto tls = reader.getT("tls", false);
+		if (!reader)
+			return this->_log.fail(EINVAL, "Invalid url: {}", reader.error());
+		if (hwm > this->_settings.snd_buffer_size * 0.8)
+			return this->_log.fail(EINVAL, "Send HWM is too large: {} > 80% of send buffer {}", hwm, this->_settings.snd_buffer_size);
+		if (this->_settings.timestamping)
+			return this->_log.fail(EINVAL, "Timestamping is not supported in epoll mode");
+		if (tls)
+			return this->_log.fail(EINVAL, "TLS is not supported in epoll mode");
+		if (events == 0)
+			return this->_log.fail(EINVAL, "Zero epoll-events parameter");
+		_send_hwm = hwm;
+		_events.resize(events);
 		return 0;
 	}
+
+	int _open(const tll::ConstConfig &props)
+	{
+		_connections.clear();
+		auto fd = epoll_create1(EPOLL_CLOEXEC);
+		if (fd == -1)
+			return this->_log.fail(EINVAL, "Failed to create epoll: {}", strerror(errno));
+		this->_update_fd(fd);
+		this->_update_dcaps(tll::dcaps::CPOLLIN | tll::dcaps::Process);
+		return Base::_open(props);
+	}
+
+	int _close()
+	{
+		for (auto & c : _connections)
+			_close_connection(c);
+		_input = nullptr; // Connection table is destroyed, even if it is closed from data callback
+		_connections.clear();
+		auto fd = this->_update_fd(-1);
+		if (fd != -1)
+			::close(fd);
+		return Base::_close();
+	}
+
+	int _post(const tll_msg_t *msg, int flags)
+	{
+		auto c = _lookup_connection(msg->addr);
+		if (!c)
+			return EINVAL;
+		if (msg->type == TLL_MESSAGE_CONTROL) {
+			switch (msg->msgid) {
+			case tcp_scheme::Disconnect::meta_id():
+				this->_log.info("Disconnect client {} on user request", c->fd);
+				_close_connection(*c);
+				return 0;
+			case tcp_scheme::WriteFlush::meta_id():
+				return _process_output(*c);
+			default:
+				return 0;
+			}
+		} else if (msg->type != TLL_MESSAGE_DATA)
+			return 0;
+		return _post_data(*c, msg, flags);
+	}
+
+	int _process(long timeout, int flags)
+	{
+		auto r = epoll_wait(this->fd(), _events.data(), _events.size(), 0);
+		if (r < 0) {
+			if (errno == EINTR)
+				return EAGAIN;
+			return this->_log.fail(EINVAL, "Failed to poll connections: {}", strerror(errno));
+		} else if (r == 0)
+			return EAGAIN;
+
+		if (this->_cleanup_flag)
+			this->_process_cleanup();
+
+		for (auto i = 0; i < r && this->state() == tll::state::Active; i++) {
+			auto & ev = _events[i];
+			auto fd = ev.data.fd;
+			if (ev.events & EPOLLOUT)
+				_process_output(_connections[fd]);
+			if (ev.events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+				_process_input(_connections[fd]);
+		}
+		return 0;
+	}
+
+	int _on_accept_socket(tll::network::scoped_socket fd, const tll::channel::tcp_connect_t * conn)
+	{
+		if (tll::channel::_::setup_socket(this->_log, fd, this->_settings, conn->addr->sa_family))
+			return this->_log.fail(EINVAL, "Failed to setup client socket {}", fd);
+
+		if ((size_t) fd >= _connections.size())
+			_connections.resize(fd + 1);
+		auto & c = _connections[fd];
+
+		epoll_event ev = {};
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		if (epoll_ctl(this->fd(), EPOLL_CTL_ADD, fd, &ev))
+			return this->_log.fail(EINVAL, "Failed to add client socket {} to epoll: {}", fd, strerror(errno));
+
+		c.fd = fd.release();
+		c.seq = this->_addr_seq++;
+		c.pollout = false;
+		c.rbuf.clear();
+		if (!this->_settings.buffer_pool)
+			c.rbuf.resize(this->_settings.rcv_buffer_size);
+		c.wbuf.clear();
+		this->_log.debug("Add client {}, seq {}", c.fd, c.seq);
+
+		this->_callback_connect(c.addr(), conn);
+		return 0;
+	}
+
+ private:
+	Connection * _lookup_connection(const tll_addr_t &a)
+	{
+		auto addr = tcp_socket_addr_t::cast(&a);
+		if (addr->fd < 0 || (size_t) addr->fd >= _connections.size() || _connections[addr->fd].fd == -1)
+			return this->_log.fail(nullptr, "Address not found: {}/{}", addr->fd, addr->seq);
+		auto & c = _connections[addr->fd];
+		if (addr->seq != c.seq)
+			return this->_log.fail(nullptr, "Address seq mismatch: {} != {}", addr->seq, c.seq);
+		return &c;
+	}
+
+	void _close_connection(Connection &c)
+	{
+		if (c.fd == -1)
+			return;
+		auto addr = c.addr();
+		epoll_ctl(this->fd(), EPOLL_CTL_DEL, c.fd, nullptr);
+		::close(c.fd);
+		// Buffers are not freed, they can be used by message that is processed now. Pooled receive
+		// buffer of such connection is returned to the pool after callback is finished
+		c.fd = -1;
+		if (this->_settings.buffer_pool) {
+			if (&c != _input)
+				tll::channel::BufferPool::instance().release(c.rbuf);
+			tll::channel::BufferPool::instance().release(c.wbuf);
+		}
+		c.rbuf.clear();
+		c.wbuf.clear();
+		this->_log.debug("Client {} closed", addr.fd);
+		this->_callback_disconnect(addr);
+	}
+
+	void _poll_output(Connection &c, bool enable)
+	{
+		if (c.pollout == enable)
+			return;
+		epoll_event ev = {};
+		ev.events = EPOLLIN | (enable ? EPOLLOUT : 0);
+		ev.data.fd = c.fd;
+		if (epoll_ctl(this->fd(), EPOLL_CTL_MOD, c.fd, &ev))
+			this->_log.error("Failed to update epoll events for client {}: {}", c.fd, strerror(errno));
+		c.pollout = enable;
+	}
+
+	void _callback_control(const Connection &c, int msgid)
+	{
+		tll_msg_t msg = { TLL_MESSAGE_CONTROL };
+		msg.msgid = msgid;
+		msg.addr = c.addr();
+		this->_callback(&msg);
+	}
+
+	void _store_output(Connection &c, const void * data, size_t size)
+	{
+		if (this->_settings.buffer_pool) {
+			tll::channel::BufferPool::instance().acquire(c.wbuf, std::max(this->_settings.snd_buffer_size, size));
+			tll::channel::BufferPool::reserve(c.wbuf, size);
+		} else if (c.wbuf.available() < size)
+			c.wbuf.resize(c.wbuf.size() + size);
+		memcpy(c.wbuf.end(), data, size);
+		c.wbuf.extend(size);
+	}
+
+	int _post_data(Connection &c, const tll_msg_t *msg, int flags)
+	{
+		const bool more = flags & TLL_POST_MORE;
+		[[maybe_unused]] std::conditional_t<std::is_same_v<Frame, void>, char, Frame> frame;
+		iovec iov[2] = {};
+		size_t iovlen = 0;
+		if constexpr (!std::is_same_v<Frame, void>) {
+			if constexpr (FrameT::frame_skip_size() != 0) {
+				FrameT::write(msg, &frame);
+				iov[iovlen++] = { &frame, sizeof(frame) };
+			}
+		}
+		iov[iovlen++] = { (void *) msg->data, msg->size };
+
+		size_t sent = 0;
+		if (more || c.wbuf.size()) {
+			if (c.wbuf.size() > _send_hwm)
+				return EAGAIN;
+		} else {
+			msghdr mhdr = {};
+			mhdr.msg_iov = iov;
+			mhdr.msg_iovlen = iovlen;
+			auto r = sendmsg(c.fd, &mhdr, MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (r < 0) {
+				if (errno != EAGAIN) {
+					this->_log.error("Failed to send data to client {}: {}", c.fd, strerror(errno));
+					_close_connection(c);
+					return EINVAL;
+				}
+				r = 0;
+			}
+			sent = r;
+		}
+
+		const auto old = c.wbuf.size();
+		for (auto i = 0u; i < iovlen; i++) {
+			auto & v = iov[i];
+			if (sent >= v.iov_len) {
+				sent -= v.iov_len;
+				continue;
+			}
+			_store_output(c, sent + (const char *) v.iov_base, v.iov_len - sent);
+			sent = 0;
+		}
+		if (old == c.wbuf.size())
+			return 0;
+
+		this->_log.trace("Stored {} bytes of pending data for client {} (now {})", c.wbuf.size() - old, c.fd, c.wbuf.size());
+		if (!more)
+			_poll_output(c, true);
+		if (c.wbuf.size() > _send_hwm)
+			_callback_control(c, tcp_scheme::WriteFull::meta_id());
+		return 0;
+	}
+
+	int _process_output(Connection &c)
+	{
+		if (c.fd == -1)
+			return 0;
+		if (!c.wbuf.size()) {
+			_poll_output(c, false);
+			return 0;
+		}
+		auto r = ::send(c.fd, c.wbuf.data(), c.wbuf.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (r < 0) {
+			if (errno == EAGAIN) {
+				_poll_output(c, true);
+				return 0;
+			}
+			this->_log.error("Failed to send pending data to client {}: {}", c.fd, strerror(errno));
+			_close_connection(c);
+			return 0;
+		}
+		c.wbuf.done(r);
+		c.wbuf.shift();
+		this->_log.trace("Sent {} bytes of pending data to client {}, {} bytes left", r, c.fd, c.wbuf.size());
+		if (c.wbuf.size()) {
+			_poll_output(c, true);
+			return 0;
+		}
+		if (this->_settings.buffer_pool)
+			tll::channel::BufferPool::instance().release(c.wbuf);
+		_poll_output(c, false);
+		_callback_control(c, tcp_scheme::WriteReady::meta_id());
+		return 0;
+	}
+
+	int _process_input(Connection &c)
+	{
+		if (c.fd == -1)
+			return 0;
+		auto & buf = c.rbuf;
+		if (this->_settings.buffer_pool)
+			tll::channel::BufferPool::instance().acquire(buf, this->_settings.rcv_buffer_size);
+		if (buf._offset >= buf.capacity() / 2 || buf.available() == 0)
+			buf.force_shift();
+
+		auto r = recv(c.fd, buf.end(), buf.available(), MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (r < 0) {
+			if (errno == EAGAIN) {
+				_release_input(c);
+				return 0;
+			}
+			this->_log.error("Failed to receive data from client {}: {}", c.fd, strerror(errno));
+			_close_connection(c);
+			return 0;
+		} else if (r == 0) {
+			this->_log.debug("Connection {} closed by peer", c.fd);
+			_close_connection(c);
+			return 0;
+		}
+		buf.extend(r);
+		this->_log.trace("Got {} bytes of data from client {}", r, c.fd);
+
+		const auto addr = c.addr();
+		tll_msg_t msg = { TLL_MESSAGE_DATA };
+		msg.addr = addr;
+		_input = &c;
+
+		if constexpr (std::is_same_v<Frame, void>) {
+			msg.data = buf.data();
+			msg.size = buf.size();
+			buf.done(buf.size());
+			this->_callback_data(&msg);
+		} else {
+			// Connection is alive while fd and seq are same, it can be closed from the callback
+			while (this->state() == tll::state::Active && c.fd == addr.fd && c.seq == addr.seq) {
+				auto frame = buf.template dataT<Frame>();
+				if (!frame)
+					break;
+				const size_t full = FrameT::frame_skip_size() + frame->size;
+				if (buf.size() < full) {
+					if (full > buf.capacity()) {
+						this->_log.error("Message size {} from client {} too large", full, c.fd);
+						_close_connection(c);
+					}
+					break;
+				}
+				FrameT::read(&msg, frame);
+				msg.data = buf.template dataT<void>(FrameT::frame_skip_size(), 0);
+				buf.done(full);
+				this->_callback_data(&msg);
+			}
+		}
+		if (_input != &c) // Channel was closed from callback
+			return 0;
+		_input = nullptr;
+		if (c.fd == addr.fd && c.seq == addr.seq)
+			_release_input(c);
+		else if (this->_settings.buffer_pool) // Connection was closed from callback
+			tll::channel::BufferPool::instance().release(c.rbuf);
+		return 0;
+	}
+
+	void _release_input(Connection &c)
+	{
+		if (this->_settings.buffer_pool && !c.rbuf.size())
+			tll::channel::BufferPool::instance().release(c.rbuf);
+	}
 };
+#endif
 
 TLL_DEFINE_IMPL(ChTcp);
 
@@ -154,6 +905,14 @@ TLL_DEFINE_IMPL(ChTcp);
 	TLL_DEFINE_IMPL(ChFramedSocket<frame>); \
 	TLL_DEFINE_IMPL(tll::channel::TcpServerSocket<ChTcpServer<frame>>)
 
+#ifdef __linux__
+#define TCP_DEFINE_IMPL_EPOLL(frame) \
+	TLL_DEFINE_IMPL(ChTcpEpollServer<frame>); \
+	TLL_DEFINE_IMPL(tll::channel::TcpServerSocket<ChTcpEpollServer<frame>>)
+#else
+#define TCP_DEFINE_IMPL_EPOLL(frame)
+#endif
+
 TCP_DEFINE_IMPL_ALL(void);
 TCP_DEFINE_IMPL_ALL(tll_frame_t);
 TCP_DEFINE_IMPL_ALL(tll_frame_short_t);
@@ -161,6 +920,13 @@ TCP_DEFINE_IMPL_ALL(tll_frame_tiny_t);
 TCP_DEFINE_IMPL_ALL(tll_frame_size32_t);
 TCP_DEFINE_IMPL_ALL(tll_frame_bson_t);
 
+TCP_DEFINE_IMPL_EPOLL(void);
+TCP_DEFINE_IMPL_EPOLL(tll_frame_t);
+TCP_DEFINE_IMPL_EPOLL(tll_frame_short_t);
+TCP_DEFINE_IMPL_EPOLL(tll_frame_tiny_t);
+TCP_DEFINE_IMPL_EPOLL(tll_frame_size32_t);
+TCP_DEFINE_IMPL_EPOLL(tll_frame_bson_t);
+
 namespace tll::frame {
 
 template <>
@@ -177,13 +943,18 @@ struct FrameT<void>
 using tll::channel::TcpChannelMode;
 
 template <typename Frame>
-const tll_channel_impl_t * _check_impl(tll::channel::TcpChannelMode mode, std::string_view frame)
+const tll_channel_impl_t * _check_impl(tll::channel::TcpChannelMode mode, std::string_view frame, bool epoll)
 {
 	for (auto & n : tll::frame::FrameT<Frame>::name()) {
 		if (n == frame) {
 			switch (mode) {
 			case TcpChannelMode::Client: return &ChTcpClient<Frame>::impl;
-			case TcpChannelMode::Server: return &ChTcpServer<Frame>::impl;
+			case TcpChannelMode::Server:
+#ifdef __linux__
+				if (epoll)
+					return &ChTcpEpollServer<Frame>::impl;
+#endif
+				return &ChTcpServer<Frame>::impl;
 			case TcpChannelMode::Socket: return &ChFramedSocket<Frame>::impl;
 			}
 		}
@@ -196,20 +967,25 @@ std::optional<const tll_channel_impl_t *> ChTcp::_init_replace(const tll::Channe
 	auto reader = channel_props_reader(url);
 	auto mode = reader.getT("mode", TcpChannelMode::Client);
 	auto frame = reader.getT<std::string>("frame", "std");
+	auto epoll = reader.getT("epoll", false);
 	if (!reader)
 		return _log.fail(std::nullopt, "Invalid url: {}", reader.error());
+#ifndef __linux__
+	if (epoll)
+		return _log.fail(std::nullopt, "Epoll server mode is supported only on Linux");
+#endif
 
-	if (auto r = _check_impl<void>(mode, frame); r) // Empty frame
+	if (auto r = _check_impl<void>(mode, frame, epoll); r) // Empty frame
 		return r;
-	if (auto r = _check_impl<tll_frame_t>(mode, frame); r)
+	if (auto r = _check_impl<tll_frame_t>(mode, frame, epoll); r)
 		return r;
-	if (auto r = _check_impl<tll_frame_short_t>(mode, frame); r)
+	if (auto r = _check_impl<tll_frame_short_t>(mode, frame, epoll); r)
 		return r;
-	if (auto r = _check_impl<tll_frame_tiny_t>(mode, frame); r)
+	if (auto r = _check_impl<tll_frame_tiny_t>(mode, frame, epoll); r)
 		return r;
-	if (auto r = _check_impl<tll_frame_size32_t>(mode, frame); r)
+	if (auto r = _check_impl<tll_frame_size32_t>(mode, frame, epoll); r)
 		return r;
-	if (auto r = _check_impl<tll_frame_bson_t>(mode, frame); r)
+	if (auto r = _check_impl<tll_frame_bson_t>(mode, frame, epoll); r)
 		return r;
 
 	return _log.fail(std::nullopt, "Unknown frame '{}", frame);
@@ -256,7 +1032,7 @@ int FramedSocket<T, F>::_post_data(const tll_msg_t *msg, int flags)
 
 
 template <typename T, typename F>
-int FramedSocket<T, F>::_pending()
+int FramedSocket<T, F>::_pending(size_t &bytes)
 {
 	auto frame = this->template rdataT<Frame>();
 	if (!frame)
@@ -277,25 +1053,54 @@ int FramedSocket<T, F>::_pending()
 	msg.time = this->_timestamp.count();
 	this->rdone(full_size);
 	this->_dcaps_pending(this->template rdataT<Frame>());
+	bytes += full_size;
 	this->_callback_data(&msg);
+	this->_rx_latency_update();
 	return 0;
 }
 
 template <typename T, typename Frame>
 int FramedSocket<T, Frame>::_process(long timeout, int flags)
 {
-	if (auto r = this->_process_output(); r)
+	if (auto r = this->_process_output(); r) {
+		this->_rbuf_release(true);
 		return r;
+	}
 
-	auto r = this->_pending();
-	if (r != EAGAIN)
-		return r;
+	// Deliver buffered frames, receive data at most once and continue until limits are reached.
+	// Remaining frames are left with Pending dcap so other channels are processed before them
+	unsigned frames = 0;
+	size_t bytes = 0;
+	bool received = false;
+	while (true) {
+		auto r = this->_pending(bytes);
+		if (r == 0) {
+			if (++frames >= _drain_frames || (_drain_bytes && bytes >= _drain_bytes))
+				break;
+			if (this->state() != tll::state::Active)
+				break;
+			continue;
+		} else if (r != EAGAIN) {
+			// Stream is broken, pending data is dropped with the buffer
+			this->_rbuf_release(true);
+			return r;
+		}
 
-	auto s = this->_recv();
-	if (!s)
-		return EINVAL;
-	if (!*s)
-		return EAGAIN;
-	this->_log.trace("Got {} bytes of data", *s);
-	return this->_pending();
+		if (received)
+			break;
+		received = true;
+
+		auto s = this->_recv();
+		if (!s) {
+			this->_rbuf_release(true);
+			return EINVAL;
+		}
+		if (!*s)
+			break;
+		this->_log.trace("Got {} bytes of data", *s);
+		tll::channel::busy_poll_stat_update(this, flags);
+	}
+	this->_rbuf_release();
+	this->_tls_check_pending();
+	return frames ? 0 : EAGAIN;
 }
@@ -6,35 +6,151 @@
  */
 
 #include "channel/timeit.h"
-
-#include "tll/util/time.h"
+#include "channel/timeit.scheme.h"
 
 using namespace tll;
 
 TLL_DEFINE_IMPL(ChTimeIt);
 
+int ChTimeIt::_on_init(tll::Channel::Url &curl, const tll::Channel::Url &url, tll::Channel *master)
+{
+	auto reader = channel_props_reader(url);
+	_sample = reader.getT("sample", 1u);
+	_per_message = reader.getT("per-message", false);
+	if (!reader)
+		return _log.fail(EINVAL, "Invalid url: {}", reader.error());
+
+	if (_sample == 0)
+		return _log.fail(EINVAL, "Zero sample interval");
+
+	if (url.sub("trace")) {
+		auto turl = url.getT<tll::Channel::Url>("trace");
+		if (!turl)
+			return _log.fail(EINVAL, "Failed to get trace url: {}", turl.error());
+		child_url_fill(*turl, "trace");
+		turl->set("dir", "w");
+		if (!turl->has("scheme"))
+			turl->set("scheme", timeit_scheme::scheme_string);
+
+		_trace = context().channel(*turl, master);
+		if (!_trace)
+			return _log.fail(EINVAL, "Failed to create trace channel");
+		_child_add(_trace.get(), "trace");
+		curl.unlink("trace");
+	}
+
+	return 0;
+}
+
+void ChTimeIt::_free()
+{
+	for (auto & [_, block] : _messages)
+		tll_stat_list_remove(context().stat_list(), block.get());
+	_messages.clear();
+	_trace.reset();
+	return Base::_free();
+}
+
+int ChTimeIt::_open(const tll::ConstConfig &cfg)
+{
+	_sample_count = 0;
+	_trace_seq = 0;
+	if (_trace) {
+		tll::Config topen;
+		if (auto sub = cfg.sub("trace"); sub)
+			topen = sub->copy();
+		if (_trace->open(topen))
+			return _log.fail(EINVAL, "Failed to open trace channel");
+	}
+	return Base::_open(cfg);
+}
+
+int ChTimeIt::_close(bool force)
+{
+	if (_trace && _trace->state() != tll::state::Closed)
+		_trace->close(force);
+	return Base::_close(force);
+}
+
+tll::stat::Block<ChTimeIt::MessageStat> * ChTimeIt::_message_stat(int msgid)
+{
+	auto it = _messages.find(msgid);
+	if (it != _messages.end())
+		return it->second.get();
+
+	std::string name;
+	if (auto scheme = _child->scheme(TLL_MESSAGE_DATA); scheme) {
+		if (auto m = scheme->lookup(msgid); m)
+			name = m->name;
+	}
+	if (name.empty())
+		name = fmt::format("{}", msgid);
+
+	auto block = std::make_unique<tll::stat::Block<MessageStat>>(fmt::format("{}/{}", this->name, name));
+	if (tll_stat_list_add(context().stat_list(), block.get()))
+		_log.warning("Failed to add stat for message {}", name);
+	return _messages.emplace(msgid, std::move(block)).first->second.get();
+}
+
+void ChTimeIt::_report(const tll_msg_t *msg, bool tx, tll::time_point start, tll::time_point end)
+{
+	auto dt = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	if (_stat_enable) {
+		if (auto page = tll::channel::stat_acquire(this); page) {
+			if (tx)
+				page->tx = dt;
+			else
+				page->rx = dt;
+		}
+	}
+
+	if (msg->type != TLL_MESSAGE_DATA)
+		return;
+
+	if (_per_message) {
+		if (auto page = _message_stat(msg->msgid)->acquire_guard(); page) {
+			if (tx)
+				page->tx = dt;
+			else
+				page->rx = dt;
+		}
+	}
+
+	if (_trace && _trace->state() == tll::state::Active) {
+		_trace_buf.resize(timeit_scheme::Trace::meta_size());
+		auto data = timeit_scheme::Trace::bind(_trace_buf);
+		data.set_start(decltype(data)::type_start(start.time_since_epoch()));
+		data.set_end(decltype(data)::type_end(end.time_since_epoch()));
+		data.set_seq(msg->seq);
+		data.set_msgid(msg->msgid);
+		data.set_direction(tx ? timeit_scheme::Trace::Direction::Tx : timeit_scheme::Trace::Direction::Rx);
+
+		tll_msg_t m = {};
+		m.msgid = data.meta_id();
+		m.seq = _trace_seq++;
+		m.data = data.view().data();
+		m.size = data.view().size();
+		if (_trace->post(&m))
+			_log.debug("Failed to post trace record for message {}", msg->seq);
+	}
+}
+
 int ChTimeIt::_post(const tll_msg_t *msg, int flags)
 {
-	if (!_stat_enable)
+	if (!_measure())
 		return Base::_post(msg, flags);
 	auto start = tll::time::now();
 	auto r = Base::_post(msg, flags);
-	auto dt = tll::time::now() - start;
-
-	if (auto page = tll::channel::stat_acquire(this); page)
-		page->tx = dt.count();
+	_report(msg, true, start, tll::time::now());
 	return r;
 }
 
 int ChTimeIt::_on_data(const tll_msg_t *msg)
 {
-	if (!_stat_enable)
+	if (!_measure())
 		return Base::_on_data(msg);
 	auto start = tll::time::now();
 	auto r = Base::_on_data(msg);
-	auto dt = tll::time::now() - start;
-
-	if (auto page = tll::channel::stat_acquire(this); page)
-		page->rx = dt.count();
+	_report(msg, false, start, tll::time::now());
 	return r;
 }
@@ -9,6 +9,11 @@
 #define _TLL_CHANNEL_TIMEIT_H
 
 #include "tll/channel/prefix.h"
+#include "tll/util/time.h"
+
+#include <map>
+#include <memory>
+#include <vector>
 
 class ChTimeIt : public tll::channel::Prefix<ChTimeIt>
 {
@@ -19,12 +24,53 @@ class ChTimeIt : public tll::channel::Prefix<ChTimeIt>
 
 	struct StatType : public Base::StatType
 	{
-		tll::stat::IntegerGroup<tll::stat::Ns, 'r', 'x', 't'> rx;
-		tll::stat::IntegerGroup<tll::stat::Ns, 't', 'x', 't'> tx;
+		tll::stat::Histogram<tll::stat::Ns, 'r', 'x', 't'> rx;
+		tll::stat::Histogram<tll::stat::Ns, 't', 'x', 't'> tx;
+	};
+
+	/// Per-message stat, reported in separate '{name}/{message}' page
+	struct MessageStat
+	{
+		tll::stat::Histogram<tll::stat::Ns, 'r', 'x', 't'> rx;
+		tll::stat::Histogram<tll::stat::Ns, 't', 'x', 't'> tx;
 	};
 
+ private:
+	unsigned _sample = 1; ///< Measure each Nth message
+	unsigned _sample_count = 0;
+	bool _per_message = false;
+
+	std::map<int, std::unique_ptr<tll::stat::Block<MessageStat>>> _messages;
+
+	std::unique_ptr<tll::Channel> _trace;
+	std::vector<char> _trace_buf;
+	long long _trace_seq = 0;
+
+ public:
+	int _on_init(tll::Channel::Url &curl, const tll::Channel::Url &url, tll::Channel *master);
+	void _free();
+
+	int _open(const tll::ConstConfig &cfg);
+	int _close(bool force);
+
 	int _post(const tll_msg_t *msg, int flags);
 	int _on_data(const tll_msg_t *msg);
+
+ private:
+	bool _measure()
+	{
+		if (!_stat_enable && !_per_message && !_trace)
+			return false;
+		if (_sample == 1)
+			return true;
+		if (++_sample_count < _sample)
+			return false;
+		_sample_count = 0;
+		return true;
+	}
+
+	void _report(const tll_msg_t *msg, bool tx, tll::time_point start, tll::time_point end);
+	tll::stat::Block<MessageStat> * _message_stat(int msgid);
 };
 
 #endif//_TLL_CHANNEL_TIMEIT_H
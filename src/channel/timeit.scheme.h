@@ -0,0 +1,103 @@
+#pragma once
+
+#include <tll/scheme/binder.h>
+#include <tll/util/conv.h>
+
+namespace timeit_scheme {
+
+static constexpr std::string_view scheme_string = R"(yamls+gz://eJy1kEELwjAMhe/7FbnlssGmItKzv0C8y1ijFGw7mw6Usf9uOsfUefb2krz3PUgBrrakAI+hbggzAKMVVKUIcp1lJQIA9yZQE413qKCPj1YSnXFxl48u2eHhLqcyF1AS1TBI8GzoqidEAf3UxLEOEXN4YVAw242Mvk18TqxA7K/dVIeO5YrJnaZoLJ1aLykcOz7J5PRfuEy3JXdpsXwx3+Xr1Y9Jz1+cje/HDtkTwMV36Q==)";
+
+struct Trace
+{
+	static constexpr size_t meta_size() { return 29; }
+	static constexpr std::string_view meta_name() { return "Trace"; }
+	static constexpr int meta_id() { return 10; }
+	static constexpr bool meta_fixed() { return true; }
+	static constexpr size_t offset_start = 0;
+	static constexpr size_t offset_end = 8;
+	static constexpr size_t offset_seq = 16;
+	static constexpr size_t offset_msgid = 24;
+	static constexpr size_t offset_direction = 28;
+
+	enum class Direction: uint8_t
+	{
+		Rx = 0,
+		Tx = 1,
+	};
+
+	template <typename Buf>
+	struct binder_type : public tll::scheme::Binder<Buf>
+	{
+		using tll::scheme::Binder<Buf>::Binder;
+
+		static constexpr auto meta_size() { return Trace::meta_size(); }
+		static constexpr auto meta_name() { return Trace::meta_name(); }
+		static constexpr auto meta_id() { return Trace::meta_id(); }
+		static constexpr auto meta_fixed() { return Trace::meta_fixed(); }
+		void view_resize() { this->_view_resize(meta_size()); }
+
+		template <typename RBuf>
+		void copy(const binder_type<RBuf> &rhs)
+		{
+			set_start(rhs.get_start());
+			set_end(rhs.get_end());
+			set_seq(rhs.get_seq());
+			set_msgid(rhs.get_msgid());
+			set_direction(rhs.get_direction());
+		}
+
+		/// Check that message and all its variable size fields are inside buffer
+		bool validate() const
+		{
+			if (this->view().size() < meta_size())
+				return false;
+			return true;
+		}
+
+		using type_start = std::chrono::time_point<std::chrono::system_clock, std::chrono::duration<int64_t, std::nano>>;
+		type_start get_start() const { return this->template _get_scalar<type_start>(offset_start); }
+		void set_start(type_start v) { return this->template _set_scalar<type_start>(offset_start, v); }
+
+		using type_end = std::chrono::time_point<std::chrono::system_clock, std::chrono::duration<int64_t, std::nano>>;
+		type_end get_end() const { return this->template _get_scalar<type_end>(offset_end); }
+		void set_end(type_end v) { return this->template _set_scalar<type_end>(offset_end, v); }
+
+		using type_seq = int64_t;
+		type_seq get_seq() const { return this->template _get_scalar<type_seq>(offset_seq); }
+		void set_seq(type_seq v) { return this->template _set_scalar<type_seq>(offset_seq, v); }
+
+		using type_msgid = int32_t;
+		type_msgid get_msgid() const { return this->template _get_scalar<type_msgid>(offset_msgid); }
+		void set_msgid(type_msgid v) { return this->template _set_scalar<type_msgid>(offset_msgid, v); }
+
+		using type_direction = Direction;
+		type_direction get_direction() const { return this->template _get_scalar<type_direction>(offset_direction); }
+		void set_direction(type_direction v) { return this->template _set_scalar<type_direction>(offset_direction, v); }
+	};
+
+	template <typename Buf>
+	static binder_type<Buf> bind(Buf &buf, size_t offset = 0) { return binder_type<Buf>(tll::make_view(buf).view(offset)); }
+
+	template <typename Buf>
+	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
+
+	template <typename Buf>
+	static bool validate(const Buf &buf, size_t offset = 0) { return bind(buf, offset).validate(); }
+};
+
+} // namespace timeit_scheme
+
+template <>
+struct tll::conv::dump<timeit_scheme::Trace::Direction> : public to_string_from_string_buf<timeit_scheme::Trace::Direction>
+{
+	template <typename Buf>
+	static inline std::string_view to_string_buf(const timeit_scheme::Trace::Direction &v, Buf &buf)
+	{
+		switch (v) {
+		case timeit_scheme::Trace::Direction::Rx: return "Rx";
+		case timeit_scheme::Trace::Direction::Tx: return "Tx";
+		default: break;
+		}
+		return tll::conv::to_string_buf<uint8_t, Buf>((uint8_t) v, buf);
+	}
+};
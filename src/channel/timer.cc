@@ -48,12 +48,18 @@ constexpr timespec tll2ts(tll::duration ts)
 
 int ChTimer::_init(const tll::Channel::Url &url, tll::Channel *master)
 {
+	auto parent = tll::channel_cast<ChTimer>(master);
+	if (parent && !parent->_wheel_master)
+		parent = nullptr;
+
 	auto reader = channel_props_reader(url);
 	_oneshot_init = reader.getT("oneshot", false);
 	_interval_init = reader.getT<tll::duration>("interval", 0ns);
 	auto initial = reader.getT<tll::duration>("initial", 0ns);
-	_clock_type = reader.getT("clock", CLOCK_MONOTONIC, {{"monotonic", CLOCK_MONOTONIC}, {"realtime", CLOCK_REALTIME}});
+	_clock_type = reader.getT("clock", parent ? parent->_clock_type : CLOCK_MONOTONIC, {{"monotonic", CLOCK_MONOTONIC}, {"realtime", CLOCK_REALTIME}});
 	_skip_old = reader.getT("skip-old", false);
+	_wheel_master = reader.getT("wheel", false);
+	auto resolution = reader.getT<tll::duration>("resolution", 1ms);
 	if (!reader)
 		return _log.fail(EINVAL, "Invalid url: {}", reader.error());
 
@@ -70,6 +76,24 @@ int ChTimer::_init(const tll::Channel::Url &url, tll::Channel *master)
 	if (clock_gettime(_clock_type, &ts))
 		return _log.fail(EINVAL, "Clock {} is not supported", clock2str(_clock_type));
 
+	if (_wheel_master) {
+		if (_interval_init.count())
+			return _log.fail(EINVAL, "Timer in wheel mode can not have interval");
+		if (resolution.count() <= 0)
+			return _log.fail(EINVAL, "Invalid wheel resolution: {}", resolution);
+		_log.info("Timer wheel with resolution {}", resolution);
+		_wheel.reset(new Wheel);
+		_wheel->master = this;
+		_wheel->resolution = resolution;
+		_wheel->base = _now();
+	} else if (parent) {
+		if (parent->_clock_type != _clock_type)
+			return _log.fail(EINVAL, "Clock {} differs from wheel clock {}", clock2str(_clock_type), clock2str(parent->_clock_type));
+		_log.info("Attach to timer wheel {}", parent->name);
+		_wheel.reset(parent->_wheel.get());
+		_wheel_entry.self = this;
+	}
+
 	_scheme.reset(context().scheme_load(timer_scheme::scheme_absolute));
 	if (!_scheme.get())
 		return _log.fail(EINVAL, "Failed to load timer scheme");
@@ -79,6 +103,13 @@ int ChTimer::_init(const tll::Channel::Url &url, tll::Channel *master)
 	return 0;
 }
 
+void ChTimer::_free()
+{
+	if (_wheel_master)
+		_wheel->master = nullptr;
+	_wheel.reset();
+}
+
 int ChTimer::_open(const ConstConfig &url)
 {
 	_next = {};
@@ -91,8 +122,11 @@ int ChTimer::_open(const ConstConfig &url)
 	if (initial.count())
 		return _log.fail(EINVAL, "'initial' parameter is deprecated");
 
+	if (_wheel_master && _interval.count())
+		return _log.fail(EINVAL, "Timer in wheel mode can not have interval");
+
 #ifdef __linux__
-	if (_with_fd) {
+	if (_with_fd && !_wheel_child()) {
 		auto fd = timerfd_create(_clock_type, TFD_NONBLOCK | TFD_CLOEXEC);
 		if (fd == -1)
 			return _log.fail(EINVAL, "Failed to create timer fd: {}", strerror(errno));
@@ -100,9 +134,29 @@ int ChTimer::_open(const ConstConfig &url)
 	}
 #endif
 
+	if (_wheel_master) {
+		if (!_wheel->wheel.size())
+			_wheel->wheel.advance(_wheel->tick_floor(_now()), [](auto) {});
+		_wheel->armed = tll::util::TimerWheel::never;
+		_wheel_rearm();
+		unsigned caps = dcaps::Process;
+#ifdef __linux__
+		if (_with_fd)
+			caps |= dcaps::CPOLLIN;
+#endif
+		_update_dcaps(caps);
+		return 0;
+	}
+
 	if (_interval.count()) {
 		_next = _now() + _interval;
 		_log.debug("Next wakeup: {}", std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(_interval));
+		if (_wheel_child()) {
+			_wheel_insert(_next);
+			if (oneshot)
+				_interval = {};
+			return 0;
+		}
 		unsigned caps = dcaps::Process;
 #ifdef __linux__
 		if (_with_fd) {
@@ -122,6 +176,10 @@ int ChTimer::_open(const ConstConfig &url)
 
 int ChTimer::_close()
 {
+	if (_wheel_master)
+		_wheel->armed = tll::util::TimerWheel::never;
+	else if (_wheel)
+		_wheel->wheel.remove(&_wheel_entry);
 #ifdef __linux__
 	auto fd = this->_update_fd(-1);
 	if (fd != -1)
@@ -158,6 +216,10 @@ int ChTimer::_rearm(tll::duration ts)
 	_interval = {};
 
 	_log.debug("Rearm relative: {}", ts);
+	if (_wheel_child()) {
+		_wheel_insert(_next);
+		return 0;
+	}
 	unsigned caps = dcaps::Process;
 #ifdef __linux__
 	if (_with_fd) {
@@ -175,6 +237,10 @@ int ChTimer::_rearm(tll::time_point ts)
 	_next = time_point(ts.time_since_epoch());
 	_interval = {};
 
+	if (_wheel_child()) {
+		_wheel_insert(_next);
+		return 0;
+	}
 	unsigned caps = dcaps::Process;
 #ifdef __linux__
 	if (_with_fd) {
@@ -192,6 +258,10 @@ int ChTimer::_rearm_clear()
 	_next = {};
 	_interval = {};
 
+	if (_wheel_child()) {
+		_wheel->wheel.remove(&_wheel_entry);
+		return 0;
+	}
 #ifdef __linux__
 	if (_with_fd) {
 		if (_rearm_timerfd({}, true, 0))
@@ -206,6 +276,8 @@ int ChTimer::_post(const tll_msg_t *msg, int flags)
 {
 	if (msg->type != TLL_MESSAGE_DATA)
 		return 0;
+	if (_wheel_master)
+		return _log.fail(EINVAL, "Timer in wheel mode does not accept messages");
 	switch (msg->msgid) {
 	case timer_scheme::relative::id: {
 		auto ts = (const timer_scheme::relative *) msg->data;
@@ -231,20 +303,8 @@ int ChTimer::_post(const tll_msg_t *msg, int flags)
 	return 0;
 }
 
-int ChTimer::_process(long timeout, int flags)
+void ChTimer::_next_update(time_point now)
 {
-	if (_next == time_point())
-		return EAGAIN;
-	auto now = _now();
-	if (now < _next)
-		return EAGAIN;
-
-	tll_msg_t msg = {};
-	msg.type = TLL_MESSAGE_DATA;
-	msg.msgid = timer_scheme::absolute::id;
-	msg.data = &now;
-	msg.size = sizeof(now);
-
 	if (_interval.count()) {
 		if (_skip_old) {
 			unsigned shift = (now - _next) / _interval;
@@ -255,6 +315,88 @@ int ChTimer::_process(long timeout, int flags)
 		_next += _interval;
 	} else
 		_next = {};
+}
+
+void ChTimer::_callback_time(time_point now)
+{
+	tll_msg_t msg = {};
+	msg.type = TLL_MESSAGE_DATA;
+	msg.msgid = timer_scheme::absolute::id;
+	msg.data = &now;
+	msg.size = sizeof(now);
+
+	if (_clock_type == CLOCK_MONOTONIC)
+		now = {};
+
+	_callback_data(&msg);
+}
+
+void ChTimer::_wheel_insert(time_point next)
+{
+	auto & w = *_wheel;
+	w.wheel.remove(&_wheel_entry);
+	auto tick = w.tick_ceil(next);
+	w.wheel.insert(&_wheel_entry, tick);
+	// Syscall is needed only if new timer is earlier then armed wakeup
+	if (tick < w.armed && w.master)
+		w.master->_wheel_rearm();
+}
+
+void ChTimer::_wheel_rearm()
+{
+	auto next = _wheel->wheel.next_expire();
+	if (next == _wheel->armed)
+		return;
+	_wheel->armed = next;
+#ifdef __linux__
+	if (fd() == -1)
+		return;
+	if (next == tll::util::TimerWheel::never)
+		_rearm_timerfd({}, true, 0);
+	else
+		_rearm_timerfd(_wheel->tick_time(next).time_since_epoch(), true, TFD_TIMER_ABSTIME);
+#endif
+}
+
+void ChTimer::_wheel_fire(time_point now)
+{
+	_next_update(now);
+	if (_next != time_point())
+		_wheel_insert(_next);
+	_callback_time(now);
+}
+
+int ChTimer::_process_wheel()
+{
+#ifdef __linux__
+	if (fd() != -1) {
+		uint64_t w;
+		if (read(fd(), &w, sizeof(w)) != sizeof(w)) {
+			if (errno == EAGAIN)
+				return EAGAIN;
+			return _log.fail(EINVAL, "Failed to read from timerfd: {}", strerror(errno));
+		}
+	}
+#endif
+	auto now = _now();
+	_wheel->wheel.advance(_wheel->tick_floor(now), [now](tll::util::TimerWheel::Entry * e) {
+		static_cast<WheelEntry *>(e)->self->_wheel_fire(now);
+	});
+	_wheel_rearm();
+	return 0;
+}
+
+int ChTimer::_process(long timeout, int flags)
+{
+	if (_wheel_master)
+		return _process_wheel();
+	if (_next == time_point())
+		return EAGAIN;
+	auto now = _now();
+	if (now < _next)
+		return EAGAIN;
+
+	_next_update(now);
 
 #ifdef __linux__
 	if (_next < now)
@@ -267,10 +409,7 @@ int ChTimer::_process(long timeout, int flags)
 	}
 #endif
 
-	if (_clock_type == CLOCK_MONOTONIC)
-		now = {};
-
-	_callback_data(&msg);
+	_callback_time(now);
 
 	if (_next == time_point())
 		_update_dcaps(0, dcaps::Process | dcaps::CPOLLMASK);
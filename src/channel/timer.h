@@ -9,7 +9,9 @@
 #define _TLL_CHANNEL_TIMER_H
 
 #include "tll/channel/base.h"
+#include "tll/util/refptr.h"
 #include "tll/util/time.h"
+#include "tll/util/timerwheel.h"
 
 #include <time.h>
 
@@ -27,6 +29,27 @@ class ChTimer : public tll::channel::Base<ChTimer>
 {
 	using time_point = timer_clock::time_point;
 
+	/// Timer wheel shared between master channel in wheel mode and its children
+	struct Wheel : public tll::util::refbase_t<Wheel, 0>
+	{
+		tll::util::TimerWheel wheel;
+		tll::duration resolution;
+		time_point base;
+		ChTimer * master = nullptr; ///< Owner of timer fd, reset when master is destroyed
+		uint64_t armed = tll::util::TimerWheel::never; ///< Tick when timer fd is armed
+
+		/// Last tick that is not later then given time
+		uint64_t tick_floor(time_point t) const { return t <= base ? 0 : (t - base) / resolution; }
+		/// First tick that is not earlier then given time
+		uint64_t tick_ceil(time_point t) const { return t <= base ? 0 : (t - base + resolution - tll::duration(1)) / resolution; }
+		time_point tick_time(uint64_t tick) const { return base + tick * resolution; }
+	};
+
+	struct WheelEntry : public tll::util::TimerWheel::Entry
+	{
+		ChTimer * self = nullptr;
+	};
+
 	bool _oneshot_init = false;
 	bool _skip_old = false;
 	tll::duration _interval, _interval_init;
@@ -35,8 +58,23 @@ class ChTimer : public tll::channel::Base<ChTimer>
 
 	time_point _next;
 
+	tll::util::refptr_t<Wheel> _wheel;
+	bool _wheel_master = false;
+	WheelEntry _wheel_entry;
+
 	time_point _now() const;
 
+	/// Timer is attached to the wheel of the master channel and has no own fd
+	bool _wheel_child() const { return _wheel && !_wheel_master; }
+	void _wheel_insert(time_point next);
+	void _wheel_rearm();
+	int _process_wheel();
+	void _wheel_fire(time_point now);
+
+	/// Shift next wakeup time after event at ``now``
+	void _next_update(time_point now);
+	void _callback_time(time_point now);
+
 	int _rearm(tll::duration);
 	int _rearm(tll::time_point);
 	int _rearm_clear();
@@ -49,6 +87,7 @@ class ChTimer : public tll::channel::Base<ChTimer>
 	static constexpr auto scheme_policy() { return SchemePolicy::Manual; }
 
 	int _init(const tll::Channel::Url &, tll::Channel *master);
+	void _free();
 	int _open(const tll::ConstConfig &);
 	int _close();
 
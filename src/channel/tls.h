@@ -0,0 +1,361 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#ifndef _CHANNEL_TLS_H
+#define _CHANNEL_TLS_H
+
+#include "build-config.h"
+
+#include "tll/channel/base.h"
+#include "tll/util/time.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#ifdef WITH_OPENSSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <arpa/inet.h>
+
+#ifdef __linux__
+#include <linux/tls.h>
+#endif
+#endif
+
+namespace tll::channel::tls {
+
+struct settings_t
+{
+	bool enable = false;
+	std::string cert;
+	std::string key;
+	std::string ca;
+	std::string hostname;
+	bool verify = true;
+	bool ktls = true;
+	tll::duration handshake_timeout = std::chrono::seconds(10); ///< Zero disables timeout
+
+	template <typename Reader>
+	int init(tll::Logger &log, Reader &reader)
+	{
+		enable = reader.getT("tls", false);
+		cert = reader.template getT<std::string>("tls-cert", "");
+		key = reader.template getT<std::string>("tls-key", cert);
+		ca = reader.template getT<std::string>("tls-ca", "");
+		hostname = reader.template getT<std::string>("tls-hostname", "");
+		verify = reader.getT("tls-verify", true);
+		ktls = reader.getT("ktls", true);
+		handshake_timeout = reader.template getT<tll::duration>("tls-handshake-timeout", handshake_timeout);
+		if (!reader)
+			return log.fail(EINVAL, "Invalid url: {}", reader.error());
+		if (handshake_timeout.count() < 0)
+			return log.fail(EINVAL, "Negative tls-handshake-timeout");
+		return 0;
+	}
+};
+
+#ifdef WITH_OPENSSL
+
+/// Last OpenSSL error as a string, error queue is cleared
+inline std::string error_string()
+{
+	std::string r;
+	while (auto e = ERR_get_error()) {
+		char buf[256];
+		ERR_error_string_n(e, buf, sizeof(buf));
+		if (r.size())
+			r += "; ";
+		r += buf;
+	}
+	if (r.empty())
+		return "unknown error";
+	return r;
+}
+
+using context_ptr_t = std::shared_ptr<SSL_CTX>;
+
+/// Create SSL context for server or client side with certificates from settings
+inline context_ptr_t context(tll::Logger &log, const settings_t &settings, bool server)
+{
+	context_ptr_t ctx(SSL_CTX_new(server ? TLS_server_method() : TLS_client_method()), SSL_CTX_free);
+	if (!ctx)
+		return log.fail(nullptr, "Failed to create SSL context: {}", error_string());
+
+	SSL_CTX_set_min_proto_version(ctx.get(), TLS1_2_VERSION);
+	SSL_CTX_set_mode(ctx.get(), SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+	// Session tickets are post-handshake records, they are not needed for long living connections
+	SSL_CTX_set_options(ctx.get(), SSL_OP_NO_TICKET);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+	// Peer can close connection without close_notify alert, handle it as normal disconnect
+	SSL_CTX_set_options(ctx.get(), SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+	if (server)
+		SSL_CTX_set_num_tickets(ctx.get(), 0);
+#ifdef SSL_OP_ENABLE_KTLS
+	if (settings.ktls)
+		SSL_CTX_set_options(ctx.get(), SSL_OP_ENABLE_KTLS);
+#endif
+
+	if (settings.cert.size()) {
+		if (SSL_CTX_use_certificate_chain_file(ctx.get(), settings.cert.c_str()) != 1)
+			return log.fail(nullptr, "Failed to load certificate '{}': {}", settings.cert, error_string());
+		if (SSL_CTX_use_PrivateKey_file(ctx.get(), settings.key.c_str(), SSL_FILETYPE_PEM) != 1)
+			return log.fail(nullptr, "Failed to load private key '{}': {}", settings.key, error_string());
+		if (SSL_CTX_check_private_key(ctx.get()) != 1)
+			return log.fail(nullptr, "Private key '{}' does not match certificate: {}", settings.key, error_string());
+	} else if (server)
+		return log.fail(nullptr, "Server needs certificate, tls-cert parameter is missing");
+
+	if (settings.ca.size()) {
+		if (SSL_CTX_load_verify_locations(ctx.get(), settings.ca.c_str(), nullptr) != 1)
+			return log.fail(nullptr, "Failed to load CA file '{}': {}", settings.ca, error_string());
+	} else if (!server && settings.verify) {
+		if (SSL_CTX_set_default_verify_paths(ctx.get()) != 1)
+			return log.fail(nullptr, "Failed to load default CA paths: {}", error_string());
+	}
+
+	if (server) {
+		// Client certificates are requested only when CA is set
+		if (settings.ca.size() && settings.verify)
+			SSL_CTX_set_verify(ctx.get(), SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, nullptr);
+	} else if (settings.verify)
+		SSL_CTX_set_verify(ctx.get(), SSL_VERIFY_PEER, nullptr);
+	return ctx;
+}
+
+/**
+ * TLS session on non-blocking socket
+ *
+ * Handshake and records are processed by OpenSSL. If kernel TLS is enabled for the direction then
+ * data is passed to the socket as is and kernel encrypts or decrypts it.
+ */
+class Session
+{
+	std::unique_ptr<SSL, decltype(&SSL_free)> _ssl = { nullptr, SSL_free };
+	bool _handshake = false;
+	bool _ktls_send = false;
+	bool _ktls_recv = false;
+	std::vector<char> _buf; ///< Buffer to merge iovec into one record
+	std::vector<char> _cbuf; ///< Control buffer for kernel TLS receive
+
+ public:
+	bool handshake_pending() const { return _handshake; }
+	bool ktls_send() const { return _ktls_send; }
+	bool ktls_recv() const { return _ktls_recv; }
+
+	/// Decrypted data is buffered in OpenSSL and is not visible by poll
+	bool pending() const { return !_ktls_recv && SSL_pending(_ssl.get()) > 0; }
+
+	int init(tll::Logger &log, const context_ptr_t &ctx, int fd, bool server, std::string_view hostname)
+	{
+		_ssl.reset(SSL_new(ctx.get()));
+		if (!_ssl)
+			return log.fail(EINVAL, "Failed to create SSL session: {}", error_string());
+		if (SSL_set_fd(_ssl.get(), fd) != 1)
+			return log.fail(EINVAL, "Failed to bind SSL session to fd {}: {}", fd, error_string());
+		if (server)
+			SSL_set_accept_state(_ssl.get());
+		else {
+			SSL_set_connect_state(_ssl.get());
+			if (hostname.size()) {
+				std::string host(hostname);
+				in6_addr buf;
+				const bool ip = inet_pton(AF_INET, host.c_str(), &buf) == 1 || inet_pton(AF_INET6, host.c_str(), &buf) == 1;
+				if (ip) {
+					if (X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(_ssl.get()), host.c_str()) != 1)
+						return log.fail(EINVAL, "Failed to set peer address '{}': {}", host, error_string());
+				} else {
+					SSL_set_tlsext_host_name(_ssl.get(), host.c_str());
+					if (SSL_set1_host(_ssl.get(), host.c_str()) != 1)
+						return log.fail(EINVAL, "Failed to set peer hostname '{}': {}", host, error_string());
+				}
+			}
+		}
+		_handshake = true;
+		_ktls_send = _ktls_recv = false;
+		return 0;
+	}
+
+	void reset()
+	{
+		if (_ssl && !_handshake)
+			SSL_shutdown(_ssl.get());
+		_ssl.reset();
+		_handshake = false;
+		_ktls_send = _ktls_recv = false;
+	}
+
+	/**
+	 * Continue handshake
+	 *
+	 * @return 0 when handshake is finished, EAGAIN if more data is needed and error code on failure.
+	 * If @p want_write is set then handshake is blocked by output.
+	 */
+	int handshake(tll::Logger &log, bool &want_write)
+	{
+		want_write = false;
+		ERR_clear_error();
+		auto r = SSL_do_handshake(_ssl.get());
+		if (r != 1) {
+			switch (SSL_get_error(_ssl.get(), r)) {
+			case SSL_ERROR_WANT_READ:
+				return EAGAIN;
+			case SSL_ERROR_WANT_WRITE:
+				want_write = true;
+				return EAGAIN;
+			case SSL_ERROR_SYSCALL:
+				if (errno)
+					return log.fail(EINVAL, "TLS handshake failed: {}", strerror(errno));
+				return log.fail(EINVAL, "TLS handshake failed: connection closed");
+			default:
+				if (auto v = SSL_get_verify_result(_ssl.get()); v != X509_V_OK)
+					return log.fail(EINVAL, "TLS handshake failed: {}", X509_verify_cert_error_string(v));
+				return log.fail(EINVAL, "TLS handshake failed: {}", error_string());
+			}
+		}
+		_handshake = false;
+#ifdef SSL_OP_ENABLE_KTLS
+		_ktls_send = BIO_get_ktls_send(SSL_get_wbio(_ssl.get()));
+		_ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(_ssl.get()));
+#endif
+		log.info("TLS session established: {} {}, kernel offload send: {}, recv: {}",
+			SSL_get_version(_ssl.get()), SSL_get_cipher_name(_ssl.get()), _ktls_send, _ktls_recv);
+		return 0;
+	}
+
+	/// Send data, same semantics as sendmsg(2) but control data is not supported
+	ssize_t sendmsg(int fd, const msghdr * msg)
+	{
+		if (_ktls_send)
+			return ::sendmsg(fd, msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		const void * data = msg->msg_iov[0].iov_base;
+		size_t size = msg->msg_iov[0].iov_len;
+		if (msg->msg_iovlen > 1) {
+			_buf.clear();
+			for (size_t i = 0; i < msg->msg_iovlen; i++) {
+				auto ptr = static_cast<const char *>(msg->msg_iov[i].iov_base);
+				_buf.insert(_buf.end(), ptr, ptr + msg->msg_iov[i].iov_len);
+			}
+			data = _buf.data();
+			size = _buf.size();
+		}
+		// In partial write mode each call sends at most one record
+		size_t sent = 0;
+		while (sent < size) {
+			ERR_clear_error();
+			auto r = SSL_write(_ssl.get(), static_cast<const char *>(data) + sent, size - sent);
+			if (r <= 0) {
+				if (sent)
+					break;
+				return _error(r);
+			}
+			sent += r;
+		}
+		return sent;
+	}
+
+	/// Receive data into first buffer, same semantics as recvmsg(2)
+	ssize_t recvmsg(int fd, msghdr * msg)
+	{
+		if (_ktls_recv)
+			return _ktls_recvmsg(fd, msg);
+		msg->msg_controllen = 0;
+		ERR_clear_error();
+		auto r = SSL_read(_ssl.get(), msg->msg_iov[0].iov_base, msg->msg_iov[0].iov_len);
+		if (r > 0)
+			return r;
+		return _error(r);
+	}
+
+ private:
+	/**
+	 * Receive with kernel TLS offload
+	 *
+	 * Kernel returns records of one type per call and reports it in TLS_GET_RECORD_TYPE control
+	 * message, without it non-data records fail with EIO. Only application data is passed to the
+	 * caller: close_notify alert is reported as end of stream, session tickets are skipped and other
+	 * alerts or KeyUpdate, that can not be handled without OpenSSL, are errors.
+	 */
+	ssize_t _ktls_recvmsg(int fd, msghdr * msg)
+	{
+#if defined(__linux__) && defined(TLS_GET_RECORD_TYPE)
+		auto control = static_cast<char *>(msg->msg_control);
+		const size_t controllen = msg->msg_controllen;
+		_cbuf.resize(controllen + CMSG_SPACE(sizeof(uint8_t)));
+		for (;;) {
+			msg->msg_control = _cbuf.data();
+			msg->msg_controllen = _cbuf.size();
+			auto r = ::recvmsg(fd, msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+			// Pass all control messages except record type to the caller
+			uint8_t type = SSL3_RT_APPLICATION_DATA;
+			size_t size = 0;
+			if (r >= 0) {
+				for (auto cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+					if (cmsg->cmsg_level == SOL_TLS && cmsg->cmsg_type == TLS_GET_RECORD_TYPE) {
+						type = *CMSG_DATA(cmsg);
+						continue;
+					}
+					auto space = CMSG_SPACE(cmsg->cmsg_len - CMSG_LEN(0));
+					if (size + space > controllen)
+						break;
+					memcpy(control + size, cmsg, cmsg->cmsg_len);
+					size += space;
+				}
+			}
+			msg->msg_control = control;
+			msg->msg_controllen = size;
+
+			if (r <= 0 || type == SSL3_RT_APPLICATION_DATA)
+				return r;
+
+			auto data = static_cast<const uint8_t *>(msg->msg_iov[0].iov_base);
+			switch (type) {
+			case SSL3_RT_ALERT:
+				if (r >= 2 && data[1] == SSL_AD_CLOSE_NOTIFY)
+					return 0;
+				errno = ECONNRESET;
+				return -1;
+			case SSL3_RT_HANDSHAKE:
+				if (r >= 1 && data[0] == SSL3_MT_NEWSESSION_TICKET)
+					continue; // Tickets are not used
+				errno = EPROTO; // KeyUpdate or unexpected handshake message
+				return -1;
+			default:
+				errno = EPROTO;
+				return -1;
+			}
+		}
+#else
+		return ::recvmsg(fd, msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
+	}
+
+	ssize_t _error(int r)
+	{
+		switch (SSL_get_error(_ssl.get(), r)) {
+		case SSL_ERROR_WANT_READ:
+		case SSL_ERROR_WANT_WRITE:
+			errno = EAGAIN;
+			return -1;
+		case SSL_ERROR_ZERO_RETURN:
+			return 0;
+		case SSL_ERROR_SYSCALL:
+			if (errno == 0) // Unexpected EOF
+				return 0;
+			return -1;
+		default:
+			errno = EPROTO;
+			return -1;
+		}
+	}
+};
+
+#endif // WITH_OPENSSL
+
+} // namespace tll::channel::tls
+
+#endif//_CHANNEL_TLS_H
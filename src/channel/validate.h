@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#ifndef _CHANNEL_VALIDATE_H
+#define _CHANNEL_VALIDATE_H
+
+#include "tll/channel/prefix.h"
+#include "tll/scheme/validate.h"
+#include "tll/util/memoryview.h"
+#include "tll/util/time.h"
+
+namespace tll::channel {
+class Validate : public tll::channel::Prefix<Validate>
+{
+	using Base = tll::channel::Prefix<Validate>;
+
+	tll::scheme::Validate _validate;
+
+	bool _input = true;
+	bool _output = false;
+	bool _drop = true;
+
+	unsigned long long _invalid = 0;
+	unsigned long long _suppressed = 0; ///< Invalid messages that were not logged
+	tll::time_point _log_next = {};
+
+	/// Invalid messages after first one are reported at most once in this interval
+	static constexpr auto log_interval = std::chrono::seconds(1);
+ public:
+	static constexpr std::string_view channel_protocol() { return "validate+"; }
+
+	struct StatType : public Base::StatType
+	{
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'i', 'n', 'v', 'a', 'l', 'i', 'd'> invalid;
+	};
+
+	int _init(const tll::Channel::Url &cfg, tll::Channel *master)
+	{
+		if (auto r = Base::_init(cfg, master); r)
+			return r;
+
+		enum Dir { In, Out, InOut };
+		auto reader = channel_props_reader(cfg);
+		auto dir = reader.getT("dir", In, {{"in", In}, {"out", Out}, {"inout", InOut}});
+		_drop = reader.getT("on-error", true, {{"drop", true}, {"fail", false}});
+		if (!reader)
+			return this->_log.fail(EINVAL, "Invalid url: {}", reader.error());
+		_input = dir != Out;
+		_output = dir != In;
+
+		return 0;
+	}
+
+	int _on_active()
+	{
+		auto s = _child->scheme();
+		if (!s)
+			return _log.fail(EINVAL, "Child without scheme, can not validate messages");
+		_validate.init(s);
+		_invalid = 0;
+		_suppressed = 0;
+		_log_next = {};
+		return Base::_on_active();
+	}
+
+	int _on_closed()
+	{
+		if (_invalid)
+			_log.info("Invalid messages: {}", _invalid);
+		return Base::_on_closed();
+	}
+
+	int _on_data(const tll_msg_t *msg)
+	{
+		if (_input && _check(msg, "Received"))
+			return _drop ? 0 : EINVAL;
+		return _callback_data(msg);
+	}
+
+	int _post(const tll_msg_t *msg, int flags)
+	{
+		if (msg->type != TLL_MESSAGE_DATA || !_output)
+			return _child->post(msg, flags);
+		if (_check(msg, "Posted"))
+			return EINVAL;
+		return _child->post(msg, flags);
+	}
+
+ private:
+	int _check(const tll_msg_t *msg, std::string_view dir)
+	{
+		auto r = _validate.validate(msg->msgid, tll::make_view(*msg));
+		if (!r)
+			return 0;
+		_invalid++;
+		if (auto page = stat_acquire(this); page)
+			page->invalid.update(1);
+
+		// Bad peer can send invalid messages at full rate, do not format each of them
+		if (_invalid > 1) {
+			auto now = tll::time::now();
+			if (now < _log_next) {
+				_suppressed++;
+				return r;
+			}
+			_log_next = now + log_interval;
+			if (_suppressed)
+				_log.error("Suppressed {} invalid messages", _suppressed);
+			_suppressed = 0;
+		} else
+			_log_next = tll::time::now() + log_interval;
+
+		if (_validate.error_stack.size())
+			_log.error("{} invalid message {} (seq {}): {}: {}", dir, msg->msgid, msg->seq, _validate.format_stack(), _validate.error);
+		else
+			_log.error("{} invalid message {} (seq {}): {}", dir, msg->msgid, msg->seq, _validate.error);
+		return r;
+	}
+};
+
+} // namespace tll::channel
+
+#endif//_CHANNEL_VALIDATE_H
@@ -0,0 +1,339 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#include "tll/channel/module.h"
+#include "tll/channel/tagged.h"
+#include "tll/util/time.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+using tll::channel::Input;
+using tll::channel::Output;
+using tll::channel::TaggedChannel;
+
+template <>
+struct tll::channel::TaggedChannel<tll::channel::Input>
+{
+	tll::Channel * channel;
+	unsigned index = 0;
+};
+
+class Arbiter : public tll::channel::Tagged<Arbiter, Input, Output>
+{
+	struct Line
+	{
+		tll::Channel * channel = nullptr;
+		char name = 'a';
+		long long seq = -1; ///< Last seq received on this line
+		tll::time_point last = {}; ///< Time of last message
+		bool stalled = false;
+		bool reset = false; ///< Other line restarted sequence, old stream on this line is dropped
+	};
+
+	enum class Mode { First, Active };
+
+	std::array<Line, 2> _lines;
+	unsigned _active = 0; ///< Line that is considered primary
+	Mode _mode = Mode::First;
+
+	std::vector<uint64_t> _bitmap; ///< Seen seq bits for window [_head - window, _head]
+	std::vector<tll::time_point> _first; ///< Time of first arrival for each slot in window
+	size_t _mask = 0;
+	long long _head = -1; ///< Largest seq seen
+
+	tll::duration _stall_timeout = {};
+	std::unique_ptr<tll::Channel> _timer; ///< Periodic stall check when lines are quiet
+
+ public:
+	using Base = tll::channel::Tagged<Arbiter, Input, Output>;
+	static constexpr std::string_view channel_protocol() { return "arbiter"; }
+	static constexpr auto child_policy() { return ChildPolicy::Many; }
+
+	struct StatType : public Base::StatType
+	{
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'd', 'u', 'p'> dup; ///< Duplicates dropped
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 's', 't', 'a', 'l', 'e'> stale; ///< Messages older then window
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 's', 'w', 'i', 't', 'c', 'h'> switch_; ///< Failovers between lines
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'a', 'w', 'i', 'n'> awin; ///< First arrivals on line A
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'b', 'w', 'i', 'n'> bwin; ///< First arrivals on line B
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'a', 'l', 'o', 's', 's'> aloss; ///< Seq gaps on line A
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'b', 'l', 'o', 's', 's'> bloss; ///< Seq gaps on line B
+		tll::stat::IntegerGroup<tll::stat::Ns, 'a', 'l', 'a', 'g'> alag; ///< Delay of line A behind line B
+		tll::stat::IntegerGroup<tll::stat::Ns, 'b', 'l', 'a', 'g'> blag; ///< Delay of line B behind line A
+	};
+
+	int _init(const tll::Channel::Url &, tll::Channel *master);
+	void _free();
+	int _open(const tll::ConstConfig &cfg);
+	int _close();
+
+	int callback_tag(TaggedChannel<Input> * c, const tll_msg_t *msg);
+	int callback_tag(TaggedChannel<Output> * c, const tll_msg_t *msg) { return 0; }
+
+ private:
+	int _on_data(Line &line, const tll_msg_t *msg);
+	int _on_state(Line &line, const tll_msg_t *msg);
+	int _on_timer(const tll_msg_t *msg);
+
+	/// Mark line as stalled and switch to other one if it was active and other line is alive
+	void _stall(Line &line, std::string_view reason);
+
+	/// Make line active
+	void _switch(Line &line);
+
+	/// Clear dedup window when line starts new sequence
+	void _reset(Line &line, long long seq);
+
+	/// Check seq against dedup window and mark it as seen, returns false for duplicates
+	bool _check(long long seq, tll::time_point now, tll::duration &lag);
+};
+
+int Arbiter::_init(const tll::Channel::Url &url, tll::Channel *)
+{
+	if (check_channels_size<Input>(2, 2))
+		return EINVAL;
+
+	auto reader = channel_props_reader(url);
+	auto window = reader.getT("window", 4096u);
+	_stall_timeout = reader.getT<tll::duration>("stall-timeout", std::chrono::seconds(1));
+	_mode = reader.getT("mode", Mode::First, {{"first", Mode::First}, {"active", Mode::Active}});
+	if (!reader)
+		return _log.fail(EINVAL, "Invalid url: {}", reader.error());
+	if (_stall_timeout.count() <= 0)
+		return _log.fail(EINVAL, "Non-positive stall timeout: {}", tll::conv::to_string(_stall_timeout));
+
+	if (window < 64)
+		window = 64;
+	size_t size = 64;
+	while (size < window)
+		size <<= 1;
+	_mask = size - 1;
+	_bitmap.resize(size / 64);
+	_first.resize(size);
+
+	unsigned idx = 0;
+	for (auto & [i, _] : _channels.get<Input>()) {
+		i.index = idx;
+		_lines[idx].channel = i.channel;
+		_lines[idx].name = 'a' + idx;
+		_log.info("Line {}: {}", (char) ('A' + idx), i.channel->name());
+		idx++;
+	}
+	_log.info("Dedup window {} messages, stall timeout {}", size, tll::conv::to_string(_stall_timeout));
+
+	auto curl = child_url_parse("timer://;clock=monotonic", "timer");
+	if (!curl)
+		return _log.fail(EINVAL, "Failed to parse timer url: {}", curl.error());
+	curl->set("interval", tll::conv::to_string(_stall_timeout / 2));
+	_timer = context().channel(*curl);
+	if (!_timer)
+		return _log.fail(EINVAL, "Failed to create timer channel");
+	_timer->callback_add([](auto * c, auto * m, void * user) { return static_cast<Arbiter *>(user)->_on_timer(m); }, this, TLL_MESSAGE_MASK_DATA);
+	_child_add(_timer.get(), "timer");
+	return 0;
+}
+
+void Arbiter::_free()
+{
+	_timer.reset();
+	return Base::_free();
+}
+
+int Arbiter::_open(const tll::ConstConfig &cfg)
+{
+	std::fill(_bitmap.begin(), _bitmap.end(), 0);
+	_head = -1;
+	_active = 0;
+	for (auto & l : _lines) {
+		l.seq = -1;
+		l.last = {};
+		l.stalled = false;
+		l.reset = false;
+	}
+	config_info().set("active", _lines[_active].channel->name());
+	if (_timer->open())
+		return _log.fail(EINVAL, "Failed to open timer channel");
+	return Base::_open(cfg);
+}
+
+int Arbiter::_close()
+{
+	_timer->close(true);
+	return Base::_close();
+}
+
+int Arbiter::callback_tag(TaggedChannel<Input> * c, const tll_msg_t *msg)
+{
+	auto & line = _lines[c->index];
+	if (msg->type == TLL_MESSAGE_DATA)
+		return _on_data(line, msg);
+	else if (msg->type == TLL_MESSAGE_STATE)
+		return _on_state(line, msg);
+	return 0;
+}
+
+bool Arbiter::_check(long long seq, tll::time_point now, tll::duration &lag)
+{
+	const size_t window = _mask + 1;
+	if (_head == -1 || seq >= _head + (long long) window) {
+		std::fill(_bitmap.begin(), _bitmap.end(), 0);
+	} else if (seq > _head) {
+		// Each slot is cleared once per window shift, amortized O(1) per message
+		for (auto s = _head + 1; s < seq; s++)
+			_bitmap[(s & _mask) / 64] &= ~(1ull << (s & 63));
+	} else {
+		const uint64_t bit = 1ull << (seq & 63);
+		auto & word = _bitmap[(seq & _mask) / 64];
+		if (word & bit) {
+			lag = now - _first[seq & _mask];
+			return false;
+		}
+		word |= bit;
+		_first[seq & _mask] = now;
+		return true;
+	}
+
+	_head = seq;
+	_bitmap[(seq & _mask) / 64] |= 1ull << (seq & 63);
+	_first[seq & _mask] = now;
+	return true;
+}
+
+void Arbiter::_reset(Line &line, long long seq)
+{
+	auto & other = _lines[1 - (&line - _lines.data())];
+	_log.info("Line {} ({}) restarted sequence: {} after {}, reset dedup window", line.name, line.channel->name(), seq, line.seq);
+	std::fill(_bitmap.begin(), _bitmap.end(), 0);
+	_head = -1;
+	line.seq = -1;
+	other.reset = other.seq != -1;
+}
+
+int Arbiter::_on_data(Line &line, const tll_msg_t *msg)
+{
+	auto now = tll::time::now();
+	auto & other = _lines[1 - (&line - _lines.data())];
+	const bool a = line.name == 'a';
+
+	// Jump back further then dedup window can not be reordering, it is new sequence
+	bool old = false;
+	if (line.seq != -1 && msg->seq + (long long) (_mask + 1) < line.seq) {
+		if (line.reset) {
+			_log.info("Line {} ({}) followed sequence reset: {} after {}", line.name, line.channel->name(), msg->seq, line.seq);
+			line.reset = false;
+			line.seq = -1;
+		} else
+			_reset(line, msg->seq);
+	} else
+		old = line.reset;
+
+	if (line.seq != -1 && msg->seq > line.seq + 1) {
+		if (auto page = tll::channel::stat_acquire(this); page) {
+			if (a)
+				page->aloss.update(msg->seq - line.seq - 1);
+			else
+				page->bloss.update(msg->seq - line.seq - 1);
+		}
+	}
+	line.seq = std::max(line.seq, msg->seq);
+	line.last = now;
+
+	if (line.stalled) {
+		_log.info("Line {} ({}) is alive again on seq {}", line.name, line.channel->name(), msg->seq);
+		line.stalled = false;
+		if (_lines[_active].stalled)
+			_switch(line);
+	}
+
+	if (!other.stalled && other.last != tll::time_point {} && now - other.last > _stall_timeout)
+		_stall(other, "no data");
+
+	if (old || (_head != -1 && msg->seq <= _head - (long long) (_mask + 1))) {
+		if (auto page = tll::channel::stat_acquire(this); page)
+			page->stale.update(1);
+		return 0;
+	}
+
+	// In active mode other line only fills gaps that active line has already passed
+	if (_mode == Mode::Active && &line != &_lines[_active] && !_lines[_active].stalled && msg->seq > _lines[_active].seq)
+		return 0;
+
+	tll::duration lag = {};
+	if (!_check(msg->seq, now, lag)) {
+		if (auto page = tll::channel::stat_acquire(this); page) {
+			page->dup.update(1);
+			if (a)
+				page->alag = lag.count();
+			else
+				page->blag = lag.count();
+		}
+		return 0;
+	}
+
+	if (auto page = tll::channel::stat_acquire(this); page) {
+		if (a)
+			page->awin.update(1);
+		else
+			page->bwin.update(1);
+	}
+
+	for (auto & [c, _] : _channels.get<Output>())
+		c->post(msg);
+	_callback_data(msg);
+	return 0;
+}
+
+int Arbiter::_on_state(Line &line, const tll_msg_t *msg)
+{
+	if (msg->msgid != tll::state::Error || state() != tll::state::Active)
+		return 0;
+	_stall(line, "channel failed");
+	for (auto & l : _lines) {
+		if (l.channel->state() != tll::state::Error)
+			return 0;
+	}
+	return state_fail(0, "Both lines failed");
+}
+
+int Arbiter::_on_timer(const tll_msg_t *)
+{
+	if (state() != tll::state::Active)
+		return 0;
+	auto now = tll::time::now();
+	for (auto & l : _lines) {
+		if (!l.stalled && l.last != tll::time_point {} && now - l.last > _stall_timeout)
+			_stall(l, "no data");
+	}
+	return 0;
+}
+
+void Arbiter::_stall(Line &line, std::string_view reason)
+{
+	if (!line.stalled)
+		_log.warning("Line {} ({}) is down: {}, last seq {}", line.name, line.channel->name(), reason, line.seq);
+	line.stalled = true;
+
+	if (&_lines[_active] != &line)
+		return;
+	auto & other = _lines[1 - _active];
+	if (other.stalled) {
+		_log.warning("Both lines are down, keep line {} ({}) active", line.name, line.channel->name());
+		return;
+	}
+	_switch(other);
+}
+
+void Arbiter::_switch(Line &line)
+{
+	_active = &line - _lines.data();
+	_log.info("Switch active line to {} ({})", line.name, line.channel->name());
+	config_info().set("active", line.channel->name());
+	if (auto page = tll::channel::stat_acquire(this); page)
+		page->switch_.update(1);
+}
+
+TLL_DEFINE_IMPL(Arbiter);
+
+TLL_DEFINE_MODULE(Arbiter);
@@ -6,6 +6,7 @@
 
 #include "tll/channel/tagged.h"
 #include "tll/stat.h"
+#include "tll/util/perfevent.h"
 #include "tll/util/rusage.h"
 
 #ifndef RUSAGE_THREAD
@@ -20,6 +21,7 @@ class RUsage : public tll::channel::Tagged<RUsage, Timer>
 {
 	using Base = tll::channel::Tagged<RUsage, Timer>;
 	using RU = tll::util::RUsage;
+	using Perf = tll::util::PerfEvent;
 	RU _rusage { RU::Process };
 
  public:
@@ -33,24 +35,72 @@ class RUsage : public tll::channel::Tagged<RUsage, Timer>
 		tll::stat::Integer<tll::stat::Max, tll::stat::Bytes, 'm', 'e', 'm'> mem;
 	};
 
+	/// Perf counters, reported in separate '{name}/perf' page
+	struct PerfStat
+	{
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'c', 'y', 'c', 'l', 'e', 's'> cycles;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'i', 'n', 's', 't', 'r'> instr;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'c', 'm', 'i', 's', 's'> cmiss;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'c', 's', 'w'> csw;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'i', 'v', 'c', 's', 'w'> ivcsw;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'm', 'i', 'g', 'r'> migr;
+	};
+
+ private:
+	bool _perf_enable = false;
+	Perf _perf;
+	long _ivcsw = 0;
+	tll::stat::Block<PerfStat> _stat_perf = { "rusage/perf" };
+
+ public:
 	int _init(const tll::Channel::Url &url, tll::Channel *master)
 	{
 		auto reader = channel_props_reader(url);
 		auto type = reader.getT("type", RU::Process, {{"process", RU::Process}, {"thread", RU::Thread}});
+		_perf_enable = reader.getT("perf", false);
 		_rusage = RU { type };
 		if (!reader)
 			return _log.fail(EINVAL, "Invalid url: {}", reader.error());
 		if (check_channels_size<Timer>(1, 1))
 			return EINVAL;
+
+		if (_perf_enable && _stat_enable) {
+			_stat_perf.init(fmt::format("{}/perf", name));
+			if (tll_stat_list_add(context().stat_list(), &_stat_perf))
+				return _log.fail(EINVAL, "Failed to add perf stat page");
+		}
 		return 0;
 	}
 
+	void _free()
+	{
+		if (_perf_enable && _stat_enable)
+			tll_stat_list_remove(context().stat_list(), &_stat_perf);
+		Base::_free();
+	}
+
 	int _open(const tll::ConstConfig &)
 	{
 		_rusage.reset();
+		_rusage.update();
+		_ivcsw = _rusage.ivcsw;
+
+		if (_perf_enable) {
+			// Counters are bound to the thread that opens logic, usually its worker
+			if (auto r = _perf.open(); r)
+				_log.warning("Perf counters are not available: {}", strerror(r));
+			else if (!_perf.hardware())
+				_log.info("Hardware perf counters are not available, report only software counters");
+		}
 		return 0;
 	}
 
+	int _close()
+	{
+		_perf.close();
+		return Base::_close();
+	}
+
 	int callback_tag(TaggedChannel<Timer> * c, const tll_msg_t *msg)
 	{
 		if (!_stat_enable)
@@ -62,6 +112,20 @@ class RUsage : public tll::channel::Tagged<RUsage, Timer>
 			page->cpu = 100 * _rusage.cpu_ratio;
 			page->cpuns = _rusage.cpu.count();
 		}
+
+		if (!_perf_enable)
+			return 0;
+
+		_perf.update();
+		if (auto page = _stat_perf.acquire_guard(); page) {
+			page->cycles = _perf.delta[Perf::Cycles];
+			page->instr = _perf.delta[Perf::Instructions];
+			page->cmiss = _perf.delta[Perf::CacheMisses];
+			page->csw = _perf.delta[Perf::ContextSwitches];
+			page->migr = _perf.delta[Perf::Migrations];
+			page->ivcsw = _rusage.ivcsw - _ivcsw;
+		}
+		_ivcsw = _rusage.ivcsw;
 		return 0;
 	}
 };
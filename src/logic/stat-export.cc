@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2024 Pavel Shramov <shramov@mexmat.net>
+ *
+ * tll is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "logic/stat-export.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace tll::stat::exported;
+
+namespace {
+constexpr size_t align8(size_t v) { return (v + 7) & ~size_t(7); }
+
+bool same_layout(const std::vector<tll_stat_field_t> &acc, const tll_stat_page_t * page)
+{
+	if (acc.size() != page->size)
+		return false;
+	for (auto i = 0u; i < page->size; i++) {
+		auto & l = acc[i];
+		auto & r = page->fields[i];
+		if (l.type != r.type || l.method != r.method || memcmp(l.name, r.name, sizeof(l.name)))
+			return false;
+	}
+	return true;
+}
+
+/// Group and histogram header fields, they are followed by sum, min and max fields
+bool group_header(const tll_stat_field_t &f)
+{
+	std::string_view name(f.name, strnlen(f.name, sizeof(f.name)));
+	return name == "_tllgrp" || name.substr(0, tll::stat::histogram::header_prefix.size()) == tll::stat::histogram::header_prefix;
+}
+
+template <typename T>
+void merge(unsigned method, T &l, T r)
+{
+	// Empty values are max for Min and min for Max so no additional check is needed
+	if (method == TLL_STAT_MIN)
+		l = std::min(l, r);
+	else
+		l = std::max(l, r);
+}
+}
+
+int Writer::open()
+{
+	close();
+
+	_pages.clear();
+	_overflow = false;
+
+	_fd = ::open(_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (_fd == -1)
+		return _log.fail(EINVAL, "Failed to open stat export file {}: {}", _filename, strerror(errno));
+
+	const size_t full = sizeof(header_t) + _capacity;
+	if (ftruncate(_fd, full))
+		return _log.fail(EINVAL, "Failed to resize stat export file {} to {}: {}", _filename, full, strerror(errno));
+
+	auto buf = mmap(nullptr, full, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	if (buf == MAP_FAILED)
+		return _log.fail(EINVAL, "Failed to mmap stat export file {}: {}", _filename, strerror(errno));
+
+	_header = static_cast<header_t *>(buf);
+	memset(_header, 0, sizeof(*_header));
+	_header->version = version;
+	_header->header_size = sizeof(header_t);
+	_header->capacity = _capacity;
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(_header->magic, magic, sizeof(magic));
+
+	_log.info("Export stat into {}, {} bytes for pages", _filename, _capacity);
+	return 0;
+}
+
+void Writer::close()
+{
+	if (_header)
+		munmap(_header, sizeof(header_t) + _header->capacity);
+	_header = nullptr;
+	if (_fd != -1)
+		::close(_fd);
+	_fd = -1;
+}
+
+void Writer::update(std::string_view name, const tll_stat_page_t * page)
+{
+	auto it = _pages.find(name);
+	if (it == _pages.end())
+		it = _pages.emplace(name, std::vector<tll_stat_field_t>()).first;
+	auto & acc = it->second;
+	if (!same_layout(acc, page)) {
+		acc.assign(page->fields, page->fields + page->size);
+		return;
+	}
+
+	size_t group_end = 0;
+	for (auto i = 0u; i < page->size; i++) {
+		auto & l = acc[i];
+		auto & r = page->fields[i];
+		if (group_header(r))
+			group_end = i + 4;
+		if (i < group_end && (r.method == TLL_STAT_MIN || r.method == TLL_STAT_MAX)) {
+			// Min and max of group are accumulated together with its count, sum and buckets
+			if (r.type == TLL_STAT_FLOAT)
+				merge(r.method, l.fvalue, r.fvalue);
+			else
+				merge(r.method, l.value, r.value);
+			continue;
+		}
+		if (r.method != TLL_STAT_SUM) {
+			l = r;
+			continue;
+		}
+		if (r.type == TLL_STAT_FLOAT)
+			l.fvalue += r.fvalue;
+		else
+			l.value += r.value;
+	}
+}
+
+int Writer::commit(long long time)
+{
+	if (!_header)
+		return EINVAL;
+
+	_buf.resize(0);
+	uint32_t pages = 0;
+	for (auto & [name, fields] : _pages) {
+		auto nsize = align8(name.size());
+		auto size = sizeof(page_t) + nsize + sizeof(tll_stat_field_t) * fields.size();
+		if (_buf.size() + size > _capacity) {
+			if (!_overflow)
+				_log.warning("Not enough space for page {} in stat export file, need {} bytes more",
+						name, _buf.size() + size - _capacity);
+			_overflow = true;
+			continue;
+		}
+
+		auto off = _buf.size();
+		_buf.resize(off + size);
+		auto ptr = _buf.data() + off;
+		auto hdr = reinterpret_cast<page_t *>(ptr);
+		hdr->size = size;
+		hdr->name_size = name.size();
+		hdr->fields = fields.size();
+		memcpy(ptr + sizeof(page_t), name.data(), name.size());
+		memcpy(ptr + sizeof(page_t) + nsize, fields.data(), sizeof(tll_stat_field_t) * fields.size());
+		pages++;
+	}
+
+	auto seq = reinterpret_cast<std::atomic<uint64_t> *>(&_header->seq);
+	auto s = seq->load(std::memory_order_relaxed);
+	seq->store(s + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	_header->time = time;
+	_header->size = _buf.size();
+	_header->pages = pages;
+	memcpy(_header + 1, _buf.data(), _buf.size());
+
+	seq->store(s + 2, std::memory_order_release);
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2024 Pavel Shramov <shramov@mexmat.net>
+ *
+ * tll is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef __LOGIC_STAT_EXPORT_H
+#define __LOGIC_STAT_EXPORT_H
+
+#include "tll/logger.h"
+#include "tll/stat.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tll::stat::exported {
+
+/**
+ * Layout of stat export file, all values are in host byte order.
+ *
+ * File starts with header followed by page records, each record is
+ * page_t header, page name padded to 8 bytes and array of tll_stat_field_t.
+ *
+ * Header is guarded by seqlock: sequence number is odd while snapshot is
+ * written, reader should copy data and check that sequence is even and not
+ * changed.
+ */
+static constexpr char magic[8] = {'T', 'L', 'L', 'S', 'T', 'A', 'T', '\0'};
+static constexpr uint32_t version = 1;
+
+struct header_t
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size; ///< Size of header, page records start at this offset
+	uint64_t seq; ///< Seqlock sequence number
+	int64_t time; ///< Snapshot time, ns since epoch
+	uint64_t capacity; ///< Space for page records
+	uint64_t size; ///< Size of page records in current snapshot
+	uint32_t pages; ///< Number of page records
+	uint32_t reserved0;
+	uint64_t reserved1;
+};
+
+static_assert(sizeof(header_t) == 64);
+
+struct page_t
+{
+	uint32_t size; ///< Full record size, multiple of 8
+	uint16_t name_size; ///< Size of page name, without padding
+	uint16_t reserved0;
+	uint32_t fields; ///< Number of fields
+	uint32_t reserved1;
+};
+
+static_assert(sizeof(page_t) == 16);
+
+/**
+ * Writer of stat export file.
+ *
+ * Pages are accumulated between snapshots: Sum fields (including group counters and histogram
+ * buckets) and min/max of groups hold cumulative values since open, standalone Min, Max and Last
+ * fields are taken from the last interval.
+ */
+class Writer
+{
+	tll::Logger _log;
+
+	std::string _filename;
+	size_t _capacity = 0;
+
+	int _fd = -1;
+	header_t * _header = nullptr;
+
+	std::map<std::string, std::vector<tll_stat_field_t>, std::less<>> _pages;
+	std::vector<char> _buf;
+	bool _overflow = false;
+
+ public:
+	Writer(const tll::Logger &log) : _log(log) {}
+	~Writer() { close(); }
+
+	int init(std::string_view filename, size_t capacity)
+	{
+		_filename = filename;
+		_capacity = capacity;
+		return 0;
+	}
+
+	int open();
+	void close();
+
+	explicit operator bool () const { return _header != nullptr; }
+
+	/// Accumulate swapped page
+	void update(std::string_view name, const tll_stat_page_t * page);
+
+	/// Write snapshot of accumulated pages
+	int commit(long long time);
+};
+
+} // namespace tll::stat::exported
+
+#endif//__LOGIC_STAT_EXPORT_H
@@ -10,11 +10,13 @@
 #include "tll/stat.h"
 #include "tll/util/conv.h"
 #include "tll/util/conv-fmt.h"
+#include "tll/util/size.h"
 
 #include "tll/scheme/logic/stat.h"
 
 #include "logic/rusage.h"
 #include "logic/quantile.h"
+#include "logic/stat-export.h"
 
 #include <regex>
 #include <thread>
@@ -26,6 +28,9 @@ class Stat : public tll::LogicBase<Stat>
 	bool _secondary = false;
 	std::string _node;
 	tll::Logger::level_t _header_level = tll::Logger::Debug;
+	bool _log_pages = true;
+
+	std::unique_ptr<tll::stat::exported::Writer> _export;
 
 	struct page_rule_t
 	{
@@ -44,6 +49,8 @@ class Stat : public tll::LogicBase<Stat>
 	static constexpr auto scheme_policy() { return SchemePolicy::Manual; }
 
 	int _init(const tll::Channel::Url &, tll::Channel *master);
+	int _open(const tll::ConstConfig &);
+	int _close();
 
 	int logic(const tll::Channel * c, const tll_msg_t *msg);
 	int _dump(tll_stat_iter_t * i);
@@ -61,6 +68,7 @@ class Stat : public tll::LogicBase<Stat>
 
 	template <typename T>
 	std::string _group(std::string_view name, tll_stat_unit_t unit, int64_t count, T sum, T min, T max);
+	std::string _histogram(const tll::stat::ConstHistogramView &hist);
 };
 
 int Stat::_init(const tll::Channel::Url &url, tll::Channel *)
@@ -77,9 +85,17 @@ int Stat::_init(const tll::Channel::Url &url, tll::Channel *)
 	_secondary = reader.getT("secondary", false);
 	_node = reader.getT<std::string>("node", "");
 	_header_level = reader.getT("header-level", tll::Logger::Debug, {{"debug", tll::Logger::Debug}, {"info", tll::Logger::Info}});
+	_log_pages = reader.getT("log", true);
+	auto efile = reader.getT<std::string>("export", "");
+	auto esize = reader.getT("export-size", tll::util::Size { 1024 * 1024 });
 	if (!reader)
 		return _log.fail(EINVAL, "Invalid url: {}", reader.error());
 
+	if (efile.size()) {
+		_export.reset(new tll::stat::exported::Writer(_log));
+		_export->init(efile, esize);
+	}
+
 	_scheme.reset(context().scheme_load(stat_scheme::scheme_string));
 	if (!_scheme.get())
 		return _log.fail(EINVAL, "Failed to load timer scheme");
@@ -110,6 +126,20 @@ int Stat::_init(const tll::Channel::Url &url, tll::Channel *)
 	return 0;
 }
 
+int Stat::_open(const tll::ConstConfig &)
+{
+	if (_export && _export->open())
+		return _log.fail(EINVAL, "Failed to open stat export file");
+	return 0;
+}
+
+int Stat::_close()
+{
+	if (_export)
+		_export->close();
+	return 0;
+}
+
 int Stat::logic(const tll::Channel * c, const tll_msg_t *msg)
 {
 	if (msg->type != TLL_MESSAGE_DATA)
@@ -121,6 +151,8 @@ int Stat::logic(const tll::Channel * c, const tll_msg_t *msg)
 	for (; i != nullptr; i = tll_stat_iter_next(i))
 		_dump(i);
 
+	if (_export)
+		_export->commit(tll::time::now().time_since_epoch().count());
 	return 0;
 }
 
@@ -165,6 +197,9 @@ int Stat::_dump(tll_stat_iter_t * iter)
 		std::this_thread::yield();
 	}
 
+	if (_export)
+		_export->update(name, page);
+
 	auto data = stat_scheme::Page::bind(_buf);
 	_buf.resize(0);
 	_buf.resize(data.meta_size());
@@ -183,6 +218,26 @@ int Stat::_dump(tll_stat_iter_t * iter)
 		if (ptr->name().empty())
 			continue;
 		auto field = fields[size];
+		if (auto hist = tll::stat::ConstHistogramView::parse(ptr, end); hist) {
+			ptr += hist.size() - 1;
+			if (hist.count() == 0)
+				continue;
+			size++;
+			field.set_name(hist.name());
+			field.set_unit(static_cast<stat_scheme::Unit>(hist.unit()));
+			if (_log_pages)
+				r += _histogram(hist) + ", ";
+			auto h = field.get_value().set_ihist();
+			h.set_count(hist.count());
+			h.set_min(hist.min());
+			h.set_max(hist.max());
+			h.set_avg(double(hist.sum()) / hist.count());
+			h.set_p50(hist.quantile(0.5));
+			h.set_p90(hist.quantile(0.9));
+			h.set_p99(hist.quantile(0.99));
+			h.set_p999(hist.quantile(0.999));
+			continue;
+		}
 		if (ptr + 3 < end && ptr->name() == "_tllgrp") {
 			auto count = ptr;
 			auto sum = ++ptr;
@@ -194,7 +249,8 @@ int Stat::_dump(tll_stat_iter_t * iter)
 			field.set_name(sum->name());
 			field.set_unit(static_cast<stat_scheme::Unit>(sum->unit()));
 			if (sum->type() == TLL_STAT_FLOAT) {
-				r += _group(sum->name(), sum->unit(), count->value, sum->fvalue, min->fvalue, max->fvalue);
+				if (_log_pages)
+					r += _group(sum->name(), sum->unit(), count->value, sum->fvalue, min->fvalue, max->fvalue) + ", ";
 				auto group = field.get_value().set_fgroup();
 				group.set_count(count->value);
 				group.set_min(min->fvalue);
@@ -202,7 +258,8 @@ int Stat::_dump(tll_stat_iter_t * iter)
 				if (count->value)
 					group.set_avg(sum->fvalue / count->value);
 			} else {
-				r += _group(sum->name(), sum->unit(), count->value, sum->value, min->value, max->value);
+				if (_log_pages)
+					r += _group(sum->name(), sum->unit(), count->value, sum->value, min->value, max->value) + ", ";
 				auto group = field.get_value().set_igroup();
 				group.set_count(count->value);
 				group.set_min(min->value);
@@ -210,10 +267,10 @@ int Stat::_dump(tll_stat_iter_t * iter)
 				if (count->value)
 					group.set_avg(double(sum->value) / count->value);
 			}
-			r += ", ";
 			continue;
 		}
-		r += _dump(*ptr) + ", ";
+		if (_log_pages)
+			r += _dump(*ptr) + ", ";
 		auto method = ptr->method();
 		if (ptr->type() == TLL_STAT_FLOAT) {
 			if (ptr->fvalue == tll::stat::default_value<tll_stat_float_t>(method))
@@ -234,7 +291,8 @@ int Stat::_dump(tll_stat_iter_t * iter)
 	}
 	fields.resize(size);
 
-	log->info("Page {}: {}", name, r.substr(0, r.size() - 2));
+	if (_log_pages)
+		log->info("Page {}: {}", name, r.substr(0, r.size() - 2));
 	tll_msg_t msg = { TLL_MESSAGE_DATA };
 	msg.msgid = data.meta_id();
 	msg.data = data.view().data();
@@ -328,6 +386,21 @@ std::string Stat::_group(std::string_view name, tll_stat_unit_t unit, int64_t co
 	}
 }
 
+std::string Stat::_histogram(const tll::stat::ConstHistogramView &hist)
+{
+	auto r = _group(hist.name(), hist.unit(), hist.count(), hist.sum(), hist.min(), hist.max());
+	auto p50 = hist.quantile(0.5), p99 = hist.quantile(0.99), p999 = hist.quantile(0.999);
+
+	switch (hist.unit()) {
+	case tll::stat::Bytes:
+		return fmt::format("{} p50/p99/p999: {}/{}/{}", r, shorten_bytes(p50), shorten_bytes(p99), shorten_bytes(p999));
+	case tll::stat::Ns:
+		return fmt::format("{} p50/p99/p999: {:.3f}us/{:.3f}us/{:.3f}us", r, p50 / 1000., p99 / 1000., p999 / 1000.);
+	default:
+		return fmt::format("{} p50/p99/p999: {}/{}/{}", r, p50, p99, p999);
+	}
+}
+
 TLL_DEFINE_IMPL(tll::channel::RUsage);
 TLL_DEFINE_IMPL(Quantile);
 TLL_DEFINE_IMPL(Stat);
@@ -20,6 +20,7 @@
 namespace tll::processor::_ {
 
 struct Worker;
+struct Move;
 
 enum class Shutdown { Close, Error, None };
 
@@ -39,12 +40,22 @@ struct Object
 	tll::channel::ReopenData reopen;
 
 	Shutdown shutdown = Shutdown::None;
+
+	tll::duration init_time = {}; //< Time spent in channel init
+	tll::duration open_time = {}; //< Time between last Activate request and Active state
+	tll::time_point activate_ts = {};
 	Worker * worker = nullptr;
 
 	std::vector<Object *> depends;
 	std::vector<Object *> rdepends;
+	std::vector<Object *> links; //< Objects linked with master or tll.channel.* parameters, moved together
+
+	bool balance = false; //< Object can be moved to other worker by load balancer
+	Move * move = nullptr; //< Pending move, object is detached or being detached from worker loop
+	std::vector<int> move_deferred; //< Activate and Deactivate requests received during move
 
 	std::list<std::string> depends_names; //< Temporary storage used during initialization
+	std::list<std::string> links_names; //< Temporary storage used during initialization
 	std::string stage_name; //< Short name without processor/stage/ prefix for stage object
 
 	std::string control_active; //< Name of extended state that is considered as Active
@@ -8,6 +8,7 @@
 #include "tll/channel.h"
 #include "tll/logger.h"
 #include "tll/processor.h"
+#include "tll/processor/scheme.h"
 #include "tll/stat.h"
 #include "tll/util/argparse.h"
 #include "tll/version.h"
@@ -20,12 +21,18 @@
 #include <list>
 
 static std::atomic<int> counter = {};
+static std::atomic<int> dump_counter = {};
 
 static void handler(int, siginfo_t *sig, void *)
 {
 	counter += 1;
 }
 
+static void dump_handler(int, siginfo_t *sig, void *)
+{
+	dump_counter += 1;
+}
+
 int main(int argc, char *argv[])
 {
 	tll::util::ArgumentParser parser("config [-Dkey=value]");
@@ -132,6 +139,9 @@ int main(int argc, char *argv[])
 	sigaction(SIGINT, &sa, nullptr);
 	sigaction(SIGTERM, &sa, nullptr);
 
+	sa.sa_sigaction = dump_handler;
+	sigaction(SIGUSR1, &sa, nullptr);
+
 	for (auto & w : proc->workers())
 		threads.push_back(
 			std::thread([](auto ptr) {
@@ -149,6 +159,16 @@ int main(int argc, char *argv[])
 	while (!loop->stop) {
 		using namespace std::chrono_literals;
 		loop->step(100ms);
+		if (dump_counter) {
+			dump_counter = 0;
+			std::vector<char> buf;
+			auto data = processor_scheme::RecorderDump::bind_reset(buf);
+			tll_msg_t msg = { TLL_MESSAGE_DATA };
+			msg.msgid = data.meta_id();
+			msg.data = data.view().data();
+			msg.size = data.view().size();
+			proc->post(&msg);
+		}
 		if (counter) {
 			counter = 0;
 			if (proc->state() == tll::state::Opening || proc->state() == tll::state::Active) {
@@ -14,7 +14,9 @@
 #include "tll/util/result.h"
 
 #include <fmt/chrono.h>
+#include <atomic>
 #include <set>
+#include <thread>
 
 #include "tll/keyring.h"
 #include "tll/scheme/channel/timer.h"
@@ -145,6 +147,18 @@ int Processor::_init(const tll::Channel::Url &url, Channel * master)
 	_stat_usage.init(fmt::format("{}/rusage", name));
 	tll_stat_list_add(context().stat_list(), &_stat_usage);
 
+	if (_alloc_count.init())
+		_log.info("Counting allocator found, report allocations in stat");
+
+	auto reader = make_props_reader(_cfg);
+	_balance.enable = reader.getT("balance.enable", false);
+	_balance.interval = reader.getT("balance.interval", _balance.interval);
+	_balance.threshold = reader.getT("balance.threshold", _balance.threshold);
+	if (!reader)
+		return _log.fail(EINVAL, "Invalid balance parameters: {}", reader.error());
+	if (_balance.enable)
+		_log.info("Worker load balancing enabled, interval {}, threshold {}%", _balance.interval, _balance.threshold * 100);
+
 	_log.debug("Processor initialized");
 	return 0;
 }
@@ -156,6 +170,8 @@ int Processor::_open(const tll::ConstConfig &)
 	config_info().set_ptr("exit-code", &_exit_code);
 	config_info().set_ptr("rusage.cpu", &_rusage.cpu_ratio);
 	config_info().set_ptr("rusage.memory", &_rusage.memory);
+	if (_alloc_count)
+		config_info().set_ptr("rusage.heap", &_alloc_count.bytes);
 	if (_ipc->open())
 		return _log.fail(EINVAL, "Failed to open IPC channel");
 	if (_timer->open())
@@ -198,25 +214,73 @@ Worker * Processor::init_worker(std::string_view name)
 	return w;
 }
 
+Worker * Processor::init_prepare(PreObject &obj)
+{
+	auto w = init_worker(obj.worker);
+	if (!w)
+		return _log.fail(nullptr, "Failed to init worker {} for object {}", obj.worker, obj.name);
+
+	if (!obj.url.has("fd") && !w->loop.poll_enable())
+		obj.url.set("fd", "no");
+	return w;
+}
+
+int Processor::init_channel(PreObject &obj)
+{
+	auto start = tll::time::now();
+	obj.channel = context().channel(obj.url);
+	obj.init_time = tll::time::now() - start;
+	if (!obj.channel)
+		return _log.fail(EINVAL, "Failed to create channel {}", conv::to_string(obj.url));
+	return 0;
+}
+
+int Processor::init_parallel(std::vector<PreObject *> &list, unsigned threads)
+{
+	for (auto o : list) {
+		if (!init_prepare(*o))
+			return EINVAL;
+	}
+
+	threads = std::min<unsigned>(threads, list.size());
+	_log.debug("Init {} objects in {} threads", list.size(), threads);
+
+	std::atomic<size_t> index = 0;
+	std::atomic<bool> failed = false;
+	auto run = [&]() {
+		for (size_t i = index++; i < list.size(); i = index++) {
+			if (init_channel(*list[i]))
+				failed = true;
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (auto i = 1u; i < threads; i++)
+		pool.emplace_back(run);
+	run();
+	for (auto & t : pool)
+		t.join();
+	return failed ? EINVAL : 0;
+}
+
 int Processor::init_one(PreObject &obj)
 {
 	auto & name = obj.name;
 	auto log = _log.prefix("{} {}:", "object", std::string_view(name)); // TODO: name is moved and left empty without std::string_view wrapper
 	log.debug("Init");
 
-	auto w = init_worker(obj.worker);
+	auto w = init_prepare(obj);
 	if (!w)
 		return log.fail(EINVAL, "Failed to init worker {}", obj.worker);
 
-	if (!obj.url.has("fd") && !w->loop.poll_enable())
-		obj.url.set("fd", "no");
+	if (!obj.channel && init_channel(obj))
+		return log.fail(EINVAL, "Failed to create channel");
+	log.debug("Channel created in {}", std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(obj.init_time));
 
-	auto channel = context().channel(obj.url);
-	if (!channel)
-		return log.fail(EINVAL, "Failed to create channel {}", conv::to_string(obj.url));
-	_objects.emplace_back(std::move(channel));
+	_objects.emplace_back(std::move(obj.channel));
 	auto o = &_objects.back();
 	o->worker = w;
+	o->init_time = obj.init_time;
 
 	auto open = obj.config.sub("open");
 	if (open) {
@@ -227,6 +291,8 @@ int Processor::init_one(PreObject &obj)
 	}
 
 	o->depends_names = {obj.depends_open.list.begin(), obj.depends_open.list.end()};
+	o->links_names = {obj.depends_init.list.begin(), obj.depends_init.list.end()};
+	o->balance = obj.balance;
 	if (o->init(obj.url))
 		return log.fail(EINVAL, "Failed to init extra parameters");
 	return 0;
@@ -241,6 +307,7 @@ std::optional<Processor::PreObject> Processor::init_pre(std::string_view extname
 	auto reader = make_props_reader(cfg);
 	auto enable = reader.getT("enable", true);
 	enable = !reader.getT("disable", !enable);
+	auto balance = reader.getT("balance", false);
 	if (!reader)
 		return log.fail(std::nullopt, "Invalid disable parameters: {}", reader.error());
 	if (!enable) {
@@ -273,6 +340,7 @@ std::optional<Processor::PreObject> Processor::init_pre(std::string_view extname
 		.config = cfg,
 		.name = name,
 		.worker = std::string(cfg.get("worker").value_or("default")),
+		.balance = balance,
 	};
 
 	auto deps = cfg.get("depends");
@@ -408,9 +476,29 @@ int Processor::init_depends()
 	}
 	_log.debug("Init order: {}", order);
 
-	for (auto & n : order) {
-		if (init_one(objects[std::string(n)]))
+	auto reader = make_props_reader(_cfg);
+	auto threads = reader.getT("init-threads", 1u);
+	if (!reader)
+		return _log.fail(EINVAL, "Invalid processor parameters: {}", reader.error());
+
+	auto it = order.begin();
+	for (auto i = 0; i < max_depth + 1; i++) {
+		std::vector<PreObject *> level;
+		for (; it != order.end(); it++) {
+			auto & o = objects[std::string(*it)];
+			if (o.depends_init.depth != i)
+				break;
+			level.push_back(&o);
+		}
+
+		// Objects on the same depth do not depend on each other and can be created concurrently
+		if (threads > 1 && level.size() > 1 && init_parallel(level, threads))
 			return EINVAL;
+
+		for (auto o : level) {
+			if (init_one(*o))
+				return EINVAL;
+		}
 	}
 	return 0;
 }
@@ -443,6 +531,16 @@ int Processor::build_rdepends()
 			o.depends.push_back(d);
 			d->rdepends.push_back(&o);
 		}
+
+		for (auto & n : o.links_names) {
+			auto d = find(n);
+			if (!d)
+				return _log.fail(EINVAL, "Unknown linked object for {}: '{}'", o.name(), n);
+			if (std::find(o.links.begin(), o.links.end(), d) == o.links.end())
+				o.links.push_back(d);
+			if (std::find(d->links.begin(), d->links.end(), &o) == d->links.end())
+				d->links.push_back(&o);
+		}
 	}
 	for (auto & o : _objects) {
 		_log.debug("Object {}, depends [{}], rdepends [{}]", o->name(), o.depends, o.rdepends);
@@ -454,6 +552,8 @@ int Processor::build_rdepends()
 			cfg->set("depends", tll::conv::to_string(o.depends));
 		if (o.rdepends.size())
 			cfg->set("rdepends", tll::conv::to_string(o.rdepends));
+		if (!o.stage)
+			cfg->setT("init-time", o.init_time);
 	}
 	return 0;
 }
@@ -602,12 +702,19 @@ int Processor::cb(const Channel * c, const tll_msg_t * msg)
 		_report_state(o, data->state, {});
 		break;
 	}
+	case scheme::Detach::id: {
+		auto data = (const scheme::Detach *) msg->data;
+		move_detached(data->obj, data->code);
+		break;
+	}
 	case scheme::WorkerState::id: {
 		auto data = (const scheme::WorkerState *) msg->data;
 		_log.info("Worker {} state {}", data->worker->name, tll_state_str(data->state));
 		data->worker->proc.state = data->state;
 		data->worker->proc.addr = msg->addr;
 		if (data->state == state::Closed) {
+			// Closed worker does not reply to detach requests
+			move_cancel(data->worker);
 			//if (state() != state::Closing)
 			//	return 0;
 			if (!std::all_of(_workers.begin(), _workers.end(), [](auto & w) { return w.second->proc.state == state::Closed; }))
@@ -666,12 +773,210 @@ int Processor::cb(const Channel * c, const tll_msg_t * msg)
 		deactivate(obj);
 		break;
 	}
+	case processor_scheme::ChannelMove::meta_id():
+		return channel_move(msg);
+	case processor_scheme::RecorderDump::meta_id():
+		return recorder_dump(msg);
 	default:
 		_log.debug("Unknown message {}", msg->msgid);
 	}
 	return 0;
 }
 
+int Processor::_post(const tll_msg_t * msg, int flags)
+{
+	if (msg->type != TLL_MESSAGE_DATA)
+		return ENOSYS;
+	if (msg->msgid == processor_scheme::RecorderDump::meta_id())
+		return recorder_dump(msg);
+	if (msg->msgid == processor_scheme::ChannelMove::meta_id())
+		return channel_move(msg);
+	return ENOSYS;
+}
+
+int Processor::recorder_dump(const tll_msg_t * msg)
+{
+	auto data = processor_scheme::RecorderDump::bind(*msg);
+	if (msg->size < data.meta_size())
+		return _log.fail(EMSGSIZE, "Invalid message size: {} < min {}", msg->size, data.meta_size());
+	auto name = data.get_worker();
+	if (name.empty())
+		loop.recorder_dump("user request");
+
+	for (auto & [n, w] : _workers) {
+		if (name.size() && n != name)
+			continue;
+		tll_msg_t m = *msg;
+		m.addr = w->proc.addr;
+		_ipc->post(&m);
+	}
+	return 0;
+}
+
+int Processor::channel_move(const tll_msg_t * msg)
+{
+	auto data = processor_scheme::ChannelMove::bind(*msg);
+	if (msg->size < data.meta_size())
+		return _log.fail(EMSGSIZE, "Invalid message size: {} < min {}", msg->size, data.meta_size());
+	auto name = data.get_channel();
+	auto obj = find(name);
+	if (!obj)
+		return _log.fail(ENOENT, "Object '{}' not found", name);
+	auto it = _workers.find(data.get_worker());
+	if (it == _workers.end())
+		return _log.fail(ENOENT, "Worker '{}' not found", data.get_worker());
+	return move(obj, it->second);
+}
+
+int Processor::move(Object * obj, Worker * worker)
+{
+	if (obj->worker == worker)
+		return 0;
+	if (state() != state::Active)
+		return _log.fail(EINVAL, "Can not move object {}: processor is not active", obj->name());
+	if (obj->worker->proc.state != state::Active || worker->proc.state != state::Active)
+		return _log.fail(EINVAL, "Can not move object {}: worker is not active", obj->name());
+
+	// Linked objects share data without locking and can not be processed in different threads
+	Move move = { .objects = { obj }, .from = obj->worker, .to = worker };
+	for (size_t i = 0; i < move.objects.size(); i++) {
+		for (auto l : move.objects[i]->links) {
+			if (l->worker != move.from)
+				continue;
+			if (std::find(move.objects.begin(), move.objects.end(), l) == move.objects.end())
+				move.objects.push_back(l);
+		}
+	}
+
+	for (auto o : move.objects) {
+		if (o->move)
+			return _log.fail(EBUSY, "Can not move object {}: object {} is already moving", obj->name(), o->name());
+		if (o->stage)
+			return _log.fail(EINVAL, "Can not move object {}: linked to stage object {}", obj->name(), o->name());
+	}
+
+	_log.info("Move objects {} from worker {} to {}", move.objects, move.from->name, move.to->name);
+	auto ptr = &_moves.emplace_back(std::move(move));
+	ptr->pending = ptr->objects.size();
+	for (auto o : ptr->objects) {
+		o->move = ptr;
+		post(o, scheme::Detach { o });
+	}
+	return 0;
+}
+
+void Processor::move_detached(Object * obj, int code)
+{
+	auto move = obj->move;
+	if (!move)
+		return;
+	if (code) {
+		_log.error("Failed to detach object {} from worker {}: {}", obj->name(), move->from->name, strerror(code));
+		move->error = code;
+	} else {
+		_log.debug("Object {} detached from worker {}", obj->name(), move->from->name);
+		move->detached.push_back(obj);
+	}
+	if (--move->pending)
+		return;
+	move_finish(move);
+}
+
+void Processor::move_finish(Move * move)
+{
+	if (!move->error && move->to->proc.state != state::Active) {
+		_log.error("Target worker {} is not active", move->to->name);
+		move->error = EINVAL;
+	}
+
+	// Detached objects are not processed by any worker now, on failure return them back
+	auto worker = move->error ? move->from : move->to;
+	for (auto o : move->detached) {
+		o->worker = worker;
+		post(o, scheme::Attach { o });
+	}
+
+	for (auto o : move->objects) {
+		o->move = nullptr;
+		for (auto id : std::exchange(o->move_deferred, {})) {
+			if (id == scheme::Activate::id)
+				post(o, scheme::Activate { o });
+			else
+				post(o, scheme::Deactivate { o });
+		}
+	}
+
+	if (move->error)
+		_log.error("Failed to move objects {} to worker {}, leave them in worker {}", move->objects, move->to->name, move->from->name);
+	else {
+		_log.info("Objects {} moved to worker {}", move->objects, move->to->name);
+		for (auto o : move->objects) {
+			if (auto cfg = _config.sub("objects", true)->sub(o->name(), true); cfg)
+				cfg->set("worker", move->to->name);
+		}
+	}
+
+	for (auto it = _moves.begin(); it != _moves.end(); it++) {
+		if (&*it == move) {
+			_moves.erase(it);
+			break;
+		}
+	}
+}
+
+void Processor::move_cancel(const Worker * worker)
+{
+	for (auto it = _moves.begin(); it != _moves.end();) {
+		auto move = &*it++;
+		if (worker && move->from != worker && move->to != worker)
+			continue;
+		_log.info("Cancel move of objects {} to worker {}", move->objects, move->to->name);
+		move->error = ECANCELED;
+		// Alive source worker still replies, move is finished when all replies are received
+		if (!worker || move->from == worker)
+			move_finish(move);
+	}
+}
+
+void Processor::balance()
+{
+	auto now = tll::time::now();
+	if (_balance.last != tll::time_point {} && now - _balance.last < _balance.interval)
+		return;
+	auto first = _balance.last == tll::time_point {};
+	auto dt = now - _balance.last;
+	_balance.last = now;
+
+	Worker * hot = nullptr;
+	Worker * cold = nullptr;
+	for (auto & [_, w] : _workers) {
+		auto cpu = w->cpu_time();
+		w->balance.load = first ? 0 : std::chrono::duration<double>(cpu - w->balance.cpu) / dt;
+		w->balance.cpu = cpu;
+		// Spinning worker is always busy, its load does not reflect amount of work
+		if (!w->loop.poll_enable() || w->proc.state != state::Active || cpu == tll::duration {})
+			continue;
+		if (!hot || w->balance.load > hot->balance.load)
+			hot = w;
+		if (!cold || w->balance.load < cold->balance.load)
+			cold = w;
+	}
+
+	if (first || hot == cold || hot->balance.load < _balance.threshold || cold->balance.load > hot->balance.load / 2)
+		return;
+	if (!_moves.empty())
+		return;
+
+	for (auto & o : _objects) {
+		if (o.worker != hot || !o.balance || o.stage)
+			continue;
+		_log.info("Worker {} load {:.0f}%, move object {} to worker {} with load {:.0f}%",
+			hot->name, hot->balance.load * 100, o.name(), cold->name, cold->balance.load * 100);
+		if (!move(&o, cold))
+			return;
+	}
+}
+
 void Processor::update(Object *o, tll_state_t s)
 {
 	_log.debug("Update channel {} state {}", o->name(), tll_state_str(s));
@@ -700,6 +1005,17 @@ void Processor::update(Object *o, tll_state_t s)
 			pending_add(o->reopen.next, o);
 		break;
 	case state::Active:
+		if (o->activate_ts != tll::time_point {}) {
+			o->open_time = tll::time::now() - o->activate_ts;
+			o->activate_ts = {};
+			_log.info("Object {} opened in {}", o->name(), std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(o->open_time));
+			if (auto cfg = _config.sub("objects", true)->sub(o->name(), true); cfg)
+				cfg->setT("open-time", o->open_time);
+			if (auto page = _stat_usage.acquire(); page) {
+				page->open.update(o->open_time.count());
+				_stat_usage.release(page);
+			}
+		}
 		for (auto & d : o->rdepends) {
 			if (d->ready_open()) {
 				activate(*d);
@@ -747,8 +1063,12 @@ void Processor::activate(Object &o)
 	o.decay = false;
 	o.opening = true;
 	o.reopen.next = {};
+	o.activate_ts = tll::time::now();
 	o.mark_subtree_open();
-	post(&o, scheme::Activate { &o });
+	if (o.move)
+		o.move_deferred.push_back(scheme::Activate::id);
+	else
+		post(&o, scheme::Activate { &o });
 }
 
 void Processor::deactivate(Object *o, std::string_view msg, bool failure)
@@ -760,7 +1080,10 @@ void Processor::deactivate(Object *o, std::string_view msg, bool failure)
 		o->reopen.active_ts = {};
 	if (o->state != state::Closing)
 		o->closing = true;
-	post<scheme::Deactivate>(o, { o });
+	if (o->move)
+		o->move_deferred.push_back(scheme::Deactivate::id);
+	else
+		post<scheme::Deactivate>(o, { o });
 }
 
 void Processor::reactivate(Object *o)
@@ -796,6 +1119,8 @@ int Processor::_close(bool force)
 	config_info().setT("exit-code", _exit_code);
 	config_info().setT("rusage.cpu", _rusage.cpu_ratio);
 	config_info().setT("rusage.memory", _rusage.memory);
+	if (_alloc_count)
+		config_info().setT("rusage.heap", _alloc_count.bytes);
 	for (auto & o : _objects) {
 		_log.debug("Force decay of object {}", o.name());
 		o.decay = true;
@@ -807,6 +1132,8 @@ int Processor::_close(bool force)
 
 	if (!force) return 0;
 
+	move_cancel();
+
 	_log.info("Close objects");
 	for (auto c = _objects.rbegin(); c != _objects.rend(); c++)
 		(*c)->close();
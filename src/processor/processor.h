@@ -13,6 +13,7 @@
 #include "tll/processor.h"
 #include "tll/processor/loop.h"
 #include "tll/logger.h"
+#include "tll/util/alloccount.h"
 #include "tll/util/rusage.h"
 
 #include "processor/deps.h"
@@ -21,9 +22,21 @@
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
 
 namespace tll::processor::_ {
 
+/// Group of linked objects that are moved from one worker to another
+struct Move
+{
+	std::vector<Object *> objects;
+	Worker * from = nullptr;
+	Worker * to = nullptr;
+	unsigned pending = 0; //< Number of objects without detach reply from source worker
+	std::vector<Object *> detached; //< Objects that are detached from source worker
+	int error = 0; //< Move failed, detached objects are returned to source worker
+};
+
 struct Processor : public tll::channel::Base<Processor>
 {
 	using Base = tll::channel::Base<Processor>;
@@ -43,6 +56,10 @@ struct Processor : public tll::channel::Base<Processor>
 		std::set<std::string> channels;
 
 		bool disabled = false;
+		bool balance = false;
+
+		std::unique_ptr<tll::Channel> channel; //< Channel created in parallel init stage
+		tll::duration init_time = {};
 
 		struct depends_t {
 			std::set<std::string> list;
@@ -67,6 +84,15 @@ struct Processor : public tll::channel::Base<Processor>
 
 	std::set<Object *> _pending_reactivate;
 
+	std::list<Move> _moves;
+
+	struct {
+		bool enable = false;
+		tll::duration interval = std::chrono::seconds(10);
+		double threshold = 0.8;
+		tll::time_point last = {};
+	} _balance;
+
 	tll_channel_t context_channel = {};
 	tll_channel_internal_t context_internal = { TLL_STATE_CLOSED };
 
@@ -86,10 +112,15 @@ struct Processor : public tll::channel::Base<Processor>
 		tll::stat::Integer<tll::stat::Max, tll::stat::Bytes, 'm', 'e', 'm'> mem;
 		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 's', 't', 'a', 't', 'e'> state;
 		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'e', 'r', 'r', 'o', 'r'> error;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'a', 'l', 'l', 'o', 'c'> alloc;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'f', 'r', 'e', 'e'> free;
+		tll::stat::Integer<tll::stat::Max, tll::stat::Bytes, 'h', 'e', 'a', 'p'> heap;
+		tll::stat::Integer<tll::stat::Max, tll::stat::Ns, 'o', 'p', 'e', 'n'> open;
 	};
 
 	tll::stat::Block<StatUsage> _stat_usage = { "processor/rusage" };
 	tll::util::RUsage _rusage { tll::util::RUsage::Process };
+	tll::util::AllocCount _alloc_count;
 
 	~Processor()
 	{
@@ -99,6 +130,9 @@ struct Processor : public tll::channel::Base<Processor>
 
 	int parse_deps(Object &obj, const Config &cfg);
 
+	Worker * init_prepare(PreObject &obj);
+	int init_channel(PreObject &obj);
+	int init_parallel(std::vector<PreObject *> &list, unsigned threads);
 	int init_one(PreObject &obj);
 	int init_depends();
 	int init_stages();
@@ -113,6 +147,13 @@ struct Processor : public tll::channel::Base<Processor>
 
 	int build_rdepends();
 
+	int move(Object * obj, Worker * worker);
+	void move_detached(Object * obj, int code);
+	void move_finish(Move * move);
+	/// Finish pending moves from or to the worker (or all moves) as failed
+	void move_cancel(const Worker * worker = nullptr);
+	void balance();
+
 	int _init(const tll::Channel::Url &, tll::Channel *);
 	int _open(const tll::ConstConfig &);
 	int _close(bool force);
@@ -142,6 +183,9 @@ struct Processor : public tll::channel::Base<Processor>
 
 	friend struct tll::CallbackT<Processor>;
 	int cb(const Channel * c, const tll_msg_t * msg);
+	int _post(const tll_msg_t * msg, int flags);
+	int recorder_dump(const tll_msg_t * msg);
+	int channel_move(const tll_msg_t * msg);
 
 	using Base::post;
 
@@ -177,11 +221,19 @@ struct Processor : public tll::channel::Base<Processor>
 
 	int _on_timer_stat(const tll::Channel *, const tll_msg_t *msg)
 	{
+		if (_balance.enable && state() == tll::state::Active)
+			balance();
 		_rusage.update();
+		_alloc_count.update();
 		if (auto page = _stat_usage.acquire(); page) {
 			page->cpu = _rusage.cpu_ratio * 100;
 			page->cpuns = _rusage.cpu.count();
 			page->mem = _rusage.memory;
+			if (_alloc_count) {
+				page->alloc = _alloc_count.alloc;
+				page->free = _alloc_count.free;
+				page->heap = _alloc_count.bytes;
+			}
 			_stat_usage.release(page);
 		}
 		return 0;
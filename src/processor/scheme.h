@@ -50,6 +50,21 @@ struct Deactivate
 	tll::processor::_::Object * obj;
 };
 
+/// Detach object from worker loop, worker always replies with same message and result code
+struct Detach
+{
+	static constexpr int id = 7;
+	tll::processor::_::Object * obj;
+	int code = 0;
+};
+
+/// Attach object to worker loop
+struct Attach
+{
+	static constexpr int id = 8;
+	tll::processor::_::Object * obj;
+};
+
 } // namespace tll::processor
 
 #endif//_PROCESSOR_SCHEME_H
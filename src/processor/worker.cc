@@ -12,6 +12,7 @@
 #include "tll/processor/scheme.h"
 
 #ifdef __linux__
+#include <pthread.h>
 #include <sched.h>
 #endif
 
@@ -76,6 +77,10 @@ int Worker::_open(const ConstConfig &)
 	if (_setaffinity())
 		return EINVAL;
 
+#ifdef __linux__
+	_cpu_clock_valid = pthread_getcpuclockid(pthread_self(), &_cpu_clock) == 0;
+#endif
+
 	loop.stop = false;
 	if (loop.time_cache_enable)
 		tll::time::cache_enable(true);
@@ -102,6 +107,29 @@ int Worker::_close()
 	return 0;
 }
 
+int Worker::_detach(Object * obj)
+{
+	if (state() != tll::state::Active)
+		return _log.fail(EINVAL, "Worker is not active, can not detach object {}", obj->name());
+	auto it = std::find(objects.begin(), objects.end(), obj);
+	if (it == objects.end())
+		return _log.fail(ENOENT, "Object {} is not in this worker, can not detach", obj->name());
+	_log.info("Detach object {}", obj->name());
+	objects.erase(it);
+	_child_del(obj->channel.get());
+	return 0;
+}
+
+tll::duration Worker::cpu_time() const
+{
+	if (!_cpu_clock_valid)
+		return {};
+	timespec ts = {};
+	if (clock_gettime(_cpu_clock, &ts))
+		return {};
+	return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
 int Worker::_setaffinity()
 {
 	if (_cpuset == 0)
@@ -125,6 +153,11 @@ int Worker::_setaffinity()
 int Worker::callback(const Channel * c, const tll_msg_t * msg)
 {
 	if (msg->type != TLL_MESSAGE_DATA) return 0;
+	if (msg->msgid == scheme::Detach::id) {
+		// Processor waits for reply even if object can not be detached
+		auto data = (const scheme::Detach *) msg->data;
+		return post(scheme::Detach { data->obj, _detach(data->obj) });
+	}
 	if (state() != tll::state::Active)
 		return 0;
 	switch (msg->msgid) {
@@ -144,12 +177,22 @@ int Worker::callback(const Channel * c, const tll_msg_t * msg)
 		channel->close(force);
 		break;
 	}
+	case scheme::Attach::id: {
+		auto data = (const scheme::Attach *) msg->data;
+		_log.info("Attach object {}", data->obj->name());
+		objects.push_back(data->obj);
+		_child_add(data->obj->channel.get());
+		break;
+	}
 	case scheme::Exit::id: {
 		close();
 		break;
 	}
 	case processor_scheme::StateUpdate::meta_id():
 		break;
+	case processor_scheme::RecorderDump::meta_id():
+		loop.recorder_dump("user request");
+		break;
 	case processor_scheme::MessageForward::meta_id(): {
 		auto data = processor_scheme::MessageForward::bind(*msg);
 		if (msg->size < data.meta_size())
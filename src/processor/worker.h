@@ -10,6 +10,8 @@
 
 #include <string_view>
 
+#include <time.h>
+
 #include "processor/deps.h"
 #include "tll/channel/base.h"
 #include "tll/processor/loop.h"
@@ -32,9 +34,13 @@ struct Worker : public tll::channel::Base<Worker>
 	struct StatType
 	{
 		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 's', 't', 'e', 'p'> step;
-		tll::stat::Integer<tll::stat::Sum, tll::stat::Ns, 'p', 'o', 'l', 'l'> poll;
+		tll::stat::Histogram<tll::stat::Ns, 'p', 'o', 'l', 'l'> poll;
 		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 's', 't', 'a', 't', 'e'> state;
 		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'e', 'r', 'r', 'o', 'r'> error;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'b', 'u', 's', 'y'> busy;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'p', 'e', 'n', 'd', 'i', 'n', 'g'> pending;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'n', 'o', 'f', 'd'> nofd;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'i', 'd', 'l', 'e'> idle;
 	};
 
 	std::optional<tll::stat::Block<StatType>> _stat;
@@ -52,6 +58,17 @@ struct Worker : public tll::channel::Base<Worker>
 
 	unsigned long long _cpuset;
 
+	bool _cpu_clock_valid = false;
+	clockid_t _cpu_clock = {}; //< CPU time clock of worker thread, captured on open
+
+	struct {
+		tll::duration cpu = {};
+		double load = 0;
+	} balance; //< Load accounting, used only by processor thread
+
+	/// CPU time used by worker thread, zero if not supported
+	tll::duration cpu_time() const;
+
 	int _init(const tll::Channel::Url &url, tll::Channel *master);
 	int _open(const tll::ConstConfig &);
 	int _close();
@@ -74,6 +91,8 @@ struct Worker : public tll::channel::Base<Worker>
 	int callback(const Channel * c, const tll_msg_t * msg);
 
 	int _setaffinity();
+	/// Remove object from worker loop, it is attached to other worker by processor
+	int _detach(Object * obj);
 };
 
 } // namespace tll
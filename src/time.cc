@@ -7,14 +7,216 @@
 
 #include "tll/util/time.h"
 
+#include <errno.h>
 #include <sys/time.h>
 #include <time.h>
 
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define TLL_TIME_WITH_TSC 1
+#endif
+
+namespace {
+
+long long clock_ns(clockid_t clock)
+{
+	timespec ts = {};
+	clock_gettime(clock, &ts);
+	return 1000000000ll * ts.tv_sec + ts.tv_nsec;
+}
+
+#ifdef TLL_TIME_WITH_TSC
+/**
+ * TSC clock calibrated against CLOCK_REALTIME
+ *
+ * Clock is piecewise linear function of TSC anchored to (TSC, time) pair. Anchor is moved by the
+ * first thread that notices that it is older then one second: rate is measured over interval
+ * between realtime samples and new anchor starts from the value that old one gives at the same
+ * point, difference with realtime is slewed over next interval by adjusting the scale. So values
+ * do not jump when anchor is moved and clock follows slow realtime adjustments. Only realtime steps
+ * larger then slew limit are followed immediately. Readers use sequence lock and never block.
+ *
+ * First realtime sample is taken at library load, so initial rate estimate usually does not
+ * need to wait.
+ */
+struct tsc_clock_t
+{
+	static constexpr long long recalibrate_ns = 1000000000;
+	static constexpr long long initial_ns = 10000000;
+	static constexpr long long slew_max_ns = 10000000; ///< Larger offsets are treated as realtime step
+	static constexpr unsigned sample_tries = 8;
+
+	std::atomic<unsigned> seq = 0;
+	std::atomic<long long> base_tsc = 0;
+	std::atomic<long long> base_ns = 0;
+	std::atomic<long long> period = 0; ///< Cycles between recalibrations
+	std::atomic<double> scale = 0; ///< Nanoseconds per cycle, includes slew correction
+	std::atomic<double> rate = 0; ///< Measured nanoseconds per cycle, used for interval conversion
+	std::atomic_flag lock = ATOMIC_FLAG_INIT;
+
+	// Fields below are protected by lock
+	bool coarse = true; ///< Rate is estimated over initial short interval
+	long long ref_tsc = 0; ///< Last realtime sample
+	long long ref_ns = 0;
+
+	const bool invariant_tsc = invariant();
+
+	tsc_clock_t()
+	{
+		if (invariant_tsc)
+			ref_tsc = sample(ref_ns);
+	}
+
+	static long long rdtsc() { return __builtin_ia32_rdtsc(); }
+
+	static bool invariant()
+	{
+		unsigned eax, ebx, ecx, edx;
+		if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+			return false;
+		return edx & (1u << 8);
+	}
+
+	/**
+	 * Get TSC and realtime pair, TSC is taken in the middle of clock_gettime call
+	 *
+	 * Several pairs are taken and one with shortest call is used, so preemption or interrupt in
+	 * the middle of the call does not skew calibration.
+	 */
+	static long long sample(long long &ns)
+	{
+		long long r = 0, width = -1;
+		for (unsigned i = 0; i < sample_tries; i++) {
+			auto t0 = rdtsc();
+			auto v = clock_ns(CLOCK_REALTIME);
+			auto t1 = rdtsc();
+			if (width < 0 || t1 - t0 < width) {
+				width = t1 - t0;
+				r = t0 + (t1 - t0) / 2;
+				ns = v;
+			}
+		}
+		return r;
+	}
+
+	void store(long long tsc, long long ns, double k, double r)
+	{
+		seq.fetch_add(1, std::memory_order_acq_rel);
+		std::atomic_thread_fence(std::memory_order_release);
+		base_tsc.store(tsc, std::memory_order_relaxed);
+		base_ns.store(ns, std::memory_order_relaxed);
+		scale.store(k, std::memory_order_relaxed);
+		rate.store(r, std::memory_order_relaxed);
+		period.store(recalibrate_ns / r, std::memory_order_relaxed);
+		seq.fetch_add(1, std::memory_order_release);
+	}
+
+	/// Initial calibration against sample taken at load, wait only if it was less then 10ms ago
+	void calibrate()
+	{
+		while (lock.test_and_set(std::memory_order_acquire)) {}
+		if (scale.load(std::memory_order_relaxed) == 0) {
+			long long ns;
+			auto tsc = ref_tsc;
+			do {
+				tsc = sample(ns);
+			} while (ns - ref_ns < initial_ns || tsc == ref_tsc);
+			auto k = double(ns - ref_ns) / (tsc - ref_tsc);
+			ref_tsc = tsc;
+			ref_ns = ns;
+			store(tsc, ns, k, k);
+		}
+		lock.clear(std::memory_order_release);
+	}
+
+	/// Move anchor to current time, return false if other thread is updating or already moved it
+	bool recalibrate(long long btsc, long long bns, double k)
+	{
+		if (lock.test_and_set(std::memory_order_acquire))
+			return false;
+		if (base_tsc.load(std::memory_order_relaxed) != btsc) {
+			lock.clear(std::memory_order_release);
+			return false;
+		}
+		const auto rold = rate.load(std::memory_order_relaxed);
+		long long ns;
+		auto tsc = sample(ns);
+		auto rnew = double(ns - ref_ns) / (tsc - ref_tsc);
+		// Realtime clock was stepped, keep old rate
+		const double tolerance = coarse ? 0.1 : 0.01;
+		if (rnew < rold * (1 - tolerance) || rnew > rold * (1 + tolerance))
+			rnew = rold;
+		else
+			coarse = false;
+		ref_tsc = tsc;
+		ref_ns = ns;
+
+		// Continue from current value and reach realtime at the end of next interval
+		auto value = bns + (long long) ((tsc - btsc) * k);
+		auto offset = ns - value;
+		auto knew = rnew;
+		if (offset > slew_max_ns || offset < -slew_max_ns)
+			value = ns;
+		else
+			knew = rnew * (1 + double(offset) / recalibrate_ns);
+		store(tsc, value, knew, rnew);
+		lock.clear(std::memory_order_release);
+		return true;
+	}
+
+	long long now()
+	{
+		for (;;) {
+			auto tsc = rdtsc();
+			auto s = seq.load(std::memory_order_acquire);
+			if (s & 1)
+				continue;
+			auto btsc = base_tsc.load(std::memory_order_relaxed);
+			auto bns = base_ns.load(std::memory_order_relaxed);
+			auto k = scale.load(std::memory_order_relaxed);
+			auto p = period.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (seq.load(std::memory_order_relaxed) != s)
+				continue;
+			if (tsc - btsc > p && recalibrate(btsc, bns, k))
+				continue;
+			return bns + (long long) ((tsc - btsc) * k);
+		}
+	}
+
+	long long to_ns(long long cycles)
+	{
+		auto k = rate.load(std::memory_order_relaxed);
+		if (k == 0) {
+			calibrate();
+			k = rate.load(std::memory_order_relaxed);
+		}
+		return cycles * k;
+	}
+};
+
+tsc_clock_t tsc_clock;
+#endif
+
+std::atomic<int> clock_source = TLL_TIME_CLOCK_REALTIME;
+
+inline long long clock_now()
+{
+#ifdef TLL_TIME_WITH_TSC
+	if (clock_source.load(std::memory_order_relaxed) == TLL_TIME_CLOCK_TSC)
+		return tsc_clock.now();
+#endif
+	return clock_ns(CLOCK_REALTIME);
+}
+
+} // namespace
+
 struct cached_clock_t
 {
 	long long last = 0;
 	int enabled = 0;
-	timespec ts = {};
 
 	void enable(bool v)
 	{
@@ -27,8 +229,7 @@ struct cached_clock_t
 
 	long long now()
 	{
-		clock_gettime(CLOCK_REALTIME, &ts);
-		last = 1000000000ll * ts.tv_sec + ts.tv_nsec;
+		last = clock_now();
 		return last;
 	}
 
@@ -56,3 +257,47 @@ void tll_time_cache_enable(int enable)
 {
 	cached_clock.enable(enable);
 }
+
+int tll_time_clock_set(tll_time_clock_t clock)
+{
+	switch (clock) {
+	case TLL_TIME_CLOCK_REALTIME:
+		break;
+	case TLL_TIME_CLOCK_TSC:
+#ifdef TLL_TIME_WITH_TSC
+		if (!tsc_clock.invariant_tsc)
+			return ENOTSUP;
+		tsc_clock.calibrate();
+		break;
+#else
+		return ENOTSUP;
+#endif
+	default:
+		return EINVAL;
+	}
+	clock_source.store(clock, std::memory_order_relaxed);
+	return 0;
+}
+
+tll_time_clock_t tll_time_clock_get()
+{
+	return (tll_time_clock_t) clock_source.load(std::memory_order_relaxed);
+}
+
+long long tll_time_cycles()
+{
+#ifdef TLL_TIME_WITH_TSC
+	if (tsc_clock.invariant_tsc)
+		return tsc_clock_t::rdtsc();
+#endif
+	return clock_ns(CLOCK_MONOTONIC);
+}
+
+long long tll_time_cycles_to_ns(long long cycles)
+{
+#ifdef TLL_TIME_WITH_TSC
+	if (tsc_clock.invariant_tsc)
+		return tsc_clock.to_ns(cycles);
+#endif
+	return cycles;
+}
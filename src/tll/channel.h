@@ -263,6 +263,7 @@ typedef enum {
 	TLL_PROCESS_WRITE = 0x2, ///< Wakeup event hint, fd is ready for write
 	TLL_PROCESS_PENDING = 0x4, ///< Wakup event hint, pending process
 	TLL_PROCESS_HINT_MASK = 0x7, ///< Mask for event hints
+	TLL_PROCESS_BUSY_POLL = 0x8, ///< Channel is processed from busy polling loop, without sleep in poll
 } tll_channel_process_flag_t;
 
 int tll_channel_process(tll_channel_t *c, long flags, int reserved);
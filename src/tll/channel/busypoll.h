@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#ifndef _TLL_CHANNEL_BUSYPOLL_H
+#define _TLL_CHANNEL_BUSYPOLL_H
+
+#include "tll/channel/base.h"
+#include "tll/logger.h"
+#include "tll/stat.h"
+#include "tll/util/sockaddr.h"
+#include "tll/util/time.h"
+
+#include <chrono>
+
+#ifdef __linux__
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+#endif
+
+namespace tll::channel {
+
+/**
+ * Low latency receive options for network sockets
+ *
+ * Busy polling makes kernel poll device queue (NAPI context) from recv or poll call instead of
+ * waiting for interrupt. Incoming CPU hints kernel (and RFS) to deliver packets to the core where
+ * channel is processed.
+ */
+struct busy_poll_settings_t
+{
+	tll::duration busy_poll = {}; ///< SO_BUSY_POLL timeout, microsecond resolution
+	bool prefer = false; ///< SO_PREFER_BUSY_POLL, suppress interrupts while application is polling
+	unsigned budget = 0; ///< SO_BUSY_POLL_BUDGET, packets per one poll, 0 for kernel default
+	int incoming_cpu = -1; ///< SO_INCOMING_CPU, -1 to keep default
+
+	template <typename Reader>
+	void init(Reader &reader)
+	{
+		busy_poll = reader.template getT<tll::duration>("busy-poll", tll::duration {});
+		prefer = reader.getT("prefer-busy-poll", false);
+		budget = reader.getT("busy-poll-budget", 0u);
+		incoming_cpu = reader.getT("incoming-cpu", -1);
+	}
+
+	int setup(tll::Logger &log, int fd) const
+	{
+		using namespace tll::network;
+#ifdef __linux__
+		if (busy_poll.count()) {
+			const int us = std::chrono::duration_cast<std::chrono::microseconds>(busy_poll).count();
+			if (setsockoptT<int>(fd, SOL_SOCKET, SO_BUSY_POLL, us))
+				return log.fail(EINVAL, "Failed to set busy poll to {}us: {}", us, strerror(errno));
+		}
+		if (prefer && setsockoptT<int>(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, 1))
+			return log.fail(EINVAL, "Failed to set prefer busy poll: {}", strerror(errno));
+		// Budget larger then default NAPI weight needs CAP_NET_ADMIN
+		if (budget && setsockoptT<int>(fd, SOL_SOCKET, SO_BUSY_POLL_BUDGET, budget))
+			return log.fail(EINVAL, "Failed to set busy poll budget to {}: {}", budget, strerror(errno));
+		if (incoming_cpu >= 0 && setsockoptT<int>(fd, SOL_SOCKET, SO_INCOMING_CPU, incoming_cpu))
+			return log.fail(EINVAL, "Failed to set incoming cpu to {}: {}", incoming_cpu, strerror(errno));
+#else
+		if (busy_poll.count() || prefer || budget || incoming_cpu >= 0)
+			log.info("Busy poll and incoming cpu options are supported only on linux");
+#endif
+		return 0;
+	}
+};
+
+/**
+ * Account receive call that got data
+ *
+ * Channel StatType must have ``rxbusy`` and ``rxwake`` fields, first one counts data that was found
+ * while processor loop was busy polling, second - data received after wakeup from poll.
+ */
+template <typename T>
+void busy_poll_stat_update(tll::channel::Base<T> * self, int flags)
+{
+	if (auto page = tll::channel::stat_acquire(self); page) {
+		if (flags & TLL_PROCESS_BUSY_POLL)
+			page->rxbusy.update(1);
+		else
+			page->rxwake.update(1);
+	}
+}
+
+} // namespace tll::channel
+
+#endif//_TLL_CHANNEL_BUSYPOLL_H
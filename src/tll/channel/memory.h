@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#ifndef _TLL_CHANNEL_MEMORY_H
+#define _TLL_CHANNEL_MEMORY_H
+
+#include "tll/channel/base.h"
+#include "tll/stat.h"
+
+namespace tll::channel {
+
+/// Stat field with number of bytes held in channel buffers, maximum over stat interval
+using MemoryStatField = tll::stat::Integer<tll::stat::Max, tll::stat::Bytes, 'm', 'e', 'm'>;
+/// Stat field with number of buffer allocations or reallocations
+using AllocStatField = tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'a', 'l', 'l', 'o', 'c'>;
+
+/**
+ * Memory accounting for major channel buffers
+ *
+ * Channel calls @ref update with total size of its buffers after they are changed, growth is
+ * counted as an allocation. Current size is also available in channel info as ``memory``, see
+ * @ref memory_export.
+ */
+class MemoryAccount
+{
+	long long _size = 0;
+	unsigned _allocs = 0;
+
+ public:
+	long long size() const { return _size; }
+	const long long * size_ptr() const { return &_size; }
+
+	/// Set new total size, return true if it was changed
+	bool update(size_t size)
+	{
+		if ((long long) size == _size)
+			return false;
+		if ((long long) size > _size)
+			_allocs++;
+		_size = size;
+		return true;
+	}
+
+	/// Account allocation that is not reflected in total size, like temporary message copy
+	void alloc(unsigned count = 1) { _allocs += count; }
+
+	/// Number of allocations since last call
+	unsigned allocs_reset() { return std::exchange(_allocs, 0); }
+};
+
+/// Publish current buffers size in channel info as ``memory`` key
+template <typename T>
+void memory_export(tll::channel::Base<T> * self, const MemoryAccount &account)
+{
+	self->config_info().set_ptr("memory", account.size_ptr());
+}
+
+/**
+ * Report memory usage into channel stat
+ *
+ * Channel StatType must have ``mem`` (see @ref MemoryStatField) and ``alloc`` (see @ref
+ * AllocStatField) fields.
+ */
+template <typename T>
+void memory_stat_update(tll::channel::Base<T> * self, MemoryAccount &account)
+{
+	if (auto page = tll::channel::stat_acquire(self); page) {
+		page->mem.update(account.size());
+		if (auto allocs = account.allocs_reset(); allocs)
+			page->alloc.update(allocs);
+	}
+}
+
+} // namespace tll::channel
+
+#endif//_TLL_CHANNEL_MEMORY_H
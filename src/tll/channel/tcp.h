@@ -9,12 +9,16 @@
 #define _TLL_CHANNEL_TCP_H
 
 #include "tll/channel/base.h"
+#include "tll/channel/busypoll.h"
+#include "tll/channel/memory.h"
 #include "tll/util/hostport.h"
 #include "tll/util/sockaddr.h"
+#include "tll/util/time.h"
 
 #include <array>
 #include <chrono>
 #include <list>
+#include <map>
 #include <vector>
 
 struct iovec;
@@ -47,7 +51,10 @@ struct tcp_settings_t {
 	bool timestamping = false;
 	bool keepalive = true;
 	bool nodelay = false;
+	bool buffer_pool = false;
+	busy_poll_settings_t busy_poll;
 	enum Protocol { TCP = 0, MPTCP, SCTP } protocol;
+	int socket_type = SOCK_STREAM; ///< SOCK_STREAM or SOCK_SEQPACKET for unix sockets
 };
 
 struct tcp_connect_t {
@@ -120,6 +127,87 @@ struct PartialBuffer
 	}
 };
 
+/**
+ * Per-thread pool of buffers shared between sockets
+ *
+ * Socket takes buffer from the pool only when it has unprocessed data and returns it back when all
+ * data is consumed, so idle connections do not hold any memory. Buffer sizes are rounded up to
+ * power of two size classes and only limited number of free buffers is kept for each class, extra
+ * ones are freed.
+ */
+class BufferPool
+{
+	std::map<size_t, std::vector<std::vector<char>>> _free;
+
+ public:
+	static constexpr size_t min_size = 4096; ///< Smallest size class
+	static constexpr size_t max_free = 16; ///< Limit of free buffers in one size class
+
+	static BufferPool & instance()
+	{
+		static thread_local BufferPool pool;
+		return pool;
+	}
+
+	/// Size class for requested size
+	static size_t size_class(size_t size)
+	{
+		size_t r = min_size;
+		while (r < size)
+			r *= 2;
+		return r;
+	}
+
+	/// Fill empty buffer with storage of given size
+	void acquire(PartialBuffer &buf, size_t size)
+	{
+		if (buf.capacity())
+			return;
+		buf.clear();
+		size = size_class(size);
+		auto it = _free.find(size);
+		if (it == _free.end() || it->second.empty()) {
+			buf.buf.resize(size);
+			return;
+		}
+		buf.buf.swap(it->second.back());
+		it->second.pop_back();
+	}
+
+	/// Grow buffer so it can hold @p size more bytes, capacity is kept in size class
+	static void reserve(PartialBuffer &buf, size_t size)
+	{
+		if (buf.available() >= size)
+			return;
+		buf.force_shift();
+		buf.buf.resize(size_class(buf.size() + size));
+	}
+
+	/// Return storage of the buffer into the pool, pending data is discarded
+	void release(PartialBuffer &buf)
+	{
+		if (!buf.capacity())
+			return;
+		buf.clear();
+		const auto size = buf.capacity();
+		if (size == size_class(size)) {
+			auto & list = _free[size];
+			if (list.size() < max_free)
+				list.push_back(std::move(buf.buf));
+		}
+		std::vector<char>().swap(buf.buf);
+	}
+
+	/// Number of free buffers in the pool
+	size_t size() const
+	{
+		size_t r = 0;
+		for (auto & [_, l] : _free)
+			r += l.size();
+		return r;
+	}
+};
+
 template <typename T>
 class TcpSocket : public Base<T>
 {
@@ -128,6 +216,12 @@ class TcpSocket : public Base<T>
 	PartialBuffer _wbuf;
 	std::vector<char> _cbuf;
 
+	bool _buffer_pool = false; ///< Take buffers from the pool only when they are needed
+	size_t _rbuf_size = 0;
+	size_t _wbuf_size = 0;
+
+	MemoryAccount _memory;
+
 	tcp_socket_addr_t _msg_addr;
 
 	using tcp_socket_t = TcpSocket<T>;
@@ -135,6 +229,16 @@ class TcpSocket : public Base<T>
  public:
 	static constexpr std::string_view channel_protocol() { return "tcp"; }
 
+	struct StatType : public Base<T>::StatType
+	{
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'r', 'x', 'b', 'u', 's', 'y'> rxbusy;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'r', 'x', 'w', 'a', 'k', 'e'> rxwake;
+		tll::stat::Histogram<tll::stat::Ns, 'r', 'x', 'k', 'e', 'r', 'n'> rxkern; ///< Kernel receive timestamp to recv call
+		tll::stat::Histogram<tll::stat::Ns, 'r', 'x', 'c', 'b'> rxcb; ///< Recv call to the end of first data callback
+		MemoryStatField mem; ///< Size of receive and send buffers
+		AllocStatField alloc; ///< Number of buffer allocations
+	};
+
 	/// How to handle send errors: change state or ignore them
 	enum class SendErrorPolicy { State, Ignore };
 	/// Send error policy settings
@@ -162,6 +266,11 @@ class TcpSocket : public Base<T>
 	int _process(long timeout, int flags);
 	int _process_output();
 
+	/// Send data to the socket, can be overriden to wrap data, for example with TLS
+	ssize_t _sys_sendmsg(const msghdr * msg) { return sendmsg(this->fd(), msg, MSG_NOSIGNAL | MSG_DONTWAIT); }
+	/// Receive data from the socket, can be overriden to unwrap data
+	ssize_t _sys_recvmsg(msghdr * msg) { return recvmsg(this->fd(), msg, MSG_NOSIGNAL | MSG_DONTWAIT); }
+
 	void bind(int fd, unsigned seq = 0) { this->_update_fd(fd); _msg_addr = { fd, seq }; }
 	const tcp_socket_addr_t & msg_addr() const { return _msg_addr; }
 
@@ -193,6 +302,23 @@ class TcpSocket : public Base<T>
 
  protected:
 	std::chrono::nanoseconds _timestamp;
+	std::chrono::nanoseconds _timestamp_sw = {}; ///< Software receive timestamp, set only when stat is enabled
+	tll::time_point _timestamp_user = {}; ///< Time when timestamped data was received by recv call
+
+	/**
+	 * Update receive latency stat, called when data callback for timestamped data is finished.
+	 * Stat is recorded once for each recv call, other frames from the same data are skipped.
+	 */
+	void _rx_latency_update()
+	{
+		if (!_timestamp_sw.count())
+			return;
+		if (auto page = stat_acquire(this); page) {
+			page->rxkern = (_timestamp_user.time_since_epoch() - _timestamp_sw).count();
+			page->rxcb = std::chrono::nanoseconds(tll::time::now() - _timestamp_user).count();
+		}
+		_timestamp_sw = {};
+	}
 
 	size_t rsize() const { return _rbuf.size(); }
 	void rdone(size_t size) { return _rbuf.done(size); }
@@ -201,9 +327,43 @@ class TcpSocket : public Base<T>
 	template <typename D>
 	const D * rdataT(size_t off = 0, size_t size = sizeof(D)) const { return _rbuf.dataT<D>(off, size); }
 
+	/// Take receive buffer from the pool if it was released, called before each receive
+	void _rbuf_acquire()
+	{
+		if (_buffer_pool && !_rbuf.capacity())
+			BufferPool::instance().acquire(_rbuf, _rbuf_size);
+		_memory_update();
+	}
+
+	/**
+	 * Return receive buffer into the pool if there is no pending data
+	 *
+	 * @param discard drop pending data and release buffer anyway, used when processing failed and
+	 *        stream can not be continued. Must not be used while data callback is running.
+	 */
+	void _rbuf_release(bool discard = false)
+	{
+		if (_buffer_pool && (discard || !_rbuf.size()) && _rbuf.capacity()) {
+			BufferPool::instance().release(_rbuf);
+			_memory_update();
+		}
+	}
+
+	/**
+	 * Account current buffer sizes, called when any of them is changed and on each receive
+	 *
+	 * Stat is updated even if size is same: ``mem`` field is reset on each stat swap.
+	 */
+	void _memory_update()
+	{
+		_memory.update(_rbuf.capacity() + _wbuf.capacity() + _cbuf.capacity());
+		memory_stat_update(this, _memory);
+	}
+
 	std::optional<size_t> _recv(size_t size);
 	std::optional<size_t> _recv()
 	{
+		_rbuf_acquire();
 		if (_rbuf._offset >= _rbuf.capacity() / 2 || _rbuf.available() == 0)
 			_rbuf.force_shift();
 		return _recv(_rbuf.available());
@@ -216,7 +376,7 @@ class TcpSocket : public Base<T>
 
 	void _store_output(const void * base, size_t size, bool more = false);
 
-	std::chrono::nanoseconds _cmsg_timestamp(msghdr * msg);
+	std::chrono::nanoseconds _cmsg_timestamp(msghdr * msg, std::chrono::nanoseconds * software = nullptr);
 };
 
 template <typename T, typename S = TcpSocket<T>>
@@ -310,6 +470,7 @@ class TcpServer : public Base<T>
 	int _post(const tll_msg_t *msg, int flags);
 
 	void _on_child_connect(tcp_socket_t *, const tcp_connect_t *);
+	void _on_child_active(tcp_socket_t *) {}
 	void _on_child_error(tcp_socket_t *) {}
 	void _on_child_closing(tcp_socket_t *);
 
@@ -347,8 +508,16 @@ class TcpServer : public Base<T>
 
 	int _cb_socket(const tll_channel_t *c, const tll_msg_t *msg);
 
+	/// Create client channel for accepted connection, can be overriden to handle sockets without child channels
+	int _on_accept_socket(tll::network::scoped_socket fd, const tcp_connect_t * conn);
+
 	int _bind(tll::network::sockaddr_any &addr);
 	void _cleanup(tcp_socket_t *);
+
+	/// Generate Connect control message
+	void _callback_connect(const tcp_socket_addr_t &addr, const tcp_connect_t * conn);
+	/// Generate Disconnect control message
+	void _callback_disconnect(const tcp_socket_addr_t &addr);
 	tcp_socket_t * _lookup(const tll_addr_t &addr);
 };
 
@@ -99,6 +99,37 @@ inline int select_protocol(tll::Logger &log, const tcp_settings_t &settings, int
 	return log.fail(-1, "Undefined protocol variant: {}", int(settings.protocol));
 }
 
+/// Set nonblocking mode and socket options from settings
+inline int setup_socket(tll::Logger &log, int fd, const tcp_settings_t &settings, int af)
+{
+	using namespace tll::network;
+
+	if (int r = nonblock(fd))
+		return log.fail(EINVAL, "Failed to set nonblock: {}", strerror(r));
+
+#ifdef __APPLE__
+	if (setsockoptT<int>(fd, SOL_SOCKET, SO_NOSIGPIPE, 1))
+		return log.fail(EINVAL, "Failed to set SO_NOSIGPIPE: {}", strerror(errno));
+#endif
+
+	if (settings.keepalive && setsockoptT<int>(fd, SOL_SOCKET, SO_KEEPALIVE, 1))
+		return log.fail(EINVAL, "Failed to set keepalive: {}", strerror(errno));
+
+	if (settings.sndbuf && setsockoptT<int>(fd, SOL_SOCKET, SO_SNDBUF, settings.sndbuf))
+		return log.fail(EINVAL, "Failed to set sndbuf to {}: {}", settings.sndbuf, strerror(errno));
+
+	if (settings.rcvbuf && setsockoptT<int>(fd, SOL_SOCKET, SO_RCVBUF, settings.rcvbuf))
+		return log.fail(EINVAL, "Failed to set rcvbuf to {}: {}", settings.rcvbuf, strerror(errno));
+
+	if (settings.nodelay && af != AF_UNIX && settings.protocol != settings.SCTP && setsockoptT<int>(fd, SOL_TCP, TCP_NODELAY, 1))
+		return log.fail(EINVAL, "Failed to set nodelay: {}", strerror(errno));
+
+	if (auto r = settings.busy_poll.setup(log, fd); r)
+		return r;
+
+	return 0;
+}
+
 } // namespace _
 
 template <typename T>
@@ -119,6 +150,8 @@ int TcpSocket<T>::_open(const ConstConfig &url)
 		this->_update_fd(*fd);
 	}
 	this->_dcaps_poll(dcaps::CPOLLIN);
+	memory_export(this, _memory);
+	_memory_update();
 	// Fd set by server
 	return 0;
 }
@@ -129,6 +162,12 @@ int TcpSocket<T>::_close()
 	auto fd = this->_update_fd(-1);
 	if (fd != -1)
 		::close(fd);
+	if (_buffer_pool) {
+		// Receive buffer can be in use if channel is closed from data callback
+		_rbuf_release();
+		BufferPool::instance().release(_wbuf);
+		_memory_update();
+	}
 	return 0;
 }
 
@@ -136,7 +175,11 @@ template <typename T>
 int TcpSocket<T>::_post_data(const tll_msg_t *msg, int flags)
 {
 	this->_log.trace("Post {} bytes of data", msg->size);
-	int r = send(this->fd(), msg->data, msg->size, MSG_NOSIGNAL | MSG_DONTWAIT);
+	struct iovec iov = {(void *) msg->data, msg->size};
+	struct msghdr mhdr = {};
+	mhdr.msg_iov = &iov;
+	mhdr.msg_iovlen = 1;
+	auto r = this->channelT()->_sys_sendmsg(&mhdr);
 	if (r < 0)
 		return this->_on_send_error(this->_log.fail(errno, "Failed to post data: {}", strerror(errno)));
 	else if ((size_t) r != msg->size)
@@ -181,23 +224,22 @@ void TcpSocket<T>::_on_output_ready()
 template <typename T>
 std::optional<size_t> TcpSocket<T>::_recv(size_t size)
 {
+	_rbuf_acquire();
 	auto left = _rbuf.available();
 	if (left == 0)
 		return this->_log.fail(std::nullopt, "No space left in recv buffer");
 
 	size = std::min(size, left);
 
-#ifdef __linux__
 	struct iovec iov = {_rbuf.end(), size};
 	msghdr mhdr = {};
 	mhdr.msg_iov = &iov;
 	mhdr.msg_iovlen = 1;
+#ifdef __linux__
 	mhdr.msg_control = _cbuf.data();
 	mhdr.msg_controllen = _cbuf.size();
-	int r = recvmsg(this->fd(), &mhdr, MSG_NOSIGNAL | MSG_DONTWAIT);
-#else
-	int r = recv(this->fd(), _rbuf.end(), size, MSG_NOSIGNAL | MSG_DONTWAIT);
 #endif
+	auto r = this->channelT()->_sys_recvmsg(&mhdr);
 	if (r < 0) {
 		if (errno == EAGAIN)
 			return 0;
@@ -208,8 +250,11 @@ std::optional<size_t> TcpSocket<T>::_recv(size_t size)
 		return 0;
 	}
 #ifdef __linux__
+	_timestamp_sw = {};
 	if (mhdr.msg_controllen)
-		_timestamp = _cmsg_timestamp(&mhdr);
+		_timestamp = _cmsg_timestamp(&mhdr, this->_stat_enable ? &_timestamp_sw : nullptr);
+	if (_timestamp_sw.count())
+		_timestamp_user = tll::time::now();
 #endif
 	_rbuf.extend(r);
 	this->_log.trace("Got {} bytes of data", r);
@@ -221,16 +266,16 @@ int TcpSocket<T>::setup(const tcp_settings_t &settings, int af)
 {
 	using namespace tll::network;
 
-	_rbuf.resize(settings.rcv_buffer_size);
-	_wbuf.resize(settings.snd_buffer_size);
-
-	if (int r = nonblock(this->fd()))
-		return this->_log.fail(EINVAL, "Failed to set nonblock: {}", strerror(r));
+	_buffer_pool = settings.buffer_pool;
+	_rbuf_size = settings.rcv_buffer_size;
+	_wbuf_size = settings.snd_buffer_size;
+	if (!_buffer_pool) {
+		_rbuf.resize(settings.rcv_buffer_size);
+		_wbuf.resize(settings.snd_buffer_size);
+	}
 
-#ifdef __APPLE__
-	if (setsockoptT<int>(this->fd(), SOL_SOCKET, SO_NOSIGPIPE, 1))
-		return this->_log.fail(EINVAL, "Failed to set SO_NOSIGPIPE: {}", strerror(errno));
-#endif
+	if (auto r = _::setup_socket(this->_log, this->fd(), settings, af); r)
+		return r;
 
 #ifdef __linux__
 	if (settings.timestamping) {
@@ -241,23 +286,11 @@ int TcpSocket<T>::setup(const tcp_settings_t &settings, int af)
 	}
 #endif
 
-	if (settings.keepalive && setsockoptT<int>(this->fd(), SOL_SOCKET, SO_KEEPALIVE, 1))
-		return this->_log.fail(EINVAL, "Failed to set keepalive: {}", strerror(errno));
-
-	if (settings.sndbuf && setsockoptT<int>(this->fd(), SOL_SOCKET, SO_SNDBUF, settings.sndbuf))
-		return this->_log.fail(EINVAL, "Failed to set sndbuf to {}: {}", settings.sndbuf, strerror(errno));
-
-	if (settings.rcvbuf && setsockoptT<int>(this->fd(), SOL_SOCKET, SO_RCVBUF, settings.rcvbuf))
-		return this->_log.fail(EINVAL, "Failed to set rcvbuf to {}: {}", settings.rcvbuf, strerror(errno));
-
-	if (settings.nodelay && af != AF_UNIX && settings.protocol != settings.SCTP && setsockoptT<int>(this->fd(), SOL_TCP, TCP_NODELAY, 1))
-		return this->_log.fail(EINVAL, "Failed to set nodelay: {}", strerror(errno));
-
 	return 0;
 }
 
 template <typename T>
-std::chrono::nanoseconds TcpSocket<T>::_cmsg_timestamp(msghdr * msg)
+std::chrono::nanoseconds TcpSocket<T>::_cmsg_timestamp(msghdr * msg, std::chrono::nanoseconds * software)
 {
 	using namespace std::chrono;
 	nanoseconds r = {};
@@ -272,6 +305,9 @@ std::chrono::nanoseconds TcpSocket<T>::_cmsg_timestamp(msghdr * msg)
 				r = seconds(ts[2].tv_sec) + nanoseconds(ts[2].tv_nsec);
 			else
 				r = seconds(ts->tv_sec) + nanoseconds(ts->tv_nsec);
+			// Software timestamp uses realtime clock and can be compared with tll::time::now
+			if (software)
+				*software = seconds(ts->tv_sec) + nanoseconds(ts->tv_nsec);
 		}
 	}
 #endif
@@ -281,8 +317,12 @@ std::chrono::nanoseconds TcpSocket<T>::_cmsg_timestamp(msghdr * msg)
 template <typename T>
 void TcpSocket<T>::_store_output(const void * data, size_t len, bool more)
 {
-	if (_wbuf.available() < len)
+	if (_buffer_pool) {
+		BufferPool::instance().acquire(_wbuf, std::max(_wbuf_size, len));
+		BufferPool::reserve(_wbuf, len);
+	} else if (_wbuf.available() < len)
 		_wbuf.resize(_wbuf.size() + len);
+	_memory_update();
 	memcpy(_wbuf.end(), data, len);
 	_wbuf.extend(len);
 	if (_wbuf.size() == len) {
@@ -310,7 +350,7 @@ int TcpSocket<T>::_sendmsg(const iovec * iov, size_t N)
 	struct msghdr msg = {};
 	msg.msg_iov = (iovec *) iov;
 	msg.msg_iovlen = N;
-	auto r = sendmsg(this->fd(), &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	auto r = this->channelT()->_sys_sendmsg(&msg);
 	if (r < 0) {
 		if (errno != EAGAIN)
 			return this->_on_send_error(this->_log.fail(EINVAL, "Failed to send {} bytes of data: {}", full, strerror(errno)));
@@ -350,7 +390,11 @@ int TcpSocket<T>::_process_output()
 {
 	if (!_wbuf.size())
 		return 0;
-	auto r = ::send(this->fd(), _wbuf.data(), _wbuf.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+	struct iovec iov = {_wbuf.data(), _wbuf.size()};
+	struct msghdr mhdr = {};
+	mhdr.msg_iov = &iov;
+	mhdr.msg_iovlen = 1;
+	auto r = this->channelT()->_sys_sendmsg(&mhdr);
 	if (r < 0) {
 		if (errno == EAGAIN) {
 			this->_update_dcaps(dcaps::CPOLLOUT);
@@ -363,6 +407,10 @@ int TcpSocket<T>::_process_output()
 	this->_log.trace("Sent {} bytes of pending data, {} bytes left", r, _wbuf.size());
 	_wbuf.shift();
 	if (!_wbuf.size()) {
+		if (_buffer_pool) {
+			BufferPool::instance().release(_wbuf);
+			_memory_update();
+		}
 		this->_update_dcaps(0, dcaps::CPOLLOUT);
 		this->channelT()->_on_output_ready();
 	} else
@@ -374,19 +422,26 @@ template <typename T>
 int TcpSocket<T>::_process(long timeout, int flags)
 {
 	auto r = _recv();
-	if (!r)
+	if (!r) {
+		_rbuf_release(true);
 		return EINVAL;
-	if (!*r)
+	}
+	if (!*r) {
+		_rbuf_release();
 		return EAGAIN;
+	}
 	this->_log.trace("Got data: {}", *r);
+	busy_poll_stat_update(this, flags);
 	tll_msg_t msg = { TLL_MESSAGE_DATA };
 	msg.data = _rbuf.data();
 	msg.size = *r;
 	msg.addr = _msg_addr;
 	msg.time = _timestamp.count();
 	this->_callback_data(&msg);
+	_rx_latency_update();
 	rdone(*r);
 	rshift();
+	_rbuf_release();
 	return 0;
 }
 
@@ -410,6 +465,8 @@ int TcpClient<T, S>::_init(const tll::Channel::Url &url, tll::Channel *master)
 		_settings.snd_buffer_size = reader.getT("send-buffer-size", size);
 		_settings.rcv_buffer_size = reader.getT("recv-buffer-size", size);
 	}
+	_settings.buffer_pool = reader.getT("buffer-pool", false);
+	_settings.busy_poll.init(reader);
 	_bind_host = reader.getT("bind", std::optional<tll::network::hostport> {});
 	_settings.protocol = reader.getT("protocol", tcp_settings_t::Protocol::TCP);
 	if (!reader)
@@ -447,19 +504,19 @@ int TcpClient<T, S>::_open(const ConstConfig &url)
 			return this->_log.fail(EINVAL, "Mismatched address family: parameter {}, parsed {}", af, _peer_active.af);
 	} else
 		_peer_active = *_peer;
-	auto addr = tll::network::resolve(_peer_active.af, SOCK_STREAM, _peer_active.host, _peer_active.port);
+	auto addr = tll::network::resolve(_peer_active.af, _settings.socket_type, _peer_active.host, _peer_active.port);
 	if (!addr)
 		return this->_log.fail(EINVAL, "Failed to resolve '{}': {}", _peer_active.host, addr.error());
 	std::swap(_addr_list, *addr);
 	_addr = _addr_list.begin();
 
-	auto fd = socket((*_addr)->sa_family, SOCK_STREAM, _::select_protocol(this->_log, _settings, (*_addr)->sa_family));
+	auto fd = socket((*_addr)->sa_family, _settings.socket_type, _::select_protocol(this->_log, _settings, (*_addr)->sa_family));
 	if (fd == -1)
 		return this->_log.fail(errno, "Failed to create socket: {}", strerror(errno));
 	this->_update_fd(fd);
 
 	if (_bind_host) {
-		addr = _bind_host->resolve(SOCK_STREAM);
+		addr = _bind_host->resolve(_settings.socket_type);
 		if (!addr)
 			return this->_log.fail(EINVAL, "Failed to resolve bind host '{}': {}", _bind_host->host, addr.error());
 		if (bind(fd, addr->front(), addr->front().size))
@@ -633,6 +690,8 @@ int TcpServer<T, C>::_init(const tll::Channel::Url &url, tll::Channel *master)
 		_settings.snd_buffer_size = reader.getT("send-buffer-size", size);
 		_settings.rcv_buffer_size = reader.getT("recv-buffer-size", size);
 	}
+	_settings.buffer_pool = reader.getT("buffer-pool", false);
+	_settings.busy_poll.init(reader);
 	_settings.protocol = reader.getT("protocol", tcp_settings_t::Protocol::TCP);
 	if (!reader)
 		return this->_log.fail(EINVAL, "Invalid url: {}", reader.error());
@@ -669,7 +728,7 @@ int TcpServer<T, C>::_open(const ConstConfig &url)
 	_cleanup_flag = false;
 	_addr_seq = 0;
 
-	auto addr = _host.resolve(SOCK_STREAM);
+	auto addr = _host.resolve(_settings.socket_type);
 	if (!addr)
 		return this->_log.fail(EINVAL, "Failed to resolve '{}': {}", _host.host, addr.error());
 
@@ -716,9 +775,9 @@ int TcpServer<T, C>::_bind(tll::network::sockaddr_any &addr)
 	this->_log.info("Listen on {}", conv::to_string(addr));
 
 #ifdef SOCK_NONBLOCK
-	static constexpr int sflags = SOCK_STREAM | SOCK_NONBLOCK;
+	const int sflags = _settings.socket_type | SOCK_NONBLOCK;
 #else
-	static constexpr int sflags = SOCK_STREAM;
+	const int sflags = _settings.socket_type;
 #endif
 
 	tll::network::scoped_socket fd(socket(addr->sa_family, sflags, _::select_protocol(this->_log, _settings, addr->sa_family)));
@@ -843,7 +902,9 @@ int TcpServer<T, C>::_cb_other(const tll_channel_t *c, const tll_msg_t *msg)
 {
 	auto socket = tll::channel_cast<tcp_socket_t>(const_cast<tll_channel_t *>(c))->channelT();
 	if (msg->type == TLL_MESSAGE_STATE) {
-		if (msg->msgid == state::Error) {
+		if (msg->msgid == state::Active) {
+			this->channelT()->_on_child_active(socket);
+		} else if (msg->msgid == state::Error) {
 			this->channelT()->_on_child_error(socket);
 			_cleanup_flag = true;
 			this->_update_dcaps(dcaps::Pending | dcaps::Process);
@@ -859,6 +920,12 @@ int TcpServer<T, C>::_cb_other(const tll_channel_t *c, const tll_msg_t *msg)
 
 template <typename T, typename C>
 void TcpServer<T, C>::_on_child_connect(tcp_socket_t *socket, const tcp_connect_t * conn)
+{
+	_callback_connect(socket->msg_addr(), conn);
+}
+
+template <typename T, typename C>
+void TcpServer<T, C>::_callback_connect(const tcp_socket_addr_t &addr, const tcp_connect_t * conn)
 {
 	std::array<char, tcp_scheme::Connect::meta_size()> buf = {};
 	auto connect = tcp_scheme::Connect::bind(buf);
@@ -877,16 +944,22 @@ void TcpServer<T, C>::_on_child_connect(tcp_socket_t *socket, const tcp_connect_
 	msg.msgid = connect.meta_id();
 	msg.size = connect.view().size();
 	msg.data = connect.view().data();
-	msg.addr = socket->msg_addr();
+	msg.addr = addr;
 	this->_callback(&msg);
 }
 
 template <typename T, typename C>
 void TcpServer<T, C>::_on_child_closing(tcp_socket_t *socket)
+{
+	_callback_disconnect(socket->msg_addr());
+}
+
+template <typename T, typename C>
+void TcpServer<T, C>::_callback_disconnect(const tcp_socket_addr_t &addr)
 {
 	tll_msg_t m = { TLL_MESSAGE_CONTROL };
 	m.msgid = tcp_scheme::Disconnect::meta_id();
-	m.addr = socket->msg_addr();
+	m.addr = addr;
 	this->_callback(&m);
 }
 
@@ -924,6 +997,12 @@ int TcpServer<T, C>::_cb_socket(const tll_channel_t *c, const tll_msg_t *msg)
 		return 0;
 	}
 
+	return this->channelT()->_on_accept_socket(std::move(fd), conn);
+}
+
+template <typename T, typename C>
+int TcpServer<T, C>::_on_accept_socket(tll::network::scoped_socket fd, const tcp_connect_t * conn)
+{
 	_socket_url.set("name", fmt::format("{}/{}", this->name, fd));
 	auto impl = this->channelT()->socket_impl_policy() == SocketImplPolicy::Fixed ? &tcp_socket_t::impl : nullptr;
 	auto r = this->context().channel(_socket_url, this->self(), impl);
@@ -5,8 +5,10 @@
 #define _TLL_CHANNEL_UDP_H
 
 #include "tll/channel/base.h"
+#include "tll/channel/busypoll.h"
 #include "tll/util/size.h"
 #include "tll/util/sockaddr.h"
+#include "tll/util/time.h"
 
 #include <array>
 #include <chrono>
@@ -21,6 +23,7 @@
 #include <linux/errqueue.h>
 #include <linux/sockios.h>
 #include <linux/net_tstamp.h>
+#include <netinet/udp.h>
 #endif
 
 #if defined(__APPLE__) && !defined(MSG_NOSIGNAL)
@@ -55,6 +58,7 @@ class Socket : public tll::channel::Base<T>
 	unsigned _ttl = 0;
 
 	std::array<long long, 8> _tx_seq;
+	std::array<tll::time_point, 8> _tx_time; ///< Time of send call, filled only when stat is enabled
 	unsigned _tx_idx = 0;
 
 	bool _timestamping = false;
@@ -68,6 +72,36 @@ class Socket : public tll::channel::Base<T>
 	int _mcast_ifindex = 0;
 	std::optional<in_addr> _mcast_ifaddr4; // Only for ipv4 multicast structures, ipv6 use interface index
 
+	unsigned _batch_rx = 1;
+	unsigned _batch_tx = 1;
+	bool _gro = false;
+	bool _gso = false;
+
+	busy_poll_settings_t _busy_poll;
+
+#ifdef __linux__
+	static constexpr size_t control_size = 256;
+
+	/// Receive ring for recvmmsg, one entry for each datagram in batch
+	std::vector<mmsghdr> _rx_hdr;
+	std::vector<iovec> _rx_iov;
+	std::vector<tll::network::sockaddr_any> _rx_addr;
+
+	/// Packet stored with TLL_POST_MORE flag
+	struct TxPacket
+	{
+		long long seq;
+		size_t offset;
+		size_t size;
+		tll::network::sockaddr_any addr;
+	};
+
+	std::vector<char> _tx_buf;
+	std::vector<TxPacket> _tx_packets;
+	std::vector<mmsghdr> _tx_hdr;
+	std::vector<iovec> _tx_iov;
+#endif
+
 	int _nametoindex()
 	{
 		if (!_mcast_interface || _mcast_ifindex)
@@ -95,7 +129,7 @@ class Socket : public tll::channel::Base<T>
 		return 0;
 	}
 
-	std::chrono::duration<int64_t, std::nano> _cmsg_timestamp(msghdr * msg)
+	std::chrono::duration<int64_t, std::nano> _cmsg_timestamp(msghdr * msg, std::chrono::nanoseconds * software = nullptr)
 	{
 		using namespace std::chrono;
 		nanoseconds r = {};
@@ -110,12 +144,57 @@ class Socket : public tll::channel::Base<T>
 					r = seconds(ts[2].tv_sec) + nanoseconds(ts[2].tv_nsec);
 				else
 					r = seconds(ts->tv_sec) + nanoseconds(ts->tv_nsec);
+				// Software timestamp uses realtime clock and can be compared with tll::time::now
+				if (software)
+					*software = seconds(ts->tv_sec) + nanoseconds(ts->tv_nsec);
 			}
 		}
 #endif
 		return r;
 	}
 
+	/// Time of recv call that is used for latency stat, zero if it is disabled
+	tll::time_point _rx_user_time() const
+	{
+		if (_timestamping && this->_stat_enable)
+			return tll::time::now();
+		return {};
+	}
+
+	/// Update receive latency stat when data callback is finished
+	void _rx_latency_update(std::chrono::nanoseconds software, tll::time_point user)
+	{
+		if (!software.count() || user == tll::time_point {})
+			return;
+		if (auto page = stat_acquire(this); page) {
+			page->rxkern = (user.time_since_epoch() - software).count();
+			page->rxcb = std::chrono::nanoseconds(tll::time::now() - user).count();
+		}
+	}
+
+	/// Remember seq (and send time if stat is enabled) to match it with transmit timestamp
+	void _tx_store_seq(long long seq, tll::time_point time = {})
+	{
+		auto idx = ++_tx_idx % _tx_seq.size();
+		_tx_seq[idx] = seq;
+		_tx_time[idx] = time;
+	}
+
+	/// Size of segments in coalesced GRO packet or 0 if packet was not coalesced
+	size_t _cmsg_gro(msghdr * msg)
+	{
+#ifdef __linux__
+		for (auto cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+				int size;
+				memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+				return size;
+			}
+		}
+#endif
+		return 0;
+	}
+
 	uint32_t _cmsg_seq(msghdr *msg)
 	{
 #ifdef __linux__
@@ -155,14 +234,22 @@ class Socket : public tll::channel::Base<T>
 			return this->_log.fail(EINVAL, "Failed to receive errqueue message: {}", strerror(errno));
 		}
 
-		auto time = _cmsg_timestamp(mhdr);
+		std::chrono::nanoseconds software = {};
+		auto time = _cmsg_timestamp(mhdr, &software);
 		auto seq = _cmsg_seq(mhdr);
 
 		tll_msg_t msg = {};
 		if (_tx_idx - seq > _tx_seq.size())
 			msg.seq = -1;
-		else
+		else {
 			msg.seq = _tx_seq[seq % _tx_seq.size()];
+			auto sent = _tx_time[seq % _tx_seq.size()];
+			// Hardware timestamp is reported in separate message without software one
+			if (software.count() && sent != tll::time_point {}) {
+				if (auto page = stat_acquire(this); page)
+					page->txkern = (software - sent.time_since_epoch()).count();
+			}
+		}
 		msg.type = TLL_MESSAGE_CONTROL;
 		msg.msgid = time_msgid;
 		msg.time = time.count();
@@ -177,6 +264,15 @@ class Socket : public tll::channel::Base<T>
 	static constexpr std::string_view channel_protocol() { return "udp"; }
 	static constexpr auto process_policy() { return Base::ProcessPolicy::Custom; }
 
+	struct StatType : public Base::StatType
+	{
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'r', 'x', 'b', 'u', 's', 'y'> rxbusy;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'r', 'x', 'w', 'a', 'k', 'e'> rxwake;
+		tll::stat::Histogram<tll::stat::Ns, 'r', 'x', 'k', 'e', 'r', 'n'> rxkern; ///< Kernel receive timestamp to recv call
+		tll::stat::Histogram<tll::stat::Ns, 'r', 'x', 'c', 'b'> rxcb; ///< Recv call to the end of data callback
+		tll::stat::Histogram<tll::stat::Ns, 't', 'x', 'k', 'e', 'r', 'n'> txkern; ///< Send call to kernel transmit timestamp
+	};
+
 	int _init(const tll::Channel::Url &url, tll::Channel *master)
 	{
 		auto reader = this->channel_props_reader(url);
@@ -188,6 +284,12 @@ class Socket : public tll::channel::Base<T>
 		_timestamping = reader.getT("timestamping", false);
 		_timestamping_tx = reader.getT("timestamping-tx", false);
 
+		_batch_rx = reader.getT("batch-rx", 1u);
+		_batch_tx = reader.getT("batch-tx", 1u);
+		_gro = reader.getT("gro", false);
+		_gso = reader.getT("gso", false);
+		_busy_poll.init(reader);
+
 		_multi = reader.getT("multicast", false);
 		if (_multi) {
 			_mcast_loop = reader.getT("loop", true);
@@ -196,10 +298,21 @@ class Socket : public tll::channel::Base<T>
 		}
 		if (!reader)
 			return this->_log.fail(EINVAL, "Invalid url: {}", reader.error());
-		_buf.resize(size);
+		if (_batch_rx == 0 || _batch_tx == 0)
+			return this->_log.fail(EINVAL, "Zero batch size: rx {}, tx {}", _batch_rx, _batch_tx);
+		if (_gso && _timestamping_tx)
+			return this->_log.fail(EINVAL, "GSO can not be used with transmit timestamping");
+#ifndef __linux__
+		if (_batch_rx > 1 || _batch_tx > 1 || _gro || _gso) {
+			this->_log.info("Batching, GRO and GSO are supported only on linux");
+			_batch_rx = _batch_tx = 1;
+			_gro = _gso = false;
+		}
+#endif
+		_buf.resize(size * _batch_rx);
 		if (_timestamping) {
 #ifdef __linux__
-			_buf_control.resize(256);
+			_buf_control.resize(control_size);
 			if (_timestamping_tx) {
 				this->_scheme_control.reset(this->context().scheme_load(control_scheme));
 				if (!this->_scheme_control.get())
@@ -209,6 +322,26 @@ class Socket : public tll::channel::Base<T>
 			this->_log.info("Packet timestamping supported only on linux");
 #endif
 		}
+
+#ifdef __linux__
+		if (_batch_rx > 1 || _gro) {
+			const size_t csize = (_timestamping || _gro) ? control_size : 0;
+			_buf_control.resize(csize * _batch_rx);
+			_rx_hdr.resize(_batch_rx);
+			_rx_iov.resize(_batch_rx);
+			_rx_addr.resize(_batch_rx);
+			for (auto i = 0u; i < _batch_rx; i++) {
+				_rx_iov[i] = { _buf.data() + i * size, size };
+				auto & hdr = _rx_hdr[i].msg_hdr;
+				hdr = {};
+				hdr.msg_name = _rx_addr[i].buf;
+				hdr.msg_iov = &_rx_iov[i];
+				hdr.msg_iovlen = 1;
+				hdr.msg_control = csize ? _buf_control.data() + i * csize : nullptr;
+				hdr.msg_controllen = csize;
+			}
+		}
+#endif
 		return 0;
 	}
 
@@ -220,6 +353,7 @@ class Socket : public tll::channel::Base<T>
 
 		_tx_idx = -1;
 		_tx_seq = {};
+		_tx_time = {};
 		if (_timestamping) {
 #ifdef __linux__
 			int v = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_SOFTWARE;
@@ -230,12 +364,26 @@ class Socket : public tll::channel::Base<T>
 #endif
 		}
 
+#ifdef __linux__
+		_tx_buf.clear();
+		_tx_packets.clear();
+		if ((_gro || _gso) && _addr->sa_family != AF_INET && _addr->sa_family != AF_INET6) {
+			this->_log.info("GRO and GSO are supported only for IP sockets, disabled");
+			_gro = _gso = false;
+		}
+		if (_gro && setsockoptT<int>(this->fd(), SOL_UDP, UDP_GRO, 1))
+			return this->_log.fail(EINVAL, "Failed to enable UDP_GRO: {}", strerror(errno));
+#endif
+
 		if (_sndbuf && setsockoptT<int>(this->fd(), SOL_SOCKET, SO_SNDBUF, _sndbuf))
 			return this->_log.fail(EINVAL, "Failed to set sndbuf to {}: {}", _sndbuf, strerror(errno));
 
 		if (_rcvbuf && setsockoptT<int>(this->fd(), SOL_SOCKET, SO_RCVBUF, _rcvbuf))
 			return this->_log.fail(EINVAL, "Failed to set rcvbuf to {}: {}", _rcvbuf, strerror(errno));
 
+		if (auto r = _busy_poll.setup(this->_log, this->fd()); r)
+			return r;
+
 		if (_ttl) {
 			if (_multi && _addr->sa_family == AF_INET6) {
 				if (setsockoptT<int>(this->fd(), IPPROTO_IPV6, IPV6_MULTICAST_HOPS, _ttl))
@@ -280,6 +428,12 @@ class Socket : public tll::channel::Base<T>
 
 	int _close()
 	{
+#ifdef __linux__
+		if (_tx_packets.size())
+			this->_log.info("Drop {} unsent packets", _tx_packets.size());
+		_tx_buf.clear();
+		_tx_packets.clear();
+#endif
 		auto fd = this->_update_fd(-1);
 		if (fd != -1)
 			::close(fd);
@@ -294,8 +448,16 @@ class Socket : public tll::channel::Base<T>
 		return 0;
 	}
 
+	/// Override hook called when packet with given seq is passed to the kernel, for batched send
+	/// it is called only when batch is flushed
+	void _on_sent(long long seq) {}
+
 	int _process(long timeout, int flags)
 	{
+#ifdef __linux__
+		if (_rx_hdr.size())
+			return _process_batch(flags);
+#endif
 		iovec iov = {_buf.data(), _buf.size()};
 		msghdr mhdr = {};
 		mhdr.msg_name = _peer.buf;
@@ -310,21 +472,209 @@ class Socket : public tll::channel::Base<T>
 				return _process_errqueue(&mhdr);
 			return this->_log.fail(EINVAL, "Failed to receive data: {}", strerror(errno));
 		}
+		auto user = _rx_user_time();
 		_peer.size = mhdr.msg_namelen;
 		this->_log.trace("Got data from {} {}", _peer, _peer->sa_family);
+		busy_poll_stat_update(this, flags);
 
 		tll_msg_t msg = { TLL_MESSAGE_DATA };
 		msg.size = r;
 		msg.data = _buf.data();
 
+		std::chrono::nanoseconds software = {};
 		if (_timestamping)
-			msg.time = _cmsg_timestamp(&mhdr).count();
+			msg.time = _cmsg_timestamp(&mhdr, &software).count();
 
-		return this->channelT()->_on_data(_peer, msg);
+		auto result = this->channelT()->_on_data(_peer, msg);
+		_rx_latency_update(software, user);
+		return result;
 	}
 
-	int _sendv(long long seq, const iovec *iov, size_t iovlen, const tll::network::sockaddr_any &addr)
+#ifdef __linux__
+	int _process_batch(int flags)
 	{
+		for (auto & i : _rx_hdr) {
+			i.msg_hdr.msg_namelen = sizeof(tll::network::sockaddr_any::buf);
+			if (i.msg_hdr.msg_control)
+				i.msg_hdr.msg_controllen = control_size;
+		}
+
+		auto count = recvmmsg(this->fd(), _rx_hdr.data(), _rx_hdr.size(), 0, nullptr);
+		if (count < 0) {
+			if (errno == EAGAIN)
+				return _process_errqueue();
+			return this->_log.fail(EINVAL, "Failed to receive data: {}", strerror(errno));
+		}
+
+		auto user = _rx_user_time();
+		this->_log.trace("Got batch of {} packets", count);
+		busy_poll_stat_update(this, flags);
+		int result = 0;
+		for (auto i = 0; i < count && this->state() == tll::state::Active; i++) {
+			auto & hdr = _rx_hdr[i].msg_hdr;
+			_peer.size = hdr.msg_namelen;
+			memcpy(_peer.buf, _rx_addr[i].buf, std::min<size_t>(hdr.msg_namelen, sizeof(_peer.buf)));
+
+			long long time = 0;
+			std::chrono::nanoseconds software = {};
+			if (_timestamping)
+				time = _cmsg_timestamp(&hdr, &software).count();
+
+			const size_t size = _rx_hdr[i].msg_len;
+			size_t segment = _gro ? _cmsg_gro(&hdr) : 0;
+			if (segment == 0)
+				segment = size;
+
+			auto data = static_cast<const char *>(_rx_iov[i].iov_base);
+			size_t off = 0;
+			do {
+				tll_msg_t msg = { TLL_MESSAGE_DATA };
+				msg.data = data + off;
+				msg.size = std::min(segment, size - off);
+				msg.time = time;
+				if (auto r = this->channelT()->_on_data(_peer, msg); r && !result)
+					result = r;
+				off += segment;
+			} while (off < size && this->state() == tll::state::Active);
+			_rx_latency_update(software, user);
+		}
+		return result;
+	}
+
+	/// Store packet in send batch, data is copied so iov can be released after the call
+	void _store_tx(long long seq, const iovec *iov, size_t iovlen, const tll::network::sockaddr_any &addr)
+	{
+		auto & p = _tx_packets.emplace_back();
+		p.seq = seq;
+		p.offset = _tx_buf.size();
+		p.addr = addr;
+		for (auto i = 0u; i < iovlen; i++) {
+			auto ptr = static_cast<const char *>(iov[i].iov_base);
+			_tx_buf.insert(_tx_buf.end(), ptr, ptr + iov[i].iov_len);
+		}
+		p.size = _tx_buf.size() - p.offset;
+	}
+
+	/// Check if stored packets can be sent as one UDP_SEGMENT buffer
+	bool _gso_possible() const
+	{
+		static constexpr size_t gso_max_segments = 64;
+		static constexpr size_t gso_max_size = 65507;
+		if (_tx_packets.size() < 2 || _tx_packets.size() > gso_max_segments || _tx_buf.size() > gso_max_size)
+			return false;
+		auto & first = _tx_packets.front();
+		for (auto & p : _tx_packets) {
+			if (p.size > first.size || (p.size < first.size && &p != &_tx_packets.back()))
+				return false;
+			if (p.addr.size != first.addr.size || memcmp(p.addr.buf, first.addr.buf, p.addr.size))
+				return false;
+		}
+		return true;
+	}
+
+	/// Send all stored packets with one sendmsg (GSO) or sendmmsg call
+	int _flush_tx()
+	{
+		if (_tx_packets.empty())
+			return 0;
+		int r = 0;
+		if (_gso && _gso_possible())
+			r = _flush_gso();
+		else
+			r = _flush_mmsg();
+		_tx_buf.clear();
+		_tx_packets.clear();
+		return r;
+	}
+
+	int _flush_gso()
+	{
+		auto & first = _tx_packets.front();
+		this->_log.trace("Post {} bytes of data in {} segments", _tx_buf.size(), _tx_packets.size());
+
+		iovec iov = { _tx_buf.data(), _tx_buf.size() };
+		char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+		msghdr m = {};
+		m.msg_name = first.addr.buf;
+		m.msg_namelen = first.addr.size;
+		m.msg_iov = &iov;
+		m.msg_iovlen = 1;
+		m.msg_control = control;
+		m.msg_controllen = sizeof(control);
+
+		auto cmsg = CMSG_FIRSTHDR(&m);
+		cmsg->cmsg_level = SOL_UDP;
+		cmsg->cmsg_type = UDP_SEGMENT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		uint16_t segment = first.size;
+		memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+
+		auto r = sendmsg(this->fd(), &m, MSG_NOSIGNAL);
+		if (r < 0) {
+			if (errno == EAGAIN)
+				return this->_log.fail(EAGAIN, "Send buffer is full, drop {} packets", _tx_packets.size());
+			return this->_log.fail(errno, "Failed to post data: {}", strerror(errno));
+		} else if ((size_t) r != _tx_buf.size())
+			return this->_log.fail(EMSGSIZE, "Failed to post data (truncated): {} of {}", r, _tx_buf.size());
+		this->channelT()->_on_sent(_tx_packets.back().seq);
+		return 0;
+	}
+
+	int _flush_mmsg()
+	{
+		const auto count = _tx_packets.size();
+		this->_log.trace("Post batch of {} packets", count);
+		_tx_hdr.resize(count);
+		_tx_iov.resize(count);
+		for (auto i = 0u; i < count; i++) {
+			auto & p = _tx_packets[i];
+			_tx_iov[i] = { _tx_buf.data() + p.offset, p.size };
+			auto & hdr = _tx_hdr[i].msg_hdr;
+			hdr = {};
+			hdr.msg_name = p.addr.buf;
+			hdr.msg_namelen = p.addr.size;
+			hdr.msg_iov = &_tx_iov[i];
+			hdr.msg_iovlen = 1;
+		}
+
+		for (size_t sent = 0; sent < count; ) {
+			const auto now = _timestamping_tx && this->_stat_enable ? tll::time::now() : tll::time_point {};
+			auto r = sendmmsg(this->fd(), _tx_hdr.data() + sent, count - sent, MSG_NOSIGNAL);
+			if (r < 0) {
+				if (errno == EAGAIN)
+					return this->_log.fail(EAGAIN, "Send buffer is full, drop {} packets", count - sent);
+				return this->_log.fail(errno, "Failed to post data: {}", strerror(errno));
+			}
+			for (auto i = sent; i < sent + r; i++) {
+				_tx_store_seq(_tx_packets[i].seq, now);
+				if (_tx_hdr[i].msg_len != _tx_packets[i].size)
+					return this->_log.fail(EMSGSIZE, "Failed to post data (truncated): {} of {}", _tx_hdr[i].msg_len, _tx_packets[i].size);
+			}
+			sent += r;
+			this->channelT()->_on_sent(_tx_packets[sent - 1].seq);
+		}
+
+		for (auto i = 0u; _timestamping_tx && i < count; i++) {
+			auto r = _process_errqueue();
+			if (r == EAGAIN)
+				break;
+			else if (r)
+				return r;
+		}
+		return 0;
+	}
+#endif
+
+	int _sendv(long long seq, const iovec *iov, size_t iovlen, const tll::network::sockaddr_any &addr, int flags = 0)
+	{
+#ifdef __linux__
+		if (_batch_tx > 1 && ((flags & TLL_POST_MORE) || _tx_packets.size())) {
+			_store_tx(seq, iov, iovlen, addr);
+			if ((flags & TLL_POST_MORE) && _tx_packets.size() < _batch_tx)
+				return 0;
+			return _flush_tx();
+		}
+#endif
 		size_t size = 0;
 		for (auto i = 0u; i < iovlen; i++)
 			size += iov[i].iov_len;
@@ -335,7 +685,7 @@ class Socket : public tll::channel::Base<T>
 		m.msg_namelen = addr.size;
 		m.msg_iov = (iovec *) iov;
 		m.msg_iovlen = iovlen;
-		_tx_seq[++_tx_idx % _tx_seq.size()] = seq;
+		_tx_store_seq(seq, _timestamping_tx && this->_stat_enable ? tll::time::now() : tll::time_point {});
 
 		auto r = sendmsg(this->fd(), &m, MSG_NOSIGNAL);
 		if (r < 0) {
@@ -344,6 +694,7 @@ class Socket : public tll::channel::Base<T>
 			return this->_log.fail(errno, "Failed to post data: {}", strerror(errno));
 		} else if ((size_t) r != size)
 			return this->_log.fail(errno, "Failed to post data (truncated): {}", strerror(errno));
+		this->channelT()->_on_sent(seq);
 		r = _process_errqueue();
 		if (r == EAGAIN)
 			return 0;
@@ -18,6 +18,7 @@
 #ifdef __linux__
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <sys/timerfd.h>
 #include <unistd.h>
 #elif defined(__FreeBSD__) || defined(__APPLE__)
@@ -30,11 +31,15 @@
 
 #ifdef __cplusplus
 
+#include "tll/processor/recorder.h"
 #include "tll/util/pointer_list.h"
+#include "tll/util/size.h"
 #include "tll/util/time.h"
 
 #include <chrono>
 #include <list>
+#include <memory>
+#include <unordered_map>
 
 namespace tll::processor {
 
@@ -56,6 +61,17 @@ struct PollResult
 };
 
 #ifdef __linux__
+/// Same as struct epoll_params from linux/eventpoll.h, not available in older headers
+struct epoll_params_t
+{
+	uint32_t busy_poll_usecs;
+	uint16_t busy_poll_budget;
+	uint8_t prefer_busy_poll;
+	uint8_t pad;
+};
+
+static constexpr unsigned long epoll_ioctl_set_params = _IOW(0x8A, 0x01, epoll_params_t); // EPIOCSPARAMS
+
 struct EPoll
 {
 	int fd = -1;
@@ -111,6 +127,18 @@ struct EPoll
 		return 0;
 	}
 
+	/// Enable kernel busy polling in epoll_wait, supported since Linux 6.9
+	int busy_poll(tll::duration timeout, unsigned budget, bool prefer)
+	{
+		epoll_params_t params = {};
+		params.busy_poll_usecs = std::chrono::duration_cast<std::chrono::microseconds>(timeout).count();
+		params.busy_poll_budget = budget;
+		params.prefer_busy_poll = prefer;
+		if (ioctl(fd, epoll_ioctl_set_params, &params))
+			return errno;
+		return 0;
+	}
+
 	void _update_helper(int * fd, int events)
 	{
 		epoll_event ev = {};
@@ -296,14 +324,42 @@ struct tll_processor_loop_t
 #endif
 	using StatStep = tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 's', 't', 'e', 'p'>;
 	using StatPoll = tll::stat::Integer<tll::stat::Sum, tll::stat::Ns, 'p', 'o', 'l', 'l'>;
+	using StatBusy = tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'b', 'u', 's', 'y'>;
+	using StatCount = tll::stat::Integer<tll::stat::Sum>;
 
 	tll_stat_block_t * _stat = nullptr;
 	unsigned _stat_step_index = -1;
 	unsigned _stat_poll_index = -1;
+	unsigned _stat_busy_index = -1; ///< Optional field, number of events found by busy polling
+	unsigned _stat_pending_index = -1; ///< Optional field, number of pending list passes
+	unsigned _stat_nofd_index = -1; ///< Optional field, number of nofd list passes
+	unsigned _stat_idle_index = -1; ///< Optional field, number of pending or nofd passes without any data
+	unsigned _stat_poll_buckets = 0; ///< Number of buckets if 'poll' field is histogram
+	unsigned _stat_poll_precision = 0;
 	unsigned _pending_count = 0;
 	unsigned _pending_steps = 0;
 
 	tll::duration _poll_interval = std::chrono::milliseconds(10);
+	tll::duration _busy_poll = {}; ///< Spin on non-blocking poll for this time before sleeping in poll
+
+	/// Per-channel profiling stat, updated on each sampled process call
+	struct ProfileStat
+	{
+		tll::stat::Integer<tll::stat::Last, tll::stat::Unknown, 's', 'a', 'm', 'p', 'l', 'e'> sample;
+		tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'a', 'g', 'a', 'i', 'n'> again;
+		tll::stat::Histogram<tll::stat::Ns, 't', 'i', 'm', 'e'> time;
+	};
+
+	using ProfileBlock = tll::stat::Block<ProfileStat>;
+
+	unsigned _profile_sample = 0; ///< Profile each Nth process call, 0 to disable
+	unsigned _profile_count = 0;
+	std::unordered_map<const tll::Channel *, std::unique_ptr<ProfileBlock>> _profile;
+
+	std::unique_ptr<tll::processor::Recorder> _recorder; ///< Flight recorder, disabled if empty
+	tll::duration _recorder_threshold = {}; ///< Record process calls longer then this value
+	bool _recorder_dump_error = true; ///< Dump recorder when channel enters Error state
+	unsigned _callback_mask = TLL_MESSAGE_MASK_CHANNEL | TLL_MESSAGE_MASK_STATE;
 
 	tll::Logger _log;
 
@@ -336,14 +392,34 @@ struct tll_processor_loop_t
 		time_cache_enable = reader.getT("time-cache", false);
 		if (_poll_enable)
 			_pending_steps = reader.getT("pending-steps", 8u);
+		_busy_poll = reader.getT<tll::duration>("busy-poll", tll::duration {});
+		auto busy_poll_budget = reader.getT("busy-poll-budget", 0u);
+		auto busy_poll_prefer = reader.getT("prefer-busy-poll", false);
+		_profile_sample = reader.getT("profile", 0u);
+		auto recorder_size = reader.getT("recorder", tll::util::Size { 0 });
+		_recorder_threshold = reader.getT<tll::duration>("recorder-threshold", tll::duration {});
+		_recorder_dump_error = reader.getT("recorder-dump-on-error", true);
 
 		_log = { name.size() ? name : "tll.processor.loop" };
 		if (!reader)
 			return _log.fail(EINVAL, "Invalid parameters: {}", reader.error());
 
+		if (recorder_size) {
+			_recorder.reset(new tll::processor::Recorder);
+			if (_recorder->init(recorder_size))
+				return _log.fail(EINVAL, "Flight recorder size {} is too small", recorder_size);
+			_callback_mask |= TLL_MESSAGE_MASK_DATA | TLL_MESSAGE_MASK_CONTROL;
+		}
+
 		if (_poll_enable) {
 			if (_poll.init(_log, nofd_interval))
 				return _log.fail(EINVAL, "Failed to init poll subsystem");
+#ifdef __linux__
+			if (_busy_poll.count()) {
+				if (auto r = _poll.busy_poll(_busy_poll, busy_poll_budget, busy_poll_prefer); r)
+					_log.info("Kernel busy polling in epoll is not available: {}", strerror(r));
+			}
+#endif
 		}
 
 		return 0;
@@ -358,20 +434,41 @@ struct tll_processor_loop_t
 		auto page = tll::stat::acquire(block);
 		if (!page)
 			return _log.fail(EINVAL, "Failed to set stat: unable to acquire page");
-		int step = -1, poll = -1;
+		int step = -1, poll = -1, busy = -1, pending = -1, nofd = -1, idle = -1;
+		_stat_poll_buckets = 0;
+		auto end = static_cast<tll::stat::Field *>(page->fields + page->size);
 		for (auto i = 0u; i < page->size; i++) {
-			auto f = static_cast<const tll::stat::Field *>(page->fields + i);
-			if (f->name() == "step")
+			auto f = static_cast<tll::stat::Field *>(page->fields + i);
+			if (auto hist = tll::stat::HistogramView::parse(f, end); hist) {
+				if (hist.name() == "poll") {
+					poll = i;
+					_stat_poll_buckets = hist.buckets();
+					_stat_poll_precision = hist.precision();
+				}
+				i += hist.size() - 1;
+			} else if (f->name() == "step")
 				step = i;
 			else if (f->name() == "poll")
 				poll = i;
+			else if (f->name() == "busy")
+				busy = i;
+			else if (f->name() == "pending")
+				pending = i;
+			else if (f->name() == "nofd")
+				nofd = i;
+			else if (f->name() == "idle")
+				idle = i;
 		}
 		tll::stat::release(block, page);
 		if (step == -1 || poll == -1)
 			return _log.fail(ENOENT, "Failed to set stat: required fields 'step' and 'poll' not found");
-		_log.debug("Stat index: step {}, poll {}", step, poll);
+		_log.debug("Stat index: step {}, poll {}{}", step, poll, _stat_poll_buckets ? " (histogram)" : "");
 		_stat_step_index = step;
 		_stat_poll_index = poll;
+		_stat_busy_index = busy;
+		_stat_pending_index = pending;
+		_stat_nofd_index = nofd;
+		_stat_idle_index = idle;
 		_stat = block;
 		if (_poll_enable)
 			time_cache_enable = false;
@@ -391,8 +488,10 @@ struct tll_processor_loop_t
 	~tll_processor_loop_t()
 	{
 		for (auto c : list) {
-			if (c) c->callback_del(this, TLL_MESSAGE_MASK_CHANNEL | TLL_MESSAGE_MASK_STATE);
+			if (c) c->callback_del(this, _callback_mask);
 		}
+		for (auto & [c, block] : _profile)
+			tll_stat_list_remove(c->context().stat_list(), block.get());
 	}
 
 	bool pending() { _log.debug("Pending check: {}, {}", list_nofd.size(), list_pending.size()); return list_nofd.size() + list_pending.size(); }
@@ -425,30 +524,36 @@ struct tll_processor_loop_t
 						}
 					}
 					_log.trace("Process pending: {} channels", list_pending.size());
-					process_list(list_pending);
+					_stat_list(_stat_pending_index, process_list(list_pending));
 					return nullptr;
 				} else
 					_pending_count = 0;
 			}
 			if (_stat)
 				start = tll::time::now();
-			auto [r, events] = _poll.poll(timeout);
+			unsigned busy = 0;
+			auto [r, events] = _poll_wait(timeout, busy);
 			if (_stat) {
 				std::chrono::nanoseconds dt = tll::time::now() - start;
 				if (auto s = tll::stat::acquire(_stat); s) {
 					static_cast<StatStep *>(s->fields + _stat_step_index)->update(1);
-					static_cast<StatPoll *>(s->fields + _stat_poll_index)->update(dt.count());
+					if (_stat_poll_buckets)
+						tll::stat::HistogramView(static_cast<tll::stat::Field *>(s->fields + _stat_poll_index), _stat_poll_precision, _stat_poll_buckets).update(dt.count());
+					else
+						static_cast<StatPoll *>(s->fields + _stat_poll_index)->update(dt.count());
+					if (busy && _stat_busy_index != -1u)
+						static_cast<StatBusy *>(s->fields + _stat_busy_index)->update(1);
 					tll::stat::release(_stat, s);
 				}
 			} else if (time_cache_enable)
 				tll::time::now();
 			if (_poll.is_pending(r)) {
 				_log.trace("Process pending: {} channels", list_pending.size());
-				process_list(list_pending, TLL_PROCESS_PENDING);
+				_stat_list(_stat_pending_index, process_list(list_pending, TLL_PROCESS_PENDING));
 				return nullptr;
 			} else if (_poll.is_nofd(r)) {
 				_log.trace("Process nofd: {} channels", list_nofd.size());
-				process_list(list_nofd);
+				_stat_list(_stat_nofd_index, process_list(list_nofd));
 				_poll.nofd_flush();
 				return nullptr;
 			} else if (_poll.is_timeout(r)) {
@@ -459,7 +564,7 @@ struct tll_processor_loop_t
 				auto c = static_cast<tll::Channel *>(r);
 				_log.trace("Poll on {}", c->name());
 				if constexpr (Process)
-					c->process(events);
+					process(c, events | busy);
 				return c;
 			}
 			return nullptr;
@@ -473,17 +578,97 @@ struct tll_processor_loop_t
 		}
 		if (time_cache_enable)
 			tll::time::now();
-		process_list(list_pending);
-		process_list(list_process);
+		process_list(list_pending, TLL_PROCESS_BUSY_POLL);
+		process_list(list_process, TLL_PROCESS_BUSY_POLL);
 		return nullptr;
 	}
 
+	/**
+	 * Wait for event, if busy poll budget is set then first spin on non-blocking poll and set @p busy
+	 * flag if channel fd event was found. Spin time is included into timeout.
+	 */
+	tll::processor::loop::PollResult _poll_wait(tll::duration timeout, unsigned &busy)
+	{
+		if (_busy_poll.count() == 0 || timeout.count() == 0)
+			return _poll.poll(timeout);
+		const auto budget = std::min(timeout, _busy_poll);
+		const auto end = tll::time::now() + budget;
+		do {
+			auto r = _poll.poll({});
+			if (!_poll.is_timeout(r.ptr)) {
+				// Pending and nofd pseudo-events are not found by polling, count only channel events
+				if (!_poll.is_pending(r.ptr) && !_poll.is_nofd(r.ptr) && !_poll.is_error(r.ptr))
+					busy = TLL_PROCESS_BUSY_POLL;
+				return r;
+			}
+		} while (!stop && tll::time::now() < end);
+		return _poll.poll(timeout - budget);
+	}
+
+	/// Update list pass counter and idle counter if no channel produced data
+	void _stat_list(unsigned index, int r)
+	{
+		if (!_stat || index == -1u)
+			return;
+		if (auto s = tll::stat::acquire(_stat); s) {
+			static_cast<StatCount *>(s->fields + index)->update(1);
+			if (r == EAGAIN && _stat_idle_index != -1u)
+				static_cast<StatCount *>(s->fields + _stat_idle_index)->update(1);
+			tll::stat::release(_stat, s);
+		}
+	}
+
+	int process(tll::Channel * c, unsigned flags)
+	{
+		if (!_recorder || !_recorder_threshold.count())
+			return _process(c, flags);
+		auto start = tll::time::now();
+		auto r = _process(c, flags);
+		auto dt = tll::time::now() - start;
+		if (dt > _recorder_threshold)
+			_recorder->process(c, dt);
+		return r;
+	}
+
+	int _process(tll::Channel * c, unsigned flags)
+	{
+		if (!_profile_sample || ++_profile_count < _profile_sample)
+			return c->process(flags);
+		_profile_count = 0;
+		return _process_profile(c, flags);
+	}
+
+	/// Sampled process call: measure time and report it into per-channel stat block
+	int _process_profile(tll::Channel * c, unsigned flags)
+	{
+		auto start = tll::time::now();
+		auto r = c->process(flags);
+		std::chrono::nanoseconds dt = tll::time::now() - start;
+
+		auto it = _profile.find(c);
+		if (it == _profile.end()) {
+			auto block = std::make_unique<ProfileBlock>(fmt::format("{}/profile", c->name()));
+			if (tll_stat_list_add(c->context().stat_list(), block.get()))
+				_log.warning("Failed to add profile stat for channel {}", c->name());
+			it = _profile.emplace(c, std::move(block)).first;
+		}
+
+		if (auto page = it->second->acquire(); page) {
+			page->sample = _profile_sample;
+			if (r == EAGAIN)
+				page->again = 1;
+			page->time = dt.count();
+			it->second->release(page);
+		}
+		return r;
+	}
+
 	int process_list(tll::processor::List<tll::Channel> &l, unsigned flags = 0)
 	{
 		int r = 0;
 		for (unsigned i = 0; i < l.size(); i++) {
 			if (l[i] == nullptr) continue;
-			r |= l[i]->process(flags) ^ EAGAIN;
+			r |= process(l[i], flags) ^ EAGAIN;
 		}
 		return r == 0 ? EAGAIN : 0;
 	}
@@ -491,7 +676,9 @@ struct tll_processor_loop_t
 	int add(tll::Channel *c)
 	{
 		_log.debug("Add channel {} with fd {}", c->name(), c->fd());
-		c->callback_add(this, TLL_MESSAGE_MASK_CHANNEL | TLL_MESSAGE_MASK_STATE);
+		c->callback_add(this, _callback_mask);
+		if (_recorder)
+			_recorder->name_add(c);
 		list.push_back(c);
 
 		process_add(c, c->fd(), c->dcaps());
@@ -577,7 +764,12 @@ struct tll_processor_loop_t
 			break;
 		}
 
-		const_cast<tll::Channel *>(c)->callback_del(this, TLL_MESSAGE_MASK_CHANNEL | TLL_MESSAGE_MASK_STATE);
+		if (auto it = _profile.find(c); it != _profile.end()) {
+			tll_stat_list_remove(c->context().stat_list(), it->second.get());
+			_profile.erase(it);
+		}
+
+		const_cast<tll::Channel *>(c)->callback_del(this, _callback_mask);
 		return 0;
 	}
 
@@ -626,8 +818,28 @@ struct tll_processor_loop_t
 		return 0;
 	}
 
+	/// Dump flight recorder into the log
+	int recorder_dump(std::string_view reason)
+	{
+		if (!_recorder)
+			return ENOENT;
+		tll::Logger log(fmt::format("{}.recorder", _log.name()));
+		_recorder->dump(log, reason);
+		return 0;
+	}
+
 	int callback(const tll::Channel *c, const tll_msg_t *msg)
 	{
+		if (msg->type == TLL_MESSAGE_DATA || msg->type == TLL_MESSAGE_CONTROL) {
+			if (_recorder)
+				_recorder->message(c, msg);
+			return 0;
+		}
+		if (msg->type == TLL_MESSAGE_STATE && _recorder) {
+			_recorder->state(c, (tll_state_t) msg->msgid);
+			if (msg->msgid == tll::state::Error && _recorder_dump_error)
+				recorder_dump(fmt::format("channel {} failed", c->name()));
+		}
 		if (msg->type == TLL_MESSAGE_STATE) {
 			if (msg->msgid == tll::state::Opening) {
 				_log.debug("Enable opening channel {}", c->name());
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2024 Pavel Shramov <shramov@mexmat.net>
+ *
+ * tll is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef _TLL_PROCESSOR_RECORDER_H
+#define _TLL_PROCESSOR_RECORDER_H
+
+#include "tll/channel.h"
+#include "tll/channel/base.h"
+#include "tll/cppring.h"
+#include "tll/logger.h"
+#include "tll/util/time.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace tll::processor {
+
+/**
+ * Flight recorder: fixed size ring of recent loop events.
+ *
+ * Records are written into PubRing, when there is no space oldest records are dropped. Recording
+ * does not allocate or format anything, channel names are resolved only when ring is dumped.
+ */
+class Recorder
+{
+ public:
+	enum class Type : uint8_t
+	{
+		Message = 0, ///< Data or control message, value is message size
+		State = 1, ///< State change, value is new state
+		Process = 2, ///< Process call exceeding threshold, value is duration in ns
+	};
+
+	struct record_t
+	{
+		int64_t time;
+		const tll_channel_t * channel;
+		Type type;
+		uint8_t reserved;
+		int16_t msgtype;
+		int32_t msgid;
+		int64_t seq;
+		int64_t value;
+	};
+
+	static_assert(sizeof(record_t) == 40);
+
+ private:
+	std::unique_ptr<tll::PubRing> _ring;
+	std::unordered_map<const tll_channel_t *, std::string> _names;
+
+ public:
+	int init(size_t size)
+	{
+		if (size < 4 * sizeof(record_t))
+			return ERANGE;
+		_ring = tll::PubRing::allocate(size);
+		return 0;
+	}
+
+	const tll::PubRing * ring() const { return _ring.get(); }
+
+	/// Remember channel name, it is kept after channel is destroyed
+	void name_add(const tll::Channel * c) { _names[c] = c->name(); }
+
+	void push(const record_t &r)
+	{
+		void * data;
+		while (_ring->write_begin(&data, sizeof(r)))
+			_ring->shift();
+		memcpy(data, &r, sizeof(r));
+		_ring->write_end(data, sizeof(r));
+	}
+
+	void message(const tll::Channel * c, const tll_msg_t * msg)
+	{
+		push({ tll::time::now_cached().time_since_epoch().count(), c, Type::Message, 0, msg->type, msg->msgid, msg->seq, (int64_t) msg->size });
+	}
+
+	void state(const tll::Channel * c, tll_state_t s)
+	{
+		push({ tll::time::now_cached().time_since_epoch().count(), c, Type::State, 0, 0, 0, 0, s });
+	}
+
+	void process(const tll::Channel * c, tll::duration dt)
+	{
+		push({ tll::time::now_cached().time_since_epoch().count(), c, Type::Process, 0, 0, 0, 0, std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count() });
+	}
+
+	/// Call function for each record, from oldest to newest
+	template <typename F>
+	void for_each(F f) const
+	{
+		auto it = _ring->begin();
+		const void * data;
+		size_t size;
+		while (it.read(&data, &size) == 0) {
+			if (size == sizeof(record_t))
+				f(*static_cast<const record_t *>(data));
+			if (it.shift())
+				break;
+		}
+	}
+
+	std::string_view name(const tll_channel_t * c) const
+	{
+		auto it = _names.find(c);
+		if (it == _names.end())
+			return "<unknown>";
+		return it->second;
+	}
+
+	void dump(tll::Logger &log, std::string_view reason) const
+	{
+		log.info("Flight recorder dump: {}", reason);
+		for_each([this, &log](const record_t &r) {
+			auto ts = tll::conv::to_string(tll::time_point(tll::duration(r.time)));
+			switch (r.type) {
+			case Type::Message:
+				log.info("{} {}: message type {}, msgid {}, seq {}, size {}", ts, name(r.channel), r.msgtype, r.msgid, r.seq, r.value);
+				break;
+			case Type::State:
+				log.info("{} {}: state {}", ts, name(r.channel), tll_state_str((tll_state_t) r.value));
+				break;
+			case Type::Process:
+				log.info("{} {}: process took {}ns", ts, name(r.channel), r.value);
+				break;
+			}
+		});
+		log.info("Flight recorder dump finished");
+	}
+};
+
+} // namespace tll::processor
+
+#endif//_TLL_PROCESSOR_RECORDER_H
@@ -5,7 +5,7 @@
 
 namespace processor_scheme {
 
-static constexpr std::string_view scheme_string = R"(yamls+gz://eJydkj1vgzAQhvf8Cm8sIAVCacJW5WOrOlSdqg5ufFBLYKhtWqUR/71nIOYrUaUu6A4/9nvv3XlE0Bxi4jxrqmFX5aWzIISzmITLTbTwRscvJcOvBXw/wBBElasYA9JRTkzO+lTirYoLvXYbAv85D0fNv8xx4BJnmxUKGCbLLuEixWyF2Q6UlsUJszvM9lIWEuMQ46cSRMv5dY2S71xfpA8ZTdVY2o/cliCv586G0jQFxyVFkijQjbjiP2Dec4mFKoU6bID5PfZmdBMOGeuUPXvv+EGFgAzvtTWgmjTV1hNONV2yVNu0KZQ0fizU2qsnAzHz2mOldiLBuiceQSnj9ma95uleoWnYrIxcpZyNoFUwNwSfIyQKZwhlTPZMdR3C7aJXujd1dCjkN5UD1/fRTY8Md+nPgYx1L30bCG/byTY728tugn+swi+FCgLh)";
+static constexpr std::string_view scheme_string = R"(yamls+gz://eJylk01vgzAMhu/9FblxoVJJGWu5Tf24VZM27TTtkDWGRQPCktCqq/jvMx+FQksnbRcUwxO/fm0zJgmLwSfWs2EGllmcWiNCBPeJO5l7o3Hn80vK8dkAjkPxCEkWax8PpKYsnxzNIcVbmUjMzC4JfGc9bI3YFZ+pTaxFJDVwDCZ1IJIQoylGS9BGyQNGdxitlJIKzy6eH1NIKs7Jc5R8F+YkvY5YqLvSjmdXBHk91ja0YSFYNpFBoMGU4lp8Q5HPJg2UadThZ5jTYm+FbiAg4rXyuLm3/WBJAhHeq2pANVVUm/c4XXapoaqm9aGg9NNAlb28N5BiXiustJkInbXEBrQu3A7WW6RuFcqGXZQR61DwDjSll4bgq4N47gXCOFctk12HcLvYle71Ha2l2jN15vreG/TIcZd+HUhX99S3M+FFNdlyZ1vZOf3DKjQ5n2ArFQfV+efoZDaYcy/VJ6hbKesyN3LXVkmp+++FHVT+AQkCP+s=)";
 
 struct StateDump
 {
@@ -226,6 +226,66 @@ struct ChannelClose
 	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
 };
 
+struct RecorderDump
+{
+	static constexpr size_t meta_size() { return 8; }
+	static constexpr std::string_view meta_name() { return "RecorderDump"; }
+	static constexpr int meta_id() { return 4208; }
+	static constexpr size_t offset_worker = 0;
+
+	template <typename Buf>
+	struct binder_type : public tll::scheme::Binder<Buf>
+	{
+		using tll::scheme::Binder<Buf>::Binder;
+
+		static constexpr auto meta_size() { return RecorderDump::meta_size(); }
+		static constexpr auto meta_name() { return RecorderDump::meta_name(); }
+		static constexpr auto meta_id() { return RecorderDump::meta_id(); }
+		void view_resize() { this->_view_resize(meta_size()); }
+
+		std::string_view get_worker() const { return this->template _get_string<tll_scheme_offset_ptr_t>(offset_worker); }
+		void set_worker(std::string_view v) { return this->template _set_string<tll_scheme_offset_ptr_t>(offset_worker, v); }
+	};
+
+	template <typename Buf>
+	static binder_type<Buf> bind(Buf &buf, size_t offset = 0) { return binder_type<Buf>(tll::make_view(buf).view(offset)); }
+
+	template <typename Buf>
+	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
+};
+
+struct ChannelMove
+{
+	static constexpr size_t meta_size() { return 16; }
+	static constexpr std::string_view meta_name() { return "ChannelMove"; }
+	static constexpr int meta_id() { return 4224; }
+	static constexpr size_t offset_channel = 0;
+	static constexpr size_t offset_worker = 8;
+
+	template <typename Buf>
+	struct binder_type : public tll::scheme::Binder<Buf>
+	{
+		using tll::scheme::Binder<Buf>::Binder;
+
+		static constexpr auto meta_size() { return ChannelMove::meta_size(); }
+		static constexpr auto meta_name() { return ChannelMove::meta_name(); }
+		static constexpr auto meta_id() { return ChannelMove::meta_id(); }
+		void view_resize() { this->_view_resize(meta_size()); }
+
+		std::string_view get_channel() const { return this->template _get_string<tll_scheme_offset_ptr_t>(offset_channel); }
+		void set_channel(std::string_view v) { return this->template _set_string<tll_scheme_offset_ptr_t>(offset_channel, v); }
+
+		std::string_view get_worker() const { return this->template _get_string<tll_scheme_offset_ptr_t>(offset_worker); }
+		void set_worker(std::string_view v) { return this->template _set_string<tll_scheme_offset_ptr_t>(offset_worker, v); }
+	};
+
+	template <typename Buf>
+	static binder_type<Buf> bind(Buf &buf, size_t offset = 0) { return binder_type<Buf>(tll::make_view(buf).view(offset)); }
+
+	template <typename Buf>
+	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
+};
+
 } // namespace processor_scheme
 
 template <>
@@ -193,6 +193,65 @@ class List : public Base<Buf>
 
 	size_t size() const { return optr()->size; }
 
+	/** Check that list data is inside buffer
+	 *
+	 * Offset pointer, optional entity size header and all elements are checked against buffer
+	 * bounds, elements with variable size are validated recursively. If check succeeds
+	 * accessors of the list and its elements can be used without any additional checks.
+	 */
+	bool validate()
+	{
+		const size_t bsize = this->_buf.size();
+		if (bsize < sizeof(Ptr))
+			return false;
+		auto ptr = optr();
+		if (ptr->size == 0)
+			return true;
+		if constexpr (std::is_same_v<Ptr, tll_scheme_offset_ptr_t>) {
+			if (ptr->entity == 0xff && ptr->offset + sizeof(uint32_t) > bsize)
+				return false;
+		}
+		const size_t entity = entity_size();
+		if (entity < entity_size_static())
+			return false;
+		const size_t offset = ptr->data_offset();
+		if (offset > bsize)
+			return false;
+		if (entity && (bsize - offset) / entity < ptr->size)
+			return false;
+		if constexpr (is_binder) {
+			if constexpr (!T::meta_fixed()) {
+				for (auto i : *this) {
+					if (!i.validate())
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	/** Access list data as array of fixed size records
+	 *
+	 * Return pointer to first element casted to R or nullptr if entity size is different from
+	 * size of R. Can be used with packed structures generated by ``tll-schemegen``, bounds are not
+	 * checked so list should be validated before.
+	 */
+	template <typename R>
+	add_const_t<R> * dataT()
+	{
+		if (entity_size() != sizeof(R))
+			return nullptr;
+		return this->_buf.view(optr()->data_offset()).template dataT<R>();
+	}
+
+	template <typename R>
+	const R * dataT() const
+	{
+		if (entity_size() != sizeof(R))
+			return nullptr;
+		return this->_buf.view(optr()->data_offset()).template dataT<R>();
+	}
+
 	iterator begin()
 	{
 		if constexpr (is_binder)
@@ -277,6 +336,7 @@ class String : public List<Buf, char, Ptr>
 	using const_iterator = typename pointer_type::const_iterator;
 
 	static constexpr size_t meta_size() { return sizeof(Ptr); }
+	static constexpr bool meta_fixed() { return false; }
 
 	String(view_type view) : List<Buf, char, Ptr>(view) {}
 
@@ -5,7 +5,7 @@
 
 namespace stat_scheme {
 
-static constexpr std::string_view scheme_string = R"(yamls+gz://eJy1VF1LwzAUfd+vyFtAWthUVProw2TgRBjzRWRkbdYF26Q0yXSM/Hdv0vTDlm4v+pQb7sm5534lRJzkNEIYTxAShWKCywidcFwUofXIgsQUg18qojYy3tOc4gDhAy0lYK1nhg28pVznMgIDIbykai8S8J3UsQByzbh6CBzEcj8TqcB5AzRL8g3WtbWYJZuBtdI5WFNjKrI1Z2qU6vGoqPTvXlaeas0/ufjiniSsM1y8kUxTm+eO0SzxYkN08v68Uh2gKlKdhenBDo6lQYGeu1vcCTP/lzCJ0NuMduMsnkqhi/E4sdBctQS6FtpTA2Uf5NKDQI8uQMghPSd1/vdSmyBntI5gLom1Eq1Wzd0yjKq2R0u0hUm8h2tnh6ynWp2S8RSbvhBtJ7shcHN+YQqcJLi6M0LvNYz1cH7UTdAQ7XqI+QDBUteklqNqWpejh/BtNR+d6r2S1M0+S2App+O1E0lHTF2gswUeASmWD7bxVxdKKkWmlf+suLS/V90Z+3hTCHg17E4lvKW+qgbDTH4A5xiNyw==)";
+static constexpr std::string_view scheme_string = R"(yamls+gz://eJzNVctqwzAQvPcrdBOUGJK+42MPbgNNKYT0UkpQYsURjSURSWlD8L93JT9j13EOLfTkNTuaHe2uxx7iJKY+wvgMISE1E1z5aI8XUno2oyRZUAx5pYmeqcWKxhT3EN7SjQKszQxwAmcpN7HyIUAIj6leiRBye72TQG4Y13c9B7HcT0RpSF4CzZh8QXRhI2bJBhBNTAxRP0lSsilnupXqfqepys49TzKqKf/g4pNnJF5+w9ErWRtq77lkdB1mYj20z/JxqrqH0kr5LZIabOtYChToubnClTLBn5QJhZmvabXO6GEjjGyvsxCG65LA5EJraqDtjbvUIDCjDgjZRsekBr8vtShyRGsLpkPs6JHBev7jth5i5HW/i0YOT4AMT4D8gClnbLtl22a485DWBtpHyTOHD/gWXivWYzOp42wYj3BSF2KsIRQEzh46Ph4nCV7d00dvOYzVcJlDJL2CaFlDBA0Ei9xulxzprlc5aoiggWAru3IlhdvA5L3S3RcSOUthIXhdv723IqyIzRt4dAAtIM3ihskdTGlDlVgbnf0DuLI/hXxy9vBMCjjVnF4qvKQ+TxcnOfsGTn7uew==)";
 
 enum class Method: uint8_t
 {
@@ -158,9 +158,63 @@ struct FGroup
 	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
 };
 
+struct IHist
+{
+	static constexpr size_t meta_size() { return 64; }
+	static constexpr std::string_view meta_name() { return "IHist"; }
+
+	template <typename Buf>
+	struct binder_type : public tll::scheme::Binder<Buf>
+	{
+		using tll::scheme::Binder<Buf>::Binder;
+
+		static constexpr auto meta_size() { return IHist::meta_size(); }
+		static constexpr auto meta_name() { return IHist::meta_name(); }
+		void view_resize() { this->_view_resize(meta_size()); }
+
+		using type_count = uint64_t;
+		type_count get_count() const { return this->template _get_scalar<type_count>(0); }
+		void set_count(type_count v) { return this->template _set_scalar<type_count>(0, v); }
+
+		using type_min = int64_t;
+		type_min get_min() const { return this->template _get_scalar<type_min>(8); }
+		void set_min(type_min v) { return this->template _set_scalar<type_min>(8, v); }
+
+		using type_max = int64_t;
+		type_max get_max() const { return this->template _get_scalar<type_max>(16); }
+		void set_max(type_max v) { return this->template _set_scalar<type_max>(16, v); }
+
+		using type_avg = double;
+		type_avg get_avg() const { return this->template _get_scalar<type_avg>(24); }
+		void set_avg(type_avg v) { return this->template _set_scalar<type_avg>(24, v); }
+
+		using type_p50 = int64_t;
+		type_p50 get_p50() const { return this->template _get_scalar<type_p50>(32); }
+		void set_p50(type_p50 v) { return this->template _set_scalar<type_p50>(32, v); }
+
+		using type_p90 = int64_t;
+		type_p90 get_p90() const { return this->template _get_scalar<type_p90>(40); }
+		void set_p90(type_p90 v) { return this->template _set_scalar<type_p90>(40, v); }
+
+		using type_p99 = int64_t;
+		type_p99 get_p99() const { return this->template _get_scalar<type_p99>(48); }
+		void set_p99(type_p99 v) { return this->template _set_scalar<type_p99>(48, v); }
+
+		using type_p999 = int64_t;
+		type_p999 get_p999() const { return this->template _get_scalar<type_p999>(56); }
+		void set_p999(type_p999 v) { return this->template _set_scalar<type_p999>(56, v); }
+	};
+
+	template <typename Buf>
+	static binder_type<Buf> bind(Buf &buf, size_t offset = 0) { return binder_type<Buf>(tll::make_view(buf).view(offset)); }
+
+	template <typename Buf>
+	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
+};
+
 struct Field
 {
-	static constexpr size_t meta_size() { return 41; }
+	static constexpr size_t meta_size() { return 73; }
 	static constexpr std::string_view meta_name() { return "Field"; }
 
 	template <typename Buf>
@@ -196,6 +250,13 @@ struct Field
 		FGroup::binder_type<Buf> unchecked_fgroup() { return this->template _get_binder<FGroup::binder_type<Buf>>(1); }
 		FGroup::binder_type<Buf> unchecked_fgroup() const { return this->template _get_binder<FGroup::binder_type<Buf>>(1); }
 		FGroup::binder_type<Buf> set_fgroup() { this->_set_type(index_fgroup); return this->template _get_binder<FGroup::binder_type<Buf>>(1); }
+
+		static constexpr union_index_type index_ihist = 4;
+		using type_ihist = IHist::binder_type<Buf>;
+		std::optional<IHist::binder_type<Buf>> get_ihist() const { if (this->union_type() != index_ihist) return std::nullopt; return unchecked_ihist(); }
+		IHist::binder_type<Buf> unchecked_ihist() { return this->template _get_binder<IHist::binder_type<Buf>>(1); }
+		IHist::binder_type<Buf> unchecked_ihist() const { return this->template _get_binder<IHist::binder_type<Buf>>(1); }
+		IHist::binder_type<Buf> set_ihist() { this->_set_type(index_ihist); return this->template _get_binder<IHist::binder_type<Buf>>(1); }
 	};
 
 
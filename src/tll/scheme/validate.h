@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#ifndef _TLL_SCHEME_VALIDATE_H
+#define _TLL_SCHEME_VALIDATE_H
+
+#include "tll/scheme.h"
+#include "tll/scheme/error-stack.h"
+#include "tll/scheme/util.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace tll::scheme {
+
+/**
+ * Check that binary data is consistent with scheme: message is not shorter then fixed part, offset
+ * pointers and list elements are inside data, array counts and union types are in range.
+ *
+ * For each message flat list of checks is compiled in @ref init: fixed size fields are covered by
+ * single size check, nested messages are inlined into parent plan and only variable parts (offset
+ * pointers, arrays and unions) are inspected for each message.
+ */
+struct Validate : public ErrorStack
+{
+	struct Plan;
+
+	/// Check of one variable field
+	struct Check
+	{
+		enum Type { Pointer, Array, Union };
+
+		Type type = Pointer;
+		/// Field descriptor
+		const Field * field = nullptr;
+		/// Offset of field from the start of data described by the plan
+		size_t offset = 0;
+		/// Fields from the plan root to this field, used for error reporting
+		std::vector<const Field *> path;
+		/// Element plan for pointers and arrays, per variant plans for unions. Null if no checks needed
+		std::vector<std::unique_ptr<Plan>> nested;
+	};
+
+	/// Compiled checks for message or list element
+	struct Plan
+	{
+		/// Size of fixed part
+		size_t size = 0;
+		std::vector<Check> checks;
+	};
+
+	std::map<int, Plan> plans;
+
+	/// Compile plans for all messages with non-zero message id
+	int init(const Scheme * scheme)
+	{
+		plans.clear();
+		for (auto m = scheme->messages; m; m = m->next) {
+			if (!m->msgid)
+				continue;
+			auto & plan = plans[m->msgid];
+			plan.size = m->size;
+			std::vector<const Field *> path;
+			for (auto f = m->fields; f; f = f->next) {
+				path.push_back(f);
+				compile(plan, f, f->offset, path);
+				path.pop_back();
+			}
+		}
+		return 0;
+	}
+
+	const Plan * lookup(int msgid) const
+	{
+		auto it = plans.find(msgid);
+		if (it == plans.end())
+			return nullptr;
+		return &it->second;
+	}
+
+	/// Validate message body, returns error code and fills error stack on failure
+	template <typename View>
+	int validate(int msgid, const View &data)
+	{
+		auto plan = lookup(msgid);
+		if (!plan)
+			return fail(ENOENT, "Message {} not found", msgid);
+		return validate(*plan, data);
+	}
+
+	template <typename View>
+	int validate(const Plan &plan, const View &data)
+	{
+		if (data.size() < plan.size)
+			return fail(EMSGSIZE, "Data size {} is less then fixed size {}", data.size(), plan.size);
+		for (auto & c : plan.checks) {
+			if (auto r = validate(c, data.view(c.offset)); r) {
+				for (auto f = c.path.rbegin(); f != c.path.rend(); f++)
+					error_stack.push_back(*f);
+				return r;
+			}
+		}
+		return 0;
+	}
+
+ private:
+	static std::unique_ptr<Plan> compile_element(const Field * field)
+	{
+		auto plan = std::make_unique<Plan>();
+		plan->size = field->size;
+		std::vector<const Field *> path;
+		compile(*plan, field, 0, path);
+		if (plan->checks.empty())
+			return nullptr;
+		return plan;
+	}
+
+	static void compile(Plan &plan, const Field * field, size_t offset, std::vector<const Field *> &path)
+	{
+		switch (field->type) {
+		case Field::Message:
+			for (auto f = field->type_msg->fields; f; f = f->next) {
+				path.push_back(f);
+				compile(plan, f, offset + f->offset, path);
+				path.pop_back();
+			}
+			return;
+		case Field::Pointer: {
+			auto & c = plan.checks.emplace_back(Check { Check::Pointer, field, offset, path });
+			c.nested.push_back(compile_element(field->type_ptr));
+			return;
+		}
+		case Field::Array: {
+			auto & c = plan.checks.emplace_back(Check { Check::Array, field, offset, path });
+			c.nested.push_back(compile_element(field->type_array));
+			return;
+		}
+		case Field::Union: {
+			auto & c = plan.checks.emplace_back(Check { Check::Union, field, offset, path });
+			for (auto i = 0u; i < field->type_union->fields_size; i++)
+				c.nested.push_back(compile_element(field->type_union->fields + i));
+			return;
+		}
+		default:
+			return;
+		}
+	}
+
+	template <typename View>
+	int validate(const Check &c, const View &data)
+	{
+		switch (c.type) {
+		case Check::Pointer: return validate_pointer(c, data);
+		case Check::Array: return validate_array(c, data);
+		case Check::Union: return validate_union(c, data);
+		}
+		return fail(EINVAL, "Unknown check type {}", (int) c.type);
+	}
+
+	template <typename View>
+	int validate_pointer(const Check &c, const View &data)
+	{
+		auto field = c.field;
+		if (field->offset_ptr_version == TLL_SCHEME_OFFSET_PTR_DEFAULT) {
+			auto ptr = data.template dataT<tll_scheme_offset_ptr_t>();
+			if (ptr->entity == 0xff && ptr->offset + sizeof(uint32_t) > data.size())
+				return fail(EINVAL, "Entity size out of bounds: offset {} + 4 > data size {}", ptr->offset, data.size());
+		}
+		auto ptr = read_pointer(field, data);
+		if (!ptr)
+			return fail(EINVAL, "Unknown offset ptr version: {}", field->offset_ptr_version);
+		if (ptr->size == 0)
+			return 0;
+		if (ptr->entity < field->type_ptr->size)
+			return fail(EINVAL, "Entity size {} is less then element size {}", ptr->entity, field->type_ptr->size);
+		if (ptr->offset > data.size())
+			return fail(EINVAL, "Offset out of bounds: offset {} > data size {}", ptr->offset, data.size());
+		if (ptr->entity && (data.size() - ptr->offset) / ptr->entity < ptr->size)
+			return fail(EINVAL, "Offset data out of bounds: offset {} + data {} * entity {} > data size {}", ptr->offset, ptr->size, ptr->entity, data.size());
+		if (auto & plan = c.nested.front(); plan) {
+			for (size_t i = 0; i < ptr->size; i++) {
+				if (auto r = validate(*plan, data.view(ptr->offset + i * ptr->entity)); r)
+					return fail_index(r, i);
+			}
+		}
+		return 0;
+	}
+
+	template <typename View>
+	int validate_array(const Check &c, const View &data)
+	{
+		auto field = c.field;
+		auto count = read_size(field->count_ptr, data.view(field->count_ptr->offset));
+		if (count < 0 || (size_t) count > field->count)
+			return fail(EINVAL, "Array size {} out of bounds: max {}", count, field->count);
+		if (auto & plan = c.nested.front(); plan) {
+			for (auto i = 0; i < count; i++) {
+				if (auto r = validate(*plan, data.view(field->type_array->offset + i * field->type_array->size)); r)
+					return fail_index(r, i);
+			}
+		}
+		return 0;
+	}
+
+	template <typename View>
+	int validate_union(const Check &c, const View &data)
+	{
+		auto desc = c.field->type_union;
+		auto idx = read_size(desc->type_ptr, data);
+		if (idx < 0 || (size_t) idx >= desc->fields_size)
+			return fail(EINVAL, "Union index out of bounds: {} >= {}", idx, desc->fields_size);
+		if (auto & plan = c.nested[idx]; plan) {
+			if (auto r = validate(*plan, data.view(desc->type_ptr->size)); r)
+				return fail_field(r, desc->fields + idx);
+		}
+		return 0;
+	}
+};
+
+} // namespace tll::scheme
+
+#endif//_TLL_SCHEME_VALIDATE_H
@@ -146,7 +146,9 @@ tll_stat_page_t * tll_stat_iter_swap(tll_stat_iter_t *);
 
 #ifdef __cplusplus
 
+#include <algorithm>
 #include <atomic>
+#include <cerrno>
 #include <cstring>
 #include <limits>
 #include <memory>
@@ -268,6 +270,198 @@ using IntegerGroup = GroupT<tll_stat_int_t, U, C0, C1, C2, C3, C4, C5, C6>;
 template <Unit U = Unknown, char C0 = 0, char C1 = 0, char C2 = 0, char C3 = 0, char C4 = 0, char C5 = 0, char C6 = 0>
 using FloatGroup = GroupT<tll_stat_float_t, U, C0, C1, C2, C3, C4, C5, C6>;
 
+/**
+ * Log-linear bucket layout used by histogram fields
+ *
+ * Values below ``2 ^ precision`` have their own buckets, each next power of two range is split into
+ * ``2 ^ precision`` equal buckets, so relative bucket width is not more then ``2 ^ -precision``.
+ * Negative values are accounted in first bucket.
+ */
+namespace histogram {
+
+/// Name prefix of histogram header field, followed by precision digit
+static constexpr std::string_view header_prefix = "_tllhs";
+/// Name of bucket field
+static constexpr std::string_view bucket_name = "_tllbkt";
+
+constexpr unsigned index(unsigned precision, tll_stat_int_t v)
+{
+	if (v < (tll_stat_int_t) (1ull << precision))
+		return v < 0 ? 0 : v;
+	const unsigned e = 63 - __builtin_clzll(v);
+	return ((e - precision + 1) << precision) + ((v >> (e - precision)) & ((1u << precision) - 1));
+}
+
+/// Lowest value that falls into the bucket
+constexpr tll_stat_int_t lower(unsigned precision, unsigned idx)
+{
+	const unsigned sub = 1u << precision;
+	if (idx < sub)
+		return idx;
+	const unsigned e = idx / sub + precision - 1;
+	return (tll_stat_int_t) (sub + idx % sub) << (e - precision);
+}
+
+/// Highest value that falls into the bucket
+constexpr tll_stat_int_t upper(unsigned precision, unsigned idx)
+{
+	return lower(precision, idx + 1) - 1;
+}
+
+} // namespace histogram
+
+/**
+ * View of histogram fields in the page: header (count), sum, min, max and list of bucket counters.
+ * Used to read or update histogram when its layout is not known at compile time.
+ */
+template <typename F>
+class HistogramViewT
+{
+	F * _ptr = nullptr;
+	unsigned _precision = 0;
+	unsigned _buckets = 0;
+
+ public:
+	HistogramViewT() = default;
+	HistogramViewT(F * ptr, unsigned precision, unsigned buckets) : _ptr(ptr), _precision(precision), _buckets(buckets) {}
+
+	/// Check if fields starting from ``ptr`` hold histogram, return empty view if not
+	static HistogramViewT parse(F * ptr, F * end)
+	{
+		if (end - ptr < 4 || ptr->name().substr(0, histogram::header_prefix.size()) != histogram::header_prefix)
+			return {};
+		auto name = ptr->name();
+		if (name.size() != histogram::header_prefix.size() + 1 || name.back() < '0' || name.back() > '9')
+			return {};
+		unsigned buckets = 0;
+		for (auto b = ptr + 4; b != end && b->name() == histogram::bucket_name; b++)
+			buckets++;
+		if (!buckets)
+			return {};
+		return { ptr, (unsigned) (name.back() - '0'), buckets };
+	}
+
+	explicit operator bool () const { return _ptr != nullptr; }
+
+	unsigned precision() const { return _precision; }
+	/// Number of bucket counters
+	unsigned buckets() const { return _buckets; }
+	/// Number of fields occupied by histogram
+	size_t size() const { return 4 + _buckets; }
+
+	F * fields() const { return _ptr; }
+	std::string_view name() const { return _ptr[1].name(); }
+	Unit unit() const { return _ptr[1].unit(); }
+
+	tll_stat_int_t count() const { return _ptr[0].value; }
+	tll_stat_int_t sum() const { return _ptr[1].value; }
+	tll_stat_int_t min() const { return _ptr[2].value; }
+	tll_stat_int_t max() const { return _ptr[3].value; }
+	tll_stat_int_t bucket(unsigned idx) const { return _ptr[4 + idx].value; }
+
+	void update(tll_stat_int_t v)
+	{
+		_ptr[0].value++;
+		_ptr[1].value += v;
+		_ptr[2].value = std::min(_ptr[2].value, v);
+		_ptr[3].value = std::max(_ptr[3].value, v);
+		_ptr[4 + std::min(histogram::index(_precision, v), _buckets - 1)].value++;
+	}
+
+	/**
+	 * Add data from other histogram with same precision, buckets that don't fit are merged into last one
+	 *
+	 * @return 0 on success or ``EINVAL`` if precision is different, histogram is not changed in this case.
+	 */
+	template <typename R>
+	int merge(const HistogramViewT<R> &rhs)
+	{
+		if (rhs.precision() != _precision)
+			return EINVAL;
+		if (!rhs.count())
+			return 0;
+		_ptr[0].value += rhs.count();
+		_ptr[1].value += rhs.sum();
+		_ptr[2].value = std::min(_ptr[2].value, rhs.min());
+		_ptr[3].value = std::max(_ptr[3].value, rhs.max());
+		for (auto i = 0u; i < rhs.buckets(); i++)
+			_ptr[4 + std::min(i, _buckets - 1)].value += rhs.bucket(i);
+		return 0;
+	}
+
+	/**
+	 * Estimate quantile, ``q`` is in ``[0, 1]`` range
+	 *
+	 * Result is upper bound of the bucket where quantile falls, clamped to ``[min, max]`` range,
+	 * or maximum value if quantile is in the last bucket.
+	 */
+	tll_stat_int_t quantile(double q) const
+	{
+		if (!count())
+			return 0;
+		tll_stat_int_t rank = std::max<tll_stat_int_t>(1, q * count() + 0.5);
+		tll_stat_int_t sum = 0;
+		for (auto i = 0u; i < _buckets; i++) {
+			sum += bucket(i);
+			if (sum < rank)
+				continue;
+			if (i == _buckets - 1) // Last bucket holds all values above the range
+				return max();
+			return std::clamp(histogram::upper(_precision, i), min(), max());
+		}
+		return max();
+	}
+};
+
+using HistogramView = HistogramViewT<Field>;
+using ConstHistogramView = HistogramViewT<const Field>;
+
+/**
+ * Histogram field with log-linear buckets (see @ref tll::stat::histogram).
+ *
+ * Update is done without floating point operations and costs same as group update and one counter
+ * increment. Layout in the page is: header field with count of values and precision in the name,
+ * sum, min and max fields (same as in group) and bucket counters. Values larger then
+ * ``2 ^ Range`` are accounted in last bucket.
+ */
+template <unsigned Precision, unsigned Range, Unit U = Unknown, char C0 = 0, char C1 = 0, char C2 = 0, char C3 = 0, char C4 = 0, char C5 = 0, char C6 = 0>
+struct HistogramT
+{
+	static_assert(Precision <= 9, "Precision is encoded as one digit");
+	static_assert(Precision < Range && Range < 63, "Invalid histogram range");
+
+	static constexpr unsigned precision = Precision;
+	static constexpr unsigned buckets_size = (Range - Precision + 1) << Precision;
+
+	FieldT<tll_stat_int_t, Sum, Unknown, '_', 't', 'l', 'l', 'h', 's', (char) ('0' + Precision)> count;
+	FieldT<tll_stat_int_t, Sum, U, C0, C1, C2, C3, C4, C5, C6> sum;
+	FieldT<tll_stat_int_t, Min, U, C0, C1, C2, C3, C4, C5, C6> min;
+	FieldT<tll_stat_int_t, Max, U, C0, C1, C2, C3, C4, C5, C6> max;
+	FieldT<tll_stat_int_t, Sum, Unknown, '_', 't', 'l', 'l', 'b', 'k', 't'> buckets[buckets_size];
+
+	HistogramT & operator = (tll_stat_int_t v) { update(v); return *this; }
+
+	void update(tll_stat_int_t v)
+	{
+		count = 1;
+		sum = v;
+		min = v;
+		max = v;
+		buckets[std::min(histogram::index(Precision, v), buckets_size - 1)].value()++;
+	}
+
+	void merge(const HistogramT &rhs) { view().merge(rhs.view()); } // Same type, precision always matches
+
+	HistogramView view() { return { &count, Precision, buckets_size }; }
+	ConstHistogramView view() const { return { &count, Precision, buckets_size }; }
+
+	tll_stat_int_t quantile(double q) const { return view().quantile(q); }
+};
+
+/// Histogram with 12.5% bucket width and range up to 2^40 (more then 18 minutes in nanoseconds)
+template <Unit U = Unknown, char C0 = 0, char C1 = 0, char C2 = 0, char C3 = 0, char C4 = 0, char C5 = 0, char C6 = 0>
+using Histogram = HistogramT<3, 40, U, C0, C1, C2, C3, C4, C5, C6>;
+
 
 struct Page : public tll_stat_page_t
 {
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024 Pavel Shramov <shramov@mexmat.net>
+ *
+ * tll is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef _TLL_UTIL_ALLOCCOUNT_H
+#define _TLL_UTIL_ALLOCCOUNT_H
+
+#include <dlfcn.h>
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Process wide allocation counters, maintained by ``libtll-alloc-count.so`` that replaces global
+ * ``operator new`` and ``operator delete``. Library is loaded with ``LD_PRELOAD``, without it
+ * counters are not available.
+ */
+struct tll_alloc_count_t
+{
+	std::atomic<unsigned long long> alloc; ///< Number of allocations
+	std::atomic<unsigned long long> free; ///< Number of deallocations
+	std::atomic<long long> bytes; ///< Currently allocated bytes, as reported by malloc_usable_size
+};
+
+extern "C" {
+/// Get pointer to allocation counters, defined in libtll-alloc-count.so
+typedef const tll_alloc_count_t * (*tll_alloc_count_func_t)();
+}
+
+namespace tll::util {
+
+/// Reader of allocation counters, reports deltas between updates
+class AllocCount
+{
+	const tll_alloc_count_t * _counters = nullptr;
+	unsigned long long _alloc = 0;
+	unsigned long long _free = 0;
+
+ public:
+	unsigned long long alloc = 0; ///< Allocations since last update
+	unsigned long long free = 0; ///< Deallocations since last update
+	long long bytes = 0; ///< Currently allocated bytes
+
+	/// Lookup counters symbol, return false if counting allocator is not loaded
+	bool init()
+	{
+		auto func = (tll_alloc_count_func_t) dlsym(RTLD_DEFAULT, "tll_alloc_count");
+		if (!func)
+			return false;
+		_counters = func();
+		_alloc = _counters->alloc.load(std::memory_order_relaxed);
+		_free = _counters->free.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	explicit operator bool () const { return _counters != nullptr; }
+
+	void update()
+	{
+		if (!_counters)
+			return;
+		auto a = _counters->alloc.load(std::memory_order_relaxed);
+		auto f = _counters->free.load(std::memory_order_relaxed);
+		alloc = a - _alloc;
+		free = f - _free;
+		_alloc = a;
+		_free = f;
+		bytes = _counters->bytes.load(std::memory_order_relaxed);
+	}
+};
+
+} // namespace tll::util
+
+#endif//_TLL_UTIL_ALLOCCOUNT_H
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: Pavel Shramov <shramov@mexmat.net>
+
+#ifndef _TLL_UTIL_PERFEVENT_H
+#define _TLL_UTIL_PERFEVENT_H
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace tll::util {
+
+/**
+ * Set of perf event counters bound to the calling thread.
+ *
+ * Each counter is opened separately so unavailable ones (hardware counters in virtual machines or
+ * with restrictive ``perf_event_paranoid``) are skipped and others are still reported. Counters
+ * are read with multiplexing correction and reported as deltas between @ref update calls.
+ */
+class PerfEvent
+{
+ public:
+	enum Counter : unsigned { Cycles, Instructions, CacheMisses, ContextSwitches, Migrations, Size };
+
+	static constexpr std::string_view counter_name(Counter c)
+	{
+		switch (c) {
+		case Cycles: return "cycles";
+		case Instructions: return "instructions";
+		case CacheMisses: return "cache-misses";
+		case ContextSwitches: return "context-switches";
+		case Migrations: return "cpu-migrations";
+		case Size: break;
+		}
+		return "unknown";
+	}
+
+	/// Counter increments since last update, zero for unavailable counters
+	std::array<uint64_t, Size> delta = {};
+
+ private:
+	std::array<int, Size> _fd;
+	std::array<uint64_t, Size> _last = {};
+
+ public:
+	PerfEvent() { _fd.fill(-1); }
+	~PerfEvent() { close(); }
+
+	PerfEvent(const PerfEvent &) = delete;
+	PerfEvent & operator = (const PerfEvent &) = delete;
+
+	bool available(Counter c) const { return _fd[c] != -1; }
+
+	/// True if at least one hardware counter is opened
+	bool hardware() const { return available(Cycles) || available(Instructions) || available(CacheMisses); }
+
+	/**
+	 * Open counters for the calling thread
+	 *
+	 * @return 0 if at least one counter is opened, otherwise errno of last failure
+	 */
+	int open()
+	{
+		close();
+		int r = ENOSYS;
+		unsigned count = 0;
+		for (unsigned i = 0; i < Size; i++) {
+			if (auto fd = _open((Counter) i); fd >= 0) {
+				_fd[i] = fd;
+				count++;
+			} else
+				r = -fd;
+		}
+		if (!count)
+			return r;
+		_read(_last);
+		delta.fill(0);
+		return 0;
+	}
+
+	void close()
+	{
+		for (auto & fd : _fd) {
+			if (fd != -1)
+				::close(fd);
+			fd = -1;
+		}
+		_last.fill(0);
+		delta.fill(0);
+	}
+
+	void update()
+	{
+		std::array<uint64_t, Size> values = {};
+		_read(values);
+		for (unsigned i = 0; i < Size; i++) {
+			delta[i] = values[i] >= _last[i] ? values[i] - _last[i] : 0;
+			_last[i] = values[i];
+		}
+	}
+
+ private:
+#ifdef __linux__
+	static int _open(Counter c)
+	{
+		struct perf_event_attr attr = {};
+		attr.size = sizeof(attr);
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.exclude_hv = 1;
+		switch (c) {
+		case Cycles: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+		case Instructions: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+		case CacheMisses: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+		case ContextSwitches: attr.type = PERF_TYPE_SOFTWARE; attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES; break;
+		case Migrations: attr.type = PERF_TYPE_SOFTWARE; attr.config = PERF_COUNT_SW_CPU_MIGRATIONS; break;
+		case Size: return -EINVAL;
+		}
+
+		auto fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+		if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+			// Unprivileged process can count only user space events
+			attr.exclude_kernel = 1;
+			fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+		}
+		if (fd < 0)
+			return -errno;
+		return fd;
+	}
+
+	void _read(std::array<uint64_t, Size> &values) const
+	{
+		for (unsigned i = 0; i < Size; i++) {
+			if (_fd[i] == -1)
+				continue;
+			uint64_t data[3] = {}; // Value, time enabled, time running
+			if (::read(_fd[i], data, sizeof(data)) != sizeof(data))
+				continue;
+			if (data[2] && data[2] < data[1]) // Counter was multiplexed, scale it
+				data[0] = (uint64_t) ((double) data[0] * data[1] / data[2]);
+			values[i] = data[0];
+		}
+	}
+#else
+	static int _open(Counter c) { return -ENOSYS; }
+	void _read(std::array<uint64_t, Size> &values) const {}
+#endif
+};
+
+} // namespace tll::util
+
+#endif//_TLL_UTIL_PERFEVENT_H
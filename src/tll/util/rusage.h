@@ -26,6 +26,8 @@ class RUsage
 	nanoseconds cpu;
 	double cpu_ratio = 0;
 	size_t memory = 0;
+	long vcsw = 0; ///< Voluntary context switches
+	long ivcsw = 0; ///< Involuntary context switches
 
 	enum Type { Process, Thread };
 	RUsage(Type type = Process)
@@ -42,6 +44,7 @@ class RUsage
 		cpu = {};
 		cpu_ratio = {};
 		memory = {};
+		vcsw = ivcsw = 0;
 	}
 
 	int update()
@@ -61,6 +64,8 @@ class RUsage
 		_last = now;
 		cpu = cnew;
 		memory = _rusage.ru_maxrss * 1024; // Kilobytes
+		vcsw = _rusage.ru_nvcsw;
+		ivcsw = _rusage.ru_nivcsw;
 		return 0;
 	}
 
@@ -28,6 +28,28 @@ long long tll_time_now_cached();
  */
 void tll_time_cache_enable(int enable);
 
+/// Clock source used by @ref tll_time_now
+typedef enum {
+	TLL_TIME_CLOCK_REALTIME = 0, ///< ``clock_gettime(CLOCK_REALTIME)`` on each call
+	TLL_TIME_CLOCK_TSC = 1, ///< Invariant TSC, slewed to ``CLOCK_REALTIME`` once per second
+} tll_time_clock_t;
+
+/** Select process wide clock source for @ref tll_time_now
+ *
+ * @return 0 on success, ENOTSUP if TSC is not available or not invariant, EINVAL for unknown clock
+ */
+int tll_time_clock_set(tll_time_clock_t clock);
+
+/// Get current clock source
+tll_time_clock_t tll_time_clock_get();
+
+/// Raw cycle counter for interval measurement: invariant TSC on x86, monotonic nanoseconds if TSC is
+/// not available or not invariant
+long long tll_time_cycles();
+
+/// Convert difference of two @ref tll_time_cycles values into nanoseconds
+long long tll_time_cycles_to_ns(long long cycles);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -53,6 +75,11 @@ static constexpr time_point epoch = {};
 
 static inline void cache_enable(bool enable) { tll_time_cache_enable(enable); }
 
+/// Raw cycle counter, use @ref cycles_to_duration to convert difference between two values
+static inline long long cycles() { return tll_time_cycles(); }
+
+static inline duration cycles_to_duration(long long cycles) { return duration(tll_time_cycles_to_ns(cycles)); }
+
 } // namespace time
 
 template <typename To, typename R, typename P>
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2024 Pavel Shramov <shramov@mexmat.net>
+ *
+ * tll is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef _TLL_UTIL_TIMERWHEEL_H
+#define _TLL_UTIL_TIMERWHEEL_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace tll::util {
+
+/**
+ * Hierarchical timing wheel with 4 levels of 64 slots.
+ *
+ * Time is measured in abstract ticks, entries are intrusive so insert and remove are O(1) and
+ * do not allocate. Level N holds entries that expire in less then 64^(N+1) ticks, they are moved
+ * to lower level (cascaded) when wheel reaches their slot. Entries that are further then 2^24
+ * ticks are kept in the last level and cascaded again until they get into range.
+ */
+class TimerWheel
+{
+ public:
+	static constexpr unsigned bits = 6;
+	static constexpr unsigned slots = 1u << bits;
+	static constexpr unsigned levels = 4;
+	static constexpr uint64_t mask = slots - 1;
+	static constexpr uint64_t range = 1ull << (bits * levels);
+	static constexpr uint64_t never = std::numeric_limits<uint64_t>::max();
+
+	struct Entry
+	{
+		Entry * prev = nullptr;
+		Entry * next = nullptr;
+		uint64_t expire = 0; ///< Expiration tick
+
+		bool linked() const { return next != nullptr; }
+
+	 private:
+		friend class TimerWheel;
+
+		void _unlink()
+		{
+			prev->next = next;
+			next->prev = prev;
+			prev = next = nullptr;
+		}
+
+		void _link(Entry * head)
+		{
+			prev = head->prev;
+			next = head;
+			head->prev->next = this;
+			head->prev = this;
+		}
+	};
+
+ private:
+	struct List : public Entry
+	{
+		List() { prev = next = this; }
+		List(const List &) = delete;
+		List & operator = (const List &) = delete;
+
+		bool empty() const { return next == this; }
+
+		/// Move all entries into other empty list
+		void splice(List &to)
+		{
+			if (empty())
+				return;
+			to.next = next;
+			to.prev = prev;
+			next->prev = &to;
+			prev->next = &to;
+			prev = next = this;
+		}
+	};
+
+	std::array<std::array<List, slots>, levels> _slots;
+	std::array<uint64_t, levels> _bitmap = {}; ///< Non-empty slots, may have stale bits after remove
+	uint64_t _next = 0; ///< Next tick to process
+	size_t _size = 0;
+
+ public:
+	/// Next tick that is not yet processed
+	uint64_t now() const { return _next; }
+	size_t size() const { return _size; }
+
+	/// Insert entry that expires at given tick, past ticks are processed on next advance
+	void insert(Entry * e, uint64_t expire)
+	{
+		e->expire = expire;
+		uint64_t delta = expire > _next ? expire - _next : 0;
+		if (delta >= range)
+			delta = range - 1;
+		const auto tick = _next + delta;
+
+		unsigned level = 0;
+		while (level + 1 < levels && delta >= (1ull << (bits * (level + 1))))
+			level++;
+		const auto idx = (tick >> (bits * level)) & mask;
+		e->_link(&_slots[level][idx]);
+		_bitmap[level] |= 1ull << idx;
+		_size++;
+	}
+
+	void remove(Entry * e)
+	{
+		if (!e->linked())
+			return;
+		e->_unlink();
+		_size--;
+	}
+
+	/**
+	 * Lower bound of nearest expiration tick or @ref never if wheel is empty
+	 *
+	 * Result is either expiration tick of first entry in the lowest level or tick when one of
+	 * higher level slots is cascaded. It is safe to skip all ticks before returned value.
+	 */
+	uint64_t next_expire() const
+	{
+		if (!_size)
+			return never;
+		uint64_t r = never;
+		for (unsigned l = 0; l < levels; l++) {
+			if (!_bitmap[l])
+				continue;
+			const auto shift = bits * l;
+			const uint64_t step = 1ull << shift;
+			const auto base = ((_next + step - 1) >> shift) << shift;
+			const auto idx = (base >> shift) & mask;
+			const auto rot = idx ? (_bitmap[l] >> idx) | (_bitmap[l] << (slots - idx)) : _bitmap[l];
+			r = std::min<uint64_t>(r, base + ((uint64_t) __builtin_ctzll(rot) << shift));
+		}
+		return r;
+	}
+
+	/**
+	 * Process all ticks up to and including ``tick``, call ``f(Entry *)`` for each expired entry.
+	 *
+	 * Entry is removed from the wheel before callback, callback may insert or remove any entries.
+	 */
+	template <typename F>
+	void advance(uint64_t tick, F f)
+	{
+		while (_next <= tick) {
+			auto n = next_expire();
+			if (n > tick) {
+				_next = tick + 1;
+				return;
+			}
+			_next = n;
+			_step(f);
+		}
+	}
+
+ private:
+	void _cascade(unsigned level, unsigned idx)
+	{
+		List list;
+		_slots[level][idx].splice(list);
+		_bitmap[level] &= ~(1ull << idx);
+		while (!list.empty()) {
+			auto e = list.next;
+			e->_unlink();
+			_size--;
+			insert(e, e->expire);
+		}
+	}
+
+	template <typename F>
+	void _step(F &f)
+	{
+		const auto idx = _next & mask;
+		if (idx == 0) {
+			for (unsigned l = 1; l < levels; l++) {
+				const auto i = (_next >> (bits * l)) & mask;
+				_cascade(l, i);
+				if (i != 0)
+					break;
+			}
+		}
+
+		List list;
+		_slots[0][idx].splice(list);
+		_bitmap[0] &= ~(1ull << idx);
+		// Entries inserted from callbacks with past expiration should get into next slot
+		_next++;
+		while (!list.empty()) {
+			auto e = list.next;
+			e->_unlink();
+			_size--;
+			f(e);
+		}
+	}
+};
+
+} // namespace tll::util
+
+#endif//_TLL_UTIL_TIMERWHEEL_H
@@ -18,7 +18,7 @@ template <typename T, typename Buf>
 size_t encode_uint(T value, Buf & buf)
 {
 	static_assert(std::is_unsigned<T>::value, "Unsigned type only");
-	buf.resize(sizeof(value) * 8 / 7);
+	buf.resize((sizeof(value) * 8 + 6) / 7);
 	auto ptr = (u8 *) buf.data();
 	do {
 		u8 b = value & 0x7fu;
@@ -35,13 +35,13 @@ int decode_uint(T& value, const void * data, size_t size)
 {
 	static_assert(std::is_unsigned<T>::value, "Unsigned type only");
 	auto ptr = (const u8 *) data;
-	unsigned limit = std::min<unsigned>(size, std::min<unsigned>(9, sizeof(T) * 8 / 7));
+	unsigned limit = std::min<unsigned>(size, (sizeof(T) * 8 + 6) / 7);
 	value = 0;
 	for (unsigned i = 0; i < limit; i++) {
 		u8 b = ptr[i];
-		value |= (b & 0x7f) << (7 * i);
+		value |= T(b & 0x7f) << (7 * i);
 		if ((b & 0x80) == 0)
-			return i + 1; // Bytes consumed, max 9 bytes
+			return i + 1; // Bytes consumed, max 10 bytes
 	}
 	return -1;
 }
@@ -25,6 +25,7 @@ struct Header
 {
 	static constexpr size_t meta_size() { return 16; }
 	static constexpr std::string_view meta_name() { return "Header"; }
+	static constexpr bool meta_fixed() { return false; }
 	static constexpr size_t offset_header = 0;
 	static constexpr size_t offset_value = 8;
 
@@ -35,6 +36,7 @@ struct Header
 
 		static constexpr auto meta_size() { return Header::meta_size(); }
 		static constexpr auto meta_name() { return Header::meta_name(); }
+		static constexpr auto meta_fixed() { return Header::meta_fixed(); }
 		void view_resize() { this->_view_resize(meta_size()); }
 
 		template <typename RBuf>
@@ -44,6 +46,18 @@ struct Header
 			set_value(rhs.get_value());
 		}
 
+		/// Check that message and all its variable size fields are inside buffer
+		bool validate() const
+		{
+			if (this->view().size() < meta_size())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::String<const Buf, tll_scheme_offset_ptr_t>>(offset_header).validate())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::String<const Buf, tll_scheme_offset_ptr_t>>(offset_value).validate())
+				return false;
+			return true;
+		}
+
 		std::string_view get_header() const { return this->template _get_string<tll_scheme_offset_ptr_t>(offset_header); }
 		void set_header(std::string_view v) { return this->template _set_string<tll_scheme_offset_ptr_t>(offset_header, v); }
 
@@ -56,6 +70,9 @@ struct Header
 
 	template <typename Buf>
 	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
+
+	template <typename Buf>
+	static bool validate(const Buf &buf, size_t offset = 0) { return bind(buf, offset).validate(); }
 };
 
 struct connect
@@ -63,6 +80,7 @@ struct connect
 	static constexpr size_t meta_size() { return 43; }
 	static constexpr std::string_view meta_name() { return "connect"; }
 	static constexpr int meta_id() { return 1; }
+	static constexpr bool meta_fixed() { return false; }
 	static constexpr size_t offset_method = 0;
 	static constexpr size_t offset_code = 1;
 	static constexpr size_t offset_size = 3;
@@ -79,6 +97,7 @@ struct connect
 		static constexpr auto meta_size() { return connect::meta_size(); }
 		static constexpr auto meta_name() { return connect::meta_name(); }
 		static constexpr auto meta_id() { return connect::meta_id(); }
+		static constexpr auto meta_fixed() { return connect::meta_fixed(); }
 		void view_resize() { this->_view_resize(meta_size()); }
 
 		template <typename RBuf>
@@ -93,6 +112,18 @@ struct connect
 			set_bytestring(rhs.get_bytestring());
 		}
 
+		/// Check that message and all its variable size fields are inside buffer
+		bool validate() const
+		{
+			if (this->view().size() < meta_size())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::String<const Buf, tll_scheme_offset_ptr_t>>(offset_path).validate())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::List<const Buf, Header::binder_type<const Buf>, tll_scheme_offset_ptr_t>>(offset_headers).validate())
+				return false;
+			return true;
+		}
+
 		using type_method = method_t;
 		type_method get_method() const { return this->template _get_scalar<type_method>(offset_method); }
 		void set_method(type_method v) { return this->template _set_scalar<type_method>(offset_method, v); }
@@ -126,6 +157,9 @@ struct connect
 
 	template <typename Buf>
 	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
+
+	template <typename Buf>
+	static bool validate(const Buf &buf, size_t offset = 0) { return bind(buf, offset).validate(); }
 };
 
 struct disconnect
@@ -133,6 +167,7 @@ struct disconnect
 	static constexpr size_t meta_size() { return 10; }
 	static constexpr std::string_view meta_name() { return "disconnect"; }
 	static constexpr int meta_id() { return 2; }
+	static constexpr bool meta_fixed() { return false; }
 	static constexpr size_t offset_code = 0;
 	static constexpr size_t offset_error = 2;
 
@@ -144,6 +179,7 @@ struct disconnect
 		static constexpr auto meta_size() { return disconnect::meta_size(); }
 		static constexpr auto meta_name() { return disconnect::meta_name(); }
 		static constexpr auto meta_id() { return disconnect::meta_id(); }
+		static constexpr auto meta_fixed() { return disconnect::meta_fixed(); }
 		void view_resize() { this->_view_resize(meta_size()); }
 
 		template <typename RBuf>
@@ -153,6 +189,16 @@ struct disconnect
 			set_error(rhs.get_error());
 		}
 
+		/// Check that message and all its variable size fields are inside buffer
+		bool validate() const
+		{
+			if (this->view().size() < meta_size())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::String<const Buf, tll_scheme_offset_ptr_t>>(offset_error).validate())
+				return false;
+			return true;
+		}
+
 		using type_code = int16_t;
 		type_code get_code() const { return this->template _get_scalar<type_code>(offset_code); }
 		void set_code(type_code v) { return this->template _set_scalar<type_code>(offset_code, v); }
@@ -166,6 +212,9 @@ struct disconnect
 
 	template <typename Buf>
 	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
+
+	template <typename Buf>
+	static bool validate(const Buf &buf, size_t offset = 0) { return bind(buf, offset).validate(); }
 };
 
 struct List
@@ -173,6 +222,7 @@ struct List
 	static constexpr size_t meta_size() { return 28; }
 	static constexpr std::string_view meta_name() { return "List"; }
 	static constexpr int meta_id() { return 10; }
+	static constexpr bool meta_fixed() { return false; }
 	static constexpr size_t offset_std = 0;
 	static constexpr size_t offset_llong = 8;
 	static constexpr size_t offset_lshort = 16;
@@ -186,6 +236,7 @@ struct List
 		static constexpr auto meta_size() { return List::meta_size(); }
 		static constexpr auto meta_name() { return List::meta_name(); }
 		static constexpr auto meta_id() { return List::meta_id(); }
+		static constexpr auto meta_fixed() { return List::meta_fixed(); }
 		void view_resize() { this->_view_resize(meta_size()); }
 
 		template <typename RBuf>
@@ -197,6 +248,22 @@ struct List
 			get_scalar().copy(rhs.get_scalar());
 		}
 
+		/// Check that message and all its variable size fields are inside buffer
+		bool validate() const
+		{
+			if (this->view().size() < meta_size())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::List<const Buf, disconnect::binder_type<const Buf>, tll_scheme_offset_ptr_t>>(offset_std).validate())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::List<const Buf, disconnect::binder_type<const Buf>, tll_scheme_offset_ptr_legacy_long_t>>(offset_llong).validate())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::List<const Buf, disconnect::binder_type<const Buf>, tll_scheme_offset_ptr_legacy_short_t>>(offset_lshort).validate())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::List<const Buf, int16_t, tll_scheme_offset_ptr_t>>(offset_scalar).validate())
+				return false;
+			return true;
+		}
+
 		using type_std = tll::scheme::binder::List<Buf, disconnect::binder_type<Buf>, tll_scheme_offset_ptr_t>;
 		using const_type_std = tll::scheme::binder::List<const Buf, disconnect::binder_type<const Buf>, tll_scheme_offset_ptr_t>;
 		const_type_std get_std() const { return this->template _get_binder<const_type_std>(offset_std); }
@@ -223,6 +290,9 @@ struct List
 
 	template <typename Buf>
 	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
+
+	template <typename Buf>
+	static bool validate(const Buf &buf, size_t offset = 0) { return bind(buf, offset).validate(); }
 };
 
 struct Copy
@@ -230,6 +300,7 @@ struct Copy
 	static constexpr size_t meta_size() { return 128; }
 	static constexpr std::string_view meta_name() { return "Copy"; }
 	static constexpr int meta_id() { return 20; }
+	static constexpr bool meta_fixed() { return false; }
 	static constexpr size_t offset_header = 0;
 	static constexpr size_t offset_i64 = 16;
 	static constexpr size_t offset_f64 = 24;
@@ -247,6 +318,7 @@ struct Copy
 		static constexpr auto meta_size() { return Copy::meta_size(); }
 		static constexpr auto meta_name() { return Copy::meta_name(); }
 		static constexpr auto meta_id() { return Copy::meta_id(); }
+		static constexpr auto meta_fixed() { return Copy::meta_fixed(); }
 		void view_resize() { this->_view_resize(meta_size()); }
 
 		template <typename RBuf>
@@ -262,6 +334,24 @@ struct Copy
 			get_lstr().copy(rhs.get_lstr());
 		}
 
+		/// Check that message and all its variable size fields are inside buffer
+		bool validate() const
+		{
+			if (this->view().size() < meta_size())
+				return false;
+			if (!this->template _get_binder<Header::binder_type<const Buf>>(offset_header).validate())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::String<const Buf, tll_scheme_offset_ptr_t>>(offset_str).validate())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::List<const Buf, Header::binder_type<const Buf>, tll_scheme_offset_ptr_t>>(offset_lmsg).validate())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::List<const Buf, int64_t, tll_scheme_offset_ptr_t>>(offset_li64).validate())
+				return false;
+			if (!this->template _get_binder<tll::scheme::binder::List<const Buf, tll::scheme::binder::String<const Buf, tll_scheme_offset_ptr_t>, tll_scheme_offset_ptr_t>>(offset_lstr).validate())
+				return false;
+			return true;
+		}
+
 		using type_header = Header::binder_type<Buf>;
 		using const_type_header = Header::binder_type<const Buf>;
 		const_type_header get_header() const { return this->template _get_binder<const_type_header>(offset_header); }
@@ -302,6 +392,9 @@ struct Copy
 
 	template <typename Buf>
 	static binder_type<Buf> bind_reset(Buf &buf) { return tll::scheme::make_binder_reset<binder_type, Buf>(buf); }
+
+	template <typename Buf>
+	static bool validate(const Buf &buf, size_t offset = 0) { return bind(buf, offset).validate(); }
 };
 
 } // namespace http_binder
@@ -14,6 +14,7 @@
 #include "tll/channel/prefix.h"
 #include "tll/channel/reopen.h"
 #include "tll/channel/tagged.h"
+#include "tll/channel/tcp.h"
 #include "tll/processor/loop.h"
 #include "tll/util/ownedmsg.h"
 
@@ -507,6 +508,50 @@ TEST(Channel, Tcp)
 	ASSERT_EQ(c1.result.size(), 0u);
 }
 
+TEST(Channel, TcpBufferPool)
+{
+	using tll::channel::BufferPool;
+	using tll::channel::PartialBuffer;
+
+	BufferPool pool;
+	EXPECT_EQ(BufferPool::size_class(0), BufferPool::min_size);
+	EXPECT_EQ(BufferPool::size_class(BufferPool::min_size + 1), 2 * BufferPool::min_size);
+	EXPECT_EQ(BufferPool::size_class(64 * 1024), 64 * 1024);
+
+	PartialBuffer buf;
+	pool.acquire(buf, 10000);
+	ASSERT_EQ(buf.capacity(), 16384u);
+
+	// Grown buffer stays in size class and is reused for smaller requests of the same class
+	buf.extend(10000);
+	BufferPool::reserve(buf, 10000);
+	ASSERT_EQ(buf.capacity(), 32768u);
+	ASSERT_EQ(buf.size(), 10000u);
+	auto ptr = buf.buf.data();
+	pool.release(buf);
+	ASSERT_EQ(buf.capacity(), 0u);
+	ASSERT_EQ(pool.size(), 1u);
+
+	pool.acquire(buf, 20000);
+	ASSERT_EQ(buf.capacity(), 32768u);
+	ASSERT_EQ(buf.buf.data(), ptr);
+	ASSERT_EQ(pool.size(), 0u);
+	pool.release(buf);
+
+	// Buffers not in size class are dropped
+	buf.buf.resize(10000);
+	pool.release(buf);
+	ASSERT_EQ(pool.size(), 1u);
+
+	// Each size class keeps limited number of free buffers
+	std::vector<PartialBuffer> list(BufferPool::max_free + 4);
+	for (auto & b : list)
+		pool.acquire(b, 100);
+	for (auto & b : list)
+		pool.release(b);
+	ASSERT_EQ(pool.size(), BufferPool::max_free + 1);
+}
+
 TEST(Channel, Reopen)
 {
 	auto ctx = tll::channel::Context(tll::Config());
@@ -2,6 +2,9 @@
 #include "tll/config.h"
 #include "tll/keyring.h"
 #include "tll/processor.h"
+#include "tll/processor/loop.h"
+#include "tll/processor/recorder.h"
+#include "tll/stat.h"
 
 #include <gtest/gtest.h>
 #include <thread>
@@ -255,3 +258,103 @@ TEST_F(ProcessorKeyring, Test)
 	ASSERT_TRUE(r);
 	ASSERT_EQ(r->str(), "body-a");
 }
+
+TEST(ProcessorRecorder, Ring)
+{
+	tll::processor::Recorder recorder;
+	ASSERT_EQ(recorder.init(64), ERANGE);
+	ASSERT_EQ(recorder.init(1024), 0);
+
+	auto ctx = tll::channel::Context(tll::Config());
+	auto c = ctx.channel("null://;name=null");
+	ASSERT_TRUE(c);
+
+	tll_msg_t msg = { TLL_MESSAGE_DATA };
+	for (auto i = 0; i < 100; i++) {
+		msg.seq = i;
+		msg.size = 2 * i;
+		recorder.message(c.get(), &msg);
+	}
+
+	std::vector<long long> seq;
+	recorder.for_each([&seq](auto &r) {
+		ASSERT_EQ(r.type, tll::processor::Recorder::Type::Message);
+		ASSERT_EQ(r.value, 2 * r.seq);
+		seq.push_back(r.seq);
+	});
+	ASSERT_GT(seq.size(), 10u);
+	ASSERT_LT(seq.size(), 100u);
+	ASSERT_EQ(seq.back(), 99);
+	for (auto i = 1u; i < seq.size(); i++)
+		ASSERT_EQ(seq[i - 1] + 1, seq[i]);
+
+	ASSERT_EQ(recorder.name(c.get()), "<unknown>");
+	recorder.name_add(c.get());
+	ASSERT_EQ(recorder.name(c.get()), "null");
+}
+
+TEST(ProcessorRecorder, Loop)
+{
+	auto ctx = tll::channel::Context(tll::Config());
+	auto cfg = tll::Config::load("yamls://{recorder: 4kb}");
+	ASSERT_TRUE(cfg);
+
+	tll::processor::Loop loop;
+	ASSERT_EQ(loop.init(*cfg), 0);
+	ASSERT_TRUE(loop._recorder);
+
+	auto c = ctx.channel("null://;name=null");
+	ASSERT_TRUE(c);
+	loop.add(c.get());
+	c->open();
+	c->close();
+
+	std::vector<tll_state_t> states;
+	loop._recorder->for_each([&states](auto &r) {
+		if (r.type == tll::processor::Recorder::Type::State)
+			states.push_back((tll_state_t) r.value);
+	});
+	ASSERT_EQ(states, std::vector<tll_state_t>({Opening, Active, Closing, Closed}));
+	ASSERT_EQ(loop.recorder_dump("test"), 0);
+	loop.del(c.get());
+}
+
+struct LoopStat
+{
+	tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 's', 't', 'e', 'p'> step;
+	tll::stat::Integer<tll::stat::Sum, tll::stat::Ns, 'p', 'o', 'l', 'l'> poll;
+	tll::stat::Integer<tll::stat::Sum, tll::stat::Unknown, 'b', 'u', 's', 'y'> busy;
+};
+
+#ifdef __linux__
+TEST(ProcessorLoop, BusyPending)
+{
+	auto ctx = tll::channel::Context(tll::Config());
+	auto cfg = tll::Config::load("yamls://{busy-poll: 10ms, pending-steps: 0}");
+	ASSERT_TRUE(cfg);
+
+	tll::processor::Loop loop;
+	ASSERT_EQ(loop.init(*cfg), 0);
+
+	tll::stat::Block<LoopStat> block("loop");
+	ASSERT_EQ(loop.stat(&block), 0);
+
+	auto c = ctx.channel("zero://;name=zero;size=1kb;fd=no;pending=yes");
+	ASSERT_TRUE(c);
+	loop.add(c.get());
+	c->open();
+	ASSERT_TRUE(loop.pending());
+
+	for (auto i = 0; i < 10; i++)
+		loop.step(10ms);
+
+	// Pending list passes are not found by busy polling
+	auto page = tll::stat::swap(&block);
+	ASSERT_NE(page, nullptr);
+	auto data = &static_cast<tll::stat::PageT<LoopStat> *>(page)->data;
+	ASSERT_EQ(data->step.value(), 10);
+	ASSERT_EQ(data->busy.value(), 0);
+
+	loop.del(c.get());
+}
+#endif
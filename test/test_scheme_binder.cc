@@ -347,3 +347,49 @@ TEST(Scheme, BinderCopy)
 	ASSERT_EQ(copy.get_lstr()[2], "s2"sv);
 	ASSERT_EQ(copy.get_lstr()[3], "s3"sv);
 }
+
+TEST(Scheme, BinderValidate)
+{
+	std::vector<char> buf;
+	auto binder = http_binder::List::bind_reset(buf);
+
+	ASSERT_TRUE(http_binder::List::validate(buf));
+
+	binder.get_std().resize(2);
+	binder.get_std()[0].set_code(1);
+	binder.get_std()[0].set_error("error");
+	binder.get_std()[1].set_code(2);
+	binder.get_lshort().resize(1);
+	binder.get_scalar().resize(2);
+	binder.get_scalar()[0] = 100;
+	binder.get_scalar()[1] = 101;
+
+	ASSERT_TRUE(http_binder::List::validate(buf));
+	ASSERT_TRUE(http_binder::List::validate(tll::const_memory { buf.data(), buf.size() }));
+	ASSERT_FALSE(http_binder::List::validate(tll::const_memory { buf.data(), binder.meta_size() - 1 }));
+	ASSERT_FALSE(http_binder::List::validate(tll::const_memory { buf.data(), buf.size() - 1 }));
+
+	auto std = binder.get_std().dataT<http_scheme::disconnect>();
+	ASSERT_NE(std, nullptr);
+	ASSERT_EQ(std[0].code, 1);
+	ASSERT_EQ(std[1].code, 2);
+	ASSERT_EQ(binder.get_std().dataT<int16_t>(), nullptr);
+
+	auto scalar = binder.get_scalar().dataT<int16_t>();
+	ASSERT_NE(scalar, nullptr);
+	ASSERT_EQ(scalar[0], 100);
+	ASSERT_EQ(scalar[1], 101);
+
+	auto ptr = (http_scheme::List *) buf.data();
+	auto offset = ptr->std.offset;
+	ptr->std.offset = buf.size();
+	ASSERT_FALSE(http_binder::List::validate(buf));
+	ptr->std.offset = offset;
+
+	ptr->std.size = 100;
+	ASSERT_FALSE(http_binder::List::validate(buf));
+	ptr->std.size = 2;
+
+	ptr->std[0].error.offset = 1000;
+	ASSERT_FALSE(http_binder::List::validate(buf));
+}
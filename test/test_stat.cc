@@ -118,6 +118,83 @@ TYPED_TEST(StatT, Group)
 	ASSERT_EQ(bytes.max.value(), 20);
 }
 
+TEST(Stat, HistogramIndex)
+{
+	using namespace tll::stat::histogram;
+	for (auto p : {0u, 1u, 3u, 5u}) {
+		for (auto i = 0u; i < (1u << p); i++)
+			ASSERT_EQ(index(p, i), i);
+		ASSERT_EQ(index(p, -10), 0u);
+		for (auto i = 0u; i < 40u << p; i++) {
+			ASSERT_EQ(index(p, lower(p, i)), i) << "precision " << p;
+			ASSERT_EQ(index(p, upper(p, i)), i) << "precision " << p;
+			ASSERT_EQ(upper(p, i) + 1, lower(p, i + 1));
+		}
+	}
+
+	// Relative bucket width is not more then 2^-precision
+	ASSERT_EQ(lower(3, index(3, 1000)), 960);
+	ASSERT_EQ(upper(3, index(3, 1000)), 1023);
+}
+
+TEST(Stat, Histogram)
+{
+	using namespace tll::stat;
+	Histogram<Ns, 'l', 'a', 't'> hist;
+	using H = decltype(hist);
+
+	ASSERT_EQ(sizeof(hist), sizeof(tll_stat_field_t) * (4 + H::buckets_size));
+	ASSERT_EQ(hist.count.name(), "_tllhs3");
+	ASSERT_EQ(hist.sum.name(), "lat");
+	ASSERT_EQ(hist.sum.unit(), Ns);
+	ASSERT_EQ(hist.buckets[0].name(), "_tllbkt");
+	ASSERT_EQ(hist.quantile(0.5), 0);
+
+	for (auto i = 1; i <= 1000; i++)
+		hist = i;
+	hist = 1000000000000000; // Out of range, accounted in last bucket
+
+	ASSERT_EQ(hist.count.value(), 1001);
+	ASSERT_EQ(hist.min.value(), 1);
+	ASSERT_EQ(hist.max.value(), 1000000000000000);
+	ASSERT_EQ(hist.buckets[H::buckets_size - 1].value(), 1);
+
+	for (auto [q, v] : std::initializer_list<std::pair<double, int>> {{0.5, 500}, {0.9, 900}, {0.99, 990}}) {
+		auto r = hist.quantile(q);
+		ASSERT_GE(r, v);
+		ASSERT_LE(r, v * 1.125) << "Quantile " << q;
+	}
+	ASSERT_EQ(hist.quantile(1), 1000000000000000);
+
+	auto page = reinterpret_cast<const Field *>(&hist);
+	auto view = ConstHistogramView::parse(page, page + sizeof(hist) / sizeof(Field));
+	ASSERT_TRUE(view);
+	ASSERT_EQ(view.name(), "lat");
+	ASSERT_EQ(view.precision(), 3u);
+	ASSERT_EQ(view.buckets(), H::buckets_size);
+	ASSERT_EQ(view.quantile(0.5), hist.quantile(0.5));
+	ASSERT_FALSE(ConstHistogramView::parse(page + 1, page + sizeof(hist) / sizeof(Field)));
+
+	Histogram<Ns, 'l', 'a', 't'> other;
+	for (auto i = 0; i < 1001; i++)
+		other = 2000;
+	other.merge(hist);
+	ASSERT_EQ(other.count.value(), 2002);
+	ASSERT_EQ(other.min.value(), 1);
+	ASSERT_EQ(other.sum.value(), hist.sum.value() + 2000 * 1001);
+	ASSERT_LE(other.quantile(0.25), 500 * 1.125);
+	ASSERT_GE(other.quantile(0.75), 2000);
+
+	HistogramT<2, 40, Ns, 'l', 'a', 't'> coarse;
+	coarse = 10;
+	ASSERT_EQ(other.view().merge(coarse.view()), EINVAL);
+	ASSERT_EQ(other.count.value(), 2002);
+	ASSERT_EQ(coarse.view().merge(hist.view()), EINVAL);
+	ASSERT_EQ(coarse.count.value(), 1);
+	ASSERT_EQ(other.view().merge(hist.view()), 0);
+	ASSERT_EQ(other.count.value(), 3003);
+}
+
 struct Data
 {
 	tll::stat::Integer<tll::stat::Sum, tll::stat::Bytes, 'r', 'x'> rsum;
@@ -21,6 +21,7 @@
 #include "tll/util/string.h"
 #include "tll/util/tempfile.h"
 #include "tll/util/time.h"
+#include "tll/util/timerwheel.h"
 #include "tll/util/value_tree_check.h"
 #include "tll/util/url.h"
 #include "tll/util/varint.h"
@@ -28,10 +29,13 @@
 
 #include "tll/conv/bits.h"
 
+#include <atomic>
 #include <fmt/format.h>
 #include <list>
+#include <random>
 #include <stdio.h>
 #include <thread>
+#include <vector>
 
 #include "test_compat.h"
 
@@ -320,6 +324,8 @@ TEST(Util, Varint)
 	CHECK_VARINT(0x3fffu, 2, "\xff\x7f"sv);
 	CHECK_VARINT(0x1fffffu, 3, "\xff\xff\x7f"sv);
 	CHECK_VARINT(0xfffffffu, 4, "\xff\xff\xff\x7f"sv);
+	CHECK_VARINT(0xffffffffu, 5, "\xff\xff\xff\xff\x0f"sv);
+	CHECK_VARINT(0x7ffffffffull, 5, "\xff\xff\xff\xff\x7f"sv);
 }
 
 TEST(Util, Time)
@@ -349,6 +355,62 @@ TEST(Util, Time)
 	ASSERT_LT(tnow1, tll::time::now_cached());
 }
 
+TEST(Util, TimeTSC)
+{
+	using namespace std::chrono_literals;
+
+	ASSERT_EQ(tll_time_clock_set((tll_time_clock_t) 100), EINVAL);
+	ASSERT_EQ(tll_time_clock_get(), TLL_TIME_CLOCK_REALTIME);
+
+	auto c0 = tll::time::cycles();
+	std::this_thread::sleep_for(10ms);
+	auto dt = tll::time::cycles_to_duration(tll::time::cycles() - c0);
+	ASSERT_GE(dt, 9ms);
+	ASSERT_LT(dt, 100ms);
+
+	if (auto r = tll_time_clock_set(TLL_TIME_CLOCK_TSC); r) {
+		ASSERT_EQ(r, ENOTSUP);
+		GTEST_SKIP() << "TSC clock is not supported";
+	}
+	ASSERT_EQ(tll_time_clock_get(), TLL_TIME_CLOCK_TSC);
+
+	auto last = tll::time::now();
+	for (auto i = 0; i < 5; i++) {
+		auto snow = std::chrono::system_clock::now();
+		auto tnow = tll::time::now();
+		ASSERT_LT(std::chrono::abs(tnow - snow), 1ms);
+		ASSERT_GE(tnow, last);
+		last = tnow;
+		std::this_thread::sleep_for(300ms); // Cross recalibration interval
+	}
+
+	// Several threads read clock continuously across recalibration. Each value is compared with
+	// last value published by any thread before the call, small tolerance covers reads that race
+	// with anchor update and TSC skew between cores.
+	std::atomic<long long> published = tll_time_now();
+	std::atomic<unsigned> errors = 0;
+	const auto end = std::chrono::steady_clock::now() + 1200ms;
+	std::vector<std::thread> threads;
+	for (auto i = 0; i < 4; i++) {
+		threads.emplace_back([&]() {
+			long long local = 0;
+			while (std::chrono::steady_clock::now() < end) {
+				auto prev = published.load();
+				auto v = tll_time_now();
+				if (v < local || v < prev - 100)
+					errors++;
+				local = v;
+				while (prev < v && !published.compare_exchange_weak(prev, v)) {}
+			}
+		});
+	}
+	for (auto & t : threads)
+		t.join();
+	ASSERT_EQ(errors.load(), 0u);
+
+	ASSERT_EQ(tll_time_clock_set(TLL_TIME_CLOCK_REALTIME), 0);
+}
+
 TEST(Util, Filesystem)
 {
 	using namespace std::filesystem;
@@ -909,3 +971,69 @@ TEST(Util, MQDeleter)
 	ASSERT_EQ(data[3], 0x8000);
 	ASSERT_EQ(data[4], 0);
 }
+
+TEST(Util, TimerWheel)
+{
+	using Wheel = tll::util::TimerWheel;
+	struct Entry : public Wheel::Entry
+	{
+		uint64_t target = 0;
+		uint64_t fired = Wheel::never;
+	};
+
+	Wheel wheel;
+	ASSERT_EQ(wheel.next_expire(), Wheel::never);
+
+	std::mt19937 rng(42);
+	std::vector<Entry> entries(1000);
+	for (auto & e : entries) {
+		switch (rng() % 4) {
+		case 0: e.target = rng() % 64; break;
+		case 1: e.target = rng() % 4096; break;
+		case 2: e.target = rng() % (1u << 20); break;
+		case 3: e.target = Wheel::range + rng() % Wheel::range; break;
+		}
+		wheel.insert(&e, e.target);
+	}
+	ASSERT_EQ(wheel.size(), entries.size());
+
+	// Remove some entries and reinsert them with different expiration
+	for (auto i = 0u; i < entries.size(); i += 10) {
+		wheel.remove(&entries[i]);
+		ASSERT_FALSE(entries[i].linked());
+		entries[i].target = rng() % 8192;
+		wheel.insert(&entries[i], entries[i].target);
+	}
+
+	uint64_t tick = 0;
+	while (wheel.size()) {
+		ASSERT_LE(wheel.now(), wheel.next_expire());
+		tick += 1 + rng() % 100000;
+		wheel.advance(tick, [&tick](Wheel::Entry * ptr) {
+			auto e = static_cast<Entry *>(ptr);
+			ASSERT_FALSE(e->linked());
+			e->fired = tick;
+		});
+		ASSERT_EQ(wheel.now(), tick + 1);
+		for (auto & e : entries) {
+			if (e.target <= tick)
+				ASSERT_NE(e.fired, Wheel::never) << "Target " << e.target << ", tick " << tick;
+			else
+				ASSERT_EQ(e.fired, Wheel::never) << "Target " << e.target << ", tick " << tick;
+		}
+	}
+
+	// Periodic entry reinserted from callback, expired entry fires on next tick
+	Entry e;
+	unsigned count = 0;
+	wheel.insert(&e, 0);
+	for (auto i = 0; i < 10; i++) {
+		wheel.advance(++tick, [&](Wheel::Entry * ptr) {
+			count++;
+			wheel.insert(ptr, tick + 1);
+		});
+	}
+	ASSERT_EQ(count, 10u);
+	wheel.remove(&e);
+	ASSERT_EQ(wheel.size(), 0u);
+}